@@ -0,0 +1,31 @@
+# Try to find libfuse 3
+# Once done, this will define
+#
+# FUSE_FOUND        - system has libfuse 3
+# FUSE_INCLUDE_DIRS - the libfuse include directories
+# FUSE_LIBRARIES    - libfuse libraries directories
+
+if(FUSE_INCLUDE_DIRS AND FUSE_LIBRARIES)
+set(FUSE_FIND_QUIETLY TRUE)
+endif(FUSE_INCLUDE_DIRS AND FUSE_LIBRARIES)
+
+find_path(FUSE_INCLUDE_DIR fuse.h
+    HINTS
+    /usr/include/fuse3/
+    /usr/local/include/fuse3/
+)
+find_library(FUSE_LIBRARY fuse3
+    HINTS
+    /usr/lib/
+    /usr/local/lib/
+)
+
+set(FUSE_INCLUDE_DIRS ${FUSE_INCLUDE_DIR})
+set(FUSE_LIBRARIES ${FUSE_LIBRARY})
+
+# handle the QUIETLY and REQUIRED arguments and set FUSE_FOUND to TRUE if
+# all listed variables are TRUE
+include(FindPackageHandleStandardArgs)
+find_package_handle_standard_args(fuse DEFAULT_MSG FUSE_INCLUDE_DIR FUSE_LIBRARY)
+
+mark_as_advanced(FUSE_INCLUDE_DIR FUSE_LIBRARY)
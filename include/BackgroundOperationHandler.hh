@@ -32,6 +32,7 @@
 #include <functional>
 #include <condition_variable>
 #include <mutex>
+#include "LockProfiler.hh"
 #include <queue>
 
 namespace kio {
@@ -120,11 +121,11 @@ private:
   //! maximum number of background threads, atomic to support changeConfiguration
   std::atomic<size_t> thread_capacity;
   //! concurrency control for queue access;
-  std::mutex queue_mutex;
+  ProfiledMutex queue_mutex;
   //! workers block until an item is inserted into queue
-  std::condition_variable worker;
+  std::condition_variable_any worker;
   //! controller will be triggered when an item is removed from queue
-  std::condition_variable controller;
+  std::condition_variable_any controller;
   //! current number of active background threads
   std::atomic<size_t> numthreads;
   //! signal worker threads to shutdown
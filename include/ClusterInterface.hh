@@ -57,6 +57,18 @@ struct ClusterStats {
     uint64_t write_ops_period;
     uint64_t write_bytes_period;
 
+    /* Deduplication stats of this cluster instance: size of deduplicated values and of content actually stored */
+    uint64_t dedup_bytes_logical;
+    uint64_t dedup_bytes_stored;
+
+    /* Requests that had to wait for a submission slot of a drive and the total time they waited */
+    uint64_t queue_deferred_total;
+    std::chrono::microseconds queue_wait_total;
+
+    /* Connection attempts to the drives of this cluster and how many of them failed */
+    uint64_t reconnect_attempts_total;
+    uint64_t reconnect_failures_total;
+
     /* Cluster health as defined in AdminClusterInterface */
     ClusterStatus health;
 };
@@ -32,6 +32,7 @@
 #include "ClusterInterface.hh"
 #include "RedundancyProvider.hh"
 #include "SocketListener.hh"
+#include "ReconnectScheduler.hh"
 #include "DataCache.hh"
 #include "KineticAdminCluster.hh"
 #include "kio/KineticIoFactory.hh"
@@ -54,6 +55,16 @@ struct ClusterInformation
   std::chrono::seconds min_reconnect_interval;
   //! interval after which an operation will timeout without response
   std::chrono::seconds operation_timeout;
+  //! data values of at least this size are stored deduplicated, 0 disables deduplication
+  size_t dedup_min_size;
+  //! maintain the number of metadata, data and attribute keys in counter keys
+  bool key_counters;
+  //! unreferenced deduplicated content is kept at least this long after it was last referenced
+  std::chrono::seconds dedup_grace;
+  //! maximum number of outstanding requests per drive, 0 for unlimited
+  size_t max_queue_depth;
+  //! requests to a drive exceeding this latency reduce its queue depth, 0 to only react to failures
+  std::chrono::milliseconds target_latency;
   //! the unique ids of drives belonging to this cluster
   std::vector<std::string> drives;
 };
@@ -83,6 +94,22 @@ public:
   //--------------------------------------------------------------------------
   std::shared_ptr<AdminClusterInterface> getAdminCluster(const std::string& id);
 
+  //--------------------------------------------------------------------------
+  //! Obtain the epoll listener shared among all connections of clusters in
+  //! this cluster map.
+  //!
+  //! @return the epoll listener
+  //--------------------------------------------------------------------------
+  SocketListener& socketListener();
+
+  //--------------------------------------------------------------------------
+  //! Obtain the reconnect scheduler shared among all connections of clusters
+  //! in this cluster map.
+  //!
+  //! @return the reconnect scheduler
+  //--------------------------------------------------------------------------
+  ReconnectScheduler& reconnectScheduler();
+
   //--------------------------------------------------------------------------
   //! Reset the object with supplied configuration
   //! 
@@ -103,6 +130,9 @@ private:
   //! epoll listener loop shared among all connections of clusters in this cluster map
   std::unique_ptr<SocketListener> listener;
 
+  //! reconnect scheduler shared among all connections of clusters in this cluster map
+  std::unique_ptr<ReconnectScheduler> reconnects;
+
   //! the cluster id <-> cluster info
   std::unordered_map<std::string, ClusterInformation> clusterInfoMap;
   
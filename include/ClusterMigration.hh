@@ -0,0 +1,154 @@
+//------------------------------------------------------------------------------
+//! @file ClusterMigration.hh
+//! @author Paul Hermann Lensing
+//! @brief Stream files from one cluster to another.
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * KineticIo - a file io interface library to kinetic devices.          *
+ *                                                                      *
+ * This Source Code Form is subject to the terms of the Mozilla         *
+ * Public License, v. 2.0. If a copy of the MPL was not                 *
+ * distributed with this file, You can obtain one at                    *
+ * https://mozilla.org/MP:/2.0/.                                        *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without       *
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or         *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public             *
+ * License for more details.                                            *
+ ************************************************************************/
+
+#ifndef KINETICIO_CLUSTERMIGRATION_HH
+#define KINETICIO_CLUSTERMIGRATION_HH
+
+/*----------------------------------------------------------------------------*/
+#if __GNUC__ == 4 && (__GNUC_MINOR__ == 4)
+    #include <cstdatomic>
+#else
+  #include <atomic>
+#endif
+#include <chrono>
+#include <string>
+#include <vector>
+#include <mutex>
+#include "ClusterInterface.hh"
+#include "AdminClusterInterface.hh"
+/*----------------------------------------------------------------------------*/
+
+namespace kio {
+
+//------------------------------------------------------------------------------
+//! Copies all files of a source cluster to a target cluster, which may use a
+//! different stripe geometry. Data is moved stripe by stripe without going
+//! through the data cache; every worker thread holds at most one source and
+//! one target stripe in memory. The source is only read, so clients can keep
+//! using it until cut-over.
+//!
+//! After a file has been copied, a checkpoint containing a signature of the
+//! source file (the versions of all its keys) is stored on the target
+//! cluster. A repeated migration skips files that have not changed since
+//! their checkpoint, so an interrupted migration can be restarted and a final
+//! pass right before cut-over only copies files modified in the meantime.
+//! Files removed from the source after they have been migrated are not
+//! removed from the target.
+//------------------------------------------------------------------------------
+class ClusterMigration {
+public:
+  //--------------------------------------------------------------------------
+  //! Migrate all files.
+  //!
+  //! @param callback optionally register a callback function that is called
+  //!   with the current number of processed files periodically
+  //! @param numThreads the number of files migrated concurrently
+  //! @return statistics: total files, need_action files that had to be
+  //!   copied, repaired files copied successfully, unrepairable failures
+  //--------------------------------------------------------------------------
+  AdminClusterInterface::KeyCounts run(AdminClusterInterface::callback_t callback, int numThreads);
+
+  //--------------------------------------------------------------------------
+  //! Migrate a single file unless its checkpoint is current.
+  //!
+  //! @param path the path of the file
+  //! @return true if the file has been copied, false if it was current
+  //--------------------------------------------------------------------------
+  bool migrateFile(const std::string& path);
+
+  //--------------------------------------------------------------------------
+  //! Constructor.
+  //!
+  //! @param source the cluster to read from
+  //! @param target the cluster to write to
+  //! @param max_bytes_per_second throttle reading from the source, 0 for no limit
+  //--------------------------------------------------------------------------
+  explicit ClusterMigration(ClusterInterface& source, ClusterInterface& target, size_t max_bytes_per_second = 0);
+
+private:
+  //! The atomic version of AdminClusterInterface::KeyCounts.
+  struct Counts {
+    std::atomic<int> total;
+    std::atomic<int> copied;
+    std::atomic<int> migrated;
+    std::atomic<int> failed;
+
+    Counts() : total(0), copied(0), migrated(0), failed(0)
+    { };
+  };
+
+  //--------------------------------------------------------------------------
+  //! Migrate the files with the supplied metadata keys.
+  //--------------------------------------------------------------------------
+  void migrateFiles(std::vector<std::string> metadata_keys, Counts& counts);
+
+  //--------------------------------------------------------------------------
+  //! Compute the signature of a source file from the versions of its
+  //! metadata, data and attribute keys.
+  //!
+  //! @param path the path of the file
+  //! @param last_block set to the highest data block number of the file, -1
+  //!   if there are no data blocks
+  //! @return the signature
+  //--------------------------------------------------------------------------
+  std::string signature(const std::string& path, int& last_block);
+
+  //--------------------------------------------------------------------------
+  //! Copy a file, metadata last so that the file only becomes visible on
+  //! the target once complete.
+  //!
+  //! @param path the path of the file
+  //! @param last_block the highest data block number of the source file
+  //--------------------------------------------------------------------------
+  void copy(const std::string& path, int last_block);
+
+  //--------------------------------------------------------------------------
+  //! Block until reading the requested number of bytes is allowed by the
+  //! configured throughput limit.
+  //--------------------------------------------------------------------------
+  void throttle(size_t bytes);
+
+  //--------------------------------------------------------------------------
+  //! List keys in the supplied range, throws on error.
+  //--------------------------------------------------------------------------
+  std::vector<std::string> list(ClusterInterface& cluster, std::shared_ptr<const std::string> start,
+                                std::shared_ptr<const std::string> end);
+
+private:
+  //! the cluster files are read from
+  ClusterInterface& source;
+
+  //! the cluster files are written to
+  ClusterInterface& target;
+
+  //! throughput limit, 0 if unlimited
+  const size_t max_bytes_per_second;
+
+  //! time the next read is allowed to start when throttling
+  std::chrono::system_clock::time_point next_read;
+
+  //! concurrency control for throttling
+  std::mutex mutex;
+};
+
+}
+
+#endif //KINETICIO_CLUSTERMIGRATION_HH
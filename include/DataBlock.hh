@@ -27,8 +27,10 @@
 #include <chrono>
 #include <string>
 #include <mutex>
+#include "LockProfiler.hh"
 #include <list>
 #include "ClusterInterface.hh"
+#include "SharedBlockCache.hh"
 /*----------------------------------------------------------------------------*/
 
 namespace kio {
@@ -62,6 +64,18 @@ public:
   //--------------------------------------------------------------------------
   void read(char* const buffer, size_t offset, size_t length);
 
+  //--------------------------------------------------------------------------
+  //! Zero-copy variant of read. The returned buffer is never modified by the
+  //! block, writes following the call operate on a private copy.
+  //!
+  //! @param offset offset in the block to start reading
+  //! @param length number of bytes to read
+  //! @param view_offset set to the position of the requested data in the
+  //!   returned buffer
+  //! @return buffer containing the requested data
+  //--------------------------------------------------------------------------
+  std::shared_ptr<const std::string> view(size_t offset, size_t length, size_t& view_offset);
+
   //--------------------------------------------------------------------------
   //! Writing in-memory only, never flushes to the backend. Any write up to the
   //! value size limit of the assigned cluster is legal. Writes do not have to
@@ -107,6 +121,23 @@ public:
   //--------------------------------------------------------------------------
   bool dirty() const;
 
+  //--------------------------------------------------------------------------
+  //! Test if the block has been verified to not exist in the backend and
+  //! has not been written to locally. Reads of an absent block return 0s.
+  //!
+  //! @return true if absent, false otherwise.
+  //--------------------------------------------------------------------------
+  bool absent() const;
+
+  //--------------------------------------------------------------------------
+  //! Obtain the value of a block that has been written to but has never been
+  //! stored in or read from the backend.
+  //!
+  //! @param max_size the maximum value size of interest
+  //! @return the value, or an empty pointer if the block doesn't qualify
+  //--------------------------------------------------------------------------
+  std::shared_ptr<const std::string> unflushedValue(size_t max_size) const;
+
   //--------------------------------------------------------------------------
   //! The identity string of a block combines the set cluster and key to form
   //! an identifier. As this identifier depends on the cluster object it will 
@@ -125,10 +156,12 @@ public:
   //! @param cluster the cluster that this block is (to be) stored on
   //! @param key the name of the block
   //! @param mode if mode::create assume that the key does not yet exist
+  //! @param shared node-wide cache for clean values, may be NULL
   //--------------------------------------------------------------------------
   void reassign(std::shared_ptr<ClusterInterface> cluster,
                 std::shared_ptr<const std::string> key,
-                Mode mode = Mode::STANDARD
+                Mode mode = Mode::STANDARD,
+                SharedBlockCache* shared = NULL
   );
 
   //--------------------------------------------------------------------------
@@ -137,10 +170,12 @@ public:
   //! @param cluster the cluster that this block is (to be) stored on
   //! @param key the name of the block
   //! @param mode if mode::create assume that the key does not yet exist
+  //! @param shared node-wide cache for clean values, may be NULL
   //--------------------------------------------------------------------------
   explicit DataBlock(std::shared_ptr<ClusterInterface> cluster,
                      std::shared_ptr<const std::string> key,
-                     Mode mode = Mode::STANDARD
+                     Mode mode = Mode::STANDARD,
+                     SharedBlockCache* shared = NULL
   );
 
   //--------------------------------------------------------------------------
@@ -163,6 +198,36 @@ private:
   //! via write and / or truncate on the local copy of the value.
   //--------------------------------------------------------------------------
   void getRemoteValue();
+
+  //--------------------------------------------------------------------------
+  //! Check if the local updates replace the complete value, in which case
+  //! the remote value is not required for merging and flushing only needs
+  //! the remote version.
+  //!
+  //! @return true if writes cover the full block capacity without truncation
+  //--------------------------------------------------------------------------
+  bool overwritten() const;
+
+  //--------------------------------------------------------------------------
+  //! Reads the remote version without the value, used to flush a block that
+  //! has been overwritten completely.
+  //--------------------------------------------------------------------------
+  void getRemoteVersion();
+
+  //--------------------------------------------------------------------------
+  //! Obtain the remote version and value, preferring a verified entry in the
+  //! node-wide shared cache over reading from the cluster.
+  //!
+  //! @param verified set to the time the obtained value was verified
+  //! @return status of the operation
+  //--------------------------------------------------------------------------
+  kinetic::KineticStatus getSharedValue(std::chrono::system_clock::time_point& verified);
+
+  //--------------------------------------------------------------------------
+  //! Ensure that local_value is not referenced by any view, so that it may
+  //! be modified in place.
+  //--------------------------------------------------------------------------
+  void detachLocalValue();
   
 private:
   //! setting the block mode can increase performance by preventing unnecessary
@@ -181,7 +246,8 @@ private:
   //! the latest known data of the key that is stored in the cluster
   std::shared_ptr<const std::string> remote_value; 
 
-  //! if data is written, the local_value will replace the remote value 
+  //! if data is written, the local_value will replace the remote value. As it
+  //! may be referenced by views, it is copied before modification if shared.
   std::shared_ptr<std::string> local_value;
   
   //! keeping track of the value size, since value may be pre-allocated to maximum size for efficiency
@@ -191,11 +257,14 @@ private:
   //! last been flushed (offset, length)
   std::list<std::pair<size_t, size_t> > updates;
 
+  //! node-wide cache for clean values, NULL if not used
+  SharedBlockCache* shared;
+
   //! time the block was last verified to be up to date
   std::chrono::system_clock::time_point timestamp;
   
   //! thread-safety
-  mutable std::mutex mutex;
+  mutable ProfiledMutex mutex;
 };
 
 }
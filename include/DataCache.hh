@@ -26,12 +26,18 @@
 #include "PrefetchOracle.hh"
 #include "BackgroundOperationHandler.hh"
 #include "DataBlock.hh"
+#include "SharedBlockCache.hh"
+#include "LockProfiler.hh"
 #include <unordered_map>
 #include <condition_variable>
+#include <atomic>
+#include <list>
 #include <exception>
 #include <mutex>
 #include <memory>
+#include <map>
 #include <set>
+#include <vector>
 /*----------------------------------------------------------------------------*/
 
 namespace kio {
@@ -42,10 +48,49 @@ class FileIo;
 //----------------------------------------------------------------------------
 //! LRU cache for Data. Threadsafe. Will create blocks
 //! that are not in cache automatically during get()
+//!
+//! Cache capacity may be divided into partitions, selected by the tenant tag
+//! a file has been opened with or by the cluster id of the file. A partition
+//! may use idle capacity up to its maximum share; when the cache is full,
+//! blocks of partitions exceeding their minimum share are evicted first.
+//! Blocks of unconfigured tenants and clusters belong to a default partition
+//! without minimum share.
+//!
+//! Blocks are spread over shards by key, each shard has its own LRU list and
+//! lock so that concurrent requests for different blocks rarely contend.
+//! Capacity and partition shares apply to the cache as a whole.
 //----------------------------------------------------------------------------
 class DataCache {
 
 public:
+  //--------------------------------------------------------------------------
+  //! Configuration of a cache partition.
+  //--------------------------------------------------------------------------
+  struct PartitionConfiguration {
+    //! tenant tag or cluster id the partition applies to
+    std::string name;
+    //! capacity in bytes guaranteed to the partition
+    size_t min;
+    //! capacity in bytes the partition may use at most, 0 for no limit
+    size_t max;
+  };
+
+  //--------------------------------------------------------------------------
+  //! Usage and hit rate of a cache partition.
+  //--------------------------------------------------------------------------
+  struct PartitionStatistics {
+    //! current size of the partition in bytes
+    size_t size;
+    //! configured minimum share in bytes
+    size_t min;
+    //! effective maximum share in bytes
+    size_t max;
+    //! number of block requests served from the cache
+    uint64_t hits;
+    //! number of block requests that required a new block
+    uint64_t misses;
+  };
+
   //--------------------------------------------------------------------------
   //! Return the data block associated with the supplied owner and block
   //! number.
@@ -61,6 +106,37 @@ public:
       DataBlock::Mode cm
   );
 
+  //--------------------------------------------------------------------------
+  //! Test if the block associated with the supplied owner and block number
+  //! is known not to exist in the backend. Negative entries follow the same
+  //! expiration rules as data blocks.
+  //!
+  //! @param owner a pointer to the kio::FileIo object the block belongs to
+  //! @param blocknumber specifies which block of the file is requested
+  //! @return true if the block is known to be absent, false otherwise
+  //--------------------------------------------------------------------------
+  bool isAbsent(kio::FileIo* owner, int blocknumber);
+
+  //--------------------------------------------------------------------------
+  //! Remember that the supplied block does not exist in the backend. If the
+  //! block is not used by anyone but the cache and the caller, its slot is
+  //! released so that a hole does not occupy a data buffer.
+  //!
+  //! @param data the block as returned by getDataKey, ignored if not absent
+  //--------------------------------------------------------------------------
+  void setAbsent(const std::shared_ptr<kio::DataBlock>& data);
+
+  //--------------------------------------------------------------------------
+  //! Release the block associated with the supplied owner and block number
+  //! early. A clean block that is not in use is removed from the cache,
+  //! otherwise the block is moved to the tail of the LRU list so that it is
+  //! the first candidate for eviction.
+  //!
+  //! @param owner a pointer to the kio::FileIo object the block belongs to
+  //! @param blocknumber specifies which block of the file is released
+  //--------------------------------------------------------------------------
+  void release(kio::FileIo* owner, int blocknumber);
+
   //--------------------------------------------------------------------------
   //! Flushes all dirty data associated with the owner.
   //!
@@ -77,6 +153,15 @@ public:
   //--------------------------------------------------------------------------
   void drop(kio::FileIo* owner, bool force=false);
 
+  //--------------------------------------------------------------------------
+  //! Transfer all blocks associated with an owner to another owner, the
+  //! blocks are no longer associated with the previous owner afterwards.
+  //!
+  //! @param from a pointer to the kio::FileIo object the blocks belong to
+  //! @param to a pointer to the kio::FileIo object taking over the blocks
+  //--------------------------------------------------------------------------
+  void transfer(kio::FileIo* from, kio::FileIo* to);
+
   //--------------------------------------------------------------------------
   //! Return current cache utilization as a double value between 0 and 1.
   //!
@@ -84,20 +169,35 @@ public:
   //--------------------------------------------------------------------------
   double utilization();
 
+  //--------------------------------------------------------------------------
+  //! Return usage and hit rate of all configured partitions. The default
+  //! partition is listed with an empty name.
+  //!
+  //! @return partition statistics by partition name
+  //--------------------------------------------------------------------------
+  std::map<std::string, PartitionStatistics> partitionStatistics();
+
   //--------------------------------------------------------------------------
   //! The configuration of an existing ClusterChunkCache object can be changed
   //! during runtime.
   //!
   //! @param capacity absolute maximum size of the cache in bytes
+  //! @param partitions the cache partitions, minimum shares may not exceed
+  //!   the capacity in sum
   //--------------------------------------------------------------------------
-  void changeConfiguration(size_t capacity);
+  void changeConfiguration(
+      size_t capacity,
+      const std::vector<PartitionConfiguration>& partitions = std::vector<PartitionConfiguration>()
+  );
 
   //--------------------------------------------------------------------------
   //! Constructor.
   //!
   //! @param capacity absolute maximum size of the cache in bytes
+  //! @param shared node-wide cache for clean blocks, may be NULL
+  //! @param num_shards number of independently locked shards, 0 for one per core
   //--------------------------------------------------------------------------
-  explicit DataCache(size_t capacity);
+  explicit DataCache(size_t capacity, SharedBlockCache* shared = NULL, size_t num_shards = 0);
 
   //--------------------------------------------------------------------------
   //! No copy constructor.
@@ -116,24 +216,37 @@ private:
   //! current size of the cache
   std::atomic<size_t> current_size;
 
-  //! current size of the unused items list
-  size_t unused_size;
-  
+  //! node-wide cache for clean blocks, handed to all data blocks
+  SharedBlockCache* shared;
+
+  struct Partition {
+    std::string name;
+    std::atomic<size_t> min;
+    std::atomic<size_t> max;
+    std::atomic<size_t> size;
+    std::atomic<uint64_t> hits;
+    std::atomic<uint64_t> misses;
+    std::atomic<bool> configured;
+
+    explicit Partition(const std::string& name) :
+        name(name), min(0), max(0), size(0), hits(0), misses(0), configured(false)
+    { }
+  };
+
+  //! all partitions ever configured by name, never erased so that cache items can keep pointers
+  std::unordered_map<std::string, std::shared_ptr<Partition>> partitions;
+
+  //! Thread safety when accessing the partition table, acquired after shard locks
+  ProfiledMutex partition_mutex;
+
   struct CacheItem {
     std::set<kio::FileIo*> owners;
     std::shared_ptr<kio::DataBlock> data;
     std::chrono::system_clock::time_point last_access;
+    Partition* partition;
   };
 
-  //! A linked list of data blocks stored in LRU order
-  std::list<CacheItem> cache;
-
-  // List of items that are no longer used but kept around for future re-use to avoid memory allocation. 
-  std::list<CacheItem> unused_items; 
-  
-  //! the lookup table
   typedef std::list<CacheItem>::iterator cache_iterator;
-  std::unordered_map<std::string, cache_iterator> lookup;
 
   //! comparison operator so we can create std::set<cache_iterator>
   struct cache_iterator_compare {
@@ -143,27 +256,92 @@ private:
     }
   };
 
-  //! keep set of cache items associated with each owner (for drop & flush commands)
-  std::unordered_map<const kio::FileIo*, std::set<cache_iterator, cache_iterator_compare>> owner_tables;
+  struct Shard {
+    //! A linked list of data blocks stored in LRU order
+    std::list<CacheItem> cache;
+
+    // List of items that are no longer used but kept around for future re-use to avoid memory allocation.
+    std::list<CacheItem> unused_items;
+
+    //! current size of the unused items list
+    size_t unused_size;
+
+    //! the lookup table
+    std::unordered_map<std::string, cache_iterator> lookup;
+
+    //! negative cache: keys of blocks known not to exist in the backend and the time they were verified
+    std::unordered_map<std::string, std::chrono::system_clock::time_point> absent_lookup;
 
-  //! Thread safety when accessing cache structures (lookup table and lru list)
-  std::mutex cache_mutex;
+    //! keep set of cache items associated with each owner (for drop & flush commands)
+    std::unordered_map<const kio::FileIo*, std::set<cache_iterator, cache_iterator_compare>> owner_tables;
+
+    //! Thread safety when accessing the structures of this shard (lookup tables and lru list)
+    ProfiledMutex mutex;
+
+    Shard() : unused_size(0), mutex("DataCache::cache_mutex")
+    { }
+  };
+
+  //! the shards, a block belongs to the shard selected by the hash of its key
+  std::vector<std::shared_ptr<Shard>> shards;
+
+  //! maximum number of negative cache entries, expired entries are evicted when reached
+  static const size_t absent_capacity;
 
 private:
   //--------------------------------------------------------------------------
   //! Remove an item from the cache as well as the lookup table and from
   //! associated owners.
   //!
+  //! @param s the shard the element belongs to, has to be locked
   //! @param it an iterator to the element to be removed
   //! @return iterator to following element
   //!--------------------------------------------------------------------------
-  cache_iterator remove_item(const cache_iterator& it);
-  
+  cache_iterator remove_item(Shard& s, const cache_iterator& it);
+
+  //--------------------------------------------------------------------------
+  //! Attempt to shrink a shard by discarding unused items from its tail.
+  //!
+  //! @param s the shard to shrink, has to be locked
+  //--------------------------------------------------------------------------
+  void try_shrink(Shard& s);
+
+  //--------------------------------------------------------------------------
+  //! Enforce the maximum share of the requesting partition and the cache
+  //! capacity after a block has been added. Has to be called without holding
+  //! any shard lock.
+  //!
+  //! @param requester the partition a new block has been added to
+  //! @param first index of the shard to start evicting from
+  //--------------------------------------------------------------------------
+  void make_room(Partition& requester, size_t first);
+
+  //--------------------------------------------------------------------------
+  //! Remove items from the shard tails until the cache (or the supplied
+  //! partition) no longer exceeds its capacity. Shards are locked one at a
+  //! time, starting with the supplied one.
+  //!
+  //! @param from only remove items of this partition, NULL for all partitions
+  //! @param borrowed only remove items of partitions exceeding their minimum share
+  //! @param force flush dirty items so that they can be removed
+  //! @param first index of the shard to start with
+  //--------------------------------------------------------------------------
+  void evict(const Partition* from, bool borrowed, bool force, size_t first);
+
+  //--------------------------------------------------------------------------
+  //! Return the index of the shard the supplied cache key belongs to.
+  //--------------------------------------------------------------------------
+  size_t shardIndex(const std::string& cache_key) const;
+
+  //--------------------------------------------------------------------------
+  //! Return the partition blocks of the supplied owner are added to.
+  //--------------------------------------------------------------------------
+  Partition& partition(const kio::FileIo* owner);
+
   //--------------------------------------------------------------------------
-  //! Attempt to shrink the cache by discarding unused items from the 
-  //! cache tail. 
+  //! Return the effective maximum share of the supplied partition in bytes.
   //--------------------------------------------------------------------------
-  void try_shrink(); 
+  size_t partitionCapacity(const Partition& p) const;
 };
 
 
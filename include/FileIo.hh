@@ -27,10 +27,13 @@
 #include "ClusterInterface.hh"
 #include "DataCache.hh"
 #include "DataBlock.hh"
+#include "SmallFilePacker.hh"
 #include <unordered_map>
 #include <chrono>
 #include <mutex>
+#include <condition_variable>
 #include <queue>
+#include <map>
 #include <list>
 
 namespace kio {
@@ -48,7 +51,8 @@ public:
   //!
   //! @param flags open flags
   //! @param mode open mode
-  //! @param opaque opaque information
+  //! @param opaque opaque information, a kio.tenant=<tag> entry selects the
+  //!   cache partition
   //! @param timeout timeout value
   //--------------------------------------------------------------------------
   void Open(int flags, mode_t mode = 0, const std::string& opaque = "", uint16_t timeout = 0);
@@ -64,6 +68,17 @@ public:
   //--------------------------------------------------------------------------
   int64_t Read(long long offset, char* buffer, int length, uint16_t timeout = 0);
 
+  //--------------------------------------------------------------------------
+  //! Read from file without copying - sync
+  //!
+  //! @param offset offset in file
+  //! @param length read length
+  //! @param views cleared and filled with views on the data read, in file order
+  //! @param timeout timeout value
+  //! @return number of bytes read
+  //--------------------------------------------------------------------------
+  int64_t ReadViews(long long offset, int length, std::vector<DataView>& views, uint16_t timeout = 0);
+
   //--------------------------------------------------------------------------
   //! Write to file - sync
   //!
@@ -90,6 +105,14 @@ public:
   //--------------------------------------------------------------------------
   void Remove(uint16_t timeout = 0);
 
+  //--------------------------------------------------------------------------
+  //! Rename file
+  //!
+  //! @param url the kinetic url of the target
+  //! @param timeout timeout value
+  //--------------------------------------------------------------------------
+  void Rename(const std::string& url, uint16_t timeout = 0);
+
   //--------------------------------------------------------------------------
   //! Sync file to disk
   //!
@@ -104,6 +127,23 @@ public:
   //--------------------------------------------------------------------------
   void Close(uint16_t timeout = 0);
 
+  //--------------------------------------------------------------------------
+  //! Close file asynchronously
+  //!
+  //! @param callback called once the data is durable, may be empty
+  //! @param timeout timeout value
+  //--------------------------------------------------------------------------
+  void CloseAsync(std::function<void(std::error_code)> callback, uint16_t timeout = 0);
+
+  //--------------------------------------------------------------------------
+  //! Announce an intention to access file data in a specific pattern.
+  //!
+  //! @param offset start of the range the advice applies to
+  //! @param length length of the range, 0 extends the range to end of file
+  //! @param advice the access pattern hint
+  //--------------------------------------------------------------------------
+  void Advise(long long offset, long long length, Advice advice);
+
   //--------------------------------------------------------------------------
   //! Get stats about the file
   //!
@@ -167,11 +207,32 @@ public:
   FileIo& operator=(const FileIo&) = delete;
 
 private:
+  //--------------------------------------------------------------------------
+  //! Constructor of the detached object completing an asynchronous close,
+  //! takes over the state of the supplied object. See CloseAsync.
+  //!
+  //! @param source the object being closed
+  //--------------------------------------------------------------------------
+  explicit FileIo(FileIo* source);
+
   enum rw {
       READ, WRITE
   };
 
-  int64_t ReadWrite(long long off, char* buffer, int length, rw mode, uint16_t timeout = 0);
+  //--------------------------------------------------------------------------
+  //! Split the request into block requests and execute them.
+  //!
+  //! @param off offset in file
+  //! @param buffer data buffer, ignored if views are requested
+  //! @param length request length
+  //! @param mode read or write
+  //! @param timeout timeout value
+  //! @param views if supplied, reads reference cached data instead of copying
+  //!   it to the buffer
+  //! @return number of bytes read or written
+  //--------------------------------------------------------------------------
+  int64_t ReadWrite(long long off, char* buffer, int length, rw mode, uint16_t timeout = 0,
+                    std::vector<DataView>* views = NULL);
 
   //--------------------------------------------------------------------------
   //! Attempt to prefetch blocks based on the provided block number. If no
@@ -182,6 +243,24 @@ private:
   //--------------------------------------------------------------------------
   void scheduleReadahead(int blocknumber);
 
+  //--------------------------------------------------------------------------
+  //! Schedule a background read of the supplied data block.
+  //!
+  //! @param blocknumber the data block to read
+  //! @return true if the read has been scheduled, false if no thread was
+  //!         available
+  //--------------------------------------------------------------------------
+  bool readahead(int blocknumber);
+
+  //--------------------------------------------------------------------------
+  //! Test if a fully accessed block should be kept in the cache, which is
+  //! the case unless it has been advised otherwise (SEQUENTIAL, NOREUSE).
+  //!
+  //! @param blocknumber the data block that has been accessed
+  //! @return true if the block should be kept, false if it can be released
+  //--------------------------------------------------------------------------
+  bool reuseExpected(int blocknumber);
+
   //--------------------------------------------------------------------------
   //! Schedule a background flush for the supplied data block.
   //!
@@ -189,26 +268,135 @@ private:
   //--------------------------------------------------------------------------
   void scheduleFlush(std::shared_ptr<kio::DataBlock> data);
 
+  //! Background flushes of a FileIo object. They may complete after the
+  //! object has been destroyed or handed its dirty state to a detached
+  //! object, so they only access this shared state.
+  struct BackgroundFlushes {
+    //! exceptions occurring during background flushes, thrown at the next request
+    std::queue<std::system_error> exceptions;
+    //! the number of scheduled flushes that have not completed yet
+    int pending;
+    //! signals completed flushes
+    std::condition_variable cv;
+    //! thread safety
+    std::mutex mutex;
+
+    BackgroundFlushes() : pending(0)
+    { }
+  };
+
   //--------------------------------------------------------------------------
   //! Execute a flush operation. As this function is intended to be run
   //! by one of the background io threads, a possibly thrown exception will
-  //! be stored in this FileIo's exception queue.
+  //! be stored in the exception queue of the supplied flush state.
   //!
+  //! @param flushes the background flush state of the FileIo object
   //! @param data the data to flush to the backend
   //--------------------------------------------------------------------------
-  void doFlush(std::shared_ptr<kio::DataBlock> data);
+  static void doFlush(std::shared_ptr<BackgroundFlushes> flushes, std::shared_ptr<kio::DataBlock> data);
 
   //--------------------------------------------------------------------------
   //! Verify the eof_blocknumber attribute.
   //--------------------------------------------------------------------------
   void verify_eof();
 
+  //--------------------------------------------------------------------------
+  //! Verify that the packed location is in sync with the metadata key.
+  //! @return true if the file is packed, false otherwise
+  //--------------------------------------------------------------------------
+  bool verify_packed();
+
+  //--------------------------------------------------------------------------
+  //! Read in the content of a packed file if not done yet.
+  //! @return true if the file is packed, false if it no longer is
+  //--------------------------------------------------------------------------
+  bool loadPacked();
+
+  //--------------------------------------------------------------------------
+  //! Serve a read request of a packed file.
+  //!
+  //! @param off offset in file
+  //! @param buffer output buffer, ignored if views are requested
+  //! @param length read length
+  //! @param views if supplied, filled with a view instead of copying
+  //! @return number of bytes read
+  //--------------------------------------------------------------------------
+  int64_t readPacked(long long off, char* buffer, int length, std::vector<DataView>* views);
+
+  //--------------------------------------------------------------------------
+  //! Small files are packed in the background after they have been closed,
+  //! possibly while this object has them opened.
+  //! @return true if the file might be packed
+  //--------------------------------------------------------------------------
+  bool mayBePacked();
+
+  //--------------------------------------------------------------------------
+  //! Flush a file written with PARALLEL_WRITE advice and resolve its size.
+  //! Blocks shared with other regions have to contain the data written by
+  //! this object, it is written again if a concurrent update lost it. The
+  //! file size stored in the backend has to cover all data written by this
+  //! object.
+  //!
+  //! @param timeout network timeout
+  //--------------------------------------------------------------------------
+  void closeParallelWrite(uint16_t timeout);
+
+  //--------------------------------------------------------------------------
+  //! Move the content of a packed file to its own data key, so it can be
+  //! modified.
+  //--------------------------------------------------------------------------
+  void unpack();
+
   //--------------------------------------------------------------------------
   //! Check for the last block on the backend cluster.
   //! @return the last block number
   //--------------------------------------------------------------------------
   int get_eof_backend();
 
+  //--------------------------------------------------------------------------
+  //! Obtain the file size stored in the backend cluster from the version of
+  //! the last block.
+  //! @return the file size
+  //--------------------------------------------------------------------------
+  long long get_size_backend();
+
+  //--------------------------------------------------------------------------
+  //! Obtain the base of the data and attribute keys of the file, reading the
+  //! metadata key if the file has not been opened.
+  //!
+  //! @return the file id, or the path for files stored before file ids
+  //--------------------------------------------------------------------------
+  const std::string& storageBase();
+
+  //--------------------------------------------------------------------------
+  //! Compute the CRC32C checksum of the whole file by combining the
+  //! checksums encoded in the versions of its data keys, without reading
+  //! data. Only data keys written without checksum are read.
+  //!
+  //! @return the checksum
+  //--------------------------------------------------------------------------
+  uint32_t computeChecksum();
+
+  //--------------------------------------------------------------------------
+  //! Remove a stored whole-file checksum before the file is modified, once
+  //! per opened file.
+  //--------------------------------------------------------------------------
+  void invalidateChecksum();
+
+  //--------------------------------------------------------------------------
+  //! Close a detached object in the background, see CloseAsync.
+  //!
+  //! @param callback called once the data is durable, may be empty
+  //! @param timeout timeout value
+  //--------------------------------------------------------------------------
+  void completeCloseAsync(std::function<void(std::error_code)> callback, uint16_t timeout);
+
+  //--------------------------------------------------------------------------
+  //! @return the key identifying the file among asynchronous closes in
+  //!   progress
+  //--------------------------------------------------------------------------
+  std::string pendingCloseKey() const;
+
   /* protected instead of private to allow mocking in cache performance testing */
 protected:
   //! we don't want to have to look in the drive map for every access...
@@ -217,23 +405,85 @@ protected:
   //! read-ahead
   PrefetchOracle prefetchOracle;
 
+  //! file-wide access pattern as set by Advise (NORMAL, SEQUENTIAL or RANDOM)
+  Advice access_pattern;
+
+  //! block ranges (first -> last block number) advised as NOREUSE
+  std::map<int, int> noreuse_ranges;
+
+  //! highest block number scheduled for readahead in SEQUENTIAL access mode
+  int readahead_limit;
+
+  //! true if a PARALLEL_WRITE region has been advised
+  bool parallel_write;
+
+  //! the region advised as PARALLEL_WRITE (first byte -> end byte)
+  std::pair<long long, long long> parallel_region;
+
+  //! data written to a block shared with other PARALLEL_WRITE regions
+  struct SharedWrites {
+    //! the written data at its offsets in the block
+    std::string value;
+    //! the written ranges (offset -> length)
+    std::vector<std::pair<size_t, size_t>> ranges;
+  };
+
+  //! data written to blocks shared with other PARALLEL_WRITE regions, by block number
+  std::map<int, SharedWrites> parallel_shared;
+
+  //! end of the data written since PARALLEL_WRITE has been advised
+  long long parallel_end;
+
   //! the currently last block number
   int eof_blocknumber;
 
   //! time point it was verified that eof_blocknumber is in sync with the backend (multi-clients)
   std::chrono::system_clock::time_point eof_verification_time;
 
-  //! Exceptions occurring during background execution are stored and thrown at the next request.
-  std::queue<std::system_error> exceptions;
-
-  //! Thread safety when accessing exceptions
-  std::mutex exception_mutex;
+  //! Background flushes in progress and their exceptions, which are thrown at the next request.
+  std::shared_ptr<BackgroundFlushes> flushes;
 
   //! true if file has been opened successfully
   bool opened;
 
+  //! true if file has been created by this object and not been closed since
+  bool created;
+
+  //! CRC32C checksum of the data written sequentially since the file has been created
+  uint32_t checksum;
+
+  //! number of bytes covered by checksum
+  long long checksum_length;
+
+  //! true if checksum covers all data written since the file has been created
+  bool checksum_sequential;
+
+  //! true if no stored whole-file checksum exists that has to be removed before modifying the file
+  bool checksum_invalidated;
+
+  //! the latest known version of the metadata key
+  std::shared_ptr<const std::string> metadata_version;
+
+  //! location of the file content if it is packed with other small files
+  SmallFilePacker::Location packed;
+
+  //! content of a packed file, read in on first access
+  std::shared_ptr<const std::string> packed_value;
+
+  //! time point it was verified that the packed location is in sync with the backend
+  std::chrono::system_clock::time_point packed_verification_time;
+
   //! the extracted path from the full path 'kinetic:clusterId:path'
   std::string path;
+
+  //! the base of data and attribute keys: a file id, the path for files stored before file ids
+  std::string base;
+
+  //! true if the base has been read from the metadata key
+  bool base_verified;
+
+  //! the tenant tag supplied with the opaque information on open, selects the cache partition
+  std::string tenant;
 };
 
 }
@@ -24,6 +24,7 @@
 
 #include "KineticCluster.hh"
 #include "AdminClusterInterface.hh"
+#include <random>
 
 namespace kio {
 
@@ -35,6 +36,9 @@ public:
   //! See documentation of public interface in AdminClusterInterface
   int count(OperationTarget target, callback_t callback = NULL);
 
+  //! See documentation of public interface in AdminClusterInterface
+  CountEstimate estimateCount(OperationTarget target, int num_samples = 32);
+
   //! See documentation of public interface in AdminClusterInterface 
   KeyCounts scan(OperationTarget target, callback_t callback = NULL, int numThreads = 1);
 
@@ -45,7 +49,14 @@ public:
   KeyCounts reset(OperationTarget target, callback_t callback = NULL, int numThreads = 1);
 
   //! See documentation of public interface in AdminClusterInterface
-  ClusterStatus status(int num_bench_keys = 0);
+  KeyCounts collectGarbage(callback_t callback = NULL, int numThreads = 1);
+
+  //! See documentation of public interface in AdminClusterInterface
+  KeyCounts migrate(const std::string& target_id, callback_t callback = NULL, int numThreads = 1,
+                    int max_mb_per_second = 0);
+
+  //! See documentation of public interface in AdminClusterInterface
+  ClusterStatus status(int num_bench_keys = 0, int bench_queue_depth = 1, int bench_value_size = 1024 * 1024);
 
   //! Perfect forwarding is nice, and I am lazy. Look in KineticCluster.hh for the correct arguments
   template<typename... Args>
@@ -60,7 +71,7 @@ private:
   //! The different types of admin cluster operations
   //--------------------------------------------------------------------------
   enum class Operation {
-    COUNT, SCAN, REPAIR, RESET
+    COUNT, SCAN, REPAIR, RESET, COLLECT
   };
 
   //--------------------------------------------------------------------------
@@ -87,13 +98,15 @@ private:
   //! @param callback function will be called periodically with total number of 
   //!   keys the requested operation has been executed on.
   //! @param numthreads the number of io threads
+  //! @param complete if supplied, set to true if all keys have been processed
   //! @return statistics of keys
   //--------------------------------------------------------------------------
   KeyCounts doOperation(
       Operation o,
       OperationTarget t,
       callback_t callback,
-      int numthreads
+      int numthreads,
+      bool* complete = NULL
   );
 
   //--------------------------------------------------------------------------
@@ -136,6 +149,29 @@ private:
       KeyCountsInternal& key_counts
   );
 
+  //--------------------------------------------------------------------------
+  //! Count the references to deduplicated content.
+  //!
+  //! @param fingerprint the content fingerprint
+  //! @param remove_stale if set, references of data keys that no longer point
+  //!   to the content are removed and not counted, unless they have been
+  //!   written recently
+  //! @return the number of references
+  //--------------------------------------------------------------------------
+  int countContentReferences(const std::string& fingerprint, bool remove_stale);
+
+  //--------------------------------------------------------------------------
+  //! Remove the supplied content key if it is no longer referenced.
+  //!
+  //! @param key the content key
+  //! @param key_counts keep statistics current by increasing need_action and
+  //!   removed counts as necessary.
+  //--------------------------------------------------------------------------
+  void collectContent(
+      const std::shared_ptr<const std::string>& key,
+      KeyCountsInternal& key_counts
+  );
+
   //--------------------------------------------------------------------------
   //! Initialize start and end keys for range requests based on operation target.
   //!
@@ -156,6 +192,25 @@ private:
   //! @return true on success, false on error
   //--------------------------------------------------------------------------
   bool removeIndicatorKey(const std::shared_ptr<const std::string>& key);
+
+  //--------------------------------------------------------------------------
+  //! Estimate the number of keys in the supplied range with a single random
+  //! descent through the key prefix tree (Knuth's tree size estimator). At
+  //! each level, the distinct next characters of all keys sharing the current
+  //! prefix are determined and one is selected at random. The estimate is the
+  //! product of the number of choices at every level times the number of
+  //! keys in the final subtree, which is small enough to be listed.
+  //!
+  //! @param start_key the first key of the range
+  //! @param end_key the last key of the range
+  //! @param random random number generator
+  //! @return an unbiased estimate of the number of keys in the range
+  //--------------------------------------------------------------------------
+  double sampleKeyCount(
+      std::shared_ptr<const std::string> start_key,
+      std::shared_ptr<const std::string> end_key,
+      std::mt19937& random
+  );
 };
 
 }
@@ -26,14 +26,18 @@
 #include <utility>
 #include <chrono>
 #include <memory>
+#include <deque>
 #include <mutex>
 #include <random>
 #include "SocketListener.hh"
-#include "BackgroundOperationHandler.hh"
+#include "ReconnectScheduler.hh"
 #include "DestructionMutex.hh"
+#include "LockProfiler.hh"
 
 namespace kio{
 
+class KineticCallback;
+
 //------------------------------------------------------------------------------
 //! Wrapping kinetic::ThreadsafeNonblockingKineticConnection, (re)connecting
 //! automatically when the underlying connection is requested.
@@ -62,18 +66,104 @@ public:
   //! Return human readable name of the auto connection. 
   //--------------------------------------------------------------------------
   const std::string& getName() const;
+
+  //--------------------------------------------------------------------------
+  //! Obtain a submission slot for a request. The number of slots adapts to
+  //! the drive: it grows additively while requests complete within the
+  //! target latency and is halved on timeouts, errors or slow requests.
+  //!
+  //! Requests that do not obtain a slot are queued in order. Slots are only
+  //! handed out to the first queued request, its callback is notified when
+  //! a slot becomes available to it.
+  //!
+  //! @param waiter the callback of the request, queued if no slot is
+  //!   available. If NULL, the request is not queued.
+  //! @return true if a slot has been obtained, false if the request has to
+  //!   wait for a slot to become available
+  //--------------------------------------------------------------------------
+  bool acquireSlot(KineticCallback* waiter = NULL);
+
+  //--------------------------------------------------------------------------
+  //! Remove a request from the queue of requests waiting for a slot. Has to
+  //! be called for every queued request that gives up waiting.
+  //!
+  //! @param waiter the callback of the request
+  //--------------------------------------------------------------------------
+  void cancelSlot(KineticCallback* waiter);
+
+  //--------------------------------------------------------------------------
+  //! Return a submission slot obtained by acquireSlot().
+  //!
+  //! @param latency the observed latency of the request
+  //! @param congested true if the request failed or timed out
+  //--------------------------------------------------------------------------
+  void releaseSlot(std::chrono::microseconds latency, bool congested);
+
+  //--------------------------------------------------------------------------
+  //! Account for a request that had to wait for a submission slot.
+  //!
+  //! @param wait the time the request waited
+  //--------------------------------------------------------------------------
+  void recordQueueWait(std::chrono::microseconds wait);
+
+  //--------------------------------------------------------------------------
+  //! Submission queue statistics of the connection.
+  //--------------------------------------------------------------------------
+  struct QueueStats {
+    //! the current outstanding request limit, 0 if unlimited
+    std::size_t limit;
+    //! the number of currently outstanding requests
+    std::size_t outstanding;
+    //! the total number of requests that had to wait for a slot
+    uint64_t deferred;
+    //! the total time requests waited for a slot
+    std::chrono::microseconds wait;
+  };
+
+  //--------------------------------------------------------------------------
+  //! Obtain submission queue statistics.
+  //!
+  //! @return the statistics
+  //--------------------------------------------------------------------------
+  QueueStats queueStats();
+
+  //--------------------------------------------------------------------------
+  //! Connection attempt statistics of the connection.
+  //--------------------------------------------------------------------------
+  struct ReconnectStats {
+    //! the total number of connection attempts
+    uint64_t attempts;
+    //! the total number of failed connection attempts
+    uint64_t failures;
+  };
+
+  //--------------------------------------------------------------------------
+  //! Obtain connection attempt statistics.
+  //!
+  //! @return the statistics
+  //--------------------------------------------------------------------------
+  ReconnectStats reconnectStats();
   
   //--------------------------------------------------------------------------
   //! Constructor.
   //!
+  //! @param sockwatch epoll listener the connection registers with
+  //! @param scheduler executes background reconnection attempts
   //! @param options host / port / key of target kinetic drive
-  //! @param ratelimit minimum time between reconnection attempts
-  //! @param min_getlog_interval minimum time between getlog attempts
+  //! @param ratelimit minimum time between reconnection attempts, base of the
+  //!   backoff after failed attempts
+  //! @param max_queue_depth maximum number of outstanding requests, 0 for
+  //!   unlimited
+  //! @param target_latency requests exceeding this latency reduce the
+  //!   outstanding request limit, 0 to only react to failed requests
   //--------------------------------------------------------------------------
   KineticAutoConnection(
       SocketListener& sockwatch,
+      ReconnectScheduler& scheduler,
       std::pair< kinetic::ConnectionOptions, kinetic::ConnectionOptions > options,
-      std::chrono::seconds ratelimit
+      std::chrono::seconds ratelimit,
+      std::size_t max_queue_depth = 0,
+      std::chrono::milliseconds target_latency = std::chrono::milliseconds(0)
   );
 
   //--------------------------------------------------------------------------
@@ -94,26 +184,60 @@ private:
   int fd;
   //! string representation of connection options for logging purposes
   std::string logstring;
-  //! timestamp of the last connection attempt
-  std::chrono::system_clock::time_point timestamp;
+  //! the total number of connection attempts
+  uint64_t reconnect_attempts;
+  //! the total number of failed connection attempts
+  uint64_t reconnect_failures;
   //! thread safety
   std::mutex mutex;
   //! use calling thread for initial connect
   std::once_flag intial_connect;
   //! register connections with epoll listener
   SocketListener& sockwatch;
+  //! executes background reconnection attempts
+  ReconnectScheduler& scheduler;
   //! random number generator
   std::mt19937 mt;
-  //! background operation handler. last initialized, first destructed, guaranteeing that no
-  //! background threads exist past any other member variable destruction
-  BackgroundOperationHandler bg;
+  //! maximum number of outstanding requests, 0 for unlimited
+  const std::size_t max_queue_depth;
+  //! requests exceeding this latency indicate congestion
+  const std::chrono::milliseconds target_latency;
+  //! current outstanding request limit, fractional for additive increase
+  double queue_limit;
+  //! the number of currently outstanding requests
+  std::size_t queue_outstanding;
+  //! the total number of requests that had to wait for a slot
+  uint64_t queue_deferred;
+  //! the total time requests waited for a slot
+  std::chrono::microseconds queue_wait;
+  //! time of the last decrease of the outstanding request limit
+  std::chrono::system_clock::time_point queue_decreased;
+  //! requests waiting for a slot, in order
+  std::deque<KineticCallback*> queue_waiters;
+  //! thread safety for submission queue state
+  ProfiledMutex queue_mutex;
 
 private:
   //--------------------------------------------------------------------------
-  //! Attempt to connect unless blocked by rate limit. Will attempt both host
-  //! names supplied to options and prioritize randomly.
+  //! Notify the first queued request if a slot is available. Requires
+  //! queue_mutex to be held.
+  //--------------------------------------------------------------------------
+  void notifyWaiter();
+
+  //--------------------------------------------------------------------------
+  //! Attempt to connect. Will attempt both host names supplied to options and
+  //! prioritize randomly.
+  //!
+  //! @return true if the connection attempt succeeded
+  //--------------------------------------------------------------------------
+  bool connect();
+
   //--------------------------------------------------------------------------
-  void connect();
+  //! Connect in the calling thread and report the result to the scheduler.
+  //--------------------------------------------------------------------------
+  void initialConnect();
+
+  friend class ReconnectScheduler;
 };
 
 }
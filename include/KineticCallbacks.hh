@@ -28,11 +28,14 @@
 #include <functional>
 #include <memory>
 #include <mutex>
+#include "LockProfiler.hh"
 #include <vector>
 #include <string>
 
 namespace kio {
 
+class KineticAutoConnection;
+
 //------------------------------------------------------------------------------
 //! Synchronization between multiple KineticCallback entities waiting on
 //! completion. Primarily offer wait_until functionality.
@@ -50,6 +53,15 @@ public:
   //----------------------------------------------------------------------------
   void wait_until(std::chrono::system_clock::time_point timeout_time);
 
+  //----------------------------------------------------------------------------
+  //! Blocking wait until either the timeout point has passed or a submission
+  //! slot became available to a queued request. Returns immediately if a slot
+  //! became available since the last call.
+  //!
+  //! @param timeout_time the point of time the function is guaranteed to return
+  //----------------------------------------------------------------------------
+  void wait_for_slot(std::chrono::system_clock::time_point timeout_time);
+
   //----------------------------------------------------------------------------
   //! Constructor
   //----------------------------------------------------------------------------
@@ -63,10 +75,12 @@ public:
 private:
   //! the number of currently outstanding requests
   int outstanding;
+  //! a submission slot became available to a queued request
+  bool slot_available;
   //! condition variable for wait_until functionality
-  std::condition_variable cv;
+  std::condition_variable_any cv;
   //! mutex for condition variable and thread safety
-  std::mutex mutex;
+  ProfiledMutex mutex;
 };
 
 //------------------------------------------------------------------------------
@@ -101,6 +115,20 @@ public:
   //----------------------------------------------------------------------------
   bool finished();
 
+  //----------------------------------------------------------------------------
+  //! Mark the operation as issued on a submission slot of the supplied
+  //! connection. The slot is returned when the result arrives.
+  //!
+  //! @param connection the connection the operation is issued on
+  //----------------------------------------------------------------------------
+  void setIssued(KineticAutoConnection* connection);
+
+  //----------------------------------------------------------------------------
+  //! Called by a connection when a submission slot became available to the
+  //! queued operation, wakes up the thread waiting in wait_for_slot.
+  //----------------------------------------------------------------------------
+  void notifySlot();
+
   //----------------------------------------------------------------------------
   //! Constructor
   //----------------------------------------------------------------------------
@@ -118,6 +146,10 @@ private:
   std::shared_ptr<CallbackSynchronization> sync;
   //! true if the associated kinetic operation has completed, false otherwise
   bool done;
+  //! the connection holding a submission slot for the operation, if any
+  KineticAutoConnection* slot;
+  //! the time the operation has been issued
+  std::chrono::system_clock::time_point issued;
 };
 
 class GetCallback : public KineticCallback, public kinetic::GetCallbackInterface {
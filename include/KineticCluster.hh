@@ -28,9 +28,16 @@
 #include "KineticCallbacks.hh"
 #include "SocketListener.hh"
 #include "RedundancyProvider.hh"
+#if __GNUC__ == 4 && (__GNUC_MINOR__ == 4)
+    #include <cstdatomic>
+#else
+  #include <atomic>
+#endif
 #include <utility>
 #include <chrono>
 #include <mutex>
+#include "LockProfiler.hh"
+#include <list>
 
 namespace kio {
 
@@ -102,11 +109,18 @@ public:
   //! @param operation_timeout the maximum interval an operation is allowed
   //! @param rp_data RedundancyProvider to be used for data keys
   //! @param rp_metadata RedundancyProvider to be used for metadata keys
+  //! @param dedup_min_size data values of at least this size are stored
+  //!   deduplicated, 0 disables deduplication
+  //! @param key_counters maintain the number of existing keys per key type
+  //! @param dedup_grace content references younger than this are kept by
+  //!   garbage collection even if their data key does not reference the
+  //!   content
   //--------------------------------------------------------------------------
   explicit KineticCluster(
       std::string id, std::size_t block_size, std::chrono::seconds operation_timeout,
       std::vector<std::unique_ptr<KineticAutoConnection>> connections,
-      std::shared_ptr<RedundancyProvider> rp
+      std::shared_ptr<RedundancyProvider> rp, std::size_t dedup_min_size = 0, bool key_counters = false,
+      std::chrono::seconds dedup_grace = std::chrono::seconds(3600)
   );
 
   //--------------------------------------------------------------------------
@@ -142,15 +156,144 @@ protected:
   void updateSnapshot(std::shared_ptr<DestructionMutex> dm);
 
   //--------------------------------------------------------------------------
-  //! Turn a single value into a stripe, complete with redundancy information
-  //! 
-  //! @param value the value 
-  //! @return the stripe build from the value 
+  //! Slice a single value into the data chunks of a stripe. Parity chunks are
+  //! left empty, they are computed by StripeOperation_PUT while the data
+  //! chunks are being sent.
+  //!
+  //! @param value the value
+  //! @return the stripe build from the value
   //--------------------------------------------------------------------------
   std::vector<std::shared_ptr<const std::string>> valueToStripe(
       const std::string& value
   );
 
+  //--------------------------------------------------------------------------
+  //! Deduplicated data keys store a reference to a content key instead of
+  //! the value itself. The content key is named after the fingerprint of
+  //! the value, its size and SHA-256 digest. Every data key referencing it
+  //! has a reference key stored as an attribute of the content, so that
+  //! unreferenced content can be garbage collected.
+  //!
+  //! Check if the supplied value of a data key is a reference to content. As
+  //! the version of a data key encodes the size of the value, a reference can
+  //! not be confused with a small value that happens to look like one.
+  //!
+  //! @param value the value as stored in the data key
+  //! @param version the version of the data key
+  //! @param fingerprint set to the fingerprint of the referenced content
+  //! @param size set to the size of the referenced content
+  //! @return true if the value is a reference to content
+  //--------------------------------------------------------------------------
+  static bool parseContentReference(
+      const std::string& value,
+      const std::shared_ptr<const std::string>& version,
+      std::string& fingerprint,
+      std::size_t& size
+  );
+
+  //--------------------------------------------------------------------------
+  //! @param fingerprint the content fingerprint
+  //! @return the path of the hidden file storing the content
+  //--------------------------------------------------------------------------
+  static std::string contentPath(const std::string& fingerprint);
+
+  //! path prefix of hidden files storing deduplicated content
+  static const std::string content_path_prefix;
+
+  //! attribute name prefix of reference keys, followed by the referencing data key
+  static const std::string content_reference_prefix;
+
+  //! references younger than this are live even if the data key does not point to the content (yet)
+  const std::chrono::seconds content_reference_grace;
+
+  //--------------------------------------------------------------------------
+  //! Make sure content with the fingerprint of the supplied value exists and
+  //! is referenced by key. The reference is written before the content, so
+  //! that it is protected from garbage collection.
+  //!
+  //! @param key the data key that will reference the content
+  //! @param value the value to store
+  //! @param fingerprint set to the fingerprint of the value
+  //! @return status of the operation
+  //--------------------------------------------------------------------------
+  kinetic::KineticStatus storeContent(
+      const std::shared_ptr<const std::string>& key,
+      const std::shared_ptr<const std::string>& value,
+      std::string& fingerprint
+  );
+
+  //--------------------------------------------------------------------------
+  //! Read the content with the supplied fingerprint.
+  //!
+  //! @param fingerprint the content fingerprint
+  //! @param value set to the content on success
+  //! @return status of the operation
+  //--------------------------------------------------------------------------
+  kinetic::KineticStatus loadContent(
+      const std::string& fingerprint,
+      std::shared_ptr<const std::string>& value
+  );
+
+  //--------------------------------------------------------------------------
+  //! Remember recently used content.
+  //!
+  //! @param fingerprint the content fingerprint
+  //! @param value the content
+  //--------------------------------------------------------------------------
+  void rememberContent(const std::string& fingerprint, const std::shared_ptr<const std::string>& value);
+
+  //--------------------------------------------------------------------------
+  //! Key counters store the number of metadata, data and attribute keys of
+  //! the cluster. Every cluster instance accumulates the keys it creates and
+  //! removes and periodically adds them to the counter keys. A counter key is
+  //! only updated if it exists, it has to be initialized with an exact count
+  //! of the keys. Forced puts may create or overwrite a key, finding out
+  //! would cost an additional request. They are counted as uncertain
+  //! instead, which an estimate accounts for as half a key. Counters may
+  //! drift and should be re-initialized occasionally.
+  //!
+  //! @param key the key
+  //! @return the index of the counter responsible for the key, -1 if the key
+  //!   is not counted
+  //--------------------------------------------------------------------------
+  int keyCounterIndex(const std::string& key) const;
+
+  //--------------------------------------------------------------------------
+  //! @param index the counter index
+  //! @return the key storing the counter
+  //--------------------------------------------------------------------------
+  std::shared_ptr<const std::string> keyCounterKey(int index) const;
+
+  //--------------------------------------------------------------------------
+  //! Account for a created or removed key, scheduling a counter update if
+  //! counters have not been updated recently.
+  //!
+  //! @param key the key
+  //! @param delta 1 if the key has been created, -1 if it has been removed
+  //! @param uncertain 1 if the key has been created or overwritten
+  //--------------------------------------------------------------------------
+  void countKey(const std::string& key, int delta, int uncertain = 0);
+
+  //--------------------------------------------------------------------------
+  //! Parse the value of a counter key.
+  //!
+  //! @param value the value of the counter key
+  //! @param count set to the number of keys known to exist
+  //! @param uncertain set to the number of keys that might exist
+  //--------------------------------------------------------------------------
+  static void parseKeyCounter(const std::string& value, int& count, int& uncertain);
+
+  //--------------------------------------------------------------------------
+  //! Add the accumulated key deltas to the counter keys.
+  //--------------------------------------------------------------------------
+  void flushKeyCounters(std::shared_ptr<DestructionMutex> dm);
+
+  //! the number of key counters
+  static const int num_key_counters = 3;
+
+  //! the names of the key types counted, used to construct the counter keys
+  static const char* const key_counter_names[num_key_counters];
+
 
 protected:
   //! cluster id
@@ -183,8 +326,32 @@ protected:
   //! prevent background threads accessing member variables after destruction
   std::shared_ptr<DestructionMutex> dmutex;
 
+  //! data values of at least this size are deduplicated, 0 if disabled
+  const std::size_t dedupMinSize;
+
+  //! size of deduplicated values written by this instance
+  std::atomic<uint64_t> dedup_bytes_logical;
+
+  //! size of content actually written by this instance for deduplicated values
+  std::atomic<uint64_t> dedup_bytes_stored;
+
+  //! recently read or written content, content is immutable so there is no need to validate it
+  std::list<std::pair<std::string, std::shared_ptr<const std::string>>> known_content;
+
+  //! true if key counters are maintained
+  const bool keyCounters;
+
+  //! keys created minus keys removed by this instance since the last counter update
+  std::atomic<int> key_counter_deltas[num_key_counters];
+
+  //! forced puts by this instance since the last counter update
+  std::atomic<int> key_counter_uncertain[num_key_counters];
+
+  //! time point the key counters have last been scheduled to be updated
+  std::chrono::system_clock::time_point key_counters_scheduled;
+
   //! concurrency control
-  std::mutex mutex;
+  ProfiledMutex mutex;
 };
 
 }
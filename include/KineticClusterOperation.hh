@@ -84,6 +84,28 @@ public:
   std::map<kinetic::StatusCode, size_t, CompareStatusCode> executeOperationVector(const std::chrono::seconds& timeout);
 
 protected:
+  //--------------------------------------------------------------------------
+  //! Issue the operations in the range [begin, end) of the operation vector
+  //! without waiting for them to complete. Allows child classes to send
+  //! part of the operation vector while preparing the rest.
+  //!
+  //! @param begin index of the first operation to issue
+  //! @param end index after the last operation to issue
+  //--------------------------------------------------------------------------
+  void submitOperations(std::size_t begin, std::size_t end);
+
+  //--------------------------------------------------------------------------
+  //! Wait for all submitted operations to complete. Deferred operations are
+  //! issued as submission slots become available, operations that did not
+  //! obtain a slot within the timeout are failed. The timeout of issued
+  //! operations starts when they are issued, operations that did not
+  //! complete within the timeout are failed.
+  //!
+  //! @param timeout the network timeout to be used
+  //! @return a std::map containing the frequency of operation results
+  //--------------------------------------------------------------------------
+  std::map<kinetic::StatusCode, size_t, CompareStatusCode> awaitOperations(const std::chrono::seconds& timeout);
+
   struct KineticAsyncOperation {
       //! The assigned kinetic function, all arguments except the connection have to be bound.
       std::function<kinetic::HandlerKey(std::shared_ptr<kinetic::ThreadsafeNonblockingKineticConnection>&)> function;
@@ -102,6 +124,30 @@ protected:
   //! Connection vector
   std::vector<std::unique_ptr<KineticAutoConnection>>& connections;
 
+  //! Underlying connections the operations have been submitted on, indexed like the operation vector
+  std::vector<std::shared_ptr<kinetic::ThreadsafeNonblockingKineticConnection>> submitted_connections;
+
+  //! Handler keys of submitted operations, indexed like the operation vector
+  std::vector<kinetic::HandlerKey> handler_keys;
+
+  //! Operations waiting for a submission slot of their connection
+  std::vector<std::size_t> deferred;
+
+  //! Time operations have been deferred, indexed like the operation vector
+  std::vector<std::chrono::system_clock::time_point> queued;
+
+  //! Time operations have been issued, indexed like the operation vector
+  std::vector<std::chrono::system_clock::time_point> issued;
+
+  //--------------------------------------------------------------------------
+  //! Issue and send a single operation if a submission slot of its connection
+  //! is available. The underlying connection has to be set already.
+  //!
+  //! @param index index into the operation vector
+  //! @return true if issued, false if no slot is available
+  //--------------------------------------------------------------------------
+  bool issueOperation(std::size_t index);
+
   //--------------------------------------------------------------------------
   //! Used for initial setup (and possible future expansion) of the operation
   //! vector. Chooses the connections to be used. Can be overwritten for
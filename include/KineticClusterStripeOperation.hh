@@ -156,6 +156,23 @@ public:
   //--------------------------------------------------------------------------
   std::shared_ptr<const std::string> getVersionAt(int index) const;
 
+  //--------------------------------------------------------------------------
+  //! Return the chunks of the stripe as they should be stored on the drives
+  //! if execute succeeded. Invalid chunks have been recomputed.
+  //!
+  //! @return the stripe
+  //--------------------------------------------------------------------------
+  const std::vector<std::shared_ptr<const std::string>>& getStripe() const;
+
+  //--------------------------------------------------------------------------
+  //! Return the positions of chunks that have been found missing, with a
+  //! version other than the stripe version or failing crc verification if
+  //! execute succeeded.
+  //!
+  //! @return the invalid chunk positions
+  //--------------------------------------------------------------------------
+  const std::vector<size_t>& getInvalidChunks() const;
+
   //--------------------------------------------------------------------------
   //! Structure to store a version and it's frequency in the operation vector
   //--------------------------------------------------------------------------
@@ -203,7 +220,31 @@ protected:
   //--------------------------------------------------------------------------
   bool insertHandoffChunks();
 
-  kinetic::KineticStatus do_execute(const std::chrono::seconds& timeout);
+  //--------------------------------------------------------------------------
+  //! Called after parity chunks have been requested in addition to data
+  //! chunks that have already been read. Chooses the chunks to decode from
+  //! and folds in the valid data chunks while the parity chunks are in
+  //! flight.
+  //--------------------------------------------------------------------------
+  void startDecoding();
+
+  //--------------------------------------------------------------------------
+  //! Complete the decoder set up by startDecoding() by adding the parity
+  //! chunks and fill in the erased chunks of the stripe.
+  //!
+  //! @return true if the stripe is complete, false if the decoder could not
+  //!   be used, e.g. because chunks it relies on turned out to be invalid
+  //--------------------------------------------------------------------------
+  bool finishDecoding();
+
+  //--------------------------------------------------------------------------
+  //! Execute the operation vector and evaluate results.
+  //!
+  //! @param timeout the network timeout
+  //! @param decode if true, start decoding while waiting for results
+  //! @return returns operation status
+  //--------------------------------------------------------------------------
+  kinetic::KineticStatus do_execute(const std::chrono::seconds& timeout, bool decode = false);
 
   //! metadata only get
   bool skip_value;
@@ -211,6 +252,14 @@ protected:
   VersionCount version;
   //! the reconstructed value
   std::shared_ptr<std::string> value;
+  //! the reconstructed stripe
+  std::vector<std::shared_ptr<const std::string>> stripe;
+  //! positions of chunks that had to be reconstructed
+  std::vector<size_t> invalid_chunks;
+  //! decoder set up by startDecoding(), if any
+  std::unique_ptr<RedundancyProvider::Decoder> decoder;
+  //! the version of the data chunks already added to the decoder
+  std::shared_ptr<const std::string> decoder_version;
 };
 
 
@@ -279,24 +328,17 @@ public:
 
   //--------------------------------------------------------------------------
   //! Execute the operation vector set up in the constructor and evaluate
-  //! results. Will throw if a partial stripe write is detected.
+  //! results. Data chunks are sent first, parity chunks are computed while
+  //! the data chunks are in flight and sent when ready.
   //!
   //! @param timeout the network timeout
   //--------------------------------------------------------------------------
   kinetic::KineticStatus execute(const std::chrono::seconds& timeout);
   
   //--------------------------------------------------------------------------
-  //! Only do a targeted repair operation based on the supplied get operation
-  //! instead of executing the operation vector set up in the constructor. 
-  //! This function is only called by the AdminCluster repair functionality.
-  //!
-  //! @param timeout the network timeout
-  //! @param drive_versions chunk versions expected on the drives 
-  //--------------------------------------------------------------------------
-  bool quick_repair(const std::chrono::seconds& timeout, const StripeOperation_GET& drive_versions);
-
-  //--------------------------------------------------------------------------
-  //! Constructor, sets up the operation vector.
+  //! Constructor, sets up the operation vector for the data chunks. Parity
+  //! chunks of the supplied stripe are expected to be empty, they are filled
+  //! in by execute().
   //!
   //! @params... all the params
   //--------------------------------------------------------------------------
@@ -318,11 +360,22 @@ private:
       kinetic::WriteMode writeMode
   );
 
+  //--------------------------------------------------------------------------
+  //! Compute the parity chunks of the stripe from the data chunks.
+  //--------------------------------------------------------------------------
+  void computeParity();
+
 private:
   //! remember target version in case we need to write handoff keys
   const std::shared_ptr<const std::string>& version_new;
   //! remember chunk values in case we write handoff keys or repair a stripe
   std::vector<std::shared_ptr<const std::string>>& values;
+  //! the version expected on the drives, required to set up parity operations
+  std::shared_ptr<const std::string> version_old;
+  //! the write mode, required to set up parity operations
+  kinetic::WriteMode write_mode;
+  //! false if computing parity failed, parity chunks must not be written in this case
+  bool parity_valid;
 };
 
 //--------------------------------------------------------------------------
@@ -362,6 +415,47 @@ private:
   );
 };
 
+//--------------------------------------------------------------------------
+//! Stripe Repair Operation, only writes the chunks a preceding get operation
+//! found to be invalid. Used by the AdminCluster repair functionality.
+//--------------------------------------------------------------------------
+class StripeOperation_REPAIR : public KineticClusterStripeOperation {
+public:
+  //--------------------------------------------------------------------------
+  //! Write the invalid chunks, expecting the chunk versions observed by the
+  //! get operation on the drives.
+  //!
+  //! @param timeout the network timeout
+  //! @return OK if all chunks could be written
+  //--------------------------------------------------------------------------
+  kinetic::KineticStatus execute(const std::chrono::seconds& timeout);
+
+  //--------------------------------------------------------------------------
+  //! Return the number of chunks written by this operation.
+  //!
+  //! @return the number of chunks
+  //--------------------------------------------------------------------------
+  size_t size() const;
+
+  //--------------------------------------------------------------------------
+  //! Constructor, sets up the operation vector. Chunks on drives that did
+  //! not return a result to the get operation are skipped.
+  //!
+  //! @param key the key of the stripe
+  //! @param chunks an executed get operation that reconstructed the stripe
+  //--------------------------------------------------------------------------
+  explicit StripeOperation_REPAIR(
+      const std::shared_ptr<const std::string>& key,
+      const StripeOperation_GET& chunks,
+      std::vector<std::unique_ptr<KineticAutoConnection>>& connections,
+      std::shared_ptr<RedundancyProvider>& redundancy
+  );
+
+private:
+  //! the number of chunks written
+  size_t num_chunks;
+};
+
 }
 
 #endif
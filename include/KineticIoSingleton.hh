@@ -25,6 +25,8 @@
 /*----------------------------------------------------------------------------*/
 #include "ClusterMap.hh"
 #include "DataCache.hh"
+#include "SharedBlockCache.hh"
+#include "SmallFilePacker.hh"
 #include "BackgroundOperationHandler.hh"
 /*----------------------------------------------------------------------------*/
 
@@ -42,6 +44,9 @@ public:
   //! return thread pool 
   BackgroundOperationHandler& threadpool();
 
+  //! return small file packer
+  SmallFilePacker& packer();
+
   size_t readaheadWindowSize();
   
   //--------------------------------------------------------------------------
@@ -73,12 +78,26 @@ private:
   struct Configuration{
       //! the maximum size of the data cache in bytes
       size_t stripecache_capacity;
+      //! partitions of the data cache by tenant tag or cluster id
+      std::vector<DataCache::PartitionConfiguration> stripecache_partitions;
       //! the maximum number of keys prefetched by readahead algorithm
       std::atomic<size_t> readahead_window_size;
       //! the number of threads used for bg io in the data cache, can be 0
       int background_io_threads;
       //! the maximum number of operations queued for bg io, can be 0 
       int background_io_queue_capacity;
+      //! the size of the node-wide shared cache in bytes, 0 to disable
+      size_t sharedcache_capacity;
+      //! the name of the node-wide shared cache segment
+      std::string sharedcache_name;
+      //! the maximum size of files to pack, 0 to disable packing
+      size_t pack_threshold;
+      //! the maximum time to wait for more small files before writing a pack
+      std::chrono::milliseconds pack_delay;
+      //! the maximum number of concurrent drive reconnection attempts
+      size_t max_concurrent_reconnects;
+      //! the number of epoll event loops serving drive connections, 0 for one per core
+      size_t listener_threads;
   };
 
   //! storing the library wide configuration parameters
@@ -87,11 +106,17 @@ private:
   //! the cluster map 
   ClusterMap clusterMap;
   
+  //! clean data blocks shared with other processes on this node
+  SharedBlockCache sharedCache;
+
   //! the data cache shared among cluster instances
   DataCache dataCache;
   
   //! the threadpool for background operations
   BackgroundOperationHandler threadPool;
+
+  //! packing small files into shared values
+  SmallFilePacker smallFilePacker;
   
   //! concurrency control
   std::mutex mutex;
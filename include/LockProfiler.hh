@@ -0,0 +1,159 @@
+//------------------------------------------------------------------------------
+//! @file LockProfiler.hh
+//! @author Paul Hermann Lensing
+//! @brief Mutex wrapper recording contention statistics per named lock site.
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * KineticIo - a file io interface library to kinetic devices.          *
+ *                                                                      *
+ * This Source Code Form is subject to the terms of the Mozilla         *
+ * Public License, v. 2.0. If a copy of the MPL was not                 *
+ * distributed with this file, You can obtain one at                    *
+ * https://mozilla.org/MP:/2.0/.                                        *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without       *
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or         *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public             *
+ * License for more details.                                            *
+ ************************************************************************/
+
+#ifndef KINETICIO_LOCKPROFILER_HH
+#define KINETICIO_LOCKPROFILER_HH
+
+#include <chrono>
+#include <mutex>
+#include <string>
+
+namespace kio {
+
+//------------------------------------------------------------------------------
+//! Collects acquisition counts, wait time histograms and hold times of
+//! ProfiledMutex objects. All mutexes constructed with the same name are
+//! accounted to the same lock site. Profiling is enabled by setting the
+//! environment variable KINETICIO_LOCK_PROFILING, otherwise mutexes do not
+//! register a lock site and no statistics are recorded.
+//------------------------------------------------------------------------------
+class LockProfiler {
+public:
+  //! Statistics of a lock site, opaque outside of the profiler.
+  struct Site;
+
+  //! the clock used for measuring wait and hold times
+  typedef std::chrono::high_resolution_clock clock;
+
+  //--------------------------------------------------------------------------
+  //! Check if profiling is enabled.
+  //!
+  //! @return true if mutexes constructed now will be profiled
+  //--------------------------------------------------------------------------
+  static bool enabled();
+
+  //--------------------------------------------------------------------------
+  //! Enable or disable profiling for mutexes constructed from now on,
+  //! overriding the environment.
+  //!
+  //! @param enable true to enable profiling
+  //--------------------------------------------------------------------------
+  static void setEnabled(bool enable);
+
+  //--------------------------------------------------------------------------
+  //! Obtain the lock site of the supplied name.
+  //!
+  //! @param name the name of the lock site
+  //! @return the lock site, NULL if profiling is disabled
+  //--------------------------------------------------------------------------
+  static Site* site(const char* name);
+
+  //--------------------------------------------------------------------------
+  //! Record an acquisition of a lock site.
+  //!
+  //! @param site the lock site
+  //! @param contended true if the mutex was held by someone else
+  //! @param wait the time spent waiting for the mutex
+  //--------------------------------------------------------------------------
+  static void acquired(Site* site, bool contended, clock::duration wait);
+
+  //--------------------------------------------------------------------------
+  //! Record a release of a lock site.
+  //!
+  //! @param site the lock site
+  //! @param hold the time the mutex has been held
+  //--------------------------------------------------------------------------
+  static void released(Site* site, clock::duration hold);
+
+  //--------------------------------------------------------------------------
+  //! Build a human readable report of all lock sites, ordered by the total
+  //! time spent waiting.
+  //!
+  //! @return the report, empty if no lock site has been profiled
+  //--------------------------------------------------------------------------
+  static std::string report();
+
+  //--------------------------------------------------------------------------
+  //! Reset the statistics of all lock sites.
+  //--------------------------------------------------------------------------
+  static void reset();
+};
+
+//------------------------------------------------------------------------------
+//! Is a Lockable, providing lock(), try_lock() and unlock() methods. Use
+//! std::condition_variable_any to wait on it.
+//------------------------------------------------------------------------------
+class ProfiledMutex {
+public:
+  void lock()
+  {
+    if (!site) {
+      mutex.lock();
+      return;
+    }
+    auto start = LockProfiler::clock::now();
+    bool contended = !mutex.try_lock();
+    if (contended) {
+      mutex.lock();
+    }
+    acquired = LockProfiler::clock::now();
+    LockProfiler::acquired(site, contended, acquired - start);
+  }
+
+  bool try_lock()
+  {
+    if (!mutex.try_lock()) {
+      return false;
+    }
+    if (site) {
+      acquired = LockProfiler::clock::now();
+      LockProfiler::acquired(site, false, LockProfiler::clock::duration::zero());
+    }
+    return true;
+  }
+
+  void unlock()
+  {
+    if (site) {
+      LockProfiler::released(site, LockProfiler::clock::now() - acquired);
+    }
+    mutex.unlock();
+  }
+
+  //--------------------------------------------------------------------------
+  //! Constructor.
+  //!
+  //! @param name the name of the lock site, e.g. "DataCache::cache_mutex"
+  //--------------------------------------------------------------------------
+  explicit ProfiledMutex(const char* name) : site(LockProfiler::site(name)) { };
+
+  ProfiledMutex(const ProfiledMutex&) = delete;
+  void operator=(const ProfiledMutex&) = delete;
+
+private:
+  std::mutex mutex;
+  LockProfiler::Site* site;
+  LockProfiler::clock::time_point acquired;
+};
+
+}
+
+#endif //KINETICIO_LOCKPROFILER_HH
@@ -24,6 +24,7 @@
 #include "KineticIoFactory.hh"
 #include "Utility.hh"
 #include <mutex>
+#include "LockProfiler.hh"
 #include <sstream>
 #include <syslog.h>
 
@@ -44,7 +45,7 @@ namespace kio {
     //!   log level.
     //--------------------------------------------------------------------------
     void registerLogFunction(logfunc_t lfunc, shouldlogfunc_t shouldfunc){
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<ProfiledMutex> lock(mutex);
       logFunction = lfunc;
       shouldLog = shouldfunc;
     }
@@ -62,7 +63,7 @@ namespace kio {
     //--------------------------------------------------------------------------
     template<typename...Args>
     void log(const char* func, const char* file, int line, int level, Args&&...args){
-      std::lock_guard<std::mutex> lock(mutex);
+      std::lock_guard<ProfiledMutex> lock(mutex);
       if(!logFunction || !shouldLog || !shouldLog(func,level))
         return;
       auto s = utility::Convert::toString(std::forward<Args>(args)...);
@@ -82,7 +83,7 @@ namespace kio {
     //--------------------------------------------------------------------------
     //! Constructor. Private, access to Logger instance through get() method.
     //--------------------------------------------------------------------------
-    explicit Logger(){};
+    explicit Logger() : mutex("Logger::mutex") {};
 
   private:
     //! log function to use
@@ -90,7 +91,7 @@ namespace kio {
     //! function to test if log function should be called for a specific function name & log level
     shouldlogfunc_t shouldLog;
     //! concurrency
-    std::mutex mutex;
+    ProfiledMutex mutex;
   };
 }
 
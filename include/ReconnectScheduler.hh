@@ -0,0 +1,180 @@
+//------------------------------------------------------------------------------
+//! @file ReconnectScheduler.hh
+//! @author Paul Hermann Lensing
+//! @brief Shared scheduling of drive reconnection attempts with backoff.
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * KineticIo - a file io interface library to kinetic devices.          *
+ *                                                                      *
+ * This Source Code Form is subject to the terms of the Mozilla         *
+ * Public License, v. 2.0. If a copy of the MPL was not                 *
+ * distributed with this file, You can obtain one at                    *
+ * https://mozilla.org/MP:/2.0/.                                        *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without       *
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or         *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public             *
+ * License for more details.                                            *
+ ************************************************************************/
+
+#ifndef KINETICIO_RECONNECTSCHEDULER_HH
+#define KINETICIO_RECONNECTSCHEDULER_HH
+
+#include <chrono>
+#include <condition_variable>
+#include <random>
+#include <unordered_map>
+#include "LockProfiler.hh"
+
+namespace kio {
+
+class KineticAutoConnection;
+
+//------------------------------------------------------------------------------
+//! Executes reconnection attempts of all connections with bounded
+//! concurrency. After a failed attempt, the next attempt of the same
+//! connection is delayed by an exponential backoff with random jitter, so
+//! that connections failed at the same time do not retry in lock-step.
+//! Connections that have been requested most often since their last
+//! attempt are served first.
+//------------------------------------------------------------------------------
+class ReconnectScheduler {
+public:
+  //--------------------------------------------------------------------------
+  //! Reconnection statistics.
+  //--------------------------------------------------------------------------
+  struct Statistics {
+    //! the total number of reconnection attempts
+    uint64_t attempts;
+    //! the total number of failed reconnection attempts
+    uint64_t failures;
+    //! the number of connections waiting for an attempt
+    std::size_t pending;
+    //! the number of connections with an attempt in progress
+    std::size_t running;
+    //! the number of connections whose last attempt failed
+    std::size_t backing_off;
+  };
+
+  //--------------------------------------------------------------------------
+  //! Request a reconnection attempt. The attempt is executed as soon as
+  //! allowed by the backoff of the connection and the concurrency limit.
+  //! Requesting an already scheduled connection increases its priority.
+  //!
+  //! @param connection the connection
+  //! @param ratelimit minimum time between attempts, base of the backoff
+  //--------------------------------------------------------------------------
+  void request(KineticAutoConnection* connection, std::chrono::seconds ratelimit);
+
+  //--------------------------------------------------------------------------
+  //! Record the result of an attempt that has been executed outside of the
+  //! scheduler, e.g. the initial connect.
+  //!
+  //! @param connection the connection
+  //! @param ratelimit minimum time between attempts, base of the backoff
+  //! @param success true if the attempt succeeded
+  //--------------------------------------------------------------------------
+  void attempted(KineticAutoConnection* connection, std::chrono::seconds ratelimit, bool success);
+
+  //--------------------------------------------------------------------------
+  //! Forget about a connection, waiting for an attempt in progress to
+  //! complete. Has to be called before a connection is destroyed.
+  //!
+  //! @param connection the connection
+  //--------------------------------------------------------------------------
+  void cancel(KineticAutoConnection* connection);
+
+  //--------------------------------------------------------------------------
+  //! Obtain reconnection statistics.
+  //!
+  //! @return the statistics
+  //--------------------------------------------------------------------------
+  Statistics stats();
+
+  //--------------------------------------------------------------------------
+  //! Change the maximum number of concurrent attempts during runtime.
+  //!
+  //! @param concurrency maximum number of concurrent attempts, at least 1
+  //--------------------------------------------------------------------------
+  void changeConfiguration(std::size_t concurrency);
+
+  //--------------------------------------------------------------------------
+  //! Constructor.
+  //!
+  //! @param concurrency maximum number of concurrent attempts, at least 1
+  //--------------------------------------------------------------------------
+  explicit ReconnectScheduler(std::size_t concurrency);
+
+  //--------------------------------------------------------------------------
+  //! Destructor, waits for attempts in progress to complete.
+  //--------------------------------------------------------------------------
+  ~ReconnectScheduler();
+
+  ReconnectScheduler(const ReconnectScheduler&) = delete;
+  void operator=(const ReconnectScheduler&) = delete;
+
+private:
+  //--------------------------------------------------------------------------
+  //! Scheduling state of a single connection.
+  //--------------------------------------------------------------------------
+  struct Entry {
+    //! the number of consecutive failed attempts
+    std::size_t failures;
+    //! the number of requests since the last attempt
+    uint64_t waiting;
+    //! true if an attempt has been requested
+    bool queued;
+    //! true if an attempt is in progress
+    bool running;
+    //! the earliest time of the next attempt
+    std::chrono::system_clock::time_point next_attempt;
+    //! base of the backoff
+    std::chrono::seconds ratelimit;
+
+    Entry() : failures(0), waiting(0), queued(false), running(false), next_attempt(), ratelimit(0)
+    { }
+  };
+
+  //--------------------------------------------------------------------------
+  //! Executes attempts until shut down or the number of workers exceeds the
+  //! configured concurrency.
+  //--------------------------------------------------------------------------
+  void worker();
+
+  //--------------------------------------------------------------------------
+  //! Update the entry of a connection after an attempt, requires the mutex
+  //! to be held.
+  //!
+  //! @param entry the entry of the connection
+  //! @param success true if the attempt succeeded
+  //--------------------------------------------------------------------------
+  void completed(Entry& entry, bool success);
+
+private:
+  //! scheduling state of all known connections
+  std::unordered_map<KineticAutoConnection*, Entry> entries;
+  //! maximum number of concurrent attempts
+  std::size_t concurrency;
+  //! current number of worker threads
+  std::size_t workers;
+  //! signal worker threads to shut down
+  bool shutdown;
+  //! total number of attempts
+  uint64_t attempts;
+  //! total number of failed attempts
+  uint64_t failures;
+  //! random number generator for backoff jitter
+  std::mt19937 mt;
+  //! workers block until an attempt is due
+  std::condition_variable_any worker_cv;
+  //! cancel and destructor block until attempts or workers are done
+  std::condition_variable_any done_cv;
+  //! concurrency control
+  ProfiledMutex mutex;
+};
+
+}
+
+#endif //KINETICIO_RECONNECTSCHEDULER_HH
@@ -27,6 +27,7 @@
 #include <string>
 #include <unordered_map>
 #include <mutex>
+#include "LockProfiler.hh"
 
 namespace kio {
 
@@ -37,7 +38,62 @@ namespace kio {
 //! replication. 
 //------------------------------------------------------------------------------
 class RedundancyProvider {
+private:
+  struct CodingTable;
+
 public:
+  //--------------------------------------------------------------------------
+  //! Incrementally recovers the erased blocks of a stripe. The contribution
+  //! of each source block is folded into the output as soon as it is added,
+  //! so that little work remains once the last source block is available.
+  //--------------------------------------------------------------------------
+  class Decoder {
+  public:
+    //--------------------------------------------------------------------------
+    //! Get the stripe indices of the blocks required for decoding.
+    //!
+    //! @return the stripe indices of all source blocks
+    //--------------------------------------------------------------------------
+    const std::vector<unsigned int>& sources() const;
+
+    //--------------------------------------------------------------------------
+    //! Add a source block. Throws if the index is not a source or the block
+    //! has the wrong size.
+    //!
+    //! @param index the stripe index of the block
+    //! @param block the block, an empty block is treated as 0ed
+    //--------------------------------------------------------------------------
+    void add(std::size_t index, const std::shared_ptr<const std::string>& block);
+
+    //--------------------------------------------------------------------------
+    //! Set the erased blocks of the stripe. Throws if not all source blocks
+    //! have been added.
+    //!
+    //! @param stripe nData+nParity blocks, erased blocks will be set
+    //--------------------------------------------------------------------------
+    void finish(std::vector<std::shared_ptr<const std::string> >& stripe);
+
+  private:
+    friend class RedundancyProvider;
+    Decoder(const std::string& pattern, const CodingTable* table, std::vector<unsigned int> sources,
+            std::size_t blockSize);
+
+    //! the error pattern of the stripe
+    std::string pattern;
+    //! coding table for the error pattern, NULL for replication
+    const CodingTable* table;
+    //! stripe indices of source blocks
+    std::vector<unsigned int> blockIndices;
+    //! size of each block
+    std::size_t blockSize;
+    //! the source blocks that have been added, indexed like blockIndices
+    std::vector<bool> added;
+    //! for replication, the source block
+    std::shared_ptr<const std::string> replica;
+    //! output buffers of the erased blocks
+    std::vector<unsigned char> memory;
+  };
+
   //--------------------------------------------------------------------------
   //! Compute all missing data and parity blocks in the the stripe. Stripe size
   //! has to equal nData+nParity. Blocks can be arbitrary size, but size has
@@ -48,6 +104,16 @@ public:
   //--------------------------------------------------------------------------
   void compute(std::vector<std::shared_ptr<const std::string> >& stripe);
 
+  //--------------------------------------------------------------------------
+  //! Set up incremental decoding for a stripe with a known error pattern.
+  //! Function will throw on incorrect input.
+  //!
+  //! @param erasures the stripe indices of all blocks to be computed
+  //! @param blockSize the size of each block in the stripe
+  //! @return the decoder
+  //--------------------------------------------------------------------------
+  std::unique_ptr<Decoder> makeDecoder(const std::vector<std::size_t>& erasures, std::size_t blockSize);
+
   //--------------------------------------------------------------------------
   //! Get nData
   //!
@@ -107,6 +173,16 @@ private:
       const std::vector<std::shared_ptr<const std::string> >& stripe
   ) const;
 
+  //--------------------------------------------------------------------------
+  //! Constructs the error pattern from a list of erased block indices.
+  //!
+  //! @param erasures the stripe indices of erased blocks
+  //! @return a string of stripe size describing the error pattern
+  //--------------------------------------------------------------------------
+  std::string getErrorPattern(
+      const std::vector<std::size_t>& erasures
+  ) const;
+
   //--------------------------------------------------------------------------
   //! Returns a reference to the coding table for the requested error pattern,
   //! if possible from the cache. If that particular table has not been
@@ -129,7 +205,7 @@ private:
   //! a cache of previously used coding tables
   std::unordered_map<std::string, CodingTable> cache;
   //! concurrency control
-  std::mutex mutex;
+  ProfiledMutex mutex;
 };
 
 }
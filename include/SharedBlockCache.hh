@@ -0,0 +1,187 @@
+//------------------------------------------------------------------------------
+//! @file SharedBlockCache.hh
+//! @author Paul Hermann Lensing
+//! @brief A node-wide cache for clean data blocks in POSIX shared memory.
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * KineticIo - a file io interface library to kinetic devices.          *
+ *                                                                      *
+ * This Source Code Form is subject to the terms of the Mozilla         *
+ * Public License, v. 2.0. If a copy of the MPL was not                 *
+ * distributed with this file, You can obtain one at                    *
+ * https://mozilla.org/MP:/2.0/.                                        *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without       *
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or         *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public             *
+ * License for more details.                                            *
+ ************************************************************************/
+
+#ifndef KINETICIO_SHAREDBLOCKCACHE_HH
+#define KINETICIO_SHAREDBLOCKCACHE_HH
+
+/*----------------------------------------------------------------------------*/
+#if __GNUC__ == 4 && (__GNUC_MINOR__ == 4)
+    #include <cstdatomic>
+#else
+  #include <atomic>
+#endif
+#include <stdint.h>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <mutex>
+/*----------------------------------------------------------------------------*/
+
+namespace kio {
+
+//------------------------------------------------------------------------------
+//! Clean data blocks shared among all processes on a node using the library.
+//! The segment is split into fixed size slots, grouped into sets of slots
+//! a key may be stored in. Each set is protected by a process-shared mutex. Only clean values are published, dirty data stays
+//! private to the process that wrote it. Entries carry the version and the
+//! time they were last verified against the backend so readers can apply
+//! the same expiration rules as DataBlock.
+//------------------------------------------------------------------------------
+class SharedBlockCache {
+public:
+  //--------------------------------------------------------------------------
+  //! Look up the entry for the supplied key.
+  //!
+  //! @param key the data key of the block
+  //! @param version set to the version of the shared value on success
+  //! @param value set to a copy of the shared value on success
+  //! @param timestamp set to the time the entry was last verified
+  //! @return true if an entry exists, false otherwise
+  //--------------------------------------------------------------------------
+  bool get(const std::string& key,
+           std::shared_ptr<const std::string>& version,
+           std::shared_ptr<const std::string>& value,
+           std::chrono::system_clock::time_point& timestamp);
+
+  //--------------------------------------------------------------------------
+  //! Publish a clean value. Values that do not fit a slot are ignored.
+  //!
+  //! @param key the data key of the block
+  //! @param version the version of the value as stored in the backend
+  //! @param value the value as stored in the backend
+  //--------------------------------------------------------------------------
+  void put(const std::string& key, const std::string& version, const std::string& value);
+
+  //--------------------------------------------------------------------------
+  //! Mark the entry for key as verified now, if it still has the supplied
+  //! version.
+  //!
+  //! @param key the data key of the block
+  //! @param version the version that has been verified against the backend
+  //--------------------------------------------------------------------------
+  void touch(const std::string& key, const std::string& version);
+
+  //--------------------------------------------------------------------------
+  //! Attach to (or create) the named shared memory segment. The geometry of
+  //! an existing segment is set by the process that created it, attaching
+  //! with a different geometry fails and leaves the shared cache disabled.
+  //! Once attached, the segment stays attached until destruction.
+  //!
+  //! @param name the shared memory object name, e.g. "/kineticio"
+  //! @param capacity the size of the data area in bytes, 0 to disable
+  //! @param slot_size the maximum size of a single value
+  //--------------------------------------------------------------------------
+  void changeConfiguration(const std::string& name, size_t capacity, size_t slot_size);
+
+  //--------------------------------------------------------------------------
+  //! @return true if attached to a shared memory segment
+  //--------------------------------------------------------------------------
+  bool enabled() const;
+
+  //--------------------------------------------------------------------------
+  //! Constructor. The cache is disabled until configured.
+  //--------------------------------------------------------------------------
+  SharedBlockCache();
+
+  //--------------------------------------------------------------------------
+  //! Destructor, unmaps the segment. The segment itself persists for other
+  //! processes on the node.
+  //--------------------------------------------------------------------------
+  ~SharedBlockCache();
+
+  //--------------------------------------------------------------------------
+  //! No copy constructor.
+  //--------------------------------------------------------------------------
+  SharedBlockCache(SharedBlockCache&) = delete;
+
+  //--------------------------------------------------------------------------
+  //! No copy assignment.
+  //--------------------------------------------------------------------------
+  void operator=(SharedBlockCache&) = delete;
+
+private:
+  struct Segment;
+  struct Slot;
+
+  //--------------------------------------------------------------------------
+  //! Find the slot holding the supplied key and lock it.
+  //!
+  //! @param key the data key of the block
+  //! @param evict if true and the key is not found, the least recently
+  //!   verified slot of the key's set is locked and returned instead
+  //! @return the index of the slot, whose set is locked, or npos if none is
+  //!   found
+  //--------------------------------------------------------------------------
+  size_t lockSlot(const std::string& key, bool evict);
+
+  //--------------------------------------------------------------------------
+  //! Lock the set containing a slot, recovering it if the previous owner
+  //! died while holding the lock.
+  //!
+  //! @param index index of a slot of the set
+  //! @return true if locked, false if the lock can not be recovered
+  //--------------------------------------------------------------------------
+  bool lock(size_t index);
+
+  //--------------------------------------------------------------------------
+  //! Unlock the set containing a slot.
+  //!
+  //! @param index index of a slot of the set
+  //--------------------------------------------------------------------------
+  void unlock(size_t index);
+
+  //--------------------------------------------------------------------------
+  //! @return the number of slots in a set
+  //--------------------------------------------------------------------------
+  size_t setSize() const;
+
+  //--------------------------------------------------------------------------
+  //! @param index slot index
+  //! @return the slot header
+  //--------------------------------------------------------------------------
+  Slot* slot(size_t index) const;
+
+  //--------------------------------------------------------------------------
+  //! @param index slot index
+  //! @return the data area of the slot
+  //--------------------------------------------------------------------------
+  char* data(size_t index) const;
+
+private:
+  //! returned by lockSlot if no slot has been locked
+  static const size_t npos;
+
+  //! number of slots a key may be stored in
+  static const size_t associativity;
+
+  //! the mapped segment, NULL if not attached
+  std::atomic<Segment*> segment;
+
+  //! the size of the mapping in bytes
+  size_t mapping_size;
+
+  //! serializes configuration changes
+  std::mutex mutex;
+};
+
+}
+
+#endif //KINETICIO_SHAREDBLOCKCACHE_HH
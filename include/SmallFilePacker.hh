@@ -0,0 +1,276 @@
+//------------------------------------------------------------------------------
+//! @file SmallFilePacker.hh
+//! @author Paul Hermann Lensing
+//! @brief Store small files appended into shared pack values.
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * KineticIo - a file io interface library to kinetic devices.          *
+ *                                                                      *
+ * This Source Code Form is subject to the terms of the Mozilla         *
+ * Public License, v. 2.0. If a copy of the MPL was not                 *
+ * distributed with this file, You can obtain one at                    *
+ * https://mozilla.org/MP:/2.0/.                                        *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without       *
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or         *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public             *
+ * License for more details.                                            *
+ ************************************************************************/
+
+#ifndef KINETICIO_SMALLFILEPACKER_HH
+#define KINETICIO_SMALLFILEPACKER_HH
+
+/*----------------------------------------------------------------------------*/
+#if __GNUC__ == 4 && (__GNUC_MINOR__ == 4)
+    #include <cstdatomic>
+#else
+  #include <atomic>
+#endif
+#include <condition_variable>
+#include <unordered_map>
+#include <chrono>
+#include <memory>
+#include <string>
+#include <vector>
+#include <mutex>
+#include <list>
+#include "ClusterInterface.hh"
+/*----------------------------------------------------------------------------*/
+
+namespace kio {
+
+//------------------------------------------------------------------------------
+//! Small files are appended into shared pack values instead of being stored
+//! in their own data keys. A pack is stored like the single data block of a
+//! hidden file, its index (offset, length and path of every entry) is stored
+//! as an attribute of that file. The metadata key of a packed file references
+//! its location in the pack. Packs are never modified once written, deleted
+//! space is reclaimed by compaction, which re-packs the live entries of a
+//! pack and removes it.
+//!
+//! Small files are stored in their own data keys when they are closed and
+//! are moved into a pack in the background. Files closed after each other
+//! are collected in the same pack until it is full or the configured delay
+//! since the first file has passed, so that a single pack write stores many
+//! small files independent of how many files are closed concurrently.
+//------------------------------------------------------------------------------
+class SmallFilePacker {
+public:
+  //! The location of a packed file.
+  struct Location {
+    //! path of the pack, empty if not packed
+    std::string pack;
+    //! offset of the file in the pack
+    size_t offset;
+    //! length of the file
+    size_t length;
+
+    Location() : pack(), offset(0), length(0)
+    { }
+  };
+
+  //--------------------------------------------------------------------------
+  //! Parse the value of a metadata key.
+  //!
+  //! @param metadata_value the value of a metadata key
+  //! @param location set to the location of the file if it is packed
+  //! @return true if the file is packed, false otherwise
+  //--------------------------------------------------------------------------
+  static bool parse(const std::string& metadata_value, Location& location);
+
+  //--------------------------------------------------------------------------
+  //! Move a closed file, which is stored in its own data key, into a pack.
+  //! Returns immediately, the pack is written in the background. The file is
+  //! not packed if it has been changed in the meantime.
+  //!
+  //! @param cluster the cluster the file is stored on
+  //! @param path the path of the file
+  //! @param base the storage base of the file, referenced from its metadata
+  //! @param value the content of the file
+  //! @param metadata_version the current version of the metadata key
+  //--------------------------------------------------------------------------
+  void schedule(const std::shared_ptr<ClusterInterface>& cluster,
+                const std::string& path,
+                const std::string& base,
+                const std::shared_ptr<const std::string>& value,
+                const std::shared_ptr<const std::string>& metadata_version);
+
+  //--------------------------------------------------------------------------
+  //! Read the content of a packed file.
+  //!
+  //! @param cluster the cluster the file is stored on
+  //! @param location the location of the file
+  //! @param value set to the content of the file on success
+  //! @return status of the operation, REMOTE_NOT_FOUND if the pack has been
+  //!   compacted in the meantime
+  //--------------------------------------------------------------------------
+  kinetic::KineticStatus read(const std::shared_ptr<ClusterInterface>& cluster,
+                              const Location& location,
+                              std::shared_ptr<const std::string>& value);
+
+  //--------------------------------------------------------------------------
+  //! Account for a packed file that has been removed or unpacked. Schedules
+  //! a background compaction of the pack once enough space has been freed.
+  //!
+  //! @param cluster the cluster the file is stored on
+  //! @param location the former location of the file
+  //--------------------------------------------------------------------------
+  void release(const std::shared_ptr<ClusterInterface>& cluster, const Location& location);
+
+  //--------------------------------------------------------------------------
+  //! Re-pack the live entries of a pack and remove it, if less than half of
+  //! the pack is still referenced.
+  //!
+  //! @param cluster the cluster the pack is stored on
+  //! @param pack the path of the pack
+  //! @return status of the operation
+  //--------------------------------------------------------------------------
+  kinetic::KineticStatus compact(const std::shared_ptr<ClusterInterface>& cluster, const std::string& pack);
+
+  //--------------------------------------------------------------------------
+  //! @return the maximum size of files to pack, 0 if packing is disabled
+  //--------------------------------------------------------------------------
+  size_t threshold() const;
+
+  //--------------------------------------------------------------------------
+  //! The configuration can be changed during runtime.
+  //!
+  //! @param threshold maximum size of files to pack, 0 to disable packing
+  //! @param delay maximum time to wait for more files before writing a pack
+  //--------------------------------------------------------------------------
+  void changeConfiguration(size_t threshold, std::chrono::milliseconds delay);
+
+  //--------------------------------------------------------------------------
+  //! Constructor. Packing is disabled until configured.
+  //--------------------------------------------------------------------------
+  SmallFilePacker();
+
+  //--------------------------------------------------------------------------
+  //! Destructor, completes removing the former data keys of packed files.
+  //--------------------------------------------------------------------------
+  ~SmallFilePacker();
+
+  //--------------------------------------------------------------------------
+  //! No copy constructor.
+  //--------------------------------------------------------------------------
+  SmallFilePacker(SmallFilePacker&) = delete;
+
+  //--------------------------------------------------------------------------
+  //! No copy assignment.
+  //--------------------------------------------------------------------------
+  void operator=(SmallFilePacker&) = delete;
+
+private:
+  //! A file added to a pack.
+  struct Entry {
+    std::string path;
+    std::string base;
+    size_t offset;
+    size_t length;
+    std::shared_ptr<const std::string> metadata_version;
+    //! version of the data key storing the file before it has been packed,
+    //! empty if the file is not stored in its own data key
+    std::shared_ptr<const std::string> data_version;
+    kinetic::KineticStatus status;
+
+    Entry(const std::string& path, const std::string& base, size_t offset, size_t length,
+          const std::shared_ptr<const std::string>& metadata_version,
+          const std::shared_ptr<const std::string>& data_version = std::shared_ptr<const std::string>()) :
+        path(path), base(base), offset(offset), length(length), metadata_version(metadata_version),
+        data_version(data_version), status(kinetic::StatusCode::CLIENT_INTERNAL_ERROR, "not written")
+    { }
+  };
+
+  //! A pack that is being filled.
+  struct Batch {
+    std::shared_ptr<ClusterInterface> cluster;
+    std::string pack;
+    std::string value;
+    std::vector<Entry> entries;
+    //! the time the first file has been added
+    std::chrono::system_clock::time_point started;
+  };
+
+  //--------------------------------------------------------------------------
+  //! Write a pack, its index and the metadata keys of all entries.
+  //!
+  //! @param batch the pack to write
+  //--------------------------------------------------------------------------
+  void write(Batch& batch);
+
+  //--------------------------------------------------------------------------
+  //! Write a pack of closed files that are stored in their own data keys.
+  //! Files that changed since they have been closed are left out.
+  //!
+  //! @param batch the pack to write
+  //! @return the written pack, entries with data_version set have been packed
+  //--------------------------------------------------------------------------
+  std::shared_ptr<Batch> writeClosed(const Batch& batch);
+
+  //--------------------------------------------------------------------------
+  //! Remove the former data keys of packed files. A file that has been
+  //! written since it has been packed is referenced from its data key again.
+  //!
+  //! @param batch a pack written by writeClosed
+  //--------------------------------------------------------------------------
+  void removeClosed(const Batch& batch);
+
+  //--------------------------------------------------------------------------
+  //! Writes packs once they are full or their delay has passed and removes
+  //! the former data keys of packed files, until shut down.
+  //--------------------------------------------------------------------------
+  void worker();
+
+  //--------------------------------------------------------------------------
+  //! Background wrapper for compact. If compaction fails, the released size
+  //! is accounted for again so that compaction is retried.
+  //!
+  //! @param cluster the cluster the pack is stored on
+  //! @param pack the path of the pack
+  //! @param size the released size of the pack that triggered compaction
+  //--------------------------------------------------------------------------
+  void doCompact(std::shared_ptr<ClusterInterface> cluster, std::string pack, size_t size);
+
+private:
+  //! maximum size of files to pack, 0 if disabled
+  std::atomic<size_t> max_file_size;
+
+  //! maximum time to wait for more files before writing a pack
+  std::chrono::milliseconds delay;
+
+  //! the currently filled pack of each cluster instance
+  std::unordered_map<std::string, std::shared_ptr<Batch>> batches;
+
+  //! packs that are full and can be written without waiting
+  std::list<std::shared_ptr<Batch>> ready;
+
+  //! written packs whose files still have to be removed from their data keys, with the time they are due
+  std::list<std::pair<std::chrono::system_clock::time_point, std::shared_ptr<Batch>>> removals;
+
+  //! size of released entries of each pack, as far as known to this process
+  std::unordered_map<std::string, size_t> released;
+
+  //! recently read packs, packs are never modified so there is no need to validate them
+  std::list<std::pair<std::string, std::shared_ptr<const std::string>>> recent;
+
+  //! true if the worker thread has been started and not exited yet
+  bool running;
+
+  //! signal the worker thread to shut down
+  bool shutdown;
+
+  //! signals ready packs to the worker thread
+  std::condition_variable cv;
+
+  //! signals the exit of the worker thread
+  std::condition_variable done_cv;
+
+  //! concurrency control
+  std::mutex mutex;
+};
+
+}
+
+#endif //KINETICIO_SMALLFILEPACKER_HH
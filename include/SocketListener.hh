@@ -24,6 +24,10 @@
 
 /*----------------------------------------------------------------------------*/
 #include <thread>
+#include <memory>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
 /*----------------------------------------------------------------------------*/
 
 namespace kio{
@@ -33,8 +37,11 @@ class KineticAutoConnection;
 
 
 //------------------------------------------------------------------------------
-//! The SocketListener class spawns a background thread which uses epoll to
-//! manage the file descriptors of registered kinetic auto connections.
+//! The SocketListener class spawns background threads which use epoll to
+//! manage the file descriptors of registered kinetic auto connections. Each
+//! thread runs its own event loop; a connection is served by a single loop
+//! for as long as it is subscribed, new subscriptions go to the loop serving
+//! the fewest connections.
 //------------------------------------------------------------------------------
 class SocketListener {
 public:
@@ -56,10 +63,29 @@ public:
   //----------------------------------------------------------------------------
   void unsubscribe(int fd);
 
+  //----------------------------------------------------------------------------
+  //! Change the number of event loops during runtime. Surplus loops continue
+  //! serving the connections already subscribed to them, but are not assigned
+  //! new subscriptions.
+  //!
+  //! @parameter loops the number of event loops, 0 for one per core
+  //----------------------------------------------------------------------------
+  void changeConfiguration(size_t loops);
+
+  //----------------------------------------------------------------------------
+  //! Obtain the number of subscriptions of each event loop accepting new
+  //! subscriptions.
+  //!
+  //! @return the number of subscriptions per event loop
+  //----------------------------------------------------------------------------
+  std::vector<size_t> subscriptions();
+
   //----------------------------------------------------------------------------
   //! Constructor.
+  //!
+  //! @parameter loops the number of event loops, 0 for one per core
   //----------------------------------------------------------------------------
-  explicit SocketListener();
+  explicit SocketListener(size_t loops = 1);
 
   //----------------------------------------------------------------------------
   //! Destructor.
@@ -67,14 +93,47 @@ public:
   ~SocketListener();
 
 private:
-  //! thread object for listener thread
-  std::thread listener;
+  //----------------------------------------------------------------------------
+  //! A single event loop.
+  //----------------------------------------------------------------------------
+  struct EventLoop {
+    //! thread object for listener thread
+    std::thread listener;
+    //! indicate to the listener thread to shut down
+    bool shutdown;
+    //! the epoll or kqueue fd
+    int listener_fd;
+    //! the number of currently subscribed fds
+    size_t subscriptions;
+  };
+
+  //----------------------------------------------------------------------------
+  //! Set up an event loop and start its listener thread. Throws if
+  //! unsuccessful.
+  //!
+  //! @return the event loop
+  //----------------------------------------------------------------------------
+  std::unique_ptr<EventLoop> startLoop();
+
+  //----------------------------------------------------------------------------
+  //! Shut down the listener thread of an event loop and release its
+  //! resources.
+  //!
+  //! @parameter loop the event loop
+  //----------------------------------------------------------------------------
+  void stopLoop(EventLoop& loop);
+
+  //! all event loops, including surplus loops after reducing their number
+  std::vector<std::unique_ptr<EventLoop>> loops;
+
+  //! the number of loops that are assigned new subscriptions
+  size_t active;
 
-  //! indicate to the listener thread to shut down
-  bool shutdown;
+  //! the event loop serving a subscribed fd
+  std::unordered_map<int, EventLoop*> subscribed;
 
-  //! the epoll or kqueue fd
-  int listener_fd;
+  //! concurrency control
+  std::mutex mutex;
 
   //! uncopyable
   SocketListener (const SocketListener&) = delete;
@@ -0,0 +1,60 @@
+//------------------------------------------------------------------------------
+//! @file Tracepoints.hh
+//! @author Paul Hermann Lensing
+//! @brief USDT probes on the I/O path for use with perf, bpftrace or systemtap.
+//------------------------------------------------------------------------------
+
+/************************************************************************
+ * KineticIo - a file io interface library to kinetic devices.          *
+ *                                                                      *
+ * This Source Code Form is subject to the terms of the Mozilla         *
+ * Public License, v. 2.0. If a copy of the MPL was not                 *
+ * distributed with this file, You can obtain one at                    *
+ * https://mozilla.org/MP:/2.0/.                                        *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without       *
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or         *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public             *
+ * License for more details.                                            *
+ ************************************************************************/
+
+#ifndef KINETICIO_TRACEPOINTS_HH
+#define KINETICIO_TRACEPOINTS_HH
+
+//------------------------------------------------------------------------------
+//! All probes belong to the provider 'kineticio'. A probe that is not attached
+//! compiles to a single nop; its arguments are still evaluated, so they should
+//! be cheap to compute. Without sys/sdt.h the probes compile to nothing.
+//!
+//! Probes and their arguments:
+//!   fileio_read_entry     (path, offset, length)
+//!   fileio_read_return    (path, bytes read or -errno)
+//!   fileio_write_entry    (path, offset, length)
+//!   fileio_write_return   (path, bytes written or -errno)
+//!   cache_hit             (key, block number)
+//!   cache_miss            (key, block number)
+//!   cache_evict           (key, block capacity)
+//!   readahead             (path, block number)
+//!   block_flush_entry     (key, size)
+//!   block_flush_return    (key, kinetic status code)
+//!   drive_op_issue        (callback, drive, operation index)
+//!   drive_op_complete     (callback, kinetic status code)
+//!   stripe_compute_entry  (number of missing chunks, chunk size)
+//!   stripe_compute_return (number of missing chunks)
+//!   connection_state      (drive, state: 0 error, 1 connected, 2 connect failed)
+//!
+//! drive_op_issue and drive_op_complete can be matched by the callback address.
+//------------------------------------------------------------------------------
+#ifdef HAVE_SYS_SDT_H
+  #include <sys/sdt.h>
+  #define KIO_TRACE1(name, a1) DTRACE_PROBE1(kineticio, name, a1)
+  #define KIO_TRACE2(name, a1, a2) DTRACE_PROBE2(kineticio, name, a1, a2)
+  #define KIO_TRACE3(name, a1, a2, a3) DTRACE_PROBE3(kineticio, name, a1, a2, a3)
+#else
+  #define KIO_TRACE1(name, a1)
+  #define KIO_TRACE2(name, a1, a2)
+  #define KIO_TRACE3(name, a1, a2, a3)
+#endif
+
+#endif //KINETICIO_TRACEPOINTS_HH
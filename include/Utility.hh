@@ -108,6 +108,34 @@ namespace kio { namespace utility {
   std::string extractAttributeName(const std::string& clusterId, const std::string& path,
                                    const std::string& attribute_key);
 
+  //--------------------------------------------------------------------------
+  //! Create a unique file id to be used as the base of the data and
+  //! attribute keys of a new file, in place of its path.
+  //!
+  //! @return the file id
+  //--------------------------------------------------------------------------
+  std::string makeFileId();
+
+  //--------------------------------------------------------------------------
+  //! Obtain the base of the data and attribute keys of a file from the value
+  //! of its metadata key. Files without a file id use their path.
+  //!
+  //! @param path the path of the file
+  //! @param metadata_value the value of the metadata key of the file
+  //! @return the file id or the path
+  //--------------------------------------------------------------------------
+  std::string metadataToBase(const std::string& path, const std::string& metadata_value);
+
+  //--------------------------------------------------------------------------
+  //! Create the metadata value entry referencing the base of the data and
+  //! attribute keys of a file.
+  //!
+  //! @param path the path of the file
+  //! @param base the file id or the path
+  //! @return the entry, empty if the base is the path itself
+  //--------------------------------------------------------------------------
+  std::string makeBaseReference(const std::string& path, const std::string& base);
+
   //--------------------------------------------------------------------------
   //! Constructs a uuid string
   //!
@@ -123,6 +151,18 @@ namespace kio { namespace utility {
   //--------------------------------------------------------------------------
   std::shared_ptr<const std::string> uuidGenerateEncodeSize(std::size_t size);
 
+  //--------------------------------------------------------------------------
+  //! Constructs a uuid string containing the supplied size attribute and the
+  //! CRC32C checksum of the value it is the version of. The uuid string has
+  //! the same length and size encoding as one without checksum, so it can
+  //! be decoded by uuidDecodeSize of versions not aware of checksums.
+  //!
+  //! @param size size attribute to encode in the returned uuid
+  //! @param checksum CRC32C checksum to encode in the returned uuid
+  //! @return a uuid string
+  //--------------------------------------------------------------------------
+  std::shared_ptr<const std::string> uuidGenerateEncodeSize(std::size_t size, uint32_t checksum);
+
   //--------------------------------------------------------------------------
   //! Decode the size attribute encoded in the supplied uuid string, which
   //! should be generated by uuidGenerateEncodeSize
@@ -132,6 +172,16 @@ namespace kio { namespace utility {
   //--------------------------------------------------------------------------
   std::size_t uuidDecodeSize(const std::shared_ptr<const std::string>& uuid);
 
+  //--------------------------------------------------------------------------
+  //! Decode the checksum encoded in the supplied uuid string. Versions
+  //! written without checksum do not contain one.
+  //!
+  //! @param uuid the uuid string
+  //! @param checksum set to the encoded CRC32C checksum on success
+  //! @return true if the uuid string contains a checksum, false otherwise
+  //--------------------------------------------------------------------------
+  bool uuidDecodeChecksum(const std::shared_ptr<const std::string>& uuid, uint32_t& checksum);
+
   //--------------------------------------------------------------------------
   //! Providing operator<< for kinetic::StatusCode
   //!
@@ -215,5 +265,6 @@ namespace kio { namespace utility {
 /* Mark Adler's crc32c implementation. See crc32c.c */
 extern "C" {
   uint32_t crc32c(uint32_t crc, const void* buf, size_t len);
+  uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, size_t len2);
 }
 #endif
\ No newline at end of file
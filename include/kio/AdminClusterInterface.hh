@@ -22,11 +22,31 @@
 #ifndef KINETICIO_ADMINCLUSTERINTERFACE_HH
 #define KINETICIO_ADMINCLUSTERINTERFACE_HH
 
+#include <string>
 #include <vector>
 #include <functional>
+#include <system_error>
 
 namespace kio {
 
+//------------------------------------------------------------------------------
+//! Benchmark results of a single drive, all zero if the benchmark failed.
+//------------------------------------------------------------------------------
+struct DriveBenchmark {
+  double put_iops;
+  double put_mbps;
+  //! put latency percentiles in milliseconds
+  double put_latency_p50;
+  double put_latency_p99;
+  double get_iops;
+  double get_mbps;
+  //! get latency percentiles in milliseconds
+  double get_latency_p50;
+  double get_latency_p99;
+  //! true if throughput is less than half or p99 latency more than double the cluster median
+  bool outlier;
+};
+
 struct ClusterStatus {
   bool indicator_exist;
   uint32_t redundancy_factor;
@@ -34,6 +54,8 @@ struct ClusterStatus {
   uint32_t drives_failed;
   std::vector<bool> connected;
   std::vector<std::string> location;
+  //! per drive benchmark results, empty if no benchmark has been requested
+  std::vector<DriveBenchmark> benchmark;
 };
 
 //------------------------------------------------------------------------------
@@ -67,6 +89,17 @@ public:
     int unrepairable;
   };
 
+  //----------------------------------------------------------------------------
+  //! Result of an approximate key count.
+  //----------------------------------------------------------------------------
+  struct CountEstimate {
+    //! the estimated number of keys
+    int count;
+    //! the actual number of keys is within count +/- error with ~95% confidence, 0 if count is exact, -1 if
+    //! the error is unknown
+    int error;
+  };
+
   //----------------------------------------------------------------------------
   //! Type of callback function object. If provided it will be called
   //! periodically with the current number of processed keys. If it returns
@@ -125,15 +158,84 @@ public:
   //!
   //! @param num_bench_keys if set put/get/del throughput will be tested for
   //!   each individual connection of the cluster using specifided number of
-  //!   keys.
+  //!   keys. All connections are tested concurrently.
+  //! @param bench_queue_depth the number of requests outstanding on each
+  //!   connection during the benchmark
+  //! @param bench_value_size the size of benchmark values in bytes
   //! @return a ClusterStatus structure containing the name and status of each
   //!   connection associated with the cluster, as well as if indicator keys
   //!   have been detected on any healthy connection.
   //--------------------------------------------------------------------------
-  virtual ClusterStatus status(int num_bench_keys = 0) = 0;
+  virtual ClusterStatus status(int num_bench_keys = 0, int bench_queue_depth = 1,
+                               int bench_value_size = 1024 * 1024) = 0;
 
   virtual ~AdminClusterInterface()
   { };
+
+  /* Functions added after the initial release of this interface are declared
+   * below the destructor and have default implementations, so that the
+   * virtual table layout of existing implementations and callers is kept. */
+
+  //--------------------------------------------------------------------------
+  //! Estimate the number of keys existing on the cluster without listing all
+  //! of them. If key counters are enabled and have been initialized by a
+  //! count operation, their value is returned. Its error is unknown, as
+  //! changes of other clients are included only after they have been
+  //! flushed to the counter and lost if a client fails. Otherwise the key
+  //! space is sampled by descending into randomly selected key prefixes, the
+  //! number of requests is independent of the number of keys. The default
+  //! implementation counts all keys.
+  //!
+  //! @param target the types of keys to be counted
+  //! @param num_samples the number of random samples, more samples reduce
+  //!   the error bound
+  //! @return the estimated number of keys and its error bound
+  //--------------------------------------------------------------------------
+  virtual CountEstimate estimateCount(OperationTarget target, int num_samples = 32)
+  {
+    CountEstimate estimate = {count(target), 0};
+    return estimate;
+  }
+
+  //--------------------------------------------------------------------------
+  //! Remove deduplicated content that is no longer referenced by any data
+  //! key, as well as outdated references to content. Only required for
+  //! clusters with deduplication enabled, the default implementation
+  //! removes nothing.
+  //!
+  //! @param callback optionally register a callback function that is called
+  //! with the current number of processed content keys periodically
+  //! @param numThreads the number of background IO threads used
+  //! @return statistics about the content keys, need_action counts
+  //!   unreferenced content, removed the content that has been removed
+  //--------------------------------------------------------------------------
+  virtual KeyCounts collectGarbage(callback_t callback = NULL, int numThreads = 1)
+  {
+    KeyCounts counts = {0, 0, 0, 0, 0, 0};
+    return counts;
+  }
+
+  //--------------------------------------------------------------------------
+  //! Copy all files of this cluster to the target cluster, which may use a
+  //! different stripe geometry. This cluster stays readable and writable
+  //! during the migration. Files that have been migrated before and have not
+  //! changed since are skipped, so an interrupted migration can be restarted
+  //! and a final run before cut-over only copies recently modified files.
+  //! The default implementation fails with ENOTSUP.
+  //!
+  //! @param target_id the id of the cluster files are copied to
+  //! @param callback optionally register a callback function that is called
+  //! with the current number of processed files periodically
+  //! @param numThreads the number of files migrated concurrently
+  //! @param max_mb_per_second limit the read throughput, 0 for no limit
+  //! @return statistics about the files, need_action counts files that had
+  //!   to be copied, repaired those copied successfully
+  //--------------------------------------------------------------------------
+  virtual KeyCounts migrate(const std::string& target_id, callback_t callback = NULL, int numThreads = 1,
+                            int max_mb_per_second = 0)
+  {
+    throw std::system_error(std::make_error_code(std::errc::not_supported));
+  }
 };
 
 }
@@ -24,6 +24,9 @@
 
 #include <string>
 #include <vector>
+#include <memory>
+#include <functional>
+#include <system_error>
 #ifdef __APPLE__
 #include <sys/mount.h>
 #else
@@ -37,9 +40,58 @@
 
 namespace kio {
 
+//------------------------------------------------------------------------------
+//! A read-only reference to file data. The view holds shared ownership of the
+//! underlying buffer, the referenced data stays valid and unchanged for as
+//! long as the view is held, regardless of concurrent writes to the file.
+//------------------------------------------------------------------------------
+struct DataView {
+  //! the buffer containing the referenced data
+  std::shared_ptr<const std::string> buffer;
+  //! position of the referenced data in the buffer
+  size_t offset;
+  //! length of the referenced data
+  size_t length;
+
+  //! @return pointer to the first byte of the referenced data
+  const char* data() const
+  {
+    return buffer->data() + offset;
+  }
+
+  DataView(std::shared_ptr<const std::string> buffer, size_t offset, size_t length) :
+      buffer(buffer), offset(offset), length(length)
+  { }
+};
 
 class FileIoInterface {
 public:
+  //---------------------------------------------------------------------------
+  //! Access pattern hints, modelled on posix_fadvise.
+  //---------------------------------------------------------------------------
+  enum class Advice {
+    //! no special treatment, default readahead behavior
+    NORMAL,
+    //! the file will be read sequentially: maximum readahead, blocks that have
+    //! been read completely are not kept in the cache
+    SEQUENTIAL,
+    //! the file will be accessed in random order: readahead is disabled
+    RANDOM,
+    //! the specified range will be accessed in the near future: start prefetching
+    WILLNEED,
+    //! the specified range will not be accessed in the near future: drop clean
+    //! data from the cache
+    DONTNEED,
+    //! the specified range will be accessed only once: evict blocks early
+    NOREUSE,
+    //! the specified range is the region this handle writes, while other
+    //! handles (possibly in other processes) concurrently write the remaining
+    //! regions of the file, e.g. for N-to-1 checkpoints. Blocks completely
+    //! inside the region are assumed to be written by this handle only, blocks
+    //! shared with other regions are merged on flush. Applies until close.
+    PARALLEL_WRITE
+  };
+
   //---------------------------------------------------------------------------
   //! Get list of all files under the specified subtree.
   //!
@@ -56,7 +108,8 @@ public:
   //!
   //! @param flags open flags, use SFS_O_CREAT (0x100) to signify create
   //! @param mode open mode (ignored)
-  //! @param opaque opaque information (ignored)
+  //! @param opaque opaque information, '&' separated key=value pairs. A
+  //!   kio.tenant=<tag> entry selects the cache partition.
   //! @param timeout timeout value
   //---------------------------------------------------------------------------
   virtual void Open(int flags, mode_t mode = 0, const std::string& opaque = "", uint16_t timeout = 0) = 0;
@@ -68,6 +121,7 @@ public:
   //---------------------------------------------------------------------------
   virtual void Close(uint16_t timeout = 0) = 0;
 
+
   //---------------------------------------------------------------------------
   //! Read from file
   //!
@@ -131,7 +185,10 @@ public:
   virtual void attrDelete(std::string name) = 0;
 
   //---------------------------------------------------------------------------
-  //! Get an attribute by name
+  //! Get an attribute by name. The attribute sys.checksum returns the CRC32C
+  //! checksum of the file content as 8 hex digits, without reading data.
+  //! The attribute sys.cachestats returns size and hit rate of each data
+  //! cache partition, entries are separated by ';'.
   //---------------------------------------------------------------------------
   virtual std::string attrGet(std::string name) = 0;
 
@@ -153,6 +210,85 @@ public:
   //---------------------------------------------------------------------------
   virtual ~FileIoInterface()
   { };
+
+  /* Functions added after the initial release of this interface are declared
+   * below the destructor and have default implementations, so that the
+   * virtual table layout of existing implementations and callers is kept. */
+
+  //---------------------------------------------------------------------------
+  //! Announce an intention to access file data in a specific pattern. As with
+  //! posix_fadvise, NORMAL, SEQUENTIAL and RANDOM apply to the whole file.
+  //! The default implementation ignores the advice.
+  //!
+  //! @param offset start of the range the advice applies to
+  //! @param length length of the range, 0 extends the range to end of file
+  //! @param advice the access pattern hint
+  //---------------------------------------------------------------------------
+  virtual void Advise(long long offset, long long length, Advice advice)
+  { }
+
+  //---------------------------------------------------------------------------
+  //! Close file without waiting for its data to be flushed. The object can
+  //! be reused or destroyed immediately, reopening the file before the close
+  //! completes sees the data that is still being flushed.
+  //!
+  //! The default implementation closes synchronously and calls the callback
+  //! before returning, for implementations without background close.
+  //!
+  //! @param callback called once the data is durable, with an empty error
+  //!   code on success or the error of the failed close, may be empty
+  //! @param timeout timeout value
+  //---------------------------------------------------------------------------
+  virtual void CloseAsync(std::function<void(std::error_code)> callback, uint16_t timeout = 0)
+  {
+    std::error_code ec;
+    try {
+      Close(timeout);
+    }
+    catch (const std::system_error& e) {
+      ec = e.code();
+    }
+    if (callback) {
+      callback(ec);
+    }
+  }
+
+  //---------------------------------------------------------------------------
+  //! Read from file without copying data into a caller supplied buffer. The
+  //! default implementation reads into a newly allocated buffer and returns
+  //! a single view on it.
+  //!
+  //! @param offset offset in file
+  //! @param length read length
+  //! @param views cleared and filled with views on the data read, in file order
+  //! @param timeout timeout value
+  //! @return number of bytes read
+  //---------------------------------------------------------------------------
+  virtual int64_t ReadViews(long long offset, int length, std::vector<DataView>& views, uint16_t timeout = 0)
+  {
+    views.clear();
+    auto buffer = std::make_shared<std::string>(length, '\0');
+    auto bytes = Read(offset, &(*buffer)[0], length, timeout);
+    if (bytes > 0) {
+      views.push_back(DataView(buffer, 0, static_cast<size_t>(bytes)));
+    }
+    return bytes;
+  }
+
+  //---------------------------------------------------------------------------
+  //! Rename file. The content and attributes of the file are not moved, so
+  //! renaming takes constant time independent of the file size. Fails with
+  //! EEXIST if the target exists and with EXDEV if the target is located on
+  //! a different cluster. The io object refers to the target afterwards.
+  //! The default implementation fails with ENOTSUP.
+  //!
+  //! @param url the kinetic url of the target, kinetic://clusterId/path
+  //! @param timeout timeout value
+  //---------------------------------------------------------------------------
+  virtual void Rename(const std::string& url, uint16_t timeout = 0)
+  {
+    throw std::system_error(std::make_error_code(std::errc::not_supported));
+  }
 };
 
 }
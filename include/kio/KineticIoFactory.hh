@@ -71,6 +71,17 @@ public:
   //! of the JSON configuration files have changed.
   //--------------------------------------------------------------------------
   static void reloadConfiguration();
+
+  //--------------------------------------------------------------------------
+  //! Report contention of the library's internal mutexes. Lock profiling has
+  //! to be enabled by setting the KINETICIO_LOCK_PROFILING environment
+  //! variable before the library is used.
+  //!
+  //! @param reset if true, statistics are reset after building the report
+  //! @return acquisition counts, wait and hold times per lock site, empty if
+  //!   lock profiling is disabled
+  //--------------------------------------------------------------------------
+  static std::string lockProfileReport(bool reset = false);
 };
 
 //----------------------------------------------------------------------------
@@ -95,6 +106,15 @@ public:
 
   virtual ~LoadableKineticIoFactoryInterface()
   {};
+
+  /* Declared below the destructor to keep the virtual table layout of the
+   * initial release of this interface. */
+
+  //! See KineticIoFactory, reports nothing unless overridden
+  virtual std::string lockProfileReport(bool reset = false)
+  {
+    return std::string();
+  }
 };
 }
 
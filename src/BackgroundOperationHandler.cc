@@ -22,7 +22,8 @@ using namespace kio;
 
 
 BackgroundOperationHandler::BackgroundOperationHandler(size_t worker_threads, size_t queue_depth) :
-    queue_capacity(queue_depth), thread_capacity(worker_threads), numthreads(0), shutdown(false)
+    queue_capacity(queue_depth), thread_capacity(worker_threads), queue_mutex("BackgroundOperationHandler::queue_mutex"),
+    numthreads(0), shutdown(false)
 {
   if (queue_depth) {
     if (worker_threads == 0) {
@@ -38,7 +39,7 @@ BackgroundOperationHandler::BackgroundOperationHandler(size_t worker_threads, si
 BackgroundOperationHandler::~BackgroundOperationHandler()
 {
   {
-    std::unique_lock<std::mutex> lck(queue_mutex);
+    std::unique_lock<ProfiledMutex> lck(queue_mutex);
     while (!q.empty()) {
       controller.wait(lck);
     }
@@ -84,7 +85,7 @@ void BackgroundOperationHandler::worker_thread()
   std::function<void()> function;
   while (true) {
     {
-      std::unique_lock<std::mutex> lck(queue_mutex);
+      std::unique_lock<ProfiledMutex> lck(queue_mutex);
       while (q.empty() && !shutdown) {
         worker.wait(lck);
       }
@@ -114,12 +115,12 @@ void BackgroundOperationHandler::run(std::function<void()>&& function)
     return run_noqueue(std::move(function));
   }
   {
-    std::lock_guard<std::mutex> lock(queue_mutex);
+    std::lock_guard<ProfiledMutex> lock(queue_mutex);
     q.push(std::move(function));
   }
   worker.notify_one();
 
-  std::unique_lock<std::mutex> lck(queue_mutex);
+  std::unique_lock<ProfiledMutex> lck(queue_mutex);
   while (q.size() > queue_capacity) {
     controller.wait(lck);
   }
@@ -131,7 +132,7 @@ bool BackgroundOperationHandler::try_run(std::function<void()>&& function)
     return try_run_noqueue(std::move(function));
   }
   {
-    std::lock_guard<std::mutex> lock(queue_mutex);
+    std::lock_guard<ProfiledMutex> lock(queue_mutex);
     if (q.size() >= queue_capacity) {
       return false;
     }
@@ -24,10 +24,20 @@ using namespace kio;
 
 
 /* Printing errors initializing static global object to stderr.*/
-ClusterMap::ClusterMap() : listener(new SocketListener())
+ClusterMap::ClusterMap() : listener(new SocketListener()), reconnects(new ReconnectScheduler(8))
 {
 }
 
+SocketListener& ClusterMap::socketListener()
+{
+  return *listener;
+}
+
+ReconnectScheduler& ClusterMap::reconnectScheduler()
+{
+  return *reconnects;
+}
+
 void ClusterMap::reset(
     std::unordered_map<std::string, ClusterInformation> clusterInfo,
     std::unordered_map<std::string, std::pair<kinetic::ConnectionOptions, kinetic::ConnectionOptions> > driveInfo
@@ -67,7 +77,8 @@ std::shared_ptr<ClusterInterface> ClusterMap::getCluster(const std::string& id)
       throw std::system_error(std::make_error_code(std::errc::no_such_device));
     }
     std::unique_ptr<KineticAutoConnection> autocon(
-        new KineticAutoConnection(*listener, driveInfoMap.at(*wwn), ki.min_reconnect_interval)
+        new KineticAutoConnection(*listener, *reconnects, driveInfoMap.at(*wwn), ki.min_reconnect_interval,
+                                  ki.max_queue_depth, ki.target_latency)
     );
     connections.push_back(std::move(autocon));
   }
@@ -85,7 +96,8 @@ std::shared_ptr<ClusterInterface> ClusterMap::getCluster(const std::string& id)
   clusterCache.insert(
       std::make_pair(id,
                      std::make_shared<KineticAdminCluster>(
-                         id, ki.blockSize, ki.operation_timeout, std::move(connections), rpCache.at(rpName)
+                         id, ki.blockSize, ki.operation_timeout, std::move(connections), rpCache.at(rpName),
+                         ki.dedup_min_size, ki.key_counters, ki.dedup_grace
                      ))
   );
 
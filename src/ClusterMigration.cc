@@ -0,0 +1,356 @@
+/************************************************************************
+ * KineticIo - a file io interface library to kinetic devices.          *
+ *                                                                      *
+ * This Source Code Form is subject to the terms of the Mozilla         *
+ * Public License, v. 2.0. If a copy of the MPL was not                 *
+ * distributed with this file, You can obtain one at                    *
+ * https://mozilla.org/MP:/2.0/.                                        *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without       *
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or         *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public             *
+ * License for more details.                                            *
+ ************************************************************************/
+
+#include "ClusterMigration.hh"
+#include "BackgroundOperationHandler.hh"
+#include "SmallFilePacker.hh"
+#include "Utility.hh"
+#include "Logging.hh"
+#include "outside/MurmurHash3.h"
+#include <system_error>
+#include <algorithm>
+#include <iomanip>
+#include <unistd.h>
+
+using std::shared_ptr;
+using std::make_shared;
+using std::string;
+using kinetic::KineticStatus;
+using kinetic::StatusCode;
+using namespace kio;
+
+namespace {
+  //! checkpoints are stored as attributes of this hidden file on the target, followed by the source cluster id
+  const string checkpoint_prefix(".kio-migration/");
+  //! the number of times a file is copied if it changes during migration
+  const int max_attempts = 3;
+  //! the highest data block number
+  const int max_block_number = 999999999;
+
+  bool isDataKeyOf(const string& key, const string& prefix)
+  {
+    return key.size() == prefix.size() + 10 && key.compare(0, prefix.size(), prefix) == 0;
+  }
+}
+
+ClusterMigration::ClusterMigration(ClusterInterface& source, ClusterInterface& target, size_t max_bytes_per_second) :
+    source(source), target(target), max_bytes_per_second(max_bytes_per_second)
+{
+}
+
+void ClusterMigration::throttle(size_t bytes)
+{
+  if (!max_bytes_per_second) {
+    return;
+  }
+
+  using namespace std::chrono;
+  std::unique_lock<std::mutex> lock(mutex);
+  auto now = system_clock::now();
+  if (next_read < now) {
+    next_read = now;
+  }
+  auto start = next_read;
+  next_read += microseconds(static_cast<int64_t>(bytes * 1000000.0 / max_bytes_per_second));
+  lock.unlock();
+
+  if (start > now) {
+    usleep(static_cast<useconds_t>(duration_cast<microseconds>(start - now).count()));
+  }
+}
+
+std::vector<std::string> ClusterMigration::list(ClusterInterface& cluster, std::shared_ptr<const std::string> start,
+                                                std::shared_ptr<const std::string> end)
+{
+  std::vector<string> result;
+  std::unique_ptr<std::vector<string>> keys;
+  do {
+    auto status = cluster.range(start, end, keys);
+    if (!status.ok()) {
+      kio_warning("range(", *start, " - ", *end, ") failed on cluster ", cluster.id(), ": ", status);
+      throw std::system_error(std::make_error_code(std::errc::io_error));
+    }
+    if (keys->size()) {
+      start = make_shared<const string>(keys->back() + static_cast<char>(0));
+      result.insert(result.end(), keys->begin(), keys->end());
+    }
+  } while (keys->size());
+  return result;
+}
+
+std::string ClusterMigration::signature(const std::string& path, int& last_block)
+{
+  string versions;
+  shared_ptr<const string> version;
+  shared_ptr<const string> metadata;
+
+  auto status = source.get(utility::makeMetadataKey(source.id(), path), version, metadata);
+  if (status.statusCode() == StatusCode::REMOTE_NOT_FOUND) {
+    throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory));
+  }
+  if (!status.ok()) {
+    kio_warning("Failed obtaining metadata version of ", path, " on cluster ", source.id(), ": ", status);
+    throw std::system_error(std::make_error_code(std::errc::io_error));
+  }
+  versions += *version;
+  auto base = utility::metadataToBase(path, metadata ? *metadata : string());
+
+  last_block = -1;
+  auto data_prefix = *utility::makeDataKey(source.id(), base, 0);
+  data_prefix.resize(data_prefix.size() - 10);
+  auto keys = list(source, utility::makeDataKey(source.id(), base, 0),
+                   utility::makeDataKey(source.id(), base, max_block_number));
+  auto attributes = list(source, utility::makeAttributeKey(source.id(), base, " "),
+                         utility::makeAttributeKey(source.id(), base, "~"));
+  keys.insert(keys.end(), attributes.begin(), attributes.end());
+
+  for (auto it = keys.cbegin(); it != keys.cend(); it++) {
+    bool data = isDataKeyOf(*it, data_prefix);
+    if (data) {
+      last_block = std::max(last_block, std::stoi(it->substr(data_prefix.size())));
+    }
+    status = source.get(make_shared<const string>(*it), version);
+    if (status.ok()) {
+      versions += *it + *version;
+    }
+    else if (status.statusCode() != StatusCode::REMOTE_NOT_FOUND) {
+      kio_warning("Failed obtaining version of ", *it, " on cluster ", source.id(), ": ", status);
+      throw std::system_error(std::make_error_code(std::errc::io_error));
+    }
+  }
+
+  uint64_t hash[2];
+  MurmurHash3_x64_128(versions.data(), static_cast<int>(versions.size()), 0, hash);
+  return utility::Convert::toString(std::hex, std::setfill('0'), std::setw(16), hash[0], std::setw(16), hash[1]);
+}
+
+void ClusterMigration::copy(const std::string& path, int last_block)
+{
+  shared_ptr<const string> version;
+  shared_ptr<const string> metadata;
+  auto status = source.get(utility::makeMetadataKey(source.id(), path), version, metadata);
+  if (!status.ok()) {
+    kio_warning("Failed reading metadata of ", path, " on cluster ", source.id(), ": ", status);
+    throw std::system_error(std::make_error_code(std::errc::io_error));
+  }
+  /* Data and attributes are stored under the file id of the file, which is kept on the target. */
+  auto base = utility::metadataToBase(path, metadata ? *metadata : string());
+  if (!metadata) {
+    metadata = make_shared<const string>();
+  }
+
+  /* The source is read block by block, a packed file is a single block cut out of its pack. */
+  size_t source_capacity = source.limits().max_value_size;
+  size_t size = 0;
+  int loaded = -1;
+  shared_ptr<const string> block;
+
+  SmallFilePacker::Location location;
+  if (SmallFilePacker::parse(*metadata, location)) {
+    shared_ptr<const string> pack;
+    throttle(location.length);
+    status = source.get(utility::makeDataKey(source.id(), location.pack, 0), version, pack);
+    if (!status.ok() || location.offset + location.length > pack->size()) {
+      kio_warning("Failed reading pack ", location.pack, " of ", path, " on cluster ", source.id(), ": ", status);
+      throw std::system_error(std::make_error_code(std::errc::io_error));
+    }
+    size = location.length;
+    source_capacity = std::max(size, static_cast<size_t>(1));
+    block = make_shared<const string>(*pack, location.offset, location.length);
+    loaded = 0;
+    metadata = make_shared<const string>(utility::makeBaseReference(path, base));
+  }
+  else if (last_block >= 0) {
+    status = source.get(utility::makeDataKey(source.id(), base, last_block), version);
+    if (!status.ok()) {
+      kio_warning("Failed obtaining size of ", path, " on cluster ", source.id(), ": ", status);
+      throw std::system_error(std::make_error_code(std::errc::io_error));
+    }
+    size = last_block * source_capacity + utility::uuidDecodeSize(version);
+  }
+
+  /* Re-stripe the file to the target geometry. Holes are kept, except for the last block defining the file size. */
+  size_t target_capacity = target.limits().max_value_size;
+  int target_blocks = static_cast<int>((size + target_capacity - 1) / target_capacity);
+
+  for (int t = 0; t < target_blocks; t++) {
+    size_t start = t * target_capacity;
+    size_t end = std::min(size, start + target_capacity);
+    string value;
+    value.reserve(end - start);
+    bool hole = true;
+
+    for (size_t pos = start; pos < end;) {
+      int number = static_cast<int>(pos / source_capacity);
+      size_t offset = pos % source_capacity;
+      size_t length = std::min(end - pos, source_capacity - offset);
+
+      if (number != loaded) {
+        throttle(source_capacity);
+        status = source.get(utility::makeDataKey(source.id(), base, number), version, block);
+        if (status.statusCode() == StatusCode::REMOTE_NOT_FOUND) {
+          block.reset();
+        }
+        else if (!status.ok()) {
+          kio_warning("Failed reading block ", number, " of ", path, " on cluster ", source.id(), ": ", status);
+          throw std::system_error(std::make_error_code(std::errc::io_error));
+        }
+        loaded = number;
+      }
+
+      size_t available = block && block->size() > offset ? std::min(length, block->size() - offset) : 0;
+      if (available) {
+        value.append(*block, offset, available);
+        hole = false;
+      }
+      value.resize(value.size() + length - available, '\0');
+      pos += length;
+    }
+
+    if (hole && t != target_blocks - 1) {
+      continue;
+    }
+    status = target.put(utility::makeDataKey(target.id(), base, t), make_shared<const string>(std::move(value)),
+                        version);
+    if (!status.ok()) {
+      kio_warning("Failed writing block ", t, " of ", path, " on cluster ", target.id(), ": ", status);
+      throw std::system_error(std::make_error_code(std::errc::io_error));
+    }
+  }
+
+  /* Remove blocks left over from a previous migration of a file that has been truncated since. */
+  auto target_prefix = *utility::makeDataKey(target.id(), base, 0);
+  target_prefix.resize(target_prefix.size() - 10);
+  auto stale = list(target, utility::makeDataKey(target.id(), base, target_blocks),
+                    utility::makeDataKey(target.id(), base, max_block_number));
+  for (auto it = stale.cbegin(); it != stale.cend(); it++) {
+    if (isDataKeyOf(*it, target_prefix)) {
+      target.remove(make_shared<const string>(*it));
+    }
+  }
+
+  auto attributes = list(source, utility::makeAttributeKey(source.id(), base, " "),
+                         utility::makeAttributeKey(source.id(), base, "~"));
+  for (auto it = attributes.cbegin(); it != attributes.cend(); it++) {
+    shared_ptr<const string> value;
+    status = source.get(make_shared<const string>(*it), version, value);
+    if (status.statusCode() == StatusCode::REMOTE_NOT_FOUND) {
+      continue;
+    }
+    if (status.ok()) {
+      auto name = utility::extractAttributeName(source.id(), base, *it);
+      status = target.put(utility::makeAttributeKey(target.id(), base, name), value, version);
+    }
+    if (!status.ok()) {
+      kio_warning("Failed copying attribute ", *it, " to cluster ", target.id(), ": ", status);
+      throw std::system_error(std::make_error_code(std::errc::io_error));
+    }
+  }
+
+  status = target.put(utility::makeMetadataKey(target.id(), path), metadata, version);
+  if (!status.ok()) {
+    kio_warning("Failed writing metadata of ", path, " on cluster ", target.id(), ": ", status);
+    throw std::system_error(std::make_error_code(std::errc::io_error));
+  }
+}
+
+bool ClusterMigration::migrateFile(const std::string& path)
+{
+  auto checkpoint_key = utility::makeAttributeKey(target.id(), checkpoint_prefix + source.id(), path);
+
+  for (int attempt = 0; attempt < max_attempts; attempt++) {
+    int last_block;
+    auto before = signature(path, last_block);
+
+    shared_ptr<const string> version;
+    shared_ptr<const string> checkpoint;
+    if (target.get(checkpoint_key, version, checkpoint).ok() && *checkpoint == before) {
+      kio_debug("File ", path, " is unchanged since its last migration.");
+      return false;
+    }
+
+    copy(path, last_block);
+
+    /* Only checkpoint if the file did not change while it was being copied. */
+    if (signature(path, last_block) == before) {
+      auto status = target.put(checkpoint_key, make_shared<const string>(before), version);
+      if (!status.ok()) {
+        kio_warning("Failed writing migration checkpoint for ", path, ": ", status);
+      }
+      kio_debug("Migrated file ", path, " from cluster ", source.id(), " to cluster ", target.id());
+      return true;
+    }
+    kio_notice("File ", path, " changed during migration, copying it again.");
+  }
+  throw std::system_error(std::make_error_code(std::errc::resource_unavailable_try_again));
+}
+
+void ClusterMigration::migrateFiles(std::vector<std::string> metadata_keys, Counts& counts)
+{
+  auto prefix = utility::makeMetadataKey(source.id(), "");
+
+  for (auto it = metadata_keys.cbegin(); it != metadata_keys.cend(); it++) {
+    auto path = it->substr(prefix->size());
+    try {
+      if (migrateFile(path)) {
+        counts.copied++;
+        counts.migrated++;
+      }
+    } catch (const std::system_error& e) {
+      /* Removed after it was listed, nothing to migrate. */
+      if (e.code() == std::errc::no_such_file_or_directory) {
+        continue;
+      }
+      kio_warning("Failed migrating file ", path, ": ", e.what());
+      counts.copied++;
+      counts.failed++;
+    } catch (const std::exception& e) {
+      kio_warning("Failed migrating file ", path, ": ", e.what());
+      counts.copied++;
+      counts.failed++;
+    }
+  }
+}
+
+AdminClusterInterface::KeyCounts ClusterMigration::run(AdminClusterInterface::callback_t callback, int numThreads)
+{
+  Counts counts;
+  auto start_key = utility::makeMetadataKey(source.id(), " ");
+  auto end_key = utility::makeMetadataKey(source.id(), "~");
+  numThreads = std::max(numThreads, 1);
+
+  {
+    BackgroundOperationHandler bg(numThreads, numThreads);
+    std::unique_ptr<std::vector<string>> keys;
+    do {
+      auto status = source.range(start_key, end_key, keys);
+      if (!status.ok()) {
+        kio_warning("range(", *start_key, " - ", *end_key, ") failed on cluster. Cannot proceed. ", status);
+        break;
+      }
+      if (keys && keys->size()) {
+        start_key = make_shared<const string>(keys->back() + static_cast<char>(0));
+        counts.total += keys->size();
+        bg.run(std::bind(&ClusterMigration::migrateFiles, this, *keys, std::ref(counts)));
+      }
+      if (callback && !callback(counts.total)) {
+        kio_notice("Callback result indicates shutdown request... interrupting execution.");
+        break;
+      }
+    } while (keys && keys->size());
+  }
+
+  return AdminClusterInterface::KeyCounts{counts.total, 0, counts.copied, counts.migrated, 0, counts.failed};
+}
@@ -16,6 +16,9 @@
 #include "DataBlock.hh"
 #include "Utility.hh"
 #include "Logging.hh"
+#include "Tracepoints.hh"
+#include <algorithm>
+#include <vector>
 
 using std::unique_ptr;
 using std::shared_ptr;
@@ -29,9 +32,10 @@ using namespace kio;
 const std::chrono::milliseconds DataBlock::expiration_time(1000);
 
 
-DataBlock::DataBlock(std::shared_ptr<ClusterInterface> c, const std::shared_ptr<const std::string> k, Mode m) :
+DataBlock::DataBlock(std::shared_ptr<ClusterInterface> c, const std::shared_ptr<const std::string> k, Mode m,
+                     SharedBlockCache* s) :
     mode(m), cluster(c), key(k), version(), remote_value(), local_value(), value_size(0), updates(),
-    timestamp(), mutex()
+    shared(s), timestamp(), mutex("DataBlock::mutex")
 {
   if (!cluster){
     kio_error("no cluster supplied");
@@ -45,10 +49,11 @@ DataBlock::~DataBlock()
 {
   // take the mutex in order to prevent object deconstruction while flush
   // operation is executed by non-owning thread.
-  std::lock_guard<std::mutex> lock(mutex);
+  std::lock_guard<ProfiledMutex> lock(mutex);
 }
 
-void DataBlock::reassign(std::shared_ptr<ClusterInterface> c, std::shared_ptr<const std::string> k, Mode m)
+void DataBlock::reassign(std::shared_ptr<ClusterInterface> c, std::shared_ptr<const std::string> k, Mode m,
+                         SharedBlockCache* s)
 {
   if (!cluster){
     kio_error("no cluster supplied");
@@ -58,10 +63,14 @@ void DataBlock::reassign(std::shared_ptr<ClusterInterface> c, std::shared_ptr<co
   key = k;
   mode = m;
   cluster = c;
+  shared = s;
   value_size = 0;
   version.reset();
   updates.clear();
   timestamp = system_clock::time_point();
+  if (local_value && !local_value.unique()) {
+    local_value.reset();
+  }
   if (local_value) {
     local_value->assign(capacity(), '0');
   }
@@ -103,11 +112,47 @@ bool DataBlock::validateVersion()
   return false;
 }
 
+KineticStatus DataBlock::getSharedValue(std::chrono::system_clock::time_point& verified)
+{
+  verified = system_clock::now();
+
+  shared_ptr<const string> shared_version;
+  shared_ptr<const string> shared_value;
+  system_clock::time_point shared_verified;
+
+  if (shared->get(*key, shared_version, shared_value, shared_verified)) {
+    /* Another process verified the shared value recently enough, it is as good as reading it ourselves. */
+    if (verified - shared_verified < expiration_time) {
+      version = std::move(shared_version);
+      remote_value = std::move(shared_value);
+      verified = shared_verified;
+      return KineticStatus(StatusCode::OK, "");
+    }
+
+    /* Otherwise validate the version exactly as validateVersion does for the local copy. */
+    shared_ptr<const string> remote_version;
+    auto status = cluster->get(key, remote_version);
+    if (status.ok() && remote_version && *remote_version == *shared_version) {
+      shared->touch(*key, *shared_version);
+      version = std::move(shared_version);
+      remote_value = std::move(shared_value);
+      return status;
+    }
+  }
+
+  auto status = cluster->get(key, version, remote_value);
+  if (status.ok() && version && remote_value) {
+    shared->put(*key, *version, *remote_value);
+  }
+  return status;
+}
+
 /* This function is written a lot more complex than it should be at first glance. It all is
  * to avoid / minimize memory allocations and copies as much as possible */
 void DataBlock::getRemoteValue()
 {
-  auto status = cluster->get(key, version, remote_value);
+  auto verified = system_clock::now();
+  auto status = shared && shared->enabled() ? getSharedValue(verified) : cluster->get(key, version, remote_value);
 
   if (!status.ok() && status.statusCode() != StatusCode::REMOTE_NOT_FOUND) {
     kio_error("Attempting to read key '", *key, "' from cluster returned error ", status);
@@ -123,8 +168,8 @@ void DataBlock::getRemoteValue()
     value_size = remote_value ? remote_value->size() : 0;
   }
 
-  /* We read in the value from the drive. Remember the time. */
-  timestamp = system_clock::now();
+  /* We read in the value from the drive (or the shared cache). Remember the time. */
+  timestamp = verified;
 
   /* If there are no local updates, there is no need to do any more work... just ensure that the
      local_value variable is empty so that all reads will be served from the remote_value */
@@ -161,9 +206,45 @@ void DataBlock::getRemoteValue()
   local_value = std::move(merged_value);
 }
 
+bool DataBlock::overwritten() const
+{
+  std::vector<std::pair<size_t, size_t> > writes;
+  for (auto it = updates.cbegin(); it != updates.cend(); it++) {
+    /* A truncate makes the resulting size depend on the order of updates, don't bother. */
+    if (!it->second) {
+      return false;
+    }
+    writes.push_back(*it);
+  }
+  std::sort(writes.begin(), writes.end());
+
+  size_t covered = 0;
+  for (auto it = writes.cbegin(); it != writes.cend() && it->first <= covered; it++) {
+    covered = std::max(covered, it->first + it->second);
+  }
+  return covered >= capacity();
+}
+
+void DataBlock::getRemoteVersion()
+{
+  auto verified = system_clock::now();
+  auto status = cluster->get(key, version);
+  if (status.statusCode() == StatusCode::REMOTE_NOT_FOUND) {
+    version.reset();
+  }
+  else if (!status.ok()) {
+    kio_error("Attempting to read version of key '", *key, "' from cluster returned error ", status);
+    throw std::system_error(std::make_error_code(std::errc::io_error));
+  }
+  timestamp = verified;
+
+  /* The remote value is replaced completely, it doesn't matter what it is. */
+  remote_value.reset();
+}
+
 void DataBlock::read(char* const buffer, size_t offset, size_t length)
 {
-  std::lock_guard<std::mutex> lock(mutex);
+  std::lock_guard<ProfiledMutex> lock(mutex);
   if (buffer == NULL || offset + length > cluster->limits().max_value_size){
     kio_warning("Invalid argument. buffer=",buffer, " offset=", offset, " length=", length);
     throw std::system_error(std::make_error_code(std::errc::invalid_argument));
@@ -189,9 +270,44 @@ void DataBlock::read(char* const buffer, size_t offset, size_t length)
   }
 }
 
+std::shared_ptr<const std::string> DataBlock::view(size_t offset, size_t length, size_t& view_offset)
+{
+  std::lock_guard<ProfiledMutex> lock(mutex);
+  if (offset + length > cluster->limits().max_value_size){
+    kio_warning("Invalid argument. offset=", offset, " length=", length);
+    throw std::system_error(std::make_error_code(std::errc::invalid_argument));
+  }
+
+  /*Ensure data is not too stale to read.*/
+  if (!validateVersion()) {
+    getRemoteValue();
+  }
+
+  shared_ptr<const string> value = local_value ? shared_ptr<const string>(local_value) : remote_value;
+  if (value && offset + length <= value_size) {
+    view_offset = offset;
+    return value;
+  }
+
+  /* The requested region is (partially) a hole that has to be filled with 0s, no way around a copy here. */
+  auto filled = make_shared<string>(length, '\0');
+  if (value && value_size > offset) {
+    value->copy(&(*filled)[0], std::min(length, value_size - offset), offset);
+  }
+  view_offset = 0;
+  return filled;
+}
+
+void DataBlock::detachLocalValue()
+{
+  if (local_value && !local_value.unique()) {
+    local_value = make_shared<string>(*local_value);
+  }
+}
+
 void DataBlock::write(const char* const buffer, size_t offset, size_t length)
 {
-  std::lock_guard<std::mutex> lock(mutex);
+  std::lock_guard<ProfiledMutex> lock(mutex);
   if (buffer == NULL || offset + length > cluster->limits().max_value_size){
     kio_warning("Invalid argument. ", buffer ? "" : "No buffer supplied!"," offset=", offset, " length=", length);
     throw std::system_error(std::make_error_code(std::errc::invalid_argument));
@@ -204,6 +320,7 @@ void DataBlock::write(const char* const buffer, size_t offset, size_t length)
    * we will allocate straight to capacity size to prevent multiple resize operations making
    * a mess of heap allocation (that's why we are storing value_size separately in the first
    * place). */
+  detachLocalValue();
   if (!local_value) {
     local_value = std::make_shared<string>(capacity(), '0');
     if (remote_value) {
@@ -222,7 +339,7 @@ void DataBlock::write(const char* const buffer, size_t offset, size_t length)
 
 void DataBlock::truncate(size_t offset)
 {
-  std::lock_guard<std::mutex> lock(mutex);
+  std::lock_guard<ProfiledMutex> lock(mutex);
   if (offset > cluster->limits().max_value_size){
     kio_warning("Invalid argument offset=", offset);
     throw std::system_error(std::make_error_code(std::errc::invalid_argument));
@@ -234,15 +351,23 @@ void DataBlock::truncate(size_t offset)
 
 void DataBlock::flush()
 {
-  std::lock_guard<std::mutex> lock(mutex);
+  std::lock_guard<ProfiledMutex> lock(mutex);
+  KIO_TRACE2(block_flush_entry, key->c_str(), value_size);
   KineticStatus status(StatusCode::CLIENT_INTERNAL_ERROR, "invalid");
   do {
     if (status.statusCode() == StatusCode::REMOTE_VERSION_MISMATCH || (!version && mode == Mode::STANDARD)) {
-      getRemoteValue();
+      /* Reading the remote value is only necessary to merge it with partial local updates. */
+      if (local_value && overwritten()) {
+        getRemoteVersion();
+      }
+      else {
+        getRemoteValue();
+      }
     }
 
     if (local_value) {
       if (value_size != local_value->size()) {
+        detachLocalValue();
         local_value->resize(value_size);
       }
       status = cluster->put(key, version, local_value, version);
@@ -254,6 +379,7 @@ void DataBlock::flush()
       status = cluster->put(key, version, remote_value, version);
     }
   } while (status.statusCode() == StatusCode::REMOTE_VERSION_MISMATCH);
+  KIO_TRACE2(block_flush_return, key->c_str(), static_cast<int>(status.statusCode()));
 
   if (!status.ok()) {
     kio_error("Attempting to write key '", *key, "' from cluster returned error ", status);
@@ -264,11 +390,16 @@ void DataBlock::flush()
      to current time. */
   updates.clear();
   timestamp = system_clock::now();
+
+  /* The flushed value is clean now, other processes on this node may use it. */
+  if (shared && shared->enabled() && version) {
+    shared->put(*key, *version, local_value ? *local_value : *remote_value);
+  }
 }
 
 bool DataBlock::dirty() const
 {
-  std::lock_guard<std::mutex> lock(mutex);
+  std::lock_guard<ProfiledMutex> lock(mutex);
   if (!updates.empty()) {
     return true;
   }
@@ -282,6 +413,26 @@ bool DataBlock::dirty() const
   return false;
 }
 
+bool DataBlock::absent() const
+{
+  std::lock_guard<ProfiledMutex> lock(mutex);
+
+  /* A block opened in STANDARD mode is assumed to exist until the backend has been asked for it. */
+  return mode == Mode::STANDARD && !version && updates.empty() && timestamp != system_clock::time_point();
+}
+
+std::shared_ptr<const std::string> DataBlock::unflushedValue(size_t max_size) const
+{
+  std::lock_guard<ProfiledMutex> lock(mutex);
+  if (version || updates.empty() || value_size > max_size) {
+    return shared_ptr<const string>();
+  }
+  if (!local_value) {
+    return make_shared<const string>(value_size, '\0');
+  }
+  return make_shared<const string>(*local_value, 0, value_size);
+}
+
 size_t DataBlock::capacity() const
 {
   return cluster->limits().max_value_size;
@@ -289,7 +440,7 @@ size_t DataBlock::capacity() const
 
 size_t DataBlock::size()
 {
-  std::lock_guard<std::mutex> lock(mutex);
+  std::lock_guard<ProfiledMutex> lock(mutex);
 
   /* Ensure size is not too stale. */
   if (!validateVersion()) {
@@ -19,45 +19,152 @@
 #include "Logging.hh"
 #include "KineticCluster.hh"
 #include "KineticIoSingleton.hh"
+#include "Tracepoints.hh"
+#include <algorithm>
+#include <thread>
 
 using namespace kio;
 
+const size_t DataCache::absent_capacity = 16384;
 
-DataCache::DataCache(size_t capacity) :
-    capacity(capacity), current_size(0), unused_size(0)
+DataCache::DataCache(size_t capacity, SharedBlockCache* shared, size_t num_shards) :
+    capacity(capacity), current_size(0), shared(shared), partition_mutex("DataCache::partition_mutex")
 {
+  partitions[""] = std::make_shared<Partition>("");
+  partitions[""]->configured = true;
+
+  if (!num_shards) {
+    num_shards = std::max(1u, std::thread::hardware_concurrency());
+  }
+  for (size_t i = 0; i < num_shards; i++) {
+    shards.push_back(std::make_shared<Shard>());
+  }
 }
 
-void DataCache::changeConfiguration(size_t cap)
+void DataCache::changeConfiguration(size_t cap, const std::vector<PartitionConfiguration>& partition_config)
 {
+  size_t min_sum = 0;
+  for (auto it = partition_config.cbegin(); it != partition_config.cend(); it++) {
+    min_sum += it->min;
+    if (it->name.empty() || (it->max && it->max < it->min)) {
+      kio_error("Invalid configuration for cache partition '", it->name, "'");
+      throw std::system_error(std::make_error_code(std::errc::invalid_argument));
+    }
+  }
+  if (min_sum > cap) {
+    kio_error("Minimum shares of cache partitions exceed cache capacity.");
+    throw std::system_error(std::make_error_code(std::errc::invalid_argument));
+  }
+
+  std::lock_guard<ProfiledMutex> lock(partition_mutex);
   capacity = cap;
+  for (auto it = partitions.begin(); it != partitions.end(); it++) {
+    if (!it->first.empty()) {
+      it->second->min = it->second->max = 0;
+      it->second->configured = false;
+    }
+  }
+  for (auto it = partition_config.cbegin(); it != partition_config.cend(); it++) {
+    if (!partitions.count(it->name)) {
+      partitions[it->name] = std::make_shared<Partition>(it->name);
+    }
+    auto& p = *partitions[it->name];
+    p.min = it->min;
+    p.max = it->max;
+    p.configured = true;
+  }
+}
+
+DataCache::Partition& DataCache::partition(const kio::FileIo* owner)
+{
+  std::lock_guard<ProfiledMutex> lock(partition_mutex);
+  if (!owner->tenant.empty()) {
+    auto it = partitions.find(owner->tenant);
+    if (it != partitions.end() && it->second->configured) {
+      return *it->second;
+    }
+  }
+  auto it = partitions.find(owner->cluster->id());
+  if (it != partitions.end() && it->second->configured) {
+    return *it->second;
+  }
+  return *partitions[""];
+}
+
+size_t DataCache::partitionCapacity(const Partition& p) const
+{
+  size_t cap = capacity;
+  size_t max = p.max;
+  return max && max < cap ? max : cap;
+}
+
+size_t DataCache::shardIndex(const std::string& cache_key) const
+{
+  return std::hash<std::string>()(cache_key) % shards.size();
+}
+
+std::map<std::string, DataCache::PartitionStatistics> DataCache::partitionStatistics()
+{
+  std::map<std::string, PartitionStatistics> stats;
+  std::lock_guard<ProfiledMutex> lock(partition_mutex);
+  for (auto it = partitions.cbegin(); it != partitions.cend(); it++) {
+    if (it->second->configured) {
+      auto& p = *it->second;
+      stats[it->first] = PartitionStatistics{p.size, p.min, partitionCapacity(p), p.hits, p.misses};
+    }
+  }
+  return stats;
 }
 
 void DataCache::drop(kio::FileIo* owner, bool force)
 {
-  std::lock_guard<std::mutex> lock(cache_mutex);
-  if (owner_tables.count(owner)) {
-    for (auto owit = owner_tables[owner].cbegin(); owit != owner_tables[owner].cend(); owit++) {
-      cache_iterator it = *owit;
-      it->owners.erase(owner);
-      /* Because some clients apparently like re-opening files, we will no longer automatically remove orphaned 
-       * data keys (unless force is set)... they will only be removed when cache pressure indicates.  */
-      if (force) {
-        remove_item(it);
+  for (auto sh = shards.begin(); sh != shards.end(); sh++) {
+    auto& s = **sh;
+    std::lock_guard<ProfiledMutex> lock(s.mutex);
+    if (s.owner_tables.count(owner)) {
+      for (auto owit = s.owner_tables[owner].cbegin(); owit != s.owner_tables[owner].cend(); owit++) {
+        cache_iterator it = *owit;
+        it->owners.erase(owner);
+        /* Because some clients apparently like re-opening files, we will no longer automatically remove orphaned
+         * data keys (unless force is set)... they will only be removed when cache pressure indicates.  */
+        if (force) {
+          remove_item(s, it);
+        }
       }
     }
+    s.owner_tables.erase(owner);
+  }
+}
+
+void DataCache::transfer(kio::FileIo* from, kio::FileIo* to)
+{
+  for (auto sh = shards.begin(); sh != shards.end(); sh++) {
+    auto& s = **sh;
+    std::lock_guard<ProfiledMutex> lock(s.mutex);
+    if (!s.owner_tables.count(from)) {
+      continue;
+    }
+    /* Copy the table, inserting into owner_tables may invalidate references. */
+    auto items = s.owner_tables[from];
+    s.owner_tables.erase(from);
+    for (auto item = items.cbegin(); item != items.cend(); item++) {
+      cache_iterator it = *item;
+      it->owners.erase(from);
+      it->owners.insert(to);
+    }
+    s.owner_tables[to].insert(items.begin(), items.end());
   }
-  owner_tables.erase(owner);
 }
 
 void DataCache::flush(kio::FileIo* owner)
 {
-  /* build a vector of blocks, so we can flush without holding cache_mutex */
+  /* build a vector of blocks, so we can flush without holding shard locks */
   std::vector<std::shared_ptr<kio::DataBlock> > blocks;
-  {
-    std::lock_guard<std::mutex> lock(cache_mutex);
-    if (owner_tables.count(owner)) {
-      for (auto item = owner_tables[owner].cbegin(); item != owner_tables[owner].cend(); item++) {
+  for (auto sh = shards.begin(); sh != shards.end(); sh++) {
+    auto& s = **sh;
+    std::lock_guard<ProfiledMutex> lock(s.mutex);
+    if (s.owner_tables.count(owner)) {
+      for (auto item = s.owner_tables[owner].cbegin(); item != s.owner_tables[owner].cend(); item++) {
         cache_iterator it = *item;
         blocks.push_back(it->data);
       }
@@ -72,25 +179,28 @@ void DataCache::flush(kio::FileIo* owner)
   }
 }
 
-DataCache::cache_iterator DataCache::remove_item(const cache_iterator& it)
+DataCache::cache_iterator DataCache::remove_item(Shard& s, const cache_iterator& it)
 {
   for (auto o = it->owners.cbegin(); o != it->owners.cend(); o++) {
-    owner_tables[*o].erase(it);
+    s.owner_tables[*o].erase(it);
   }
 
-  lookup.erase(it->data->getIdentity());
+  auto identity = it->data->getIdentity();
+  KIO_TRACE2(cache_evict, identity.c_str(), it->data->capacity());
+  s.lookup.erase(identity);
   current_size -= it->data->capacity();
+  it->partition->size -= it->data->capacity();
 
   /* We don't want to keep too many unused cache items around... */
-  if (unused_size > 0.1 * capacity) {
+  if (s.unused_size > 0.1 * capacity / shards.size()) {
     kio_debug("Deleting cache key ", it->data->getIdentity(), " from cache.");
-    return cache.erase(it);
+    return s.cache.erase(it);
   }
 
   kio_debug("Transferring cache key ", it->data->getIdentity(), " from cache to unused items pool.");
   auto next_it = std::next(it);
-  unused_size += it->data->capacity();
-  unused_items.splice(unused_items.begin(), cache, it);
+  s.unused_size += it->data->capacity();
+  s.unused_items.splice(s.unused_items.begin(), s.cache, it);
   return next_it;
 }
 
@@ -103,109 +213,245 @@ namespace {
   }
 }
 
-void DataCache::try_shrink()
+void DataCache::try_shrink(Shard& s)
 {
   using namespace std::chrono;
+  if (s.cache.empty()) {
+    return;
+  }
   auto expired = system_clock::now() - seconds(5);
-  auto num_items = (current_size / cache.back().data->capacity()) * 0.1;
+  auto num_items = (current_size / shards.size() / s.cache.back().data->capacity()) * 0.1;
   auto count_items = 0;
 
-  for (auto it = --cache.end(); num_items > count_items && it != cache.begin(); it--, count_items++) {
+  for (auto it = --s.cache.end(); num_items > count_items && it != s.cache.begin(); it--, count_items++) {
     if ((it->owners.empty() || it->last_access < expired) && !it->data->dirty() && it->data.unique()) {
-      it = remove_item(it);
+      it = remove_item(s, it);
     }
     else if(it->data->dirty() && it->last_access < expired){
       kio_debug("Attempting background flush of dirty expired data chunk: ", it->data->getIdentity());
       kio().threadpool().try_run(std::bind(&doFlush, it->data));
     }
   }
+}
 
-  /* If cache size exceeds capacity, we have to force remove data keys. */
+void DataCache::make_room(Partition& requester, size_t first)
+{
+  /* A partition exceeding its maximum share has to make room from its own blocks, even if there is idle capacity. */
+  if (requester.size > partitionCapacity(requester)) {
+    kio_debug("Cache partition '", requester.name, "' reached its maximum share.");
+    evict(&requester, false, false, first);
+    evict(&requester, false, true, first);
+  }
+
+  /* If cache size exceeds capacity, we have to force remove data keys. Blocks of partitions that borrowed
+   * capacity beyond their minimum share go first, so every partition can always use its guaranteed share. */
   if (capacity < current_size) {
     kio_debug("Cache capacity reached.");
+    evict(NULL, true, false, first);
+    evict(NULL, true, true, first);
+    evict(NULL, false, false, first);
+    evict(NULL, false, true, first);
+  }
+}
+
+void DataCache::evict(const Partition* from, bool borrowed, bool force, size_t first)
+{
+  using namespace std::chrono;
+
+  for (size_t i = 0; i < shards.size(); i++) {
+    auto& s = *shards[(first + i) % shards.size()];
+    std::lock_guard<ProfiledMutex> lock(s.mutex);
 
-    for (auto it = --cache.end(); capacity < current_size && it != cache.begin(); it--) {
-      if (it->data.unique() && !it->data->dirty()) {
-        kio_debug("Cache key ", it->data->getIdentity(), " identified for removal. It is in cache position ",
-                  std::distance(cache.begin(), it), " out of ", std::distance(cache.begin(), cache.end()),
-                  " and has last been accessed ", duration_cast<seconds>(system_clock::now() - it->last_access), " ago");
-        remove_item(it);
+    /* Removing an item does not invalidate the iterator to its successor. */
+    for (auto it = s.cache.end(); it != s.cache.begin();) {
+      if (from ? from->size <= partitionCapacity(*from) : capacity >= current_size) {
+        return;
+      }
+      auto item = std::prev(it);
+      if ((from && item->partition != from) || (borrowed && item->partition->size <= item->partition->min) ||
+          !item->data.unique() || (item->data->dirty() && !force)) {
+        it = item;
+        continue;
+      }
+      if (item->data->dirty()) {
+        try {
+          item->data->flush();
+        }
+        catch (const std::exception& e) {
+          kio_warning("Failed flushing cache item ", item->data->getIdentity(), "  Reason: ", e.what());
+          it = item;
+          continue;
+        }
+        kio_notice("Cache key ", item->data->getIdentity(), " identified for FORCE REMOVAL as there were no clean "
+            "unique keys in the cache to drop.");
       }
+      else {
+        kio_debug("Cache key ", item->data->getIdentity(), " of partition '", item->partition->name,
+                  "' identified for removal. It is in shard position ", std::distance(s.cache.begin(), item),
+                  " out of ", s.cache.size(), " and has last been accessed ",
+                  duration_cast<seconds>(system_clock::now() - item->last_access), " ago");
+      }
+      remove_item(s, item);
     }
+  }
+}
 
-    /* Second try.. can't find an ideal candidate, we will flush. */
-    for (auto it = --cache.end(); capacity < current_size && it != cache.begin(); it--) {
-      if (it->data.unique()) {
-        if (it->data->dirty()) {
-          try {
-            it->data->flush();
-          }
-          catch (const std::exception& e) {
-            kio_warning("Failed flushing cache item ", it->data->getIdentity(), "  Reason: ", e.what());
-            continue;
-          }
-        }
-        kio_notice("Cache key ", it->data->getIdentity(), " identified for FORCE REMOVAL as there were no clean unique"
-            "keys in the cache to drop.");
-        remove_item(it);
+bool DataCache::isAbsent(kio::FileIo* owner, int blocknumber)
+{
+  auto data_key = utility::makeDataKey(owner->cluster->id(), owner->base, blocknumber);
+  std::string cache_key = *data_key + owner->cluster->instanceId();
+
+  auto& s = *shards[shardIndex(cache_key)];
+  std::lock_guard<ProfiledMutex> cachelock(s.mutex);
+  auto it = s.absent_lookup.find(cache_key);
+  if (it == s.absent_lookup.end()) {
+    return false;
+  }
+  /* A block still in the cache might have been written to after it has been found absent. */
+  auto cached = s.lookup.find(cache_key);
+  bool written = cached != s.lookup.end() && !cached->second->data->absent();
+
+  if (!written && std::chrono::system_clock::now() - it->second < DataBlock::expiration_time) {
+    kio_debug("Data key ", *data_key, " is known to be absent, serving hole for owner ", owner);
+    return true;
+  }
+  s.absent_lookup.erase(it);
+  return false;
+}
+
+void DataCache::setAbsent(const std::shared_ptr<kio::DataBlock>& data)
+{
+  auto cache_key = data->getIdentity();
+  auto now = std::chrono::system_clock::now();
+
+  auto& s = *shards[shardIndex(cache_key)];
+  std::lock_guard<ProfiledMutex> cachelock(s.mutex);
+  if (!data->absent()) {
+    return;
+  }
+  if (s.absent_lookup.size() >= absent_capacity / shards.size()) {
+    for (auto it = s.absent_lookup.begin(); it != s.absent_lookup.end();) {
+      if (now - it->second < DataBlock::expiration_time) {
+        it++;
+      } else {
+        it = s.absent_lookup.erase(it);
       }
     }
+    if (s.absent_lookup.size() >= absent_capacity / shards.size()) {
+      kio_debug("Negative cache capacity reached, dropping all entries of shard.");
+      s.absent_lookup.clear();
+    }
+  }
+  s.absent_lookup[cache_key] = now;
+
+  /* Release the cache slot if nobody but the cache and the caller is holding on to the block. */
+  auto it = s.lookup.find(cache_key);
+  if (it != s.lookup.end() && it->second->data == data && data.use_count() == 2) {
+    kio_debug("Releasing absent cache key ", cache_key, " from cache.");
+    remove_item(s, it->second);
   }
 }
 
+void DataCache::release(kio::FileIo* owner, int blocknumber)
+{
+  auto data_key = utility::makeDataKey(owner->cluster->id(), owner->base, blocknumber);
+  std::string cache_key = *data_key + owner->cluster->instanceId();
+
+  auto& s = *shards[shardIndex(cache_key)];
+  std::lock_guard<ProfiledMutex> cachelock(s.mutex);
+  auto it = s.lookup.find(cache_key);
+  if (it == s.lookup.end()) {
+    return;
+  }
+  if (it->second->data.unique() && !it->second->data->dirty()) {
+    kio_debug("Releasing data key ", *data_key, " from cache on request of owner ", owner);
+    remove_item(s, it->second);
+    return;
+  }
+  /* Splicing the element to the back of the list will keep iterators valid. Resetting the access
+   * timestamp lets try_shrink consider the block (and flush it if dirty) right away. */
+  it->second->last_access = std::chrono::system_clock::time_point();
+  s.cache.splice(s.cache.end(), s.cache, it->second);
+}
+
 std::shared_ptr<kio::DataBlock> DataCache::getDataKey(kio::FileIo* owner, int blocknumber, DataBlock::Mode mode)
 {
   /* We cannot use the block key directly for cache lookups, as reloading the configuration will create
      different cluster objects and we have to avoid FileIo objects being associated with multiple clusters */
-  auto data_key = utility::makeDataKey(owner->cluster->id(), owner->path, blocknumber);
+  auto data_key = utility::makeDataKey(owner->cluster->id(), owner->base, blocknumber);
   std::string cache_key = *data_key + owner->cluster->instanceId();
 
-  std::lock_guard<std::mutex> cachelock(cache_mutex);
-  /* If the requested block is already cached, we can return it without IO. */
-  if (lookup.count(cache_key)) {
-    kio_debug("Serving data key ", *data_key, " for owner ", owner, " from cache.");
+  auto index = shardIndex(cache_key);
+  auto& s = *shards[index];
+  std::shared_ptr<kio::DataBlock> data;
+  Partition* p;
+  {
+    std::lock_guard<ProfiledMutex> cachelock(s.mutex);
+    /* Once a block is requested it may be written to, it can no longer be considered absent. */
+    s.absent_lookup.erase(cache_key);
+
+    /* If the requested block is already cached, we can return it without IO. */
+    if (s.lookup.count(cache_key)) {
+      kio_debug("Serving data key ", *data_key, " for owner ", owner, " from cache.");
+      KIO_TRACE2(cache_hit, data_key->c_str(), blocknumber);
 
-    /* Splicing the element into the front of the list will keep iterators valid. */
-    cache.splice(cache.begin(), cache, lookup[cache_key]);
+      /* Splicing the element into the front of the list will keep iterators valid. */
+      s.cache.splice(s.cache.begin(), s.cache, s.lookup[cache_key]);
+      s.cache.front().partition->hits++;
 
-    /* set owner<->cache_item relationship. Since we have std::sets there's no need to test for existence */
-    owner_tables[owner].insert(cache.begin());
-    cache.front().owners.insert(owner);
+      /* set owner<->cache_item relationship. Since we have std::sets there's no need to test for existence */
+      s.owner_tables[owner].insert(s.cache.begin());
+      s.cache.front().owners.insert(owner);
 
-    /* Update access timestamp */
-    cache.front().last_access = std::chrono::system_clock::now();
-    return cache.front().data;
-  }
+      /* Update access timestamp */
+      s.cache.front().last_access = std::chrono::system_clock::now();
+      return s.cache.front().data;
+    }
 
-  /* Attempt to shrink cache size by releasing unused items */
-  if (current_size > capacity * 0.7) {
-    try_shrink();
-  }
+    p = &partition(owner);
+    p->misses++;
+    KIO_TRACE2(cache_miss, data_key->c_str(), blocknumber);
+
+    /* Attempt to shrink cache size by releasing unused items */
+    if (current_size > capacity * 0.7 || p->size > partitionCapacity(*p) * 0.7) {
+      try_shrink(s);
+    }
 
-  /* Re-use an existing data key object if possible, if none exists create a new one. */
-  if (unused_items.begin() != unused_items.end()) {
-    auto it = unused_items.begin();
-    unused_size -= it->data->capacity();
-    it->owners.clear();
-    it->owners.insert(owner);
-    it->data->reassign(owner->cluster, data_key, mode);
-    it->last_access = std::chrono::system_clock::now();
-    cache.splice(cache.begin(), unused_items, it);
-    kio_debug("Added reused data key ", *data_key, " to the cache for owner ", owner);
+    /* Re-use an existing data key object if possible, if none exists create a new one. */
+    if (s.unused_items.begin() != s.unused_items.end()) {
+      auto it = s.unused_items.begin();
+      s.unused_size -= it->data->capacity();
+      it->owners.clear();
+      it->owners.insert(owner);
+      it->data->reassign(owner->cluster, data_key, mode, shared);
+      it->last_access = std::chrono::system_clock::now();
+      it->partition = p;
+      s.cache.splice(s.cache.begin(), s.unused_items, it);
+      kio_debug("Added reused data key ", *data_key, " to the cache for owner ", owner);
+    }
+    else {
+      s.cache.push_front(
+          CacheItem{std::set<kio::FileIo*>{owner},
+                    std::make_shared<DataBlock>(owner->cluster, data_key, mode, shared),
+                    std::chrono::system_clock::now(),
+                    p
+          }
+      );
+      kio_debug("Added new data key ", *data_key, " to the cache for owner ", owner);
+    }
+    current_size += s.cache.front().data->capacity();
+    p->size += s.cache.front().data->capacity();
+    s.lookup[cache_key] = s.cache.begin();
+    s.owner_tables[owner].insert(s.cache.begin());
+    data = s.cache.front().data;
   }
-  else {
-    cache.push_front(
-        CacheItem{std::set<kio::FileIo*>{owner},
-                  std::make_shared<DataBlock>(owner->cluster, data_key, mode),
-                  std::chrono::system_clock::now()
-        }
-    );
-    kio_debug("Added new data key ", *data_key, " to the cache for owner ", owner);
+
+  /* Evicting may visit all shards, which must not happen while holding the lock of one of them. The new block
+   * is held by data and will not be evicted. */
+  if (p->size > partitionCapacity(*p) || capacity < current_size) {
+    make_room(*p, index);
   }
-  current_size += cache.front().data->capacity();
-  lookup[cache_key] = cache.begin();
-  owner_tables[owner].insert(cache.begin());
-  return cache.front().data;;
+  return data;
 }
 
 double DataCache::utilization()
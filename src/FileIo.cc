@@ -17,6 +17,8 @@
 #include "FileIo.hh"
 #include "ClusterMap.hh"
 #include "KineticIoSingleton.hh"
+#include "Tracepoints.hh"
+#include <iomanip>
 
 using std::shared_ptr;
 using std::unique_ptr;
@@ -27,9 +29,72 @@ using kinetic::StatusCode;
 
 using namespace kio;
 
+namespace {
+  //! name of the attribute storing the whole-file checksum
+  const string checksum_attribute("sys.checksum");
+
+  string checksumToString(uint32_t checksum)
+  {
+    return utility::Convert::toString(std::hex, std::setfill('0'), std::setw(8), checksum);
+  }
+
+  //! extend a crc by length zero bytes without processing them
+  uint32_t appendZeros(uint32_t crc, size_t length)
+  {
+    return crc32c_combine(crc, crc32c_combine(0xffffffff, 0, length) ^ 0xffffffff, length);
+  }
+
+  //! Files with an asynchronous close in progress, shared among all FileIo objects. Reopening such a file has to
+  //! account for blocks not flushed yet.
+  class PendingCloses {
+  public:
+    void add(const string& key, int eof_blocknumber)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto& p = pending[key];
+      p.eof_blocknumber = p.count++ ? std::max(p.eof_blocknumber, eof_blocknumber) : eof_blocknumber;
+    }
+
+    void remove(const string& key)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = pending.find(key);
+      if (it != pending.end() && --it->second.count == 0) {
+        pending.erase(it);
+      }
+    }
+
+    //! @return the last block number of the pending close, -1 if there is none
+    int eof(const string& key)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      auto it = pending.find(key);
+      return it != pending.end() ? it->second.eof_blocknumber : -1;
+    }
+
+  private:
+    struct Pending {
+      size_t count;
+      int eof_blocknumber;
+
+      Pending() : count(0), eof_blocknumber(0)
+      { }
+    };
+    std::unordered_map<string, Pending> pending;
+    std::mutex mutex;
+  };
+
+  PendingCloses& pendingCloses()
+  {
+    static PendingCloses p;
+    return p;
+  }
+}
 
 FileIo::FileIo(const std::string& url) :
-    cluster(), prefetchOracle(kio().readaheadWindowSize()), opened(false)
+    cluster(), prefetchOracle(kio().readaheadWindowSize()), access_pattern(Advice::NORMAL), readahead_limit(-1),
+    parallel_write(false), parallel_end(0), flushes(std::make_shared<BackgroundFlushes>()), opened(false), created(false),
+    checksum(0), checksum_length(0), checksum_sequential(false), checksum_invalidated(false), base_verified(false)
 {
   if (url.compare(0, strlen("kinetic://"), "kinetic://") != 0) {
     kio_error("Invalid url supplied. Required format: kinetic://clusterId/path, supplied: ", url);
@@ -37,11 +102,27 @@ FileIo::FileIo(const std::string& url) :
   }
 
   path = utility::urlToPath(url);
+  base = path;
   cluster = kio().cmap().getCluster(
       utility::urlToClusterId(url)
   );
 }
 
+FileIo::FileIo(FileIo* source) :
+    cluster(source->cluster), prefetchOracle(kio().readaheadWindowSize()), access_pattern(Advice::NORMAL),
+    readahead_limit(-1), parallel_write(source->parallel_write), parallel_region(source->parallel_region),
+    parallel_shared(source->parallel_shared), parallel_end(source->parallel_end),
+    eof_blocknumber(source->eof_blocknumber), eof_verification_time(source->eof_verification_time),
+    flushes(source->flushes), opened(source->opened), created(source->created), checksum(source->checksum),
+    checksum_length(source->checksum_length), checksum_sequential(source->checksum_sequential),
+    checksum_invalidated(source->checksum_invalidated), metadata_version(source->metadata_version),
+    packed(source->packed), packed_value(source->packed_value), packed_verification_time(source->packed_verification_time),
+    path(source->path), base(source->base), base_verified(source->base_verified), tenant(source->tenant)
+{
+  /* Background flushes still in progress now complete for the detached object. */
+  source->flushes = std::make_shared<BackgroundFlushes>();
+}
+
 FileIo::~FileIo()
 {
   /* In case fileIo object is destroyed without having been closed, throw cache data out the window. If
@@ -54,17 +135,45 @@ void FileIo::Open(int flags, mode_t mode, const std::string& opaque, uint16_t ti
   auto mdkey = utility::makeMetadataKey(cluster->id(), path);
 
   KineticStatus status(StatusCode::CLIENT_INTERNAL_ERROR, "");
+  packed = SmallFilePacker::Location();
+  packed_value.reset();
+  created = false;
+  parallel_write = false;
+  parallel_shared.clear();
+  parallel_end = 0;
+  base = path;
+  base_verified = false;
+  checksum = 0;
+  checksum_length = 0;
+  checksum_sequential = false;
+  checksum_invalidated = false;
+
+  /* The opaque information is a list of key=value pairs separated by '&', a tenant tag selects the cache partition. */
+  tenant.clear();
+  auto tag = ("&" + opaque).find("&kio.tenant=");
+  if (tag != std::string::npos) {
+    tenant = opaque.substr(tag + strlen("kio.tenant="));
+    tenant = tenant.substr(0, tenant.find('&'));
+  }
+
   if (flags & SFS_O_CREAT) {
-    shared_ptr<const string> version;
+    /* New files store their data and attributes under a file id, so that they can be renamed without moving them. */
+    auto id = utility::makeFileId();
     status = cluster->put(
         mdkey,
         make_shared<const string>(),
-        make_shared<const string>(),
-        version);
+        make_shared<const string>(utility::makeBaseReference(path, id)),
+        metadata_version);
 
     if (status.ok()) {
+      base = id;
+      base_verified = true;
       eof_blocknumber = 0;
       eof_verification_time = std::chrono::system_clock::now();
+      created = true;
+      /* A new file has no stored checksum, maintain it as long as the file is written sequentially. */
+      checksum_sequential = true;
+      checksum_invalidated = true;
     }
     else if (status.statusCode() == StatusCode::REMOTE_VERSION_MISMATCH) {
       kio_debug("File ", path, " already exists (O_CREAT flag set).");
@@ -72,14 +181,21 @@ void FileIo::Open(int flags, mode_t mode, const std::string& opaque, uint16_t ti
     }
   }
   else {
-    shared_ptr<const string> version;
+    shared_ptr<const string> value;
     status = cluster->get(
         mdkey,
-        version
+        metadata_version,
+        value
     );
     if (status.ok()) {
+      base = utility::metadataToBase(path, value ? *value : string());
+      base_verified = true;
       eof_blocknumber = 0;
       eof_verification_time = std::chrono::system_clock::time_point();
+      if (value) {
+        SmallFilePacker::parse(*value, packed);
+      }
+      packed_verification_time = std::chrono::system_clock::now();
     }
     else if (status.statusCode() == StatusCode::REMOTE_NOT_FOUND) {
       kio_debug("File ", path, " does not exist and cannot be opened without O_CREAT flag.");
@@ -96,11 +212,108 @@ void FileIo::Open(int flags, mode_t mode, const std::string& opaque, uint16_t ti
 
 void FileIo::Close(uint16_t timeout)
 {
+  /* Small new files are stored in their own data key first and packed in the background, so that files closed
+   * one after the other share a pack. With parallel writers, the first block says nothing about the size of the
+   * file. */
+  shared_ptr<const string> pack_value;
+  if (created && eof_blocknumber == 0 && packed.pack.empty() && kio().packer().threshold() && !parallel_write) {
+    pack_value = kio().cache().getDataKey(this, 0, DataBlock::Mode::STANDARD)->unflushedValue(
+        kio().packer().threshold()
+    );
+  }
+  bool store_checksum = created && checksum_sequential && !parallel_write;
+  bool resolve_parallel = parallel_write;
+  created = false;
+  parallel_write = false;
   eof_blocknumber = 0;
   opened = false;
 
-  Sync(timeout);
+  if (resolve_parallel) {
+    closeParallelWrite(timeout);
+  }
+  else {
+    Sync(timeout);
+  }
   kio().cache().drop(this);
+  if (pack_value) {
+    kio().packer().schedule(cluster, path, base, pack_value, metadata_version);
+  }
+
+  /* Stored after the data, a missing checksum is computed on demand. The checksum only covers the data written
+   * through this object, it is not stored if the file has a different size at close. */
+  if (store_checksum) {
+    long long size = packed.pack.empty() ? get_size_backend() : static_cast<long long>(packed.length);
+    if (size != checksum_length) {
+      kio_notice("Not storing checksum of ", checksum_length, " bytes for file ", path, " of ", size, " bytes.");
+      auto status = cluster->remove(utility::makeAttributeKey(cluster->id(), storageBase(), checksum_attribute));
+      if (!status.ok() && status.statusCode() != StatusCode::REMOTE_NOT_FOUND) {
+        kio_warning("Failed removing checksum of file ", path, ": ", status);
+      }
+      return;
+    }
+    std::shared_ptr<const string> version;
+    auto status = cluster->put(
+        utility::makeAttributeKey(cluster->id(), storageBase(), checksum_attribute),
+        make_shared<const string>(checksumToString(checksum)),
+        version
+    );
+    if (!status.ok()) {
+      kio_warning("Failed storing checksum of file ", path, ": ", status);
+    }
+  }
+}
+
+void FileIo::CloseAsync(std::function<void(std::error_code)> callback, uint16_t timeout)
+{
+  /* The dirty state of the file is handed to a detached object, which completes the close in the background. */
+  std::shared_ptr<FileIo> detached(new FileIo(this));
+  pendingCloses().add(pendingCloseKey(), eof_blocknumber);
+  kio().cache().transfer(this, detached.get());
+
+  created = false;
+  parallel_write = false;
+  eof_blocknumber = 0;
+  opened = false;
+
+  kio().threadpool().run(std::bind(&FileIo::completeCloseAsync, detached, callback, timeout));
+}
+
+void FileIo::completeCloseAsync(std::function<void(std::error_code)> callback, uint16_t timeout)
+{
+  std::error_code ec;
+  try {
+    Close(timeout);
+  }
+  catch (const std::system_error& e) {
+    ec = e.code();
+  }
+  catch (const std::exception& e) {
+    ec = std::make_error_code(std::errc::io_error);
+  }
+  {
+    /* Wait for background flushes scheduled before the close, their errors would have been reported by the
+     * next request. */
+    std::unique_lock<std::mutex> lock(flushes->mutex);
+    while (flushes->pending) {
+      flushes->cv.wait(lock);
+    }
+    if (!ec && !flushes->exceptions.empty()) {
+      ec = flushes->exceptions.front().code();
+    }
+  }
+  if (ec) {
+    kio_warning("Asynchronous close of file ", path, " failed: ", ec.message());
+  }
+  pendingCloses().remove(pendingCloseKey());
+
+  if (callback) {
+    callback(ec);
+  }
+}
+
+std::string FileIo::pendingCloseKey() const
+{
+  return cluster->instanceId() + ":" + base;
 }
 
 void FileIo::Sync(uint16_t timeout)
@@ -109,6 +322,57 @@ void FileIo::Sync(uint16_t timeout)
   cluster->flush();
 }
 
+void FileIo::closeParallelWrite(uint16_t timeout)
+{
+  Sync(timeout);
+
+  /* Shared blocks are merged with the data of other writers when flushed. Rather than relying on version checks alone,
+   * verify that the stored blocks contain the data of this writer and write it again if it is missing. */
+  const int max_attempts = 3;
+  for (auto it = parallel_shared.cbegin(); it != parallel_shared.cend(); it++) {
+    auto key = utility::makeDataKey(cluster->id(), base, it->first);
+    for (int attempt = 0;; attempt++) {
+      shared_ptr<const string> version;
+      shared_ptr<const string> value;
+      auto status = cluster->get(key, version, value);
+      if (!status.ok() && status.statusCode() != StatusCode::REMOTE_NOT_FOUND) {
+        kio_error("Failed verifying shared block ", it->first, " of file ", path, ": ", status);
+        throw std::system_error(std::make_error_code(std::errc::io_error));
+      }
+
+      bool complete = true;
+      for (auto r = it->second.ranges.cbegin(); r != it->second.ranges.cend() && complete; r++) {
+        complete = status.ok() && value && value->size() >= r->first + r->second &&
+                   value->compare(r->first, r->second, it->second.value, r->first, r->second) == 0;
+      }
+      if (complete) {
+        break;
+      }
+      if (attempt == max_attempts) {
+        kio_error("Data written to shared block ", it->first, " of file ", path, " has been lost in concurrent updates.");
+        throw std::system_error(std::make_error_code(std::errc::io_error));
+      }
+
+      kio_warning("Writing data lost in a concurrent update to shared block ", it->first, " of file ", path, " again.");
+      auto data = kio().cache().getDataKey(this, it->first, DataBlock::Mode::STANDARD);
+      for (auto r = it->second.ranges.cbegin(); r != it->second.ranges.cend(); r++) {
+        data->write(it->second.value.data() + r->first, r->first, r->second);
+      }
+      data->flush();
+    }
+  }
+
+  /* The file size has to cover everything this writer wrote. */
+  long long size = get_size_backend();
+  if (size < parallel_end) {
+    kio_error("Size ", size, " of file ", path, " does not cover data written up to ", parallel_end);
+    throw std::system_error(std::make_error_code(std::errc::io_error));
+  }
+  kio_debug("Closed parallel writer of file ", path, ", file size is ", size, " bytes.");
+  parallel_shared.clear();
+  parallel_end = 0;
+}
+
 void do_readahead(std::shared_ptr<kio::DataBlock> data)
 {
   char buf[1];
@@ -117,33 +381,139 @@ void do_readahead(std::shared_ptr<kio::DataBlock> data)
 
 void FileIo::scheduleReadahead(int blocknumber)
 {
+  if (access_pattern == Advice::RANDOM) {
+    return;
+  }
   prefetchOracle.add(blocknumber);
 
-  /* Adjust to cache utilization. Full force to 0.75 usage, decreasing until 0.95, then disabled. */
+  /* Adjust to cache utilization. Full force to 0.75 usage, decreasing until 0.95, then disabled. Sequential
+   * access has been announced by the client, so we don't reduce readahead before the cache is actually full. */
   size_t readahead_length = kio().readaheadWindowSize();
   auto cache_utilization = kio().cache().utilization();
 
   if (cache_utilization > 0.95) {
     readahead_length = 0;
   }
-  else if (cache_utilization > 0.75) {
+  else if (cache_utilization > 0.75 && access_pattern != Advice::SEQUENTIAL) {
     readahead_length *= ((1.0 - cache_utilization) / 0.25);
   }
 
-  if (readahead_length) {
-    auto prediction = prefetchOracle.predict(readahead_length, PrefetchOracle::PredictionType::CONTINUE);
-    for (auto it = prediction.cbegin(); it != prediction.cend(); it++) {
-      if (*it < eof_blocknumber) {
-        auto data = kio().cache().getDataKey(this, *it, DataBlock::Mode::STANDARD);
-        auto scheduled = kio().threadpool().try_run(std::bind(do_readahead, data));
-        if (scheduled)
-          kio_debug("Readahead of data block #", *it);
+  if (!readahead_length) {
+    return;
+  }
+  if (access_pattern == Advice::SEQUENTIAL) {
+    /* No need to wait for the oracle to detect the pattern. Only schedule blocks that have not been scheduled
+     * already, unless the client seeked outside the current readahead window. Blocks that could not be scheduled
+     * remain outside the limit to be tried again on the next access. */
+    int window_end = blocknumber + static_cast<int>(readahead_length);
+    if (readahead_limit < blocknumber || readahead_limit > window_end) {
+      readahead_limit = blocknumber;
+    }
+    while (readahead_limit < window_end && readahead_limit + 1 < eof_blocknumber) {
+      if (!kio().cache().isAbsent(this, readahead_limit + 1) && !readahead(readahead_limit + 1)) {
+        break;
       }
+      readahead_limit++;
+    }
+    return;
+  }
+
+  auto prediction = prefetchOracle.predict(readahead_length, PrefetchOracle::PredictionType::CONTINUE);
+  for (auto it = prediction.cbegin(); it != prediction.cend(); it++) {
+    if (*it < eof_blocknumber && !kio().cache().isAbsent(this, *it)) {
+      readahead(*it);
+    }
+  }
+}
+
+bool FileIo::readahead(int blocknumber)
+{
+  auto data = kio().cache().getDataKey(this, blocknumber, DataBlock::Mode::STANDARD);
+  auto scheduled = kio().threadpool().try_run(std::bind(do_readahead, data));
+  if (scheduled) {
+    KIO_TRACE2(readahead, path.c_str(), blocknumber);
+    kio_debug("Readahead of data block #", blocknumber);
+  }
+  return scheduled;
+}
+
+bool FileIo::reuseExpected(int blocknumber)
+{
+  if (access_pattern == Advice::SEQUENTIAL) {
+    return false;
+  }
+  for (auto it = noreuse_ranges.cbegin(); it != noreuse_ranges.cend() && it->first <= blocknumber; it++) {
+    if (blocknumber <= it->second) {
+      return false;
     }
   }
+  return true;
 }
 
-void FileIo::doFlush(std::shared_ptr<kio::DataBlock> data)
+void FileIo::Advise(long long offset, long long length, Advice advice)
+{
+  if (!opened) {
+    kio_error("Advise operation not permitted on non-opened object.");
+    throw std::system_error(std::make_error_code(std::errc::operation_not_permitted));
+  }
+  if (offset < 0 || length < 0) {
+    kio_error("Invalid range supplied to advise operation: offset=", offset, ", length=", length);
+    throw std::system_error(std::make_error_code(std::errc::invalid_argument));
+  }
+
+  const size_t block_capacity = cluster->limits().max_value_size;
+  int first_block = static_cast<int>(offset / block_capacity);
+  int last_block = length ? static_cast<int>((offset + length - 1) / block_capacity) : std::numeric_limits<int>::max();
+
+  switch (advice) {
+    case Advice::NORMAL:
+      noreuse_ranges.clear();
+      /* fall through */
+    case Advice::SEQUENTIAL:
+    case Advice::RANDOM:
+      access_pattern = advice;
+      readahead_limit = -1;
+      break;
+
+    case Advice::WILLNEED:
+      /* Prefetch as much of the range as the cache and the background threads can handle right now. */
+      verify_eof();
+      for (int block = first_block; block <= std::min(last_block, eof_blocknumber); block++) {
+        if (kio().cache().utilization() > 0.95) {
+          break;
+        }
+        if (kio().cache().isAbsent(this, block)) {
+          continue;
+        }
+        auto data = kio().cache().getDataKey(this, block, DataBlock::Mode::STANDARD);
+        if (!kio().threadpool().try_run(std::bind(do_readahead, data))) {
+          break;
+        }
+        kio_debug("Advised prefetch of data block #", block);
+      }
+      break;
+
+    case Advice::DONTNEED:
+      for (int block = first_block; block <= std::min(last_block, eof_blocknumber); block++) {
+        kio().cache().release(this, block);
+      }
+      break;
+
+    case Advice::NOREUSE:
+      if (noreuse_ranges.count(first_block) == 0 || noreuse_ranges[first_block] < last_block) {
+        noreuse_ranges[first_block] = last_block;
+      }
+      break;
+
+    case Advice::PARALLEL_WRITE:
+      parallel_write = true;
+      checksum_sequential = false;
+      parallel_region = std::make_pair(offset, length ? offset + length : std::numeric_limits<long long>::max());
+      break;
+  }
+}
+
+void FileIo::doFlush(std::shared_ptr<BackgroundFlushes> flushes, std::shared_ptr<kio::DataBlock> data)
 {
   if (data->dirty()) {
     try {
@@ -151,31 +521,46 @@ void FileIo::doFlush(std::shared_ptr<kio::DataBlock> data)
     }
     catch (const std::system_error& e) {
       kio_warning("Exception ocurred in background flush of data block ", data->getIdentity(), ": ", e.what());
-      std::lock_guard<std::mutex> lock(exception_mutex);
-      exceptions.push(e);
+      std::lock_guard<std::mutex> lock(flushes->mutex);
+      flushes->exceptions.push(e);
     }
   }
+  std::lock_guard<std::mutex> lock(flushes->mutex);
+  flushes->pending--;
+  flushes->cv.notify_all();
 }
 
 void FileIo::scheduleFlush(std::shared_ptr<kio::DataBlock> data)
 {
-  kio().threadpool().run(std::bind(&FileIo::doFlush, this, data));
+  {
+    std::lock_guard<std::mutex> lock(flushes->mutex);
+    flushes->pending++;
+  }
+  kio().threadpool().run(std::bind(&FileIo::doFlush, flushes, data));
 }
 
 
 int64_t FileIo::ReadWrite(long long off, char* buffer,
-                          int length, FileIo::rw mode, uint16_t timeout)
+                          int length, FileIo::rw mode, uint16_t timeout, std::vector<DataView>* views)
 {
   {
-    std::lock_guard<std::mutex> lock(exception_mutex);
-    if (!exceptions.empty()) {
-      auto e = exceptions.front();
-      exceptions.pop();
+    std::lock_guard<std::mutex> lock(flushes->mutex);
+    if (!flushes->exceptions.empty()) {
+      auto e = flushes->exceptions.front();
+      flushes->exceptions.pop();
       kio_warning("Re-throwing exception caught in previous async flush operation: ", e.what());
       throw e;
     }
   }
 
+  /* Packed files are served from their pack. Before they can be written to, they are moved to their own data key. */
+  if (mayBePacked() && verify_packed()) {
+    if (mode == rw::READ) {
+      return readPacked(off, buffer, length, views);
+    }
+    unpack();
+  }
+
   const size_t block_capacity = cluster->limits().max_value_size;
   size_t length_todo = static_cast<size_t>(length);
   size_t off_done = 0;
@@ -187,24 +572,85 @@ int64_t FileIo::ReadWrite(long long off, char* buffer,
 
     /* Increase last block number if we write past currently known file size...*/
     DataBlock::Mode cm = DataBlock::Mode::STANDARD;
-    if (mode == rw::WRITE && block_number > eof_blocknumber) {
+    bool shared_block = false;
+    if (mode == rw::WRITE && parallel_write) {
+      /* ...unless other handles write the file concurrently. Then the known file size is meaningless, but blocks
+       * inside the advised region belong to this handle. Blocks shared with other regions are read and merged on
+       * flush, which happens once on sync / close rather than every time this handle completes its part. */
+      long long block_start = static_cast<long long>(block_number) * block_capacity;
+      shared_block = block_start < parallel_region.first ||
+                     block_start + static_cast<long long>(block_capacity) > parallel_region.second;
+      if (!shared_block) {
+        cm = DataBlock::Mode::CREATE;
+      }
+      eof_blocknumber = std::max(eof_blocknumber, block_number);
+    }
+    else if (mode == rw::WRITE && block_number > eof_blocknumber) {
       eof_blocknumber = block_number;
       cm = DataBlock::Mode::CREATE;
     }
 
+    /* Serve reads of blocks known not to exist (holes, past eof) without touching the backend. */
+    if (mode == rw::READ && kio().cache().isAbsent(this, block_number)) {
+      if (!views) {
+        memset(buffer + off_done, 0, block_length);
+      }
+      if (block_number >= eof_blocknumber) {
+        verify_eof();
+        if (block_number < eof_blocknumber) {
+          continue;
+        }
+        break;
+      }
+      if (views) {
+        views->push_back(DataView(make_shared<const string>(block_length, '\0'), 0, block_length));
+      }
+      length_todo -= block_length;
+      off_done += block_length;
+      continue;
+    }
+
     auto data = kio().cache().getDataKey(this, block_number, cm);
-    scheduleReadahead(block_number);
+    if (mode == rw::READ || !parallel_write) {
+      scheduleReadahead(block_number);
+    }
 
     if (mode == rw::WRITE) {
       data->write(buffer + off_done, block_offset, block_length);
 
+      /* Remember what has been written to blocks shared with other writers, so it can be verified on close. */
+      if (shared_block) {
+        auto& shared = parallel_shared[block_number];
+        if (shared.value.size() < block_offset + block_length) {
+          shared.value.resize(block_offset + block_length);
+        }
+        shared.value.replace(block_offset, block_length, buffer + off_done, block_length);
+        shared.ranges.push_back(std::make_pair(block_offset, block_length));
+      }
+      if (parallel_write) {
+        parallel_end = std::max(parallel_end, off + static_cast<long long>(off_done + block_length));
+      }
+
       /* Flush data in background if writing to block capacity.*/
-      if (block_offset + block_length == block_capacity) {
+      if (block_offset + block_length == block_capacity && !shared_block) {
         scheduleFlush(data);
       }
     }
     else if (mode == rw::READ) {
-      data->read(buffer + off_done, block_offset, block_length);
+      if (views) {
+        /* Only view the last block up to its size, so that the view does not require a zero-filled copy. */
+        size_t view_length = block_length;
+        if (block_number >= eof_blocknumber) {
+          size_t size = data->size();
+          view_length = size > block_offset ? std::min(block_length, size - block_offset) : 0;
+        }
+        size_t view_offset = 0;
+        auto view = data->view(block_offset, view_length, view_offset);
+        views->push_back(DataView(view, view_offset, view_length));
+      }
+      else {
+        data->read(buffer + off_done, block_offset, block_length);
+      }
 
       /* If it looks like we are reading the last block (or past it) */
       if (block_number >= eof_blocknumber) {
@@ -212,15 +658,34 @@ int64_t FileIo::ReadWrite(long long off, char* buffer,
         /* First verify that the stored last block number is still up to date. */
         verify_eof();
         if (block_number < eof_blocknumber) {
+          if (views) {
+            views->pop_back();
+          }
           continue;
         }
 
         /* make sure length doesn't indicate that we read past file size. */
+        size_t read_length = 0;
         if (data->size() > block_offset) {
-          length_todo -= std::min(block_length, data->size() - block_offset);
+          read_length = std::min(block_length, data->size() - block_offset);
+          length_todo -= read_length;
         }
+        if (views && read_length) {
+          views->back().length = read_length;
+        }
+        else if (views) {
+          views->pop_back();
+        }
+        kio().cache().setAbsent(data);
         break;
       }
+      kio().cache().setAbsent(data);
+    }
+
+    /* Blocks that have been accessed completely and are not expected to be accessed again can be released. */
+    if (block_offset + block_length == block_capacity && !reuseExpected(block_number)) {
+      data.reset();
+      kio().cache().release(this, block_number);
     }
     length_todo -= block_length;
     off_done += block_length;
@@ -237,7 +702,36 @@ int64_t FileIo::Read(long long offset, char* buffer, int length,
     throw std::system_error(std::make_error_code(std::errc::operation_not_permitted));
   }
 
-  return ReadWrite(offset, buffer, length, FileIo::rw::READ, timeout);
+  KIO_TRACE3(fileio_read_entry, path.c_str(), offset, length);
+  try {
+    auto result = ReadWrite(offset, buffer, length, FileIo::rw::READ, timeout);
+    KIO_TRACE2(fileio_read_return, path.c_str(), result);
+    return result;
+  }
+  catch (const std::system_error& e) {
+    KIO_TRACE2(fileio_read_return, path.c_str(), -e.code().value());
+    throw;
+  }
+}
+
+int64_t FileIo::ReadViews(long long offset, int length, std::vector<DataView>& views, uint16_t timeout)
+{
+  if (!opened) {
+    kio_error("Read operation not permitted on non-opened object.");
+    throw std::system_error(std::make_error_code(std::errc::operation_not_permitted));
+  }
+
+  views.clear();
+  KIO_TRACE3(fileio_read_entry, path.c_str(), offset, length);
+  try {
+    auto result = ReadWrite(offset, NULL, length, FileIo::rw::READ, timeout, &views);
+    KIO_TRACE2(fileio_read_return, path.c_str(), result);
+    return result;
+  }
+  catch (const std::system_error& e) {
+    KIO_TRACE2(fileio_read_return, path.c_str(), -e.code().value());
+    throw;
+  }
 }
 
 int64_t FileIo::Write(long long offset, const char* buffer,
@@ -248,8 +742,25 @@ int64_t FileIo::Write(long long offset, const char* buffer,
     throw std::system_error(std::make_error_code(std::errc::operation_not_permitted));
   }
 
-  return ReadWrite(offset, const_cast<char*>(buffer), length,
-                   FileIo::rw::WRITE, timeout);
+  KIO_TRACE3(fileio_write_entry, path.c_str(), offset, length);
+  try {
+    if (!checksum_sequential || offset != checksum_length) {
+      checksum_sequential = false;
+      invalidateChecksum();
+    }
+    auto result = ReadWrite(offset, const_cast<char*>(buffer), length, FileIo::rw::WRITE, timeout);
+    if (checksum_sequential) {
+      checksum = crc32c(checksum, buffer, static_cast<size_t>(result));
+      checksum_length += result;
+    }
+    KIO_TRACE2(fileio_write_return, path.c_str(), result);
+    return result;
+  }
+  catch (const std::system_error& e) {
+    KIO_TRACE2(fileio_write_return, path.c_str(), -e.code().value());
+    checksum_sequential = false;
+    throw;
+  }
 }
 
 void FileIo::Truncate(long long offset, uint16_t timeout)
@@ -259,6 +770,15 @@ void FileIo::Truncate(long long offset, uint16_t timeout)
     throw std::system_error(std::make_error_code(std::errc::operation_not_permitted));
   }
 
+  if (!packed.pack.empty() && verify_packed()) {
+    unpack();
+  }
+
+  if (!checksum_sequential || offset != checksum_length) {
+    checksum_sequential = false;
+    invalidateChecksum();
+  }
+
   const size_t block_capacity = cluster->limits().max_value_size;
   int block_number = static_cast<int>(offset / block_capacity);
   size_t block_offset = offset - block_number * block_capacity;
@@ -279,8 +799,8 @@ void FileIo::Truncate(long long offset, uint16_t timeout)
   std::unique_ptr<std::vector<string>> keys;
   do {
     KineticStatus status = cluster->range(
-        utility::makeDataKey(cluster->id(), path, offset ? block_number + 1 : 0),
-        utility::makeDataKey(cluster->id(), path, std::numeric_limits<int>::max()),
+        utility::makeDataKey(cluster->id(), base, offset ? block_number + 1 : 0),
+        utility::makeDataKey(cluster->id(), base, std::numeric_limits<int>::max()),
         keys);
     if (!status.ok()) {
       kio_error("KeyRange request unexpectedly failed for path ", path, ": ", status);
@@ -306,12 +826,20 @@ void FileIo::Remove(uint16_t timeout)
   if (!opened) {
     Open(0);
   }
+  checksum_sequential = false;
+
+  /* The content of a packed file is removed with the pack once it has been compacted. */
+  if (!packed.pack.empty()) {
+    kio().packer().release(cluster, packed);
+    packed = SmallFilePacker::Location();
+    packed_value.reset();
+  }
 
   auto attributes = attrList();
 
   KineticStatus status(StatusCode::CLIENT_INTERNAL_ERROR, "");
   for (auto iter = attributes.cbegin(); iter != attributes.cend(); ++iter) {
-    status = cluster->remove(utility::makeAttributeKey(cluster->id(), path, *iter));
+    status = cluster->remove(utility::makeAttributeKey(cluster->id(), base, *iter));
     if (!status.ok()) {
       kio_error("Deleting attribute ", *iter, " failed: ", status);
       throw std::system_error(std::make_error_code(std::errc::io_error));
@@ -327,12 +855,209 @@ void FileIo::Remove(uint16_t timeout)
 }
 
 
+void FileIo::Rename(const std::string& url, uint16_t timeout)
+{
+  if (url.compare(0, strlen("kinetic://"), "kinetic://") != 0) {
+    kio_error("Invalid url supplied. Required format: kinetic://clusterId/path, supplied: ", url);
+    throw std::system_error(std::make_error_code(std::errc::invalid_argument));
+  }
+  if (utility::urlToClusterId(url) != cluster->id()) {
+    kio_error("Cannot rename ", path, " to a different cluster: ", url);
+    throw std::system_error(std::make_error_code(std::errc::cross_device_link));
+  }
+  auto target = utility::urlToPath(url);
+
+  /* We allow renaming unopened files... */
+  if (!opened) {
+    Open(0);
+  }
+  if (target == path) {
+    return;
+  }
+
+  /* Packs reference their files by path, a packed file is moved to its own data key first. */
+  if (!packed.pack.empty() && verify_packed()) {
+    unpack();
+  }
+
+  auto mdkey = utility::makeMetadataKey(cluster->id(), path);
+  shared_ptr<const string> version;
+  shared_ptr<const string> value;
+  auto status = cluster->get(mdkey, version, value);
+  if (status.statusCode() == StatusCode::REMOTE_NOT_FOUND ||
+      (status.ok() && utility::metadataToBase(path, value ? *value : string()) != base)) {
+    kio_warning("File does not exist: ", path);
+    throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory));
+  }
+  SmallFilePacker::Location location;
+  if (status.ok() && value && SmallFilePacker::parse(*value, location)) {
+    kio_warning("File ", path, " has been packed concurrently, not renaming it.");
+    throw std::system_error(std::make_error_code(std::errc::device_or_resource_busy));
+  }
+  if (!status.ok()) {
+    kio_error("Failed reading metadata of path ", path, ": ", status);
+    throw std::system_error(std::make_error_code(std::errc::io_error));
+  }
+
+  /* The target metadata key may not exist yet, and the source metadata key is only removed if it has not been
+   * changed in the meantime. Otherwise the target is removed again, so that the file exists exactly once. */
+  auto target_mdkey = utility::makeMetadataKey(cluster->id(), target);
+  shared_ptr<const string> target_version;
+  status = cluster->put(
+      target_mdkey,
+      make_shared<const string>(),
+      make_shared<const string>(utility::makeBaseReference(target, base)),
+      target_version
+  );
+  if (status.statusCode() == StatusCode::REMOTE_VERSION_MISMATCH) {
+    kio_debug("Rename target ", target, " already exists.");
+    throw std::system_error(std::make_error_code(std::errc::file_exists));
+  }
+  if (!status.ok()) {
+    kio_error("Failed writing metadata of rename target ", target, ": ", status);
+    throw std::system_error(std::make_error_code(std::errc::io_error));
+  }
+
+  status = cluster->remove(mdkey, version);
+  if (!status.ok()) {
+    cluster->remove(target_mdkey, target_version);
+    if (status.statusCode() == StatusCode::REMOTE_NOT_FOUND) {
+      kio_warning("File ", path, " has been removed during rename.");
+      throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory));
+    }
+    if (status.statusCode() == StatusCode::REMOTE_VERSION_MISMATCH) {
+      kio_warning("File ", path, " has been modified during rename.");
+      throw std::system_error(std::make_error_code(std::errc::device_or_resource_busy));
+    }
+    kio_error("Failed removing metadata of renamed file ", path, ": ", status);
+    throw std::system_error(std::make_error_code(std::errc::io_error));
+  }
+
+  kio_debug("Renamed ", path, " to ", target, ", data and attributes remain stored as ", base);
+  path = target;
+  metadata_version = target_version;
+}
+
+const std::string& FileIo::storageBase()
+{
+  if (base_verified) {
+    return base;
+  }
+
+  shared_ptr<const string> version;
+  shared_ptr<const string> value;
+  auto status = cluster->get(utility::makeMetadataKey(cluster->id(), path), version, value);
+  if (status.ok()) {
+    base = utility::metadataToBase(path, value ? *value : string());
+    base_verified = true;
+  }
+  else if (status.statusCode() != StatusCode::REMOTE_NOT_FOUND) {
+    kio_error("Failed reading metadata of path ", path, ": ", status);
+    throw std::system_error(std::make_error_code(std::errc::io_error));
+  }
+  return base;
+}
+
+void FileIo::invalidateChecksum()
+{
+  if (checksum_invalidated) {
+    return;
+  }
+  auto status = cluster->remove(utility::makeAttributeKey(cluster->id(), storageBase(), checksum_attribute));
+  if (!status.ok() && status.statusCode() != StatusCode::REMOTE_NOT_FOUND) {
+    kio_error("Failed removing checksum of file ", path, ": ", status);
+    throw std::system_error(std::make_error_code(std::errc::io_error));
+  }
+  checksum_invalidated = true;
+}
+
+uint32_t FileIo::computeChecksum()
+{
+  shared_ptr<const string> version;
+  shared_ptr<const string> value;
+  auto status = cluster->get(utility::makeMetadataKey(cluster->id(), path), version, value);
+  if (status.statusCode() == StatusCode::REMOTE_NOT_FOUND) {
+    kio_warning("File does not exist: ", path);
+    throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory));
+  }
+  if (!status.ok()) {
+    kio_error("Failed reading metadata of path ", path, ": ", status);
+    throw std::system_error(std::make_error_code(std::errc::io_error));
+  }
+
+  /* Packed files are small, their content is cut out of the (likely cached) pack. */
+  SmallFilePacker::Location location;
+  if (value && SmallFilePacker::parse(*value, location)) {
+    status = kio().packer().read(cluster, location, value);
+    if (!status.ok()) {
+      kio_error("Failed reading packed file ", path, " from pack ", location.pack, ": ", status);
+      throw std::system_error(std::make_error_code(std::errc::io_error));
+    }
+    return crc32c(0, value->data(), value->size());
+  }
+
+  auto file_base = utility::metadataToBase(path, value ? *value : string());
+  auto data_prefix = *utility::makeDataKey(cluster->id(), file_base, 0);
+  data_prefix.resize(data_prefix.size() - 10);
+  const size_t block_capacity = cluster->limits().max_value_size;
+
+  /* Blocks are combined in order. Missing blocks and the unwritten end of blocks before the last one read as zeros. */
+  uint32_t crc = 0;
+  size_t length = 0;
+  auto start = utility::makeDataKey(cluster->id(), file_base, 0);
+  auto end = utility::makeDataKey(cluster->id(), file_base, std::numeric_limits<int>::max());
+  std::unique_ptr<std::vector<string>> keys;
+  do {
+    status = cluster->range(start, end, keys);
+    if (!status.ok()) {
+      kio_error("KeyRange request unexpectedly failed for path ", path, ": ", status);
+      throw std::system_error(std::make_error_code(std::errc::io_error));
+    }
+    for (auto it = keys->cbegin(); it != keys->cend(); it++) {
+      if (it->size() != data_prefix.size() + 10 || it->compare(0, data_prefix.size(), data_prefix) != 0) {
+        continue;
+      }
+      auto key = make_shared<const string>(*it);
+      status = cluster->get(key, version);
+      if (status.statusCode() == StatusCode::REMOTE_NOT_FOUND) {
+        continue;
+      }
+      uint32_t block_crc = 0;
+      if (status.ok() && !utility::uuidDecodeChecksum(version, block_crc)) {
+        /* Written without checksum in the version. */
+        status = cluster->get(key, version, value);
+        if (status.ok()) {
+          block_crc = crc32c(0, value->data(), value->size());
+        }
+      }
+      if (!status.ok()) {
+        kio_error("Failed obtaining checksum of data key ", *key, ": ", status);
+        throw std::system_error(std::make_error_code(std::errc::io_error));
+      }
+
+      size_t block_start = std::stoi(it->substr(data_prefix.size())) * block_capacity;
+      if (block_start > length) {
+        crc = appendZeros(crc, block_start - length);
+      }
+      auto block_size = utility::uuidDecodeSize(version);
+      crc = crc32c_combine(crc, block_crc, block_size);
+      length = block_start + block_size;
+    }
+    if (!keys->empty()) {
+      start = make_shared<const string>(keys->back() + static_cast<char>(0));
+    }
+  } while (keys->size() == cluster->limits().max_range_elements);
+
+  kio_debug("Computed checksum ", checksumToString(crc), " of ", length, " bytes for file ", path);
+  return crc;
+}
+
 int FileIo::get_eof_backend()
 {
   /* Do a reverse get-range to obtain last block number. */
   std::unique_ptr<std::vector<string>> keys;
-  auto start_key = utility::makeDataKey(cluster->id(), path, 999999999);
-  auto end_key = utility::makeDataKey(cluster->id(), path, 0);
+  auto start_key = utility::makeDataKey(cluster->id(), base, 999999999);
+  auto end_key = utility::makeDataKey(cluster->id(), base, 0);
   KineticStatus status = cluster->range(start_key, end_key, keys, 1);
   
   if (!status.ok()) {
@@ -340,11 +1065,14 @@ int FileIo::get_eof_backend()
     throw std::system_error(std::make_error_code(std::errc::io_error));
   }
 
+  /* Blocks of an asynchronous close in progress might not have been flushed yet. */
+  int pending = pendingCloses().eof(pendingCloseKey());
+
   /* Success: get block number from last key.*/
   if (keys->size() > 0) {
     std::string key = keys->front();
     std::string number = key.substr(key.find_last_of('_') + 1, key.length());
-    return std::stoi(number);
+    return std::max(std::stoi(number), pending);
   }
 
   /* No block keys found. Ensure that the key has not been removed by testing for
@@ -352,12 +1080,26 @@ int FileIo::get_eof_backend()
   shared_ptr<const string> version;
   auto mdkey = utility::makeMetadataKey(cluster->id(), path);
   if (cluster->get(mdkey, version).ok()) {
-    return 0;
+    return std::max(0, pending);
   }
   kio_warning("File does not exist: ", path);
   throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory));
 }
 
+long long FileIo::get_size_backend()
+{
+  /* The file size follows from the last block, its size is encoded in its version. */
+  int last_block = get_eof_backend();
+  shared_ptr<const string> version;
+  auto status = cluster->get(utility::makeDataKey(cluster->id(), base, last_block), version);
+  if (!status.ok() && status.statusCode() != StatusCode::REMOTE_NOT_FOUND) {
+    kio_error("Failed obtaining size of file ", path, ": ", status);
+    throw std::system_error(std::make_error_code(std::errc::io_error));
+  }
+  return status.ok() ?
+         static_cast<long long>(last_block) * cluster->limits().max_value_size + utility::uuidDecodeSize(version) : 0;
+}
+
 void FileIo::verify_eof()
 {
   using namespace std::chrono;
@@ -382,6 +1124,123 @@ void FileIo::verify_eof()
 }
 
 
+bool FileIo::verify_packed()
+{
+  using namespace std::chrono;
+  if (duration_cast<milliseconds>(system_clock::now() - packed_verification_time) > DataBlock::expiration_time) {
+    auto mdkey = utility::makeMetadataKey(cluster->id(), path);
+
+    /* Most of the time the metadata key will not have changed, no need to read the value in that case. */
+    shared_ptr<const string> version;
+    auto status = cluster->get(mdkey, version);
+    if (!status.ok() || !version || !metadata_version || *version != *metadata_version) {
+      shared_ptr<const string> value;
+      status = cluster->get(mdkey, version, value);
+      if (status.statusCode() == StatusCode::REMOTE_NOT_FOUND) {
+        kio_warning("File does not exist: ", path);
+        throw std::system_error(std::make_error_code(std::errc::no_such_file_or_directory));
+      }
+      if (!status.ok()) {
+        kio_error("Failed reading metadata of path ", path, ": ", status);
+        throw std::system_error(std::make_error_code(std::errc::io_error));
+      }
+
+      SmallFilePacker::Location location;
+      if (!value || !SmallFilePacker::parse(*value, location)) {
+        location = SmallFilePacker::Location();
+      }
+      if (location.pack != packed.pack || location.offset != packed.offset) {
+        packed_value.reset();
+      }
+      packed = location;
+      metadata_version = version;
+    }
+    packed_verification_time = system_clock::now();
+  }
+  return !packed.pack.empty();
+}
+
+bool FileIo::loadPacked()
+{
+  if (packed_value) {
+    return true;
+  }
+
+  auto status = kio().packer().read(cluster, packed, packed_value);
+  if (status.statusCode() == StatusCode::REMOTE_NOT_FOUND) {
+    /* The pack has been compacted in the meantime, the metadata key references the new location. */
+    auto previous = packed.pack;
+    metadata_version.reset();
+    packed_verification_time = std::chrono::system_clock::time_point();
+    if (!verify_packed()) {
+      return false;
+    }
+    if (packed.pack != previous) {
+      status = kio().packer().read(cluster, packed, packed_value);
+    }
+  }
+  if (!status.ok()) {
+    kio_error("Failed reading packed file ", path, " from pack ", packed.pack, ": ", status);
+    throw std::system_error(std::make_error_code(std::errc::io_error));
+  }
+  return true;
+}
+
+int64_t FileIo::readPacked(long long off, char* buffer, int length, std::vector<DataView>* views)
+{
+  if (!loadPacked()) {
+    return ReadWrite(off, buffer, length, rw::READ, 0, views);
+  }
+  size_t offset = static_cast<size_t>(off);
+  if (offset >= packed_value->size()) {
+    return 0;
+  }
+
+  size_t read_length = std::min(static_cast<size_t>(length), packed_value->size() - offset);
+  if (views) {
+    views->push_back(DataView(packed_value, offset, read_length));
+  }
+  else {
+    packed_value->copy(buffer, read_length, offset);
+  }
+  return read_length;
+}
+
+bool FileIo::mayBePacked()
+{
+  return !packed.pack.empty() || (!created && eof_blocknumber == 0 && kio().packer().threshold());
+}
+
+void FileIo::unpack()
+{
+  if (!loadPacked()) {
+    return;
+  }
+
+  /* Store the content in its own data key before the metadata key stops referencing the pack. */
+  if (!packed_value->empty()) {
+    auto data = kio().cache().getDataKey(this, 0, DataBlock::Mode::STANDARD);
+    data->write(packed_value->data(), 0, packed_value->size());
+    data->flush();
+  }
+
+  auto status = cluster->put(
+      utility::makeMetadataKey(cluster->id(), path),
+      metadata_version,
+      make_shared<const string>(utility::makeBaseReference(path, base)),
+      metadata_version
+  );
+  if (!status.ok()) {
+    kio_error("Failed unpacking file ", path, " from pack ", packed.pack, ": ", status);
+    throw std::system_error(std::make_error_code(std::errc::io_error));
+  }
+
+  kio_debug("Unpacked file ", path, " from pack ", packed.pack);
+  kio().packer().release(cluster, packed);
+  packed = SmallFilePacker::Location();
+  packed_value.reset();
+}
+
 void FileIo::Stat(struct stat* buf, uint16_t timeout)
 {
   /* We allow statting unopened files... */
@@ -389,10 +1248,18 @@ void FileIo::Stat(struct stat* buf, uint16_t timeout)
     Open(0);
   }
 
+  memset(buf, 0, sizeof(struct stat));
+  if (mayBePacked() && verify_packed()) {
+    buf->st_blksize = cluster->limits().max_value_size;
+    buf->st_blocks = 1;
+    buf->st_size = packed.length;
+    kio_debug("Reported file size is ", buf->st_size, " bytes, file is packed in ", packed.pack);
+    return;
+  }
+
   verify_eof();
   auto last_block = kio().cache().getDataKey(this, eof_blocknumber, DataBlock::Mode::STANDARD);
 
-  memset(buf, 0, sizeof(struct stat));
   buf->st_blksize = cluster->limits().max_value_size;
   buf->st_blocks = eof_blocknumber + 1;
   buf->st_size = eof_blocknumber * buf->st_blksize + last_block->size();
@@ -421,11 +1288,35 @@ std::string FileIo::attrGet(std::string name)
         ",read-mb-second=", (stats.read_bytes_period / time) / MB,
         ",read-ops-second=", stats.read_ops_period / time,
         ",write-mb-second=", (stats.write_bytes_period / time) / MB,
-        ",write-ops-second=", stats.write_ops_period / time
+        ",write-ops-second=", stats.write_ops_period / time,
+        ",dedup-mb-total=", stats.dedup_bytes_logical / MB,
+        ",dedup-mb-stored=", stats.dedup_bytes_stored / MB,
+        ",queue-deferred-total=", stats.queue_deferred_total,
+        ",queue-wait-ms-total=", duration_cast<milliseconds>(stats.queue_wait_total).count(),
+        ",reconnects-total=", stats.reconnect_attempts_total,
+        ",reconnect-failures-total=", stats.reconnect_failures_total
     );
     kio_debug(stringstats);
     return stringstats;
   }
+  if (name == "sys.cachestats") {
+    auto partitions = kio().cache().partitionStatistics();
+    double MB = 1024 * 1024;
+    std::string stringstats;
+    for (auto it = partitions.cbegin(); it != partitions.cend(); it++) {
+      stringstats += utility::Convert::toString(
+          stringstats.empty() ? "" : ";",
+          "partition=", it->first,
+          ",size-mb=", it->second.size / MB,
+          ",min-mb=", it->second.min / MB,
+          ",max-mb=", it->second.max / MB,
+          ",hits=", it->second.hits,
+          ",misses=", it->second.misses
+      );
+    }
+    kio_debug(stringstats);
+    return stringstats;
+  }
   if (name == "sys.health") {
     auto h = cluster->stats().health;
     int redundancies = static_cast<int>(h.redundancy_factor) - h.drives_failed;
@@ -441,14 +1332,25 @@ std::string FileIo::attrGet(std::string name)
     return stringhealth;
   }
 
+  /* The checksum of a file being written sequentially is known, otherwise it is computed if not stored. */
+  if (name == checksum_attribute && created && checksum_sequential) {
+    return checksumToString(checksum);
+  }
+  if (name == checksum_attribute && opened) {
+    kio().cache().flush(this);
+  }
+
   std::shared_ptr<const string> value;
   std::shared_ptr<const string> version;
   auto status = cluster->get(
-      utility::makeAttributeKey(cluster->id(), path, name),
+      utility::makeAttributeKey(cluster->id(), storageBase(), name),
       version, value);
   if (status.ok()) {
     return *value;
   }
+  if (name == checksum_attribute && status.statusCode() == kinetic::StatusCode::REMOTE_NOT_FOUND) {
+    return checksumToString(computeChecksum());
+  }
 
   /* Requested attribute doesn't exist or there was connection problem. */
   if (status.statusCode() == kinetic::StatusCode::REMOTE_NOT_FOUND) {
@@ -464,7 +1366,7 @@ void FileIo::attrSet(std::string name, std::string value)
 {
   auto empty = std::make_shared<const string>();
   auto status = cluster->put(
-      utility::makeAttributeKey(cluster->id(), path, name),
+      utility::makeAttributeKey(cluster->id(), storageBase(), name),
       std::make_shared<const string>(value),
       empty
   );
@@ -478,7 +1380,7 @@ void FileIo::attrSet(std::string name, std::string value)
 void FileIo::attrDelete(std::string name)
 {
   auto empty = std::make_shared<const string>();
-  auto status = cluster->remove( utility::makeAttributeKey(cluster->id(), path, name) );
+  auto status = cluster->remove( utility::makeAttributeKey(cluster->id(), storageBase(), name) );
   if (!status.ok()) {
     kio_error("Failed getting attribute ", name, " due to: ", status);
     throw std::system_error(std::make_error_code(std::errc::io_error));
@@ -490,8 +1392,9 @@ std::vector<std::string> FileIo::attrList()
   std::unique_ptr<std::vector<string>> keys;
   std::vector<std::string> names;
 
-  auto start = utility::makeAttributeKey(cluster->id(), path, " ");
-  auto end = utility::makeAttributeKey(cluster->id(), path, "~");
+  auto& attribute_base = storageBase();
+  auto start = utility::makeAttributeKey(cluster->id(), attribute_base, " ");
+  auto end = utility::makeAttributeKey(cluster->id(), attribute_base, "~");
 
   do {
     auto status = cluster->range(start, end, keys);
@@ -500,7 +1403,7 @@ std::vector<std::string> FileIo::attrList()
       throw std::system_error(std::make_error_code(std::errc::io_error));
     }
     for (auto it = keys->cbegin(); it != keys->cend(); it++) {
-      names.push_back(utility::extractAttributeName(cluster->id(), path, *it));
+      names.push_back(utility::extractAttributeName(cluster->id(), attribute_base, *it));
     }
     if (keys->size()) {
       start = std::make_shared<const string>(keys->back());
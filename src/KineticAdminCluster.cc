@@ -15,9 +15,15 @@
 
 #include "KineticAdminCluster.hh"
 #include <Logging.hh>
+#include "KineticIoSingleton.hh"
+#include "ClusterMigration.hh"
 #include <algorithm>
 #include <zconf.h>
 #include <iomanip>
+#include <cstdlib>
+#include <cmath>
+#include <deque>
+#include <thread>
 
 using namespace kio;
 using namespace kinetic;
@@ -28,123 +34,239 @@ KineticAdminCluster::~KineticAdminCluster()
 }
 
 namespace {
-/* Functions intended to benchmark individual connections */
-int finish_timed_operation(
-    std::shared_ptr<kinetic::ThreadsafeNonblockingKineticConnection>& con,
-    std::chrono::system_clock::time_point& run_start,
-    std::shared_ptr<CallbackSynchronization>& sync,
-    std::shared_ptr<kio::KineticCallback> cb
+/* Range request for key sampling, where a partial result is of no use. */
+std::unique_ptr<std::vector<string>> rangeOrThrow(
+    ClusterInterface& cluster,
+    const std::shared_ptr<const string>& start_key,
+    const std::shared_ptr<const string>& end_key,
+    size_t max_elements
 )
 {
-  fd_set x;  int y;
-  con->Run(&x, &x, &y);
-  std::chrono::system_clock::time_point timeout_time = run_start + std::chrono::seconds(10);
-  sync->wait_until(timeout_time);
-  auto run_end = std::chrono::system_clock::now();
-
-  if (!cb->getResult().ok()) {
-    kio_debug(cb->getResult());
-    throw std::runtime_error("Failed timed operation.");
+  std::unique_ptr<std::vector<string>> keys;
+  auto status = cluster.range(start_key, end_key, keys, max_elements);
+  if (!status.ok()) {
+    kio_warning("range(", *start_key, " - ", *end_key, ") failed on cluster ", cluster.id(), ": ", status);
+    throw std::system_error(std::make_error_code(std::errc::io_error));
+  }
+  return keys;
+}
+
+/* The key counter responsible for the target, -1 if there is none. Has to match KineticCluster::key_counter_names. */
+int targetCounterIndex(AdminClusterInterface::OperationTarget target)
+{
+  switch (target) {
+    case AdminClusterInterface::OperationTarget::METADATA:
+      return 0;
+    case AdminClusterInterface::OperationTarget::DATA:
+      return 1;
+    case AdminClusterInterface::OperationTarget::ATTRIBUTE:
+      return 2;
+    default:
+      return -1;
   }
-  return (int) std::chrono::duration_cast<std::chrono::milliseconds>(run_end - run_start).count();
-};
+}
 
-int timed_put(
-    std::shared_ptr<kinetic::ThreadsafeNonblockingKineticConnection>& con,
-    std::string key
+/* Functions intended to benchmark individual connections */
+typedef std::shared_ptr<kinetic::ThreadsafeNonblockingKineticConnection> connection_t;
+typedef std::function<std::shared_ptr<kio::KineticCallback>(
+    const std::string&, std::shared_ptr<CallbackSynchronization>)> issue_t;
+
+std::shared_ptr<kio::KineticCallback> issue_put(
+    connection_t con,
+    std::shared_ptr<const KineticRecord> record,
+    const std::string& key,
+    std::shared_ptr<CallbackSynchronization> sync
 )
 {
-  auto sync = std::make_shared<CallbackSynchronization>();
   auto cb = std::make_shared<kio::PutCallback>(sync);
-  std::string value(1024*1024, 'x');
-  auto record = std::make_shared<KineticRecord>(
-      value, "", "", com::seagate::kinetic::client::proto::Command_Algorithm_INVALID_ALGORITHM
-  );
-
-  auto run_start = std::chrono::system_clock::now();
   con->Put(key, "", WriteMode::IGNORE_VERSION, record, cb);
-  return finish_timed_operation(con,run_start,sync,cb);
+  return cb;
 }
 
-int timed_remove(
-    std::shared_ptr<kinetic::ThreadsafeNonblockingKineticConnection>& con,
-    std::string key
+std::shared_ptr<kio::KineticCallback> issue_get(
+    connection_t con,
+    const std::string& key,
+    std::shared_ptr<CallbackSynchronization> sync
 )
 {
-  auto sync = std::make_shared<CallbackSynchronization>();
-  auto cb = std::make_shared<kio::BasicCallback>(sync);
+  auto cb = std::make_shared<kio::GetCallback>(sync);
+  con->Get(key, cb);
+  return cb;
+}
 
-  auto run_start = std::chrono::system_clock::now();
+std::shared_ptr<kio::KineticCallback> issue_remove(
+    connection_t con,
+    const std::string& key,
+    std::shared_ptr<CallbackSynchronization> sync
+)
+{
+  auto cb = std::make_shared<kio::BasicCallback>(sync);
   con->Delete(key, "", WriteMode::IGNORE_VERSION, cb);
-  return finish_timed_operation(con,run_start,sync,cb);
+  return cb;
 }
 
-int timed_get(
-    std::shared_ptr<kinetic::ThreadsafeNonblockingKineticConnection>& con,
-    std::string key
+/* Issue a request for every key, keeping up to queue_depth requests outstanding. Requests are expected to complete
+ * in order, the latency of a request that completes before its predecessors is measured when its predecessors have
+ * completed. */
+std::vector<double> timed_requests(
+    connection_t& con,
+    const std::vector<std::string>& keys,
+    size_t queue_depth,
+    issue_t issue,
+    double& seconds
 )
 {
-  auto sync = std::make_shared<CallbackSynchronization>();
-  auto cb = std::make_shared<kio::GetCallback>(sync);
+  struct Request {
+    std::shared_ptr<CallbackSynchronization> sync;
+    std::shared_ptr<kio::KineticCallback> cb;
+    std::chrono::system_clock::time_point start;
+  };
+  std::deque<Request> outstanding;
+  std::vector<double> latencies;
+
   auto run_start = std::chrono::system_clock::now();
-  con->Get(key,cb);
-  return finish_timed_operation(con,run_start,sync,cb);
+  auto key = keys.cbegin();
+  while (key != keys.cend() || !outstanding.empty()) {
+    if (key != keys.cend() && outstanding.size() < queue_depth) {
+      while (key != keys.cend() && outstanding.size() < queue_depth) {
+        Request r;
+        r.sync = std::make_shared<CallbackSynchronization>();
+        r.start = std::chrono::system_clock::now();
+        r.cb = issue(*key++, r.sync);
+        outstanding.push_back(r);
+      }
+      fd_set x;  int y;
+      con->Run(&x, &x, &y);
+    }
+
+    auto& r = outstanding.front();
+    r.sync->wait_until(r.start + std::chrono::seconds(10));
+    if (!r.cb->finished() || !r.cb->getResult().ok()) {
+      kio_debug(r.cb->getResult());
+      throw std::runtime_error("Failed timed operation.");
+    }
+    latencies.push_back(std::chrono::duration_cast<std::chrono::microseconds>(
+        std::chrono::system_clock::now() - r.start).count() / 1000.0);
+    outstanding.pop_front();
+  }
+  seconds = std::chrono::duration_cast<std::chrono::microseconds>(
+      std::chrono::system_clock::now() - run_start).count() / 1000000.0;
+  return latencies;
 }
 
-float benchmark_function(
-    std::vector<std::string> keys,
-    std::shared_ptr<kinetic::ThreadsafeNonblockingKineticConnection>& connection,
-    std::function<int(std::shared_ptr<kinetic::ThreadsafeNonblockingKineticConnection>&, std::string)> fun)
+double percentile(std::vector<double> values, double p)
 {
-  int timing = 1;
-  for (auto key = keys.begin(); key != keys.end(); key++){
-    timing += fun(connection, *key);
+  if (values.empty()) {
+    return 0;
   }
-  return keys.size() / (timing / 1000.0);
+  std::sort(values.begin(), values.end());
+  return values[std::min(values.size() - 1, static_cast<size_t>(p * values.size()))];
 }
 
+void benchmark_connection(
+    KineticAutoConnection* con,
+    int num_keys,
+    int queue_depth,
+    int value_size,
+    DriveBenchmark* result,
+    char* connected
+)
+{
+  try {
+    auto async_con = con->get();
+    *connected = true;
+
+    if (num_keys) {
+      std::vector<std::string> keys;
+      for (int i = 0; i < num_keys; i++) {
+        std::stringstream ss;
+        ss << std::setw(10) << std::setfill('0') << i;
+        keys.push_back("benchmark_key_" + ss.str());
+      }
+      auto record = std::make_shared<const KineticRecord>(
+          std::string(value_size, 'x'), "", "", com::seagate::kinetic::client::proto::Command_Algorithm_INVALID_ALGORITHM
+      );
+      auto qd = static_cast<size_t>(std::max(queue_depth, 1));
+      double put_seconds, get_seconds, remove_seconds;
+
+      auto put = timed_requests(async_con, keys, qd, std::bind(issue_put, async_con, record, std::placeholders::_1,
+                                                               std::placeholders::_2), put_seconds);
+      std::random_shuffle(keys.begin(), keys.end());
+      auto get = timed_requests(async_con, keys, qd, std::bind(issue_get, async_con, std::placeholders::_1,
+                                                               std::placeholders::_2), get_seconds);
+      timed_requests(async_con, keys, qd, std::bind(issue_remove, async_con, std::placeholders::_1,
+                                                    std::placeholders::_2), remove_seconds);
+
+      double megabytes = static_cast<double>(num_keys) * value_size / (1024 * 1024);
+      result->put_iops = num_keys / put_seconds;
+      result->put_mbps = megabytes / put_seconds;
+      result->put_latency_p50 = percentile(put, 0.5);
+      result->put_latency_p99 = percentile(put, 0.99);
+      result->get_iops = num_keys / get_seconds;
+      result->get_mbps = megabytes / get_seconds;
+      result->get_latency_p50 = percentile(get, 0.5);
+      result->get_latency_p99 = percentile(get, 0.99);
+    }
+  } catch (std::exception& e) {
+    kio_debug(e.what());
+    *connected = false;
+    *result = DriveBenchmark();
+  }
 }
 
-ClusterStatus KineticAdminCluster::status(int num_bench_keys)
+}
+
+ClusterStatus KineticAdminCluster::status(int num_bench_keys, int bench_queue_depth, int bench_value_size)
 {
-  /* Set individual connection info */
-  std::vector<std::string> location;
-  std::vector<bool> connected;
+  /* Check (and benchmark) all connections concurrently */
+  std::vector<char> connected(connections.size(), false);
+  std::vector<DriveBenchmark> benchmark(connections.size(), DriveBenchmark());
+  {
+    std::vector<std::thread> threads;
+    for (size_t i = 0; i < connections.size(); i++) {
+      threads.push_back(std::thread(benchmark_connection, connections[i].get(), num_bench_keys, bench_queue_depth,
+                                    bench_value_size, &benchmark[i], &connected[i]));
+    }
+    for (auto it = threads.begin(); it != threads.end(); it++) {
+      it->join();
+    }
+  }
 
+  std::vector<std::string> location;
   for (auto it = connections.cbegin(); it != connections.cend(); it++) {
-    auto& con = *it;
-    location.push_back(con->getName());
-    try {
-      auto async_con = con->get();
-
-      if(num_bench_keys) {
-        /* create benchmark keys */
-        std::vector<std::string> keys;
-        for (int i = 0; i < num_bench_keys; i++) {
-          std::stringstream ss;
-          ss << std::setw(10) << std::setfill('0') << i;
-          keys.push_back("benchmark_key_" + ss.str());
-        }
-        auto seq_put = benchmark_function(keys, async_con, timed_put);
-        auto seq_get = benchmark_function(keys, async_con, timed_get);
-        benchmark_function(keys, async_con, timed_remove);
-
-        std::random_shuffle(keys.begin(), keys.end());
-        auto rnd_put = benchmark_function(keys, async_con, timed_put);
-        std::random_shuffle(keys.begin(), keys.end());
-        auto rnd_get = benchmark_function(keys, async_con, timed_get);
-        std::random_shuffle(keys.begin(), keys.end());
-        benchmark_function(keys, async_con, timed_remove);
-
-        location.back() += utility::Convert::toString(
-            std::fixed, std::setprecision(1),
-            " :: MB/s seq_put=", seq_put, " seq_get=", seq_get, " rnd_put=", rnd_put, " rnd_get=", rnd_get
-        );
+    location.push_back((*it)->getName());
+  }
+
+  if (num_bench_keys) {
+    /* Flag drives deviating from the cluster median */
+    std::vector<double> put_mbps, get_mbps, put_p99, get_p99;
+    for (size_t i = 0; i < benchmark.size(); i++) {
+      if (connected[i]) {
+        put_mbps.push_back(benchmark[i].put_mbps);
+        get_mbps.push_back(benchmark[i].get_mbps);
+        put_p99.push_back(benchmark[i].put_latency_p99);
+        get_p99.push_back(benchmark[i].get_latency_p99);
+      }
+    }
+    auto median_put_mbps = percentile(put_mbps, 0.5);
+    auto median_get_mbps = percentile(get_mbps, 0.5);
+    auto median_put_p99 = percentile(put_p99, 0.5);
+    auto median_get_p99 = percentile(get_p99, 0.5);
+
+    for (size_t i = 0; i < benchmark.size(); i++) {
+      if (!connected[i]) {
+        continue;
       }
-      connected.push_back(true);
-    } catch (std::exception& e) {
-      kio_debug(e.what());
-      connected.push_back(false);
+      auto& b = benchmark[i];
+      b.outlier = b.put_mbps < median_put_mbps / 2 || b.get_mbps < median_get_mbps / 2 ||
+                  b.put_latency_p99 > median_put_p99 * 2 || b.get_latency_p99 > median_get_p99 * 2;
+
+      location[i] += utility::Convert::toString(
+          std::fixed, std::setprecision(1),
+          " :: put ", b.put_iops, " IOPS ", b.put_mbps, " MB/s p50=", b.put_latency_p50, "ms p99=", b.put_latency_p99,
+          "ms :: get ", b.get_iops, " IOPS ", b.get_mbps, " MB/s p50=", b.get_latency_p50, "ms p99=", b.get_latency_p99,
+          "ms", b.outlier ? " :: OUTLIER" : ""
+      );
     }
   }
 
@@ -153,8 +275,11 @@ ClusterStatus KineticAdminCluster::status(int num_bench_keys)
   }
 
   auto clusterStatus = stats().health;
-  clusterStatus.connected = connected;
+  clusterStatus.connected = std::vector<bool>(connected.begin(), connected.end());
   clusterStatus.location = location;
+  if (num_bench_keys) {
+    clusterStatus.benchmark = benchmark;
+  }
   return clusterStatus;
 }
 
@@ -225,12 +350,12 @@ void KineticAdminCluster::repairKey(const std::shared_ptr<const string>& key, Ke
   auto getStatus = getOperation.execute(operation_timeout);
     
   if(getStatus.ok()) { 
-    auto value = getOperation.getValue(); 
-    auto version = getOperation.getVersion();
-    auto stripe = this->valueToStripe(*value);
-    
-    StripeOperation_PUT putOperation(key, version, version, stripe, kinetic::WriteMode::REQUIRE_SAME_VERSION, connections, redundancy);
-    if(!putOperation.quick_repair(operation_timeout, getOperation)) {
+    /* Only write the chunks that are missing, stale or corrupt, they have been reconstructed by the get. */
+    StripeOperation_REPAIR repairOperation(key, getOperation, connections, redundancy);
+    kio_debug("Repairing ", repairOperation.size(), " of ", redundancy->size(), " chunks of key ", *key);
+    if(!repairOperation.execute(operation_timeout).ok()) {
+        auto value = getOperation.getValue();
+        auto version = getOperation.getVersion();
         auto putstatus = this->put(key, version, value, version);
         if (!putstatus.ok()) {
           kio_warning("Failed put operation on target-key \"", *key, "\" ", putstatus);
@@ -255,6 +380,110 @@ void KineticAdminCluster::repairKey(const std::shared_ptr<const string>& key, Ke
   };
 }
 
+int KineticAdminCluster::countContentReferences(const std::string& fingerprint, bool remove_stale)
+{
+  auto path = contentPath(fingerprint);
+  auto prefix = utility::makeAttributeKey(id(), path, content_reference_prefix);
+  auto start_key = prefix;
+  auto end_key = utility::makeAttributeKey(id(), path, content_reference_prefix + "~");
+  int references = 0;
+
+  std::unique_ptr<std::vector<string>> keys;
+  do {
+    auto status = range(start_key, end_key, keys);
+    if (!status.ok()) {
+      kio_warning("Failed listing references of content ", fingerprint, ": ", status);
+      throw std::system_error(std::make_error_code(std::errc::io_error));
+    }
+    if (!keys || keys->empty()) {
+      break;
+    }
+    start_key = std::make_shared<const string>(keys->back() + static_cast<char>(0));
+
+    for (auto it = keys->cbegin(); it != keys->cend(); it++) {
+      if (!remove_stale) {
+        references++;
+        continue;
+      }
+      auto ref_key = std::make_shared<const string>(*it);
+      std::shared_ptr<const string> ref_version;
+      std::shared_ptr<const string> ref_value;
+      auto status = do_get(ref_key, ref_version, ref_value, false);
+      if (status.statusCode() == StatusCode::REMOTE_NOT_FOUND) {
+        continue;
+      }
+
+      /* Read the data key as stored, without resolving the content it references. */
+      auto data_key = std::make_shared<const string>(it->substr(prefix->size()));
+      std::shared_ptr<const string> data_version;
+      std::shared_ptr<const string> data_value;
+      auto data_status = status.ok() ? do_get(data_key, data_version, data_value, false) : status;
+      if (!data_status.ok() && data_status.statusCode() != StatusCode::REMOTE_NOT_FOUND) {
+        kio_warning("Failed validating reference ", *ref_key, ": ", data_status);
+        throw std::system_error(std::make_error_code(std::errc::io_error));
+      }
+
+      string referenced;
+      size_t size;
+      if (data_status.ok() && parseContentReference(*data_value, data_version, referenced, size) &&
+          referenced == fingerprint) {
+        references++;
+        continue;
+      }
+
+      /* The data key might not have been written yet by a client that just stored the reference. */
+      using namespace std::chrono;
+      auto written = system_clock::time_point(milliseconds(std::strtoll(ref_value->c_str(), NULL, 10)));
+      if (system_clock::now() - written < content_reference_grace) {
+        references++;
+        continue;
+      }
+      kio_debug("Removing stale reference ", *ref_key);
+      remove(ref_key, ref_version);
+    }
+  } while (keys->size());
+  return references;
+}
+
+void KineticAdminCluster::collectContent(const std::shared_ptr<const string>& key, KeyCountsInternal& key_counts)
+{
+  /* Content keys are made with block number 0, strip the data key prefix and the block number suffix. */
+  auto prefix = utility::makeDataKey(id(), content_path_prefix, 0);
+  auto suffix_length = prefix->size() - prefix->find_last_of('_');
+  auto fingerprint = key->substr(prefix->size() - suffix_length, key->size() - prefix->size());
+
+  if (countContentReferences(fingerprint, true)) {
+    return;
+  }
+  key_counts.need_action++;
+
+  std::shared_ptr<const string> version;
+  std::shared_ptr<const string> value;
+  auto status = do_get(key, version, value, false);
+  if (!status.ok()) {
+    kio_warning("Failed reading unreferenced content key \"", *key, "\" ", status);
+    throw std::system_error(std::make_error_code(std::errc::io_error));
+  }
+  status = remove(key, version);
+  if (!status.ok()) {
+    kio_warning("Failed removing unreferenced content key \"", *key, "\" ", status);
+    throw std::system_error(std::make_error_code(std::errc::io_error));
+  }
+
+  /* A client might have referenced the content concurrently after finding it existing. */
+  if (countContentReferences(fingerprint, false)) {
+    kio_notice("Content ", fingerprint, " has been referenced during garbage collection, restoring it.");
+    std::shared_ptr<const string> version_out;
+    status = do_put(key, std::make_shared<const string>(), value, version_out, WriteMode::REQUIRE_SAME_VERSION);
+    if (!status.ok() && status.statusCode() != StatusCode::REMOTE_VERSION_MISMATCH) {
+      kio_error("Failed restoring content key \"", *key, "\" ", status);
+      throw std::system_error(std::make_error_code(std::errc::io_error));
+    }
+    return;
+  }
+  key_counts.removed++;
+}
+
 void KineticAdminCluster::applyOperation(
     Operation operation, OperationTarget target, KeyCountsInternal& key_counts,
     std::vector<std::shared_ptr<const string>> keys
@@ -280,6 +509,10 @@ void KineticAdminCluster::applyOperation(
           }
           break;
         }
+        case Operation::COLLECT: {
+          collectContent(key, key_counts);
+          break;
+        }
         case Operation::RESET: {
           if (target == OperationTarget::INDICATOR) {
             if (!removeIndicatorKey(key)) {
@@ -340,14 +573,21 @@ kio::AdminClusterInterface::KeyCounts KineticAdminCluster::doOperation(
     Operation o,
     OperationTarget t,
     callback_t callback,
-    int numthreads
+    int numthreads,
+    bool* complete
 )
 {
   KeyCountsInternal key_counts;
 
   std::shared_ptr<const string> start_key;
   std::shared_ptr<const string> end_key;
-  initRangeKeys(t, start_key, end_key);
+  if (o == Operation::COLLECT) {
+    start_key = utility::makeDataKey(id(), content_path_prefix, 0);
+    end_key = utility::makeDataKey(id(), content_path_prefix + "~", 0);
+  }
+  else {
+    initRangeKeys(t, start_key, end_key);
+  }
 
   {
     BackgroundOperationHandler bg(numthreads, numthreads);
@@ -375,6 +615,10 @@ kio::AdminClusterInterface::KeyCounts KineticAdminCluster::doOperation(
         break;
       }
     } while (keys && keys->size());
+
+    if (complete) {
+      *complete = keys && keys->empty();
+    }
   }
 
   return KeyCounts{key_counts.total, key_counts.incomplete, key_counts.need_action,
@@ -384,7 +628,137 @@ kio::AdminClusterInterface::KeyCounts KineticAdminCluster::doOperation(
 
 int KineticAdminCluster::count(OperationTarget target, callback_t callback)
 {
-  return doOperation(Operation::COUNT, target, std::move(callback), 0).total;
+  bool complete = false;
+  auto total = doOperation(Operation::COUNT, target, std::move(callback), 0, &complete).total;
+
+  /* A complete count (re-)initializes the key counter. */
+  auto index = targetCounterIndex(target);
+  if (keyCounters && complete && index >= 0) {
+    std::shared_ptr<const string> version;
+    auto status = put(keyCounterKey(index), std::make_shared<const string>(utility::Convert::toString(total, " ", 0)),
+                      version);
+    if (status.ok()) {
+      key_counter_deltas[index] = 0;
+      key_counter_uncertain[index] = 0;
+    }
+    else {
+      kio_warning("Failed initializing key counter ", *keyCounterKey(index), ": ", status);
+    }
+  }
+  return total;
+}
+
+kio::AdminClusterInterface::CountEstimate KineticAdminCluster::estimateCount(OperationTarget target, int num_samples)
+{
+  auto index = targetCounterIndex(target);
+  if (keyCounters && index >= 0) {
+    flushKeyCounters(dmutex);
+    std::shared_ptr<const string> version;
+    std::shared_ptr<const string> value;
+    if (get(keyCounterKey(index), version, value).ok()) {
+      /* Half of the uncertain puts are assumed to have created a key. There is no bound for the deltas other
+       * clients have not flushed yet or lost by terminating before flushing them. */
+      int count;
+      int uncertain;
+      parseKeyCounter(*value, count, uncertain);
+      return CountEstimate{count + (uncertain + 1) / 2, -1};
+    }
+    kio_notice("Key counter ", *keyCounterKey(index), " has not been initialized, sampling key space instead.");
+  }
+
+  std::shared_ptr<const string> start_key;
+  std::shared_ptr<const string> end_key;
+  initRangeKeys(target, start_key, end_key);
+
+  /* Small key sets are counted exactly. */
+  auto keys = rangeOrThrow(*this, start_key, end_key, 0);
+  if (keys->size() < limits().max_range_elements) {
+    return CountEstimate{static_cast<int>(keys->size()), 0};
+  }
+
+  std::random_device rd;
+  std::mt19937 random(rd());
+  num_samples = std::max(num_samples, 2);
+
+  std::vector<double> samples;
+  double sum = 0;
+  for (int i = 0; i < num_samples; i++) {
+    samples.push_back(sampleKeyCount(start_key, end_key, random));
+    sum += samples.back();
+  }
+  double mean = sum / num_samples;
+  double variance = 0;
+  for (auto it = samples.cbegin(); it != samples.cend(); it++) {
+    variance += (*it - mean) * (*it - mean);
+  }
+  variance /= num_samples - 1;
+
+  /* 95% confidence interval of the mean, assuming it to be normally distributed. */
+  double error = 1.96 * std::sqrt(variance / num_samples);
+  return CountEstimate{static_cast<int>(mean + 0.5), static_cast<int>(std::ceil(error))};
+}
+
+double KineticAdminCluster::sampleKeyCount(
+    std::shared_ptr<const string> start_key,
+    std::shared_ptr<const string> end_key,
+    std::mt19937& random
+)
+{
+  double multiplier = 1;
+  while (true) {
+    auto keys = rangeOrThrow(*this, start_key, end_key, 0);
+    if (keys->size() < limits().max_range_elements) {
+      return multiplier * keys->size();
+    }
+
+    /* All keys in the range share the common prefix of the first and last key. */
+    const auto& first = keys->front();
+    const auto last = rangeOrThrow(*this, end_key, start_key, 1)->front();
+    size_t depth = 0;
+    while (depth < first.size() && depth < last.size() && first[depth] == last[depth]) {
+      depth++;
+    }
+    auto prefix = first.substr(0, depth);
+
+    /* The prefix itself might be a key, otherwise there have to be at least two distinct next characters. Find
+     * the ones not contained in the listed keys by skipping to the next character. */
+    bool terminal = first.size() == depth;
+    std::vector<unsigned char> children;
+    for (auto it = keys->cbegin(); it != keys->cend(); it++) {
+      if (it->size() > depth && (children.empty() || children.back() != static_cast<unsigned char>((*it)[depth]))) {
+        children.push_back(static_cast<unsigned char>((*it)[depth]));
+      }
+    }
+    while (children.back() < static_cast<unsigned char>(last[depth])) {
+      auto skip = std::make_shared<const string>(prefix + static_cast<char>(children.back() + 1));
+      auto next = rangeOrThrow(*this, skip, end_key, 1);
+      if (next->empty()) {
+        break;
+      }
+      children.push_back(static_cast<unsigned char>(next->front()[depth]));
+    }
+
+    size_t choices = children.size() + (terminal ? 1 : 0);
+    size_t choice = random() % choices;
+    multiplier *= choices;
+    if (terminal) {
+      if (!choice) {
+        return multiplier;
+      }
+      choice--;
+    }
+
+    /* Restrict the range to keys starting with the chosen character. */
+    auto child = prefix + static_cast<char>(children[choice]);
+    auto child_end = child + string(limits().max_key_size > child.size() ? limits().max_key_size - child.size() : 0,
+                                    static_cast<char>(0xff));
+    if (child > *start_key) {
+      start_key = std::make_shared<const string>(child);
+    }
+    if (child_end < *end_key) {
+      end_key = std::make_shared<const string>(std::move(child_end));
+    }
+  }
 }
 
 kio::AdminClusterInterface::KeyCounts KineticAdminCluster::scan(OperationTarget target,
@@ -403,4 +777,9 @@ kio::AdminClusterInterface::KeyCounts KineticAdminCluster::reset(OperationTarget
                                                                  callback_t callback, int numThreads)
 {
   return doOperation(Operation::RESET, target, std::move(callback), numThreads);
+}
+
+kio::AdminClusterInterface::KeyCounts KineticAdminCluster::collectGarbage(callback_t callback, int numThreads)
+{
+  return doOperation(Operation::COLLECT, OperationTarget::DATA, std::move(callback), numThreads);
 }
\ No newline at end of file
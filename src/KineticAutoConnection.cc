@@ -15,18 +15,26 @@
 
 #include "KineticAutoConnection.hh"
 #include "KineticIoSingleton.hh"
+#include "KineticCallbacks.hh"
+#include <algorithm>
 #include <sstream>
 #include <Logging.hh>
+#include <Tracepoints.hh>
 
 using namespace kinetic;
 using namespace kio;
 
 KineticAutoConnection::KineticAutoConnection(
     SocketListener& sw,
+    ReconnectScheduler& rs,
     std::pair<kinetic::ConnectionOptions, kinetic::ConnectionOptions> o,
-    std::chrono::seconds r) :
-    options(o), ratelimit(r), connection(), healthy(false), fd(0), timestamp(std::chrono::system_clock::now()),
-    mutex(), sockwatch(sw), mt(), bg(1, 0)
+    std::chrono::seconds r,
+    std::size_t max_queue_depth,
+    std::chrono::milliseconds target_latency) :
+    options(o), ratelimit(r), connection(), healthy(false), fd(0), reconnect_attempts(0), reconnect_failures(0),
+    mutex(), sockwatch(sw), scheduler(rs), mt(), max_queue_depth(max_queue_depth), target_latency(target_latency),
+    queue_limit(static_cast<double>(max_queue_depth)), queue_outstanding(0), queue_deferred(0), queue_wait(0),
+    queue_decreased(), queue_waiters(), queue_mutex("KineticAutoConnection::queue_mutex")
 {
   std::random_device rd;
   mt.seed(rd());
@@ -37,6 +45,8 @@ KineticAutoConnection::KineticAutoConnection(
 
 KineticAutoConnection::~KineticAutoConnection()
 {
+  /* Waits for a reconnection attempt in progress. */
+  scheduler.cancel(this);
   if (fd) {
     sockwatch.unsubscribe(fd);
   }
@@ -47,6 +57,103 @@ const std::string& KineticAutoConnection::getName() const
   return logstring;
 }
 
+bool KineticAutoConnection::acquireSlot(KineticCallback* waiter)
+{
+  std::lock_guard<ProfiledMutex> lock(queue_mutex);
+  if (!max_queue_depth) {
+    queue_outstanding++;
+    return true;
+  }
+
+  /* Requests may not overtake requests that are already waiting for a slot. */
+  bool first = queue_waiters.empty() || (waiter && queue_waiters.front() == waiter);
+  if (!first || queue_outstanding >= static_cast<std::size_t>(queue_limit)) {
+    if (waiter && std::find(queue_waiters.begin(), queue_waiters.end(), waiter) == queue_waiters.end()) {
+      queue_waiters.push_back(waiter);
+    }
+    return false;
+  }
+  if (!queue_waiters.empty()) {
+    queue_waiters.pop_front();
+  }
+  queue_outstanding++;
+
+  /* Multiple slots may have become available at once. */
+  notifyWaiter();
+  return true;
+}
+
+void KineticAutoConnection::cancelSlot(KineticCallback* waiter)
+{
+  std::lock_guard<ProfiledMutex> lock(queue_mutex);
+  auto it = std::find(queue_waiters.begin(), queue_waiters.end(), waiter);
+  if (it != queue_waiters.end()) {
+    queue_waiters.erase(it);
+    notifyWaiter();
+  }
+}
+
+void KineticAutoConnection::notifyWaiter()
+{
+  if (!queue_waiters.empty() && queue_outstanding < static_cast<std::size_t>(queue_limit)) {
+    queue_waiters.front()->notifySlot();
+  }
+}
+
+void KineticAutoConnection::releaseSlot(std::chrono::microseconds latency, bool congested)
+{
+  std::lock_guard<ProfiledMutex> lock(queue_mutex);
+  if (queue_outstanding) {
+    queue_outstanding--;
+  }
+  if (!max_queue_depth) {
+    return;
+  }
+
+  if (congested || (target_latency.count() && latency > target_latency)) {
+    /* Multiplicative decrease, at most once per request latency so that a burst of slow requests issued at the
+     * same time only counts once. */
+    auto now = std::chrono::system_clock::now();
+    if (now - queue_decreased > latency) {
+      queue_limit = std::max(1.0, queue_limit / 2);
+      queue_decreased = now;
+      kio_debug("Reduced queue depth of ", logstring, " to ", static_cast<std::size_t>(queue_limit));
+    }
+  }
+  else {
+    /* Additive increase, by one slot for every limit's worth of requests completing in time. */
+    queue_limit = std::min(static_cast<double>(max_queue_depth), queue_limit + 1 / queue_limit);
+  }
+  notifyWaiter();
+}
+
+void KineticAutoConnection::recordQueueWait(std::chrono::microseconds wait)
+{
+  std::lock_guard<ProfiledMutex> lock(queue_mutex);
+  queue_deferred++;
+  queue_wait += wait;
+}
+
+KineticAutoConnection::QueueStats KineticAutoConnection::queueStats()
+{
+  std::lock_guard<ProfiledMutex> lock(queue_mutex);
+  QueueStats stats;
+  stats.limit = static_cast<std::size_t>(queue_limit);
+  stats.outstanding = queue_outstanding;
+  stats.deferred = queue_deferred;
+  stats.wait = queue_wait;
+  return stats;
+}
+
+KineticAutoConnection::ReconnectStats KineticAutoConnection::reconnectStats()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  ReconnectStats stats;
+  stats.attempts = reconnect_attempts;
+  stats.failures = reconnect_failures;
+  return stats;
+}
+
 void KineticAutoConnection::setError(
     std::shared_ptr<kinetic::ThreadsafeNonblockingKineticConnection>& errorConnection)
 {
@@ -66,35 +173,31 @@ void KineticAutoConnection::setError(
     fd = 0;
   }
   kio_notice("Setting connection ", getName(), " into error state.");
+  KIO_TRACE2(connection_state, logstring.c_str(), 0);
   healthy = false;
 }
 
 std::shared_ptr<kinetic::ThreadsafeNonblockingKineticConnection> KineticAutoConnection::get()
 {
-  std::call_once(intial_connect, &KineticAutoConnection::connect, this);
+  std::call_once(intial_connect, &KineticAutoConnection::initialConnect, this);
 
-  std::lock_guard<std::mutex> lock(mutex);
-  if (healthy) {
-    return connection;
-  }
-
-  /* Rate limit re-connection attempts. */
-  using namespace std::chrono;
-  auto duration = duration_cast<seconds>(std::chrono::system_clock::now() - timestamp);
-  if (duration > ratelimit) {
-    if (bg.try_run(std::bind(&KineticAutoConnection::connect, this))) {
-      timestamp = std::chrono::system_clock::now();
-      kio_debug(logstring, " Scheduled background reconnect. Last reconnect attempt has been scheduled ",
-                duration, " ago. ratelimit is ", ratelimit);
-    }
-    else {
-      kio_notice(logstring, " Failed scheduling background reconnect despite last having been scheduled ",
-                 duration, " ago. ratelimit is ", ratelimit);
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    if (healthy) {
+      return connection;
     }
   }
+
+  /* Rate limiting and backoff of re-connection attempts is up to the scheduler. */
+  scheduler.request(this, ratelimit);
   throw std::system_error(std::make_error_code(std::errc::not_connected));
 }
 
+void KineticAutoConnection::initialConnect()
+{
+  scheduler.attempted(this, ratelimit, connect());
+}
+
 namespace {
   class ConnectCallback : public kinetic::SimpleCallbackInterface {
   public:
@@ -122,7 +225,7 @@ namespace {
   };
 }
 
-void KineticAutoConnection::connect()
+bool KineticAutoConnection::connect()
 {
   kio_debug("Starting connection attempt", logstring);
 
@@ -167,19 +270,24 @@ void KineticAutoConnection::connect()
     kio_debug("Factory did not return a connection. ", logstring);
   }
 
+  bool success = tmpfd != 0;
   {
     std::lock_guard<std::mutex> lock(mutex);
-    if (tmpfd) {
+    reconnect_attempts++;
+    if (success) {
       tmpfd--;
       sockwatch.subscribe(tmpfd, this);
       fd = tmpfd;
       connection = std::move(tmpcon);
       healthy = true;
-      timestamp = std::chrono::system_clock::now();
       kio_debug("Connection attempt succeeded ", logstring);
+      KIO_TRACE2(connection_state, logstring.c_str(), 1);
     }
     else {
+      reconnect_failures++;
       kio_debug("Connection attempt failed ", logstring);
+      KIO_TRACE2(connection_state, logstring.c_str(), 2);
     }
   }
+  return success;
 }
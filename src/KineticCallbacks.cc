@@ -14,12 +14,15 @@
  ************************************************************************/
 
 #include <KineticCallbacks.hh>
+#include <Tracepoints.hh>
+#include "KineticAutoConnection.hh"
 
 using namespace kio;
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
-CallbackSynchronization::CallbackSynchronization() : outstanding(0), cv(), mutex()
+CallbackSynchronization::CallbackSynchronization() :
+    outstanding(0), slot_available(false), cv(), mutex("CallbackSynchronization::mutex")
 { }
 
 CallbackSynchronization::~CallbackSynchronization()
@@ -27,56 +30,100 @@ CallbackSynchronization::~CallbackSynchronization()
 
 void CallbackSynchronization::wait_until(std::chrono::system_clock::time_point timeout_time)
 {
-  std::unique_lock<std::mutex> lck(mutex);
+  std::unique_lock<ProfiledMutex> lck(mutex);
   while (outstanding && std::chrono::system_clock::now() < timeout_time) {
     cv.wait_until(lck, timeout_time);
   }
 }
 
+void CallbackSynchronization::wait_for_slot(std::chrono::system_clock::time_point timeout_time)
+{
+  std::unique_lock<ProfiledMutex> lck(mutex);
+  while (!slot_available && std::chrono::system_clock::now() < timeout_time) {
+    cv.wait_until(lck, timeout_time);
+  }
+  slot_available = false;
+}
+
 
 ////////////////////////////////////////////////////////////////////////////////////////////////////////////////////
 
 KineticCallback::KineticCallback(std::shared_ptr<CallbackSynchronization> s) :
     status(kinetic::KineticStatus(kinetic::StatusCode::CLIENT_INTERNAL_ERROR, "no result")),
     sync(std::move(s)),
-    done(false)
+    done(false),
+    slot(NULL)
 {
+  /* Callbacks may be created while operations of the same synchronization object are in flight. */
+  std::lock_guard<ProfiledMutex> lock(sync->mutex);
   sync->outstanding++;
 }
 
 KineticCallback::~KineticCallback()
-{ }
+{
+  /* Never leak a submission slot, even if the result did not arrive. */
+  if (slot) {
+    slot->releaseSlot(std::chrono::microseconds(0), true);
+  }
+}
 
 void KineticCallback::OnResult(kinetic::KineticStatus result)
 {
-  std::unique_lock<std::mutex> lock(sync->mutex);
-  if (done) {
-    return;
+  KineticAutoConnection* connection = NULL;
+  {
+    std::unique_lock<ProfiledMutex> lock(sync->mutex);
+    if (done) {
+      return;
+    }
+
+    KIO_TRACE2(drive_op_complete, this, static_cast<int>(result.statusCode()));
+    status = result;
+    done = true;
+    sync->outstanding--;
+    if (!sync->outstanding) {
+      sync->cv.notify_one();
+    }
+    std::swap(connection, slot);
   }
 
-  status = result;
-  done = true;
-  sync->outstanding--;
-  if (!sync->outstanding) {
-    sync->cv.notify_one();
+  /* Return the submission slot, failed requests (including timeouts) indicate congestion. */
+  if (connection) {
+    connection->releaseSlot(
+        std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::system_clock::now() - issued),
+        result.statusCode() == kinetic::StatusCode::CLIENT_IO_ERROR
+    );
   }
 }
 
+void KineticCallback::setIssued(KineticAutoConnection* connection)
+{
+  std::lock_guard<ProfiledMutex> lock(sync->mutex);
+  slot = connection;
+  issued = std::chrono::system_clock::now();
+}
+
+void KineticCallback::notifySlot()
+{
+  std::lock_guard<ProfiledMutex> lock(sync->mutex);
+  sync->slot_available = true;
+  sync->cv.notify_one();
+}
+
 kinetic::KineticStatus& KineticCallback::getResult()
 {
-  std::lock_guard<std::mutex> lock(sync->mutex);
+  std::lock_guard<ProfiledMutex> lock(sync->mutex);
   return status;
 }
 
 bool KineticCallback::finished()
 {
-  std::lock_guard<std::mutex> lock(sync->mutex);
+  std::lock_guard<ProfiledMutex> lock(sync->mutex);
   return done;
 }
 
 void KineticCallback::reset()
 {
-  std::lock_guard<std::mutex> lock(sync->mutex);
+  std::lock_guard<ProfiledMutex> lock(sync->mutex);
   done = false;
   status = kinetic::KineticStatus(kinetic::StatusCode::CLIENT_INTERNAL_ERROR, "no result");
   sync->outstanding++;
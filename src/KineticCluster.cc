@@ -16,9 +16,13 @@
 #include "KineticCluster.hh"
 #include "Utility.hh"
 #include <set>
+#include <cstring>
+#include <sstream>
+#include <iomanip>
 #include <unistd.h>
 #include "Logging.hh"
 #include "KineticIoSingleton.hh"
+#include <openssl/sha.h>
 
 using std::unique_ptr;
 using std::shared_ptr;
@@ -26,13 +30,32 @@ using std::string;
 using namespace kinetic;
 using namespace kio;
 
+namespace {
+  //! values of data keys referencing deduplicated content start with this tag
+  const string content_reference_tag("kio-dedup ");
+  //! number of recently used content values to keep
+  const size_t known_content_capacity = 8;
+}
+
+const std::string KineticCluster::content_path_prefix(".kio-dedup/");
+const std::string KineticCluster::content_reference_prefix("ref:");
+const char* const KineticCluster::key_counter_names[KineticCluster::num_key_counters] = {"metadata", "data", "attribute"};
+
 KineticCluster::KineticCluster(
     std::string id, std::size_t block_size, std::chrono::seconds op_timeout,
     std::vector<std::unique_ptr<KineticAutoConnection>> cons,
-    std::shared_ptr<RedundancyProvider> rp
-) : identity(id), instanceIdentity(utility::uuidGenerateString()), chunkCapacity(block_size),
-    operation_timeout(op_timeout), connections(std::move(cons)), redundancy(rp), dmutex(std::make_shared<DestructionMutex>())
+    std::shared_ptr<RedundancyProvider> rp, std::size_t dedup_min_size, bool key_counters,
+    std::chrono::seconds dedup_grace
+) : content_reference_grace(dedup_grace), identity(id), instanceIdentity(utility::uuidGenerateString()),
+    chunkCapacity(block_size),
+    operation_timeout(op_timeout), connections(std::move(cons)), redundancy(rp), dmutex(std::make_shared<DestructionMutex>()),
+    dedupMinSize(dedup_min_size), dedup_bytes_logical(0), dedup_bytes_stored(0), keyCounters(key_counters),
+    mutex("KineticCluster::mutex")
 {
+  for (int i = 0; i < num_key_counters; i++) {
+    key_counter_deltas[i] = 0;
+    key_counter_uncertain[i] = 0;
+  }
 
   /* Attempt to get cluster limits from _any_ drive in the cluster */
   for (size_t off = 0; off < connections.size(); off++) {
@@ -68,6 +91,13 @@ KineticCluster::KineticCluster(
 
 KineticCluster::~KineticCluster()
 {
+  if (keyCounters) {
+    try {
+      flushKeyCounters(dmutex);
+    } catch (const std::exception& e) {
+      kio_warning("Failed updating key counters of cluster ", id(), ": ", e.what());
+    }
+  }
   dmutex->setDestructed();
 }
 
@@ -88,7 +118,7 @@ const std::string& KineticCluster::id() const
 
 ClusterStats KineticCluster::stats()
 {
-  std::lock_guard<std::mutex> lock(mutex);
+  std::lock_guard<ProfiledMutex> lock(mutex);
 
   using namespace std::chrono;
   if (duration_cast<seconds>(system_clock::now() - statistics_scheduled) > seconds(2)) {
@@ -96,6 +126,21 @@ ClusterStats KineticCluster::stats()
     statistics_scheduled = system_clock::now();
     kio_debug("Scheduled statistics update for cluster ", id());
   }
+  statistics_snapshot.dedup_bytes_logical = dedup_bytes_logical;
+  statistics_snapshot.dedup_bytes_stored = dedup_bytes_stored;
+
+  statistics_snapshot.queue_deferred_total = 0;
+  statistics_snapshot.queue_wait_total = std::chrono::microseconds(0);
+  statistics_snapshot.reconnect_attempts_total = 0;
+  statistics_snapshot.reconnect_failures_total = 0;
+  for (auto it = connections.begin(); it != connections.end(); it++) {
+    auto queue = (*it)->queueStats();
+    statistics_snapshot.queue_deferred_total += queue.deferred;
+    statistics_snapshot.queue_wait_total += queue.wait;
+    auto reconnects = (*it)->reconnectStats();
+    statistics_snapshot.reconnect_attempts_total += reconnects.attempts;
+    statistics_snapshot.reconnect_failures_total += reconnects.failures;
+  }
   return statistics_snapshot;
 }
 
@@ -142,6 +187,9 @@ KineticStatus KineticCluster::do_remove(const std::shared_ptr<const std::string>
   if (delOp.needsIndicator()) {
     delOp.putIndicatorKey();
   }
+  if (status.ok()) {
+    countKey(*key, -1);
+  }
   kio_debug("Remove request of key ", *key, " completed with status: ", status);
   return status;
 }
@@ -166,9 +214,8 @@ std::vector<std::shared_ptr<const std::string>> KineticCluster::valueToStripe(co
   std::vector<std::shared_ptr<const string>> stripe;
 
   auto chunkSize = value.length() < chunkCapacity ? value.length() : chunkCapacity;
-  std::shared_ptr<std::string> zero;
 
-  /* Set data chunks of the stripe. If value < stripe size, fill in with 0ed strings. */
+  /* Set data chunks of the stripe. If value < stripe size, the remaining data chunks are not written. */
   for (size_t i = 0; i < redundancy->numData(); i++) {
     if (i * chunkSize < value.length()) {
       auto chunk = std::make_shared<string>(value.substr(i * chunkSize, chunkSize));
@@ -176,28 +223,135 @@ std::vector<std::shared_ptr<const std::string>> KineticCluster::valueToStripe(co
       stripe.push_back(chunk);
     }
     else {
-      if (!zero) {
-        zero = make_shared<string>();
-        zero->resize(chunkSize);
-      }
-      stripe.push_back(zero);
+      stripe.push_back(std::make_shared<const string>());
     }
   }
   /* Set empty strings for parities */
   for (size_t i = 0; i < redundancy->numParity(); i++) {
     stripe.push_back(std::make_shared<const string>());
   }
-  /* Compute redundancy */
-  redundancy->compute(stripe);
+  return stripe;
+}
+
+
+std::string KineticCluster::contentPath(const std::string& fingerprint)
+{
+  return content_path_prefix + fingerprint;
+}
+
+bool KineticCluster::parseContentReference(const std::string& value,
+                                           const std::shared_ptr<const std::string>& version,
+                                           std::string& fingerprint, std::size_t& size)
+{
+  if (value.size() > 128 || value.compare(0, content_reference_tag.size(), content_reference_tag) != 0) {
+    return false;
+  }
+  std::istringstream ss(value.substr(content_reference_tag.size()));
+  std::size_t s = 0;
+  if (!(ss >> s) || ss.get() != '-' || s <= value.size()) {
+    return false;
+  }
+  try {
+    if (utility::uuidDecodeSize(version) != s) {
+      return false;
+    }
+  } catch (const std::invalid_argument& e) {
+    return false;
+  }
+  fingerprint = value.substr(content_reference_tag.size());
+  size = s;
+  return true;
+}
 
-  /* We don't actually want to write the 0ed data chunks used for redundancy computation. So get rid of them. */
-  for (size_t index = (value.size() + chunkSize - 1) / chunkSize; index < redundancy->numData(); index++) {
-    stripe[index] = std::make_shared<const string>();
+void KineticCluster::rememberContent(const std::string& fingerprint, const std::shared_ptr<const std::string>& value)
+{
+  std::lock_guard<ProfiledMutex> lock(mutex);
+  for (auto it = known_content.begin(); it != known_content.end(); it++) {
+    if (it->first == fingerprint) {
+      known_content.splice(known_content.begin(), known_content, it);
+      return;
+    }
+  }
+  known_content.push_front(std::make_pair(fingerprint, value));
+  if (known_content.size() > known_content_capacity) {
+    known_content.pop_back();
   }
+}
 
-  return stripe;
+KineticStatus KineticCluster::loadContent(const std::string& fingerprint, std::shared_ptr<const std::string>& value)
+{
+  {
+    std::lock_guard<ProfiledMutex> lock(mutex);
+    for (auto it = known_content.begin(); it != known_content.end(); it++) {
+      if (it->first == fingerprint) {
+        value = it->second;
+        known_content.splice(known_content.begin(), known_content, it);
+        return KineticStatus(StatusCode::OK, "");
+      }
+    }
+  }
+
+  shared_ptr<const string> version;
+  shared_ptr<const string> content;
+  auto status = do_get(utility::makeDataKey(identity, contentPath(fingerprint), 0), version, content, false);
+  if (status.ok()) {
+    rememberContent(fingerprint, content);
+    value = content;
+  }
+  return status;
 }
 
+KineticStatus KineticCluster::storeContent(const std::shared_ptr<const std::string>& key,
+                                           const std::shared_ptr<const std::string>& value,
+                                           std::string& fingerprint)
+{
+  /* Content is shared with every data key of the same fingerprint without comparing it, so the fingerprint has to be
+   * collision resistant. Anyone able to write a file could otherwise make other files read data of their choice. */
+  unsigned char digest[SHA256_DIGEST_LENGTH];
+  SHA256(reinterpret_cast<const unsigned char*>(value->data()), value->size(), digest);
+  std::ostringstream ss;
+  ss << value->size() << "-" << std::hex << std::setfill('0');
+  for (size_t i = 0; i < sizeof(digest); i++) {
+    ss << std::setw(2) << static_cast<unsigned int>(digest[i]);
+  }
+  fingerprint = ss.str();
+  auto path = contentPath(fingerprint);
+
+  /* The reference is written first. Garbage collection does not remove content that is referenced, and re-checks
+   * for references after removing content. So if the content is found to exist below, it will continue to exist. */
+  using namespace std::chrono;
+  auto timestamp = duration_cast<milliseconds>(system_clock::now().time_since_epoch()).count();
+  shared_ptr<const string> version;
+  auto status = do_put(utility::makeAttributeKey(identity, path, content_reference_prefix + *key),
+                       make_shared<const string>(), make_shared<const string>(utility::Convert::toString(timestamp)),
+                       version, WriteMode::IGNORE_VERSION);
+  if (!status.ok()) {
+    return status;
+  }
+  dedup_bytes_logical += value->size();
+
+  /* Writing already existing content only requires a version check, no chunk data is sent. */
+  auto content_key = utility::makeDataKey(identity, path, 0);
+  shared_ptr<const string> content;
+  status = do_get(content_key, version, content, true);
+  if (status.statusCode() == StatusCode::REMOTE_NOT_FOUND) {
+    status = do_put(content_key, make_shared<const string>(), value, version, WriteMode::REQUIRE_SAME_VERSION);
+    if (status.ok()) {
+      dedup_bytes_stored += value->size();
+    }
+    /* Another client stored the same content concurrently. */
+    else if (status.statusCode() == StatusCode::REMOTE_VERSION_MISMATCH) {
+      status = KineticStatus(StatusCode::OK, "");
+    }
+  }
+  if (status.ok()) {
+    rememberContent(fingerprint, value);
+  }
+  else {
+    kio_warning("Failed storing content ", fingerprint, " for key ", *key, ": ", status);
+  }
+  return status;
+}
 
 KineticStatus KineticCluster::do_put(const std::shared_ptr<const std::string>& key,
                                      const std::shared_ptr<const std::string>& version,
@@ -209,17 +363,44 @@ KineticStatus KineticCluster::do_put(const std::shared_ptr<const std::string>& k
     return KineticStatus(StatusCode::CLIENT_INTERNAL_ERROR, "invalid input.");
   }
 
-  /* Compute Stripe */
+  /* The version encodes the value size. If a content reference is written as is (e.g. during repair), it has to
+   * encode the size of the referenced content. */
+  auto stored = value;
+  auto size = value->size();
+  std::string fingerprint;
+  bool reference = parseContentReference(*value, version, fingerprint, size);
+
+  /* The version also encodes the checksum of the value, so that file checksums can be computed without reading
+   * data. A content reference written as is keeps the checksum of the referenced content, if known. */
+  uint32_t checksum = 0;
+  bool has_checksum = reference ? utility::uuidDecodeChecksum(version, checksum) : true;
+  if (!reference) {
+    checksum = crc32c(0, value->data(), value->size());
+  }
+  if (!reference && dedupMinSize && size >= dedupMinSize) {
+    auto data_prefix = identity + ":data:";
+    if (key->compare(0, data_prefix.size(), data_prefix) == 0 &&
+        key->compare(data_prefix.size(), content_path_prefix.size(), content_path_prefix) != 0) {
+      auto status = storeContent(key, value, fingerprint);
+      if (!status.ok()) {
+        return status;
+      }
+      stored = make_shared<const string>(content_reference_tag + fingerprint);
+    }
+  }
+
+  /* Slice the value, parity is computed by the put operation */
   std::vector<std::shared_ptr<const string>> stripe;
   try {
-    stripe = valueToStripe(*value);
+    stripe = valueToStripe(*stored);
   } catch (const std::exception& e) {
     kio_error("Failed building data stripe for key ", *key, ": ", e.what());
     return KineticStatus(StatusCode::CLIENT_INTERNAL_ERROR, e.what());
   }
 
   /* Do not use version_out variable directly in case the client uses the same pointer for version and version_out. */
-  auto version_new = utility::uuidGenerateEncodeSize(value->size());
+  auto version_new = has_checksum ? utility::uuidGenerateEncodeSize(size, checksum) :
+                     utility::uuidGenerateEncodeSize(size);
 
   StripeOperation_PUT putOp(key, version_new, version, stripe, mode, connections, redundancy);
 
@@ -230,6 +411,16 @@ KineticStatus KineticCluster::do_put(const std::shared_ptr<const std::string>& k
   }
   if (status.ok()) {
     version_out = version_new;
+    /* Callers that know whether the key exists (e.g. data blocks, which read the remote version before writing)
+     * put conditionally. A forced put might have created the key or overwritten it. */
+    if (mode == WriteMode::REQUIRE_SAME_VERSION) {
+      if (version->empty()) {
+        countKey(*key, 1);
+      }
+    }
+    else {
+      countKey(*key, 0, 1);
+    }
   }
   return status;
 }
@@ -327,9 +518,26 @@ kinetic::KineticStatus KineticCluster::get(const std::shared_ptr<const std::stri
                                            std::shared_ptr<const std::string>& version,
                                            std::shared_ptr<const std::string>& value)
 {
-  auto status = do_get(key, version, value, false);
-  if (status.ok())
+  shared_ptr<const string> stored_version;
+  shared_ptr<const string> stored_value;
+  auto status = do_get(key, stored_version, stored_value, false);
+
+  /* Content references are resolved independently of the dedup configuration, so that deduplicated data remains
+   * readable if deduplication is disabled. */
+  std::string fingerprint;
+  std::size_t size;
+  if (status.ok() && parseContentReference(*stored_value, stored_version, fingerprint, size)) {
+    status = loadContent(fingerprint, stored_value);
+    if (!status.ok() || stored_value->size() != size) {
+      kio_error("Key ", *key, " references unavailable content ", fingerprint, ": ", status);
+      status = KineticStatus(StatusCode::CLIENT_IO_ERROR, "referenced content unavailable");
+    }
+  }
+  if (status.ok()) {
+    version = stored_version;
+    value = stored_value;
     kio_debug("Get DATA request of key ", *key, " completed with status: ", status);
+  }
   return status;
 }
 
@@ -393,7 +601,7 @@ void KineticCluster::updateSnapshot(std::shared_ptr<DestructionMutex> dm)
   }
 
   /* update cluster variables */
-  std::lock_guard<std::mutex> lock(mutex);
+  std::lock_guard<ProfiledMutex> lock(mutex);
   statistics_snapshot.io_start = statistics_snapshot.io_end;
   statistics_snapshot.io_end = std::chrono::system_clock::now();
   statistics_snapshot.read_ops_period = read_ops_total - statistics_snapshot.read_ops_total;
@@ -411,4 +619,94 @@ void KineticCluster::updateSnapshot(std::shared_ptr<DestructionMutex> dm)
 
   statistics_snapshot.health.indicator_exist = indicator;
   statistics_snapshot.health.drives_failed = num_failed;
-}
\ No newline at end of file
+}
+int KineticCluster::keyCounterIndex(const std::string& key) const
+{
+  if (key.size() <= identity.size() || key.compare(0, identity.size(), identity) || key[identity.size()] != ':') {
+    return -1;
+  }
+  for (int i = 0; i < num_key_counters; i++) {
+    auto length = strlen(key_counter_names[i]);
+    if (key.compare(identity.size() + 1, length, key_counter_names[i]) == 0 &&
+        key.size() > identity.size() + 1 + length && key[identity.size() + 1 + length] == ':') {
+      return i;
+    }
+  }
+  return -1;
+}
+
+std::shared_ptr<const std::string> KineticCluster::keyCounterKey(int index) const
+{
+  return make_shared<const string>(identity + ":count:" + key_counter_names[index]);
+}
+
+void KineticCluster::parseKeyCounter(const std::string& value, int& count, int& uncertain)
+{
+  /* Counters initialized before uncertain puts have been tracked only store the count. */
+  std::istringstream ss(value);
+  count = uncertain = 0;
+  ss >> count >> uncertain;
+}
+
+void KineticCluster::countKey(const std::string& key, int delta, int uncertain)
+{
+  if (!keyCounters) {
+    return;
+  }
+  auto index = keyCounterIndex(key);
+  if (index < 0) {
+    return;
+  }
+  key_counter_deltas[index] += delta;
+  key_counter_uncertain[index] += uncertain;
+
+  std::lock_guard<ProfiledMutex> lock(mutex);
+  using namespace std::chrono;
+  if (duration_cast<seconds>(system_clock::now() - key_counters_scheduled) > seconds(1)) {
+    kio().threadpool().try_run(std::bind(&KineticCluster::flushKeyCounters, this, dmutex));
+    key_counters_scheduled = system_clock::now();
+  }
+}
+
+void KineticCluster::flushKeyCounters(std::shared_ptr<DestructionMutex> dm)
+{
+  std::lock_guard<DestructionMutex> dlock(*dm);
+
+  for (int i = 0; i < num_key_counters; i++) {
+    int delta = key_counter_deltas[i].exchange(0);
+    int uncertain = key_counter_uncertain[i].exchange(0);
+    if (!delta && !uncertain) {
+      continue;
+    }
+
+    auto key = keyCounterKey(i);
+    KineticStatus status(StatusCode::CLIENT_INTERNAL_ERROR, "");
+    for (int attempt = 0; attempt < 5; attempt++) {
+      shared_ptr<const string> version;
+      shared_ptr<const string> value;
+      status = get(key, version, value);
+      if (status.statusCode() == StatusCode::REMOTE_NOT_FOUND) {
+        /* Counter has not been initialized, there is nothing the delta could be added to. */
+        status = KineticStatus(StatusCode::OK, "");
+        break;
+      }
+      if (!status.ok()) {
+        break;
+      }
+      int count;
+      int counted_uncertain;
+      parseKeyCounter(*value, count, counted_uncertain);
+      status = put(key, version, make_shared<const string>(
+          utility::Convert::toString(count + delta, " ", counted_uncertain + uncertain)
+      ), version);
+      if (status.statusCode() != StatusCode::REMOTE_VERSION_MISMATCH) {
+        break;
+      }
+    }
+    if (!status.ok()) {
+      kio_notice("Failed updating key counter ", *key, ", retrying later: ", status);
+      key_counter_deltas[i] += delta;
+      key_counter_uncertain[i] += uncertain;
+    }
+  }
+}
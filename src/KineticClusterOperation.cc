@@ -15,6 +15,8 @@
 
 #include "KineticClusterOperation.hh"
 #include <Logging.hh>
+#include <Tracepoints.hh>
+#include <algorithm>
 #include <set>
 
 using namespace kio;
@@ -25,7 +27,12 @@ KineticClusterOperation::KineticClusterOperation(std::vector<std::unique_ptr<Kin
 { }
 
 KineticClusterOperation::~KineticClusterOperation()
-{ }
+{
+  /* Never leave a callback queued on a connection. */
+  for (auto it = deferred.cbegin(); it != deferred.cend(); it++) {
+    operations[*it].connection->cancelSlot(operations[*it].callback.get());
+  }
+}
 
 void KineticClusterOperation::expandOperationVector(std::size_t size, std::size_t offset)
 {
@@ -42,14 +49,43 @@ void KineticClusterOperation::expandOperationVector(std::size_t size, std::size_
 
 std::map<kinetic::StatusCode, size_t, CompareStatusCode> KineticClusterOperation::executeOperationVector(
     const std::chrono::seconds& timeout)
+{
+  submitOperations(0, operations.size());
+  return awaitOperations(timeout);
+}
+
+bool KineticClusterOperation::issueOperation(std::size_t index)
 {
   fd_set a; int fd;
-  std::vector<std::shared_ptr<kinetic::ThreadsafeNonblockingKineticConnection>> cons(operations.size());
-  std::vector<kinetic::HandlerKey> hkeys(operations.size());
+  auto& op = operations[index];
+  auto& con = submitted_connections[index];
+  if (!op.connection->acquireSlot(op.callback.get())) {
+    return false;
+  }
+  issued[index] = std::chrono::system_clock::now();
+  op.callback->setIssued(op.connection);
+  handler_keys[index] = op.function(con);
+  KIO_TRACE3(drive_op_issue, op.callback.get(), op.connection->getName().c_str(), index);
+  if (!con->Run(&a, &a, &fd)) {
+    op.callback->OnResult(KineticStatus(StatusCode::CLIENT_IO_ERROR, "Run returned false."));
+    op.connection->setError(con);
+    kio_notice("Failed executing async operation for connection ", op.connection->getName());
+  }
+  return true;
+}
+
+void KineticClusterOperation::submitOperations(std::size_t begin, std::size_t end)
+{
+  auto& cons = submitted_connections;
+  cons.resize(operations.size());
+  handler_keys.resize(operations.size());
+  queued.resize(operations.size());
+  issued.resize(operations.size(), std::chrono::system_clock::now());
+
+  /* Call functions on connections. Operations exceeding the queue depth of their drive are deferred. */
+  for (size_t i = begin; i < end; i++) {
+    cons[i].reset();
 
-  /* Call functions on connections. */
-  for (size_t i = 0; i < operations.size(); i++) {
-    
     /* Skip operations that are already finished. This is most frequently the case in a 2phase get. */
     if(operations[i].callback->finished()) {
       continue;
@@ -63,24 +99,74 @@ std::map<kinetic::StatusCode, size_t, CompareStatusCode> KineticClusterOperation
       continue;
     }
 
-    hkeys[i] = operations[i].function(cons[i]);
-    if (!cons[i]->Run(&a, &a, &fd)) {
-      operations[i].callback->OnResult(KineticStatus(StatusCode::CLIENT_IO_ERROR, "Run returned false."));
-      operations[i].connection->setError(cons[i]);
-      kio_notice("Failed executing async operation for connection ", operations[i].connection->getName());
+    if (!issueOperation(i)) {
+      queued[i] = std::chrono::system_clock::now();
+      deferred.push_back(i);
     }
   }
+}
+
+std::map<kinetic::StatusCode, size_t, CompareStatusCode> KineticClusterOperation::awaitOperations(
+    const std::chrono::seconds& timeout)
+{
+  using namespace std::chrono;
+  auto& cons = submitted_connections;
+  auto& hkeys = handler_keys;
+  cons.resize(operations.size());
+  hkeys.resize(operations.size());
+  issued.resize(operations.size(), system_clock::now());
 
-  /* Wait until sufficient requests returned or we pass operation timeout. */
-  std::chrono::system_clock::time_point timeout_time = std::chrono::system_clock::now() + timeout;
-  sync->wait_until(timeout_time);
+  /* Issue deferred operations as submission slots become available. Connections wake us up when a slot becomes
+   * available to the first operation in their queue. */
+  auto queue_timeout_time = system_clock::now() + timeout;
+  while (!deferred.empty()) {
+    for (auto it = deferred.begin(); it != deferred.end();) {
+      if (!issueOperation(*it)) {
+        it++;
+        continue;
+      }
+      operations[*it].connection->recordQueueWait(duration_cast<microseconds>(system_clock::now() - queued[*it]));
+      it = deferred.erase(it);
+    }
+    if (deferred.empty() || system_clock::now() >= queue_timeout_time) {
+      break;
+    }
+    sync->wait_for_slot(queue_timeout_time);
+  }
 
-  /* Timeout any unfinished request. We do not assume connection to be in error state because of a timeout */
-  for (size_t i = 0; i < operations.size(); i++) {
-    if (!operations[i].callback->finished()) {
-      kio_warning("Network timeout (", timeout, ") for connection ", operations[i].connection->getName());
-      cons[i]->RemoveHandler(hkeys[i]);
-      operations[i].callback->OnResult(KineticStatus(StatusCode::CLIENT_IO_ERROR, "Network timeout"));
+  /* Operations that never obtained a submission slot have not been sent. As they don't hold a slot, failing them
+   * does not count as congestion. */
+  for (auto it = deferred.cbegin(); it != deferred.cend(); it++) {
+    kio_warning("Queue timeout (", timeout, ") for connection ", operations[*it].connection->getName());
+    operations[*it].connection->cancelSlot(operations[*it].callback.get());
+    operations[*it].connection->recordQueueWait(duration_cast<microseconds>(system_clock::now() - queued[*it]));
+    operations[*it].callback->OnResult(KineticStatus(StatusCode::CLIENT_IO_ERROR, "Queue timeout"));
+  }
+  deferred.clear();
+
+  /* Wait until sufficient requests returned or the earliest timeout of an outstanding request passes. Timeout
+   * requests individually, we do not assume connection to be in error state because of a timeout. */
+  while (true) {
+    auto timeout_time = system_clock::time_point::max();
+    for (size_t i = 0; i < operations.size(); i++) {
+      if (!operations[i].callback->finished()) {
+        timeout_time = std::min(timeout_time, issued[i] + timeout);
+      }
+    }
+    if (timeout_time == system_clock::time_point::max()) {
+      break;
+    }
+    sync->wait_until(timeout_time);
+
+    auto now = system_clock::now();
+    for (size_t i = 0; i < operations.size(); i++) {
+      if (!operations[i].callback->finished() && issued[i] + timeout <= now) {
+        kio_warning("Network timeout (", timeout, ") for connection ", operations[i].connection->getName());
+        if (cons[i]) {
+          cons[i]->RemoveHandler(hkeys[i]);
+        }
+        operations[i].callback->OnResult(KineticStatus(StatusCode::CLIENT_IO_ERROR, "Network timeout"));
+      }
     }
   }
 
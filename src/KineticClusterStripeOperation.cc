@@ -18,6 +18,7 @@
 #include <ClusterInterface.hh>
 #include "KineticClusterStripeOperation.hh"
 #include "outside/MurmurHash3.h"
+#include <algorithm>
 #include <set>
 #include <unistd.h>
 
@@ -74,6 +75,12 @@ std::shared_ptr<KineticRecord> makeRecord(const std::shared_ptr<const std::strin
   );
 }
 
+bool validChecksum(const KineticRecord& record)
+{
+  auto checksum = crc32c(0, record.value()->c_str(), record.value()->length());
+  return utility::Convert::toString(checksum) == *record.tag();
+}
+
 bool validStatusCode(const kinetic::StatusCode& code)
 {
   return code == StatusCode::OK || code == StatusCode::REMOTE_NOT_FOUND ||
@@ -139,18 +146,44 @@ StripeOperation_PUT::StripeOperation_PUT(const std::shared_ptr<const std::string
                                          kinetic::WriteMode writeMode,
                                          std::vector<std::unique_ptr<KineticAutoConnection>>& connections,
                                          std::shared_ptr<RedundancyProvider>& redundancy)
-    : WriteStripeOperation(connections, key, redundancy), version_new(version_new), values(values)
+    : WriteStripeOperation(connections, key, redundancy), version_new(version_new), values(values),
+      version_old(version_old), write_mode(writeMode), parity_valid(true)
 {
   if (values.size() != redundancy->size()) {
     kio_error("Invalid input. Stripe of ", values.size(), " is not compatible with redundancy of ", redundancy->size());
     throw std::system_error(std::make_error_code(std::errc::invalid_argument));
   }
   expandOperationVector(values.size(), 0);
-  for (size_t i = 0; i < operations.size(); i++) {
+  for (size_t i = 0; i < redundancy->numData(); i++) {
     fillOperation(i, version_old, writeMode);
   }
 }
 
+void StripeOperation_PUT::computeParity()
+{
+  /* An empty value is stored as a stripe of empty chunks. */
+  if (values.front()->empty()) {
+    return;
+  }
+
+  /* Data chunks past the end of the value are not written, but take part in parity computation as zeroes. */
+  auto stripe = values;
+  std::shared_ptr<const string> zero;
+  for (size_t i = 0; i < redundancy->numData(); i++) {
+    if (stripe[i]->empty()) {
+      if (!zero) {
+        zero = std::make_shared<const string>(values.front()->size(), '\0');
+      }
+      stripe[i] = zero;
+    }
+  }
+  redundancy->compute(stripe);
+
+  for (size_t i = redundancy->numData(); i < redundancy->size(); i++) {
+    values[i] = stripe[i];
+  }
+}
+
 void StripeOperation_PUT::fillOperation(size_t index, const shared_ptr<const string>& drive_version,
                                         kinetic::WriteMode writeMode)
 {
@@ -176,27 +209,30 @@ void StripeOperation_PUT::fillOperation(size_t index, const shared_ptr<const str
       PersistMode::WRITE_BACK);
 }
 
-bool StripeOperation_PUT::quick_repair(const std::chrono::seconds& timeout, 
-                                       const StripeOperation_GET& drive_versions) 
+kinetic::KineticStatus StripeOperation_PUT::execute(const std::chrono::seconds& timeout)
 {
-  for (size_t opnum = 0; opnum < operations.size(); opnum++) {
-    auto drive_version = drive_versions.getVersionAt(opnum);
-    operations[opnum].callback->OnResult(kinetic::KineticStatus(StatusCode::OK, ""));
-    if(drive_version && *drive_version != *version_new) {
-     fillOperation(opnum, drive_version, kinetic::WriteMode::REQUIRE_SAME_VERSION);
+  /* Send the data chunks right away, parity is computed while they are on the wire. */
+  submitOperations(0, redundancy->numData());
+  try {
+    computeParity();
+  } catch (const std::exception& e) {
+    kio_error("Failed computing parity for key ", *key, ": ", e.what());
+    parity_valid = false;
+  }
+  for (size_t i = redundancy->numData(); i < redundancy->size(); i++) {
+    fillOperation(i, version_old, write_mode);
+    if (!parity_valid) {
+      operations[i].callback->OnResult(KineticStatus(StatusCode::CLIENT_INTERNAL_ERROR, "Parity not available."));
     }
   }
-  auto rmap = executeOperationVector(timeout);
-  if(rmap[StatusCode::OK] == operations.size()) {
-    return true; 
-  }
-  kio_notice("Quick repair failed. ", operations.size() - rmap[StatusCode::OK], " chunks could not be written.");
-  return false;   
-}
+  submitOperations(redundancy->numData(), redundancy->size());
+  auto rmap = awaitOperations(timeout);
 
-kinetic::KineticStatus StripeOperation_PUT::execute(const std::chrono::seconds& timeout)
-{
-  auto rmap = executeOperationVector(timeout);
+  /* The data chunks may have been written, mark the stripe for repair. */
+  if (!parity_valid) {
+    need_indicator = true;
+    return KineticStatus(StatusCode::CLIENT_INTERNAL_ERROR, "Failed computing parity.");
+  }
 
   /* Partial stripe write has to be resolved. */
   if (rmap[StatusCode::OK] && (rmap[StatusCode::REMOTE_VERSION_MISMATCH] || rmap[StatusCode::REMOTE_NOT_FOUND])) {
@@ -222,6 +258,9 @@ kinetic::KineticStatus StripeOperation_PUT::execute(const std::chrono::seconds&
 void StripeOperation_PUT::putHandoffKeys()
 {
   for (size_t opnum = 0; opnum < values.size(); opnum++) {
+    if (opnum >= redundancy->numData() && !parity_valid) {
+      break;
+    }
     auto scode = operations[opnum].callback->getResult().statusCode();
     if (scode != StatusCode::OK && scode != StatusCode::REMOTE_VERSION_MISMATCH) {
       kio_debug("Creating handoff key due to status code ", scode, " on connection ",
@@ -484,25 +523,18 @@ bool StripeOperation_GET::insertHandoffChunks()
 void StripeOperation_GET::reconstructValue()
 {
   value = make_shared<string>();
+  stripe.clear();
+  invalid_chunks.clear();
 
   auto size = utility::uuidDecodeSize(version.version);
-  if (!size) {
-    kio_debug("Key ", *key, " is empty according to version: ", version.version);
-    return;
-  }
   std::vector<size_t> zeroed_indices;
 
-  std::vector<shared_ptr<const string>> stripe;
-  bool need_recovery = false;
-
   /* Step 1) re-construct stripe */
   for (size_t i = 0; i < operations.size(); i++) {
     auto& record = std::static_pointer_cast<GetCallback>(operations[i].callback)->getRecord();
 
     if (record && *record->version() == *version.version && record->value()) {
-      auto checksum = crc32c(0, record->value()->c_str(), record->value()->length());
-      auto tag = utility::Convert::toString(checksum);
-      if (tag == *record->tag()) {
+      if (validChecksum(*record)) {
         stripe.push_back(record->value());
         /* If we have no value but passed crc verification, this indicates a 0ed data chunk has been used for
          * parity calculations but not unnecessarily written to the backend. */
@@ -513,7 +545,7 @@ void StripeOperation_GET::reconstructValue()
       else {
         kio_warning("Chunk ", i, " of key ", *key, " failed crc verification.");
         stripe.push_back(make_shared<const string>());
-        need_recovery = true;
+        invalid_chunks.push_back(i);
         need_indicator = true;
       }
     }
@@ -526,26 +558,41 @@ void StripeOperation_GET::reconstructValue()
         kio_notice("Chunk ", i, " of key ", *key, " is invalid.");
       }
       stripe.push_back(make_shared<const string>());
-      need_recovery = true;
+      invalid_chunks.push_back(i);
     }
   }
 
-  if (need_recovery) {
+  if (!size) {
+    kio_debug("Key ", *key, " is empty according to version: ", version.version);
+    stripe.assign(operations.size(), make_shared<const string>());
+    return;
+  }
 
-    if (zeroed_indices.size()) {
-      size_t chunkSize = 0;
-      for (auto it = stripe.cbegin(); it != stripe.cend(); it++) {
-        if ((*it)->length()) {
-          chunkSize = (*it)->length();
-          break;
+  if (invalid_chunks.size()) {
+    /* Use the decoder set up while waiting for parity chunks if possible. Otherwise only the invalid chunks are
+     * computed. */
+    if (!finishDecoding()) {
+      if (zeroed_indices.size()) {
+        size_t chunkSize = 0;
+        for (auto it = stripe.cbegin(); it != stripe.cend(); it++) {
+          if ((*it)->length()) {
+            chunkSize = (*it)->length();
+            break;
+          }
+        }
+        auto zero = std::make_shared<const std::string>(chunkSize, '\0');
+        for (auto it = zeroed_indices.cbegin(); it != zeroed_indices.cend(); it++) {
+          stripe[*it] = zero;
         }
       }
-      auto zero = std::make_shared<const std::string>(chunkSize, '\0');
-      for (auto it = zeroed_indices.cbegin(); it != zeroed_indices.cend(); it++) {
-        stripe[*it] = zero;
-      }
+      redundancy->compute(stripe);
+    }
+
+    /* Data chunks past the end of the value are 0ed for parity computation but not stored. */
+    auto chunkSize = stripe.front()->size();
+    for (size_t i = (size + chunkSize - 1) / chunkSize; i < redundancy->numData(); i++) {
+      stripe[i] = make_shared<const string>();
     }
-    redundancy->compute(stripe);
   }
 
   /* Step 2) merge data chunks into single value */
@@ -561,6 +608,82 @@ void StripeOperation_GET::reconstructValue()
   }
 }
 
+void StripeOperation_GET::startDecoding()
+{
+  decoder.reset();
+  if (skip_value) {
+    return;
+  }
+
+  /* All data chunks have been read already. If they agree on a version, the invalid ones have to be decoded from
+   * the first parity chunks, so the decoding sources are known before the parity chunks arrive. */
+  std::vector<size_t> erasures;
+  std::shared_ptr<const std::string> data_version;
+  size_t chunkSize = 0;
+  for (size_t i = 0; i < redundancy->numData(); i++) {
+    auto& record = std::static_pointer_cast<GetCallback>(operations[i].callback)->getRecord();
+    if (!record || !record->value() || !validChecksum(*record)) {
+      erasures.push_back(i);
+      continue;
+    }
+    if (data_version && *data_version != *record->version()) {
+      return;
+    }
+    data_version = record->version();
+    chunkSize = std::max(chunkSize, record->value()->size());
+  }
+  if (erasures.empty() || erasures.size() > redundancy->numParity() || !chunkSize) {
+    return;
+  }
+
+  /* Parity chunks that are not required as sources are recomputed along with the data chunks. */
+  for (size_t i = redundancy->numData() + erasures.size(); i < redundancy->size(); i++) {
+    erasures.push_back(i);
+  }
+
+  try {
+    decoder = redundancy->makeDecoder(erasures, chunkSize);
+    auto& sources = decoder->sources();
+    for (auto it = sources.cbegin(); it != sources.cend(); it++) {
+      if (*it < redundancy->numData()) {
+        decoder->add(*it, std::static_pointer_cast<GetCallback>(operations[*it].callback)->getRecord()->value());
+      }
+    }
+    decoder_version = data_version;
+  } catch (const std::exception& e) {
+    kio_notice("Failed setting up progressive decoding for key ", *key, ": ", e.what());
+    decoder.reset();
+  }
+}
+
+bool StripeOperation_GET::finishDecoding()
+{
+  std::unique_ptr<RedundancyProvider::Decoder> d(std::move(decoder));
+  if (!d || *decoder_version != *version.version) {
+    return false;
+  }
+
+  auto& sources = d->sources();
+  for (auto it = sources.cbegin(); it != sources.cend(); it++) {
+    if (std::find(invalid_chunks.cbegin(), invalid_chunks.cend(), *it) != invalid_chunks.cend()) {
+      return false;
+    }
+  }
+
+  try {
+    for (auto it = sources.cbegin(); it != sources.cend(); it++) {
+      if (*it >= redundancy->numData()) {
+        d->add(*it, stripe[*it]);
+      }
+    }
+    d->finish(stripe);
+  } catch (const std::exception& e) {
+    kio_notice("Progressive decoding of key ", *key, " failed: ", e.what());
+    return false;
+  }
+  return true;
+}
+
 bool getVersionEqual(const std::shared_ptr<KineticCallback>& lhs, const std::shared_ptr<KineticCallback>& rhs)
 {
   if (!lhs->getResult().ok() || !rhs->getResult().ok()) {
@@ -622,9 +745,13 @@ StripeOperation_GET::VersionCount StripeOperation_GET::mostFrequentVersion() con
 }
 
 
-kinetic::KineticStatus StripeOperation_GET::do_execute(const std::chrono::seconds& timeout)
+kinetic::KineticStatus StripeOperation_GET::do_execute(const std::chrono::seconds& timeout, bool decode)
 {
-  auto rmap = executeOperationVector(timeout);
+  submitOperations(0, operations.size());
+  if (decode) {
+    startDecoding();
+  }
+  auto rmap = awaitOperations(timeout);
   version = mostFrequentVersion();
 
   /* Indicator should be written if chunk versions of this stripe are not aligned */
@@ -658,17 +785,20 @@ kinetic::KineticStatus StripeOperation_GET::execute(const std::chrono::seconds&
   }
 
   /* Add parity chunks to get request (already obtained chunks will not be re-fetched). */
+  bool decode = false;
   if (operations.size() == redundancy->numData()) {
     expandOperationVector(redundancy->numParity(), operations.size());
     fillOperationVector();
+    decode = true;
   }
   try {
-    return do_execute(timeout);
+    return do_execute(timeout, decode);
   } catch (std::exception& e) {
     kio_debug("Failed getting stripe for key ", *key, " even with parities: ", e.what());
   }
 
   /* As a last ditch effort try to use handoff chunks if any are available to serve the request */
+  decoder.reset();
   if (this->insertHandoffChunks()) {
     try {
       return do_execute(timeout);
@@ -689,6 +819,16 @@ std::shared_ptr<const std::string> StripeOperation_GET::getValue() const
   return value;
 }
 
+const std::vector<std::shared_ptr<const std::string>>& StripeOperation_GET::getStripe() const
+{
+  return stripe;
+}
+
+const std::vector<size_t>& StripeOperation_GET::getInvalidChunks() const
+{
+  return invalid_chunks;
+}
+
 std::shared_ptr<const std::string> StripeOperation_GET::getVersionAt(int index) const
 {
   auto& cb = operations[index].callback;
@@ -708,3 +848,61 @@ std::shared_ptr<const std::string> StripeOperation_GET::getVersionAt(int index)
 
   return std::shared_ptr<const std::string>();
 }
+
+StripeOperation_REPAIR::StripeOperation_REPAIR(const std::shared_ptr<const std::string>& key,
+                                               const StripeOperation_GET& chunks,
+                                               std::vector<std::unique_ptr<KineticAutoConnection>>& connections,
+                                               std::shared_ptr<RedundancyProvider>& redundancy)
+    : KineticClusterStripeOperation(connections, key, redundancy), num_chunks(0)
+{
+  auto& stripe = chunks.getStripe();
+  auto& invalid = chunks.getInvalidChunks();
+  auto version = chunks.getVersion();
+
+  expandOperationVector(redundancy->size(), 0);
+  for (size_t i = 0; i < operations.size(); i++) {
+    auto cb = std::make_shared<PutCallback>(sync);
+    operations[i].callback = cb;
+
+    auto drive_version = chunks.getVersionAt(i);
+    if (!drive_version || std::find(invalid.cbegin(), invalid.cend(), i) == invalid.cend()) {
+      cb->OnResult(kinetic::KineticStatus(StatusCode::OK, ""));
+      continue;
+    }
+    operations[i].function = std::bind<HandlerKey(ThreadsafeNonblockingKineticConnection::*)(
+        const shared_ptr<const string>,
+        const shared_ptr<const string>,
+        WriteMode,
+        const shared_ptr<const KineticRecord>,
+        const shared_ptr<PutCallbackInterface>,
+        PersistMode)>(
+        &ThreadsafeNonblockingKineticConnection::Put,
+        std::placeholders::_1,
+        key,
+        drive_version,
+        WriteMode::REQUIRE_SAME_VERSION,
+        makeRecord(stripe[i], version),
+        cb,
+        PersistMode::WRITE_BACK);
+    num_chunks++;
+  }
+}
+
+size_t StripeOperation_REPAIR::size() const
+{
+  return num_chunks;
+}
+
+kinetic::KineticStatus StripeOperation_REPAIR::execute(const std::chrono::seconds& timeout)
+{
+  if (!num_chunks) {
+    return KineticStatus(StatusCode::OK, "");
+  }
+  auto rmap = executeOperationVector(timeout);
+  if (rmap[StatusCode::OK] == operations.size()) {
+    return KineticStatus(StatusCode::OK, "");
+  }
+  kio_notice("Repair of key ", *key, " failed. ", operations.size() - rmap[StatusCode::OK], " of ", num_chunks,
+             " chunks could not be written.");
+  return KineticStatus(StatusCode::CLIENT_IO_ERROR, "Chunks of key " + *key + " could not be written.");
+}
@@ -18,6 +18,7 @@
 #include "KineticIoSingleton.hh"
 #include "Utility.hh"
 #include "Logging.hh"
+#include "LockProfiler.hh"
 
 using namespace kio;
 
@@ -42,6 +43,15 @@ void KineticIoFactory::reloadConfiguration()
   kio().loadConfiguration();
 }
 
+std::string KineticIoFactory::lockProfileReport(bool reset)
+{
+  auto report = LockProfiler::report();
+  if (reset) {
+    LockProfiler::reset();
+  }
+  return report;
+}
+
 namespace kio {
 class LoadableKineticIoFactory : public LoadableKineticIoFactoryInterface
 {
@@ -64,6 +74,11 @@ class LoadableKineticIoFactory : public LoadableKineticIoFactoryInterface
   {
     return KineticIoFactory::reloadConfiguration();
   }
+
+  std::string lockProfileReport(bool reset)
+  {
+    return KineticIoFactory::lockProfileReport(reset);
+  }
 };
 }
 
@@ -20,7 +20,7 @@
 
 using namespace kio;
 
-KineticIoSingleton::KineticIoSingleton() : dataCache(0), threadPool(0, 0)
+KineticIoSingleton::KineticIoSingleton() : dataCache(0, &sharedCache), threadPool(0, 0)
 {
   configuration.readahead_window_size = 0;
   try {
@@ -52,6 +52,11 @@ BackgroundOperationHandler& KineticIoSingleton::threadpool()
   return threadPool;
 }
 
+SmallFilePacker& KineticIoSingleton::packer()
+{
+  return smallFilePacker;
+}
+
 /* Utility functions for this class only. */
 namespace {
 /* Read file located at path into string buffer and return it. */
@@ -89,6 +94,25 @@ int loadJsonIntEntry(struct json_object* obj, const char* key)
   return json_object_get_int(tmp);
 }
 
+/* Optional entries fall back to the supplied default value if they don't exist. */
+int loadJsonIntEntry(struct json_object* obj, const char* key, int default_value)
+{
+  struct json_object* tmp = NULL;
+  if (!json_object_object_get_ex(obj, key, &tmp)) {
+    return default_value;
+  }
+  return json_object_get_int(tmp);
+}
+
+std::string loadJsonStringEntry(struct json_object* obj, const char* key, const char* default_value)
+{
+  struct json_object* tmp = NULL;
+  if (!json_object_object_get_ex(obj, key, &tmp)) {
+    return default_value;
+  }
+  return json_object_get_string(tmp);
+}
+
 void put_json(json_object* json_root)
 {
   json_object_put(json_root);
@@ -174,10 +198,20 @@ void KineticIoSingleton::loadConfiguration()
   };
   parseConfiguration(o1);
 
+  /* Shared cache slots have to fit the largest stripe of any configured cluster. */
+  size_t max_stripe_size = 0;
+  for (auto it = clusterInfo.cbegin(); it != clusterInfo.cend(); it++) {
+    max_stripe_size = std::max(max_stripe_size, it->second.numData * it->second.blockSize);
+  }
+
   std::lock_guard<std::mutex> lock(mutex);
+  dataCache.changeConfiguration(configuration.stripecache_capacity, configuration.stripecache_partitions);
   clusterMap.reset(std::move(clusterInfo), std::move(driveInfo));
-  dataCache.changeConfiguration(configuration.stripecache_capacity);
+  clusterMap.reconnectScheduler().changeConfiguration(configuration.max_concurrent_reconnects);
+  clusterMap.socketListener().changeConfiguration(configuration.listener_threads);
+  sharedCache.changeConfiguration(configuration.sharedcache_name, configuration.sharedcache_capacity, max_stripe_size);
   threadPool.changeConfiguration(configuration.background_io_threads, configuration.background_io_queue_capacity);
+  smallFilePacker.changeConfiguration(configuration.pack_threshold, configuration.pack_delay);
 }
 
 std::unordered_map<std::string, std::pair<kinetic::ConnectionOptions, kinetic::ConnectionOptions>> KineticIoSingleton::parseDrives(
@@ -257,6 +291,12 @@ std::unordered_map<std::string, ClusterInformation> KineticIoSingleton::parseClu
 
     cinfo.min_reconnect_interval = std::chrono::seconds(loadJsonIntEntry(cluster, "minReconnectInterval"));
     cinfo.operation_timeout = std::chrono::seconds(loadJsonIntEntry(cluster, "timeout"));
+    cinfo.dedup_min_size = (size_t) loadJsonIntEntry(cluster, "dedupMinSizeKB", 0);
+    cinfo.dedup_min_size *= 1024;
+    cinfo.key_counters = loadJsonIntEntry(cluster, "keyCounters", 0) != 0;
+    cinfo.dedup_grace = std::chrono::seconds(loadJsonIntEntry(cluster, "dedupGraceSeconds", 3600));
+    cinfo.max_queue_depth = (size_t) loadJsonIntEntry(cluster, "maxQueueDepth", 0);
+    cinfo.target_latency = std::chrono::milliseconds(loadJsonIntEntry(cluster, "targetLatencyMs", 0));
 
     struct json_object* list = NULL;
     if (!json_object_object_get_ex(cluster, "drives", &list)) {
@@ -281,9 +321,39 @@ void KineticIoSingleton::parseConfiguration(struct json_object* config)
   configuration.stripecache_capacity = (size_t) loadJsonIntEntry(config, "cacheCapacityMB");
   configuration.stripecache_capacity *= 1024 * 1024;
 
+  configuration.stripecache_partitions.clear();
+  struct json_object* partitions = NULL;
+  if (json_object_object_get_ex(config, "cachePartitions", &partitions)) {
+    int num_partitions = json_object_array_length(partitions);
+    for (int i = 0; i < num_partitions; i++) {
+      auto partition = json_object_array_get_idx(partitions, i);
+      DataCache::PartitionConfiguration p;
+      p.name = loadJsonStringEntry(partition, "name");
+      p.min = (size_t) loadJsonIntEntry(partition, "minMB", 0) * 1024 * 1024;
+      p.max = (size_t) loadJsonIntEntry(partition, "maxMB", 0) * 1024 * 1024;
+      configuration.stripecache_partitions.push_back(p);
+    }
+  }
+
   configuration.readahead_window_size = (size_t) loadJsonIntEntry(config, "maxReadaheadWindow");
   configuration.background_io_threads = loadJsonIntEntry(config, "maxBackgroundIoThreads");
   configuration.background_io_queue_capacity = loadJsonIntEntry(config, "maxBackgroundIoQueue");
+
+  configuration.sharedcache_capacity = (size_t) loadJsonIntEntry(config, "sharedCacheCapacityMB", 0);
+  configuration.sharedcache_capacity *= 1024 * 1024;
+  configuration.sharedcache_name = loadJsonStringEntry(config, "sharedCacheName", "/kineticio");
+
+  configuration.pack_threshold = (size_t) loadJsonIntEntry(config, "smallFilePackingKB", 0);
+  configuration.pack_threshold *= 1024;
+  configuration.pack_delay = std::chrono::milliseconds(loadJsonIntEntry(config, "smallFilePackingDelayMS", 20));
+
+  configuration.max_concurrent_reconnects = (size_t) loadJsonIntEntry(config, "maxConcurrentReconnects", 8);
+  if (!configuration.max_concurrent_reconnects) {
+    kio_error("maxConcurrentReconnects has to be at least 1.");
+    throw std::system_error(std::make_error_code(std::errc::invalid_argument));
+  }
+
+  configuration.listener_threads = (size_t) loadJsonIntEntry(config, "listenerThreads", 1);
 }
 
 size_t KineticIoSingleton::readaheadWindowSize()
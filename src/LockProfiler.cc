@@ -0,0 +1,192 @@
+/************************************************************************
+ * KineticIo - a file io interface library to kinetic devices.          *
+ *                                                                      *
+ * This Source Code Form is subject to the terms of the Mozilla         *
+ * Public License, v. 2.0. If a copy of the MPL was not                 *
+ * distributed with this file, You can obtain one at                    *
+ * https://mozilla.org/MP:/2.0/.                                        *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without       *
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or         *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public             *
+ * License for more details.                                            *
+ ************************************************************************/
+
+#include "LockProfiler.hh"
+#if __GNUC__ == 4 && (__GNUC_MINOR__ == 4)
+    #include <cstdatomic>
+#else
+  #include <atomic>
+#endif
+#include <algorithm>
+#include <cstdlib>
+#include <iomanip>
+#include <map>
+#include <sstream>
+#include <vector>
+
+using namespace kio;
+using namespace std::chrono;
+
+namespace {
+  //! number of wait time histogram buckets: < 1us, < 2us, < 4us, ... and >= 2^(num_buckets-2) us
+  const int num_buckets = 20;
+}
+
+struct LockProfiler::Site {
+  std::string name;
+  std::atomic<uint64_t> acquisitions;
+  std::atomic<uint64_t> contended;
+  std::atomic<uint64_t> wait_ns;
+  std::atomic<uint64_t> max_wait_ns;
+  std::atomic<uint64_t> hold_ns;
+  std::atomic<uint64_t> max_hold_ns;
+  //! wait times of contended acquisitions
+  std::atomic<uint64_t> wait_histogram[num_buckets];
+
+  explicit Site(const std::string& n) : name(n)
+  {
+    clear();
+  }
+
+  void clear()
+  {
+    acquisitions = contended = wait_ns = max_wait_ns = hold_ns = max_hold_ns = 0;
+    for (int i = 0; i < num_buckets; i++) {
+      wait_histogram[i] = 0;
+    }
+  }
+};
+
+namespace {
+  /* Sites are never freed, mutexes of static objects may be used during static destruction. */
+  std::mutex& registry_mutex()
+  {
+    static std::mutex* m = new std::mutex();
+    return *m;
+  }
+
+  std::map<std::string, LockProfiler::Site*>& registry()
+  {
+    static std::map<std::string, LockProfiler::Site*>* r = new std::map<std::string, LockProfiler::Site*>();
+    return *r;
+  }
+
+  std::atomic<bool>& enabled_flag()
+  {
+    static std::atomic<bool> enabled(getenv("KINETICIO_LOCK_PROFILING") != NULL);
+    return enabled;
+  }
+
+  void update_max(std::atomic<uint64_t>& max, uint64_t value)
+  {
+    uint64_t current = max.load();
+    while (value > current && !max.compare_exchange_weak(current, value)) {
+    }
+  }
+
+  bool by_wait_time(const LockProfiler::Site* lhs, const LockProfiler::Site* rhs)
+  {
+    return lhs->wait_ns.load() > rhs->wait_ns.load();
+  }
+}
+
+bool LockProfiler::enabled()
+{
+  return enabled_flag().load();
+}
+
+void LockProfiler::setEnabled(bool enable)
+{
+  enabled_flag() = enable;
+}
+
+LockProfiler::Site* LockProfiler::site(const char* name)
+{
+  if (!enabled()) {
+    return NULL;
+  }
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  auto& site = registry()[name];
+  if (!site) {
+    site = new Site(name);
+  }
+  return site;
+}
+
+void LockProfiler::acquired(Site* site, bool contended, clock::duration wait)
+{
+  site->acquisitions++;
+  if (!contended) {
+    return;
+  }
+  uint64_t ns = duration_cast<nanoseconds>(wait).count();
+  site->contended++;
+  site->wait_ns += ns;
+  update_max(site->max_wait_ns, ns);
+
+  int bucket = 0;
+  for (uint64_t us = ns / 1000; us && bucket < num_buckets - 1; us >>= 1) {
+    bucket++;
+  }
+  site->wait_histogram[bucket]++;
+}
+
+void LockProfiler::released(Site* site, clock::duration hold)
+{
+  uint64_t ns = duration_cast<nanoseconds>(hold).count();
+  site->hold_ns += ns;
+  update_max(site->max_hold_ns, ns);
+}
+
+std::string LockProfiler::report()
+{
+  std::vector<Site*> sites;
+  {
+    std::lock_guard<std::mutex> lock(registry_mutex());
+    for (auto it = registry().cbegin(); it != registry().cend(); it++) {
+      sites.push_back(it->second);
+    }
+  }
+  std::sort(sites.begin(), sites.end(), by_wait_time);
+
+  std::ostringstream out;
+  out << std::fixed << std::setprecision(1);
+  for (auto it = sites.cbegin(); it != sites.cend(); it++) {
+    auto& s = **it;
+    uint64_t acquisitions = s.acquisitions;
+    uint64_t contended = s.contended;
+    out << s.name << ": " << acquisitions << " acquisitions, "
+        << contended << " contended (" << (acquisitions ? 100.0 * contended / acquisitions : 0.0) << "%)" << std::endl
+        << "  wait: total " << s.wait_ns / 1000000.0 << " ms, avg " << (contended ? s.wait_ns / 1000.0 / contended : 0.0)
+        << " us, max " << s.max_wait_ns / 1000.0 << " us" << std::endl
+        << "  hold: total " << s.hold_ns / 1000000.0 << " ms, avg " << (acquisitions ? s.hold_ns / 1000.0 / acquisitions : 0.0)
+        << " us, max " << s.max_hold_ns / 1000.0 << " us" << std::endl;
+
+    if (contended) {
+      out << "  contended wait histogram:";
+      for (int i = 0; i < num_buckets; i++) {
+        uint64_t count = s.wait_histogram[i];
+        if (!count) {
+          continue;
+        }
+        if (i == num_buckets - 1) {
+          out << " >=" << (1ull << (i - 1)) << "us:" << count;
+        } else {
+          out << " <" << (1ull << i) << "us:" << count;
+        }
+      }
+      out << std::endl;
+    }
+  }
+  return out.str();
+}
+
+void LockProfiler::reset()
+{
+  std::lock_guard<std::mutex> lock(registry_mutex());
+  for (auto it = registry().begin(); it != registry().end(); it++) {
+    it->second->clear();
+  }
+}
@@ -0,0 +1,195 @@
+/************************************************************************
+ * KineticIo - a file io interface library to kinetic devices.          *
+ *                                                                      *
+ * This Source Code Form is subject to the terms of the Mozilla         *
+ * Public License, v. 2.0. If a copy of the MPL was not                 *
+ * distributed with this file, You can obtain one at                    *
+ * https://mozilla.org/MP:/2.0/.                                        *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without       *
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or         *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public             *
+ * License for more details.                                            *
+ ************************************************************************/
+
+#include "ReconnectScheduler.hh"
+#include "KineticAutoConnection.hh"
+#include <algorithm>
+#include <thread>
+#include <Logging.hh>
+
+using namespace kio;
+
+/* The backoff doubles with every consecutive failure up to ratelimit * 2^max_backoff_exponent. */
+static const std::size_t max_backoff_exponent = 6;
+
+ReconnectScheduler::ReconnectScheduler(std::size_t c) :
+    concurrency(std::max<std::size_t>(c, 1)), workers(0), shutdown(false), attempts(0), failures(0), mt(),
+    mutex("ReconnectScheduler::mutex")
+{
+  std::random_device rd;
+  mt.seed(rd());
+
+  std::lock_guard<ProfiledMutex> lock(mutex);
+  for (; workers < concurrency; workers++) {
+    std::thread(&ReconnectScheduler::worker, this).detach();
+  }
+}
+
+ReconnectScheduler::~ReconnectScheduler()
+{
+  std::unique_lock<ProfiledMutex> lock(mutex);
+  shutdown = true;
+  worker_cv.notify_all();
+  while (workers) {
+    done_cv.wait(lock);
+  }
+}
+
+void ReconnectScheduler::changeConfiguration(std::size_t c)
+{
+  std::lock_guard<ProfiledMutex> lock(mutex);
+  concurrency = std::max<std::size_t>(c, 1);
+  /* Surplus workers exit on their own after being woken up. */
+  for (; workers < concurrency; workers++) {
+    std::thread(&ReconnectScheduler::worker, this).detach();
+  }
+  worker_cv.notify_all();
+}
+
+void ReconnectScheduler::request(KineticAutoConnection* connection, std::chrono::seconds ratelimit)
+{
+  std::lock_guard<ProfiledMutex> lock(mutex);
+  auto& entry = entries[connection];
+  entry.ratelimit = ratelimit;
+  entry.waiting++;
+
+  if (!entry.queued && !entry.running) {
+    entry.queued = true;
+    if (entry.next_attempt <= std::chrono::system_clock::now()) {
+      worker_cv.notify_one();
+    }
+    kio_debug(connection->getName(), " Scheduled background reconnect after ", entry.failures,
+              " consecutive failed attempts.");
+  }
+}
+
+void ReconnectScheduler::attempted(KineticAutoConnection* connection, std::chrono::seconds ratelimit, bool success)
+{
+  std::lock_guard<ProfiledMutex> lock(mutex);
+  auto& entry = entries[connection];
+  entry.ratelimit = ratelimit;
+  completed(entry, success);
+}
+
+void ReconnectScheduler::cancel(KineticAutoConnection* connection)
+{
+  std::unique_lock<ProfiledMutex> lock(mutex);
+  auto it = entries.find(connection);
+  while (it != entries.end() && it->second.running) {
+    done_cv.wait(lock);
+    it = entries.find(connection);
+  }
+  if (it != entries.end()) {
+    entries.erase(it);
+  }
+}
+
+ReconnectScheduler::Statistics ReconnectScheduler::stats()
+{
+  std::lock_guard<ProfiledMutex> lock(mutex);
+  Statistics s;
+  s.attempts = attempts;
+  s.failures = failures;
+  s.pending = s.running = s.backing_off = 0;
+  for (auto it = entries.cbegin(); it != entries.cend(); it++) {
+    if (it->second.queued) {
+      s.pending++;
+    }
+    if (it->second.running) {
+      s.running++;
+    }
+    if (it->second.failures) {
+      s.backing_off++;
+    }
+  }
+  return s;
+}
+
+void ReconnectScheduler::completed(Entry& entry, bool success)
+{
+  using namespace std::chrono;
+  attempts++;
+  entry.waiting = 0;
+
+  if (success) {
+    entry.failures = 0;
+    entry.next_attempt = system_clock::now() + entry.ratelimit;
+    return;
+  }
+
+  failures++;
+  entry.failures++;
+  auto max = duration_cast<milliseconds>(entry.ratelimit).count() <<
+             std::min(entry.failures - 1, max_backoff_exponent);
+  /* Jitter uniformly between half and full backoff. */
+  auto backoff = max ? max / 2 + static_cast<int64_t>(mt() % (max / 2 + 1)) : 0;
+  entry.next_attempt = system_clock::now() + milliseconds(backoff);
+}
+
+void ReconnectScheduler::worker()
+{
+  using namespace std::chrono;
+  std::unique_lock<ProfiledMutex> lock(mutex);
+
+  while (!shutdown && workers <= concurrency) {
+    auto now = system_clock::now();
+    auto wakeup = now + seconds(1);
+
+    /* Pick the due connection with the most requests, the longest waiting one on ties. */
+    auto next = entries.end();
+    for (auto it = entries.begin(); it != entries.end(); it++) {
+      auto& entry = it->second;
+      if (!entry.queued || entry.running) {
+        continue;
+      }
+      if (entry.next_attempt > now) {
+        wakeup = std::min(wakeup, entry.next_attempt);
+        continue;
+      }
+      if (next == entries.end() || entry.waiting > next->second.waiting ||
+          (entry.waiting == next->second.waiting && entry.next_attempt < next->second.next_attempt)) {
+        next = it;
+      }
+    }
+
+    if (next == entries.end()) {
+      worker_cv.wait_until(lock, wakeup);
+      continue;
+    }
+
+    auto connection = next->first;
+    next->second.queued = false;
+    next->second.running = true;
+    lock.unlock();
+
+    bool success = false;
+    try {
+      success = connection->connect();
+    }
+    catch (const std::exception& e) {
+      kio_warning("Exception during reconnect of ", connection->getName(), ": ", e.what());
+    }
+
+    lock.lock();
+    /* cancel() waits for running attempts, the entry still exists. */
+    auto& entry = entries.at(connection);
+    entry.running = false;
+    completed(entry, success);
+    done_cv.notify_all();
+  }
+
+  workers--;
+  done_cv.notify_all();
+}
@@ -15,7 +15,9 @@
 
 #include "RedundancyProvider.hh"
 #include "Utility.hh"
+#include "Tracepoints.hh"
 #include <isa-l.h>
+#include <algorithm>
 
 using std::string;
 using std::make_shared;
@@ -103,7 +105,8 @@ static int gf_gen_decode_matrix(
 }
 
 RedundancyProvider::RedundancyProvider(std::size_t data, std::size_t parity) :
-    nData(data), nParity(parity), encode_matrix((nData + nParity) * nData)
+    nData(data), nParity(parity), encode_matrix((nData + nParity) * nData),
+    mutex("RedundancyProvider::mutex")
 {
   // k = data
   // m = data + parity
@@ -157,7 +160,7 @@ RedundancyProvider::CodingTable& RedundancyProvider::getCodingTable(
     const std::string& pattern
 )
 {
-  std::lock_guard<std::mutex> lock(mutex);
+  std::lock_guard<ProfiledMutex> lock(mutex);
 
   /* If decode matrix is not already cached we have to construct it. */
   if (!cache.count(pattern)) {
@@ -236,6 +239,7 @@ void RedundancyProvider::compute(std::vector<std::shared_ptr<const std::string>
 
   /* normal operation: erasure coding */
   auto& dd = getCodingTable(pattern);
+  KIO_TRACE2(stripe_compute_entry, dd.nErrors, stripe[dd.blockIndices[0]]->size());
 
   unsigned char* inbuf[nData];
   for (size_t i = 0; i < nData; i++) {
@@ -268,6 +272,133 @@ void RedundancyProvider::compute(std::vector<std::shared_ptr<const std::string>
       e++;
     }
   }
+  KIO_TRACE1(stripe_compute_return, dd.nErrors);
+}
+
+std::string RedundancyProvider::getErrorPattern(
+    const std::vector<std::size_t>& erasures
+) const
+{
+  using utility::Convert;
+
+  std::string pattern(nData + nParity, 0);
+  for (auto it = erasures.cbegin(); it != erasures.cend(); it++) {
+    if (*it >= pattern.size()) {
+      throw std::invalid_argument(Convert::toString(
+          "ErasureCoding: Illegal block index ", *it, " for stripe size ", pattern.size()
+      ));
+    }
+    pattern[*it] = 1;
+  }
+  if (erasures.size() > nParity) {
+    throw std::invalid_argument(Convert::toString(
+        "ErasureCoding: More errors than parity blocks. ", erasures.size(), " errors, ", nParity, " parities."
+    ));
+  }
+  return pattern;
+}
+
+std::unique_ptr<RedundancyProvider::Decoder> RedundancyProvider::makeDecoder(
+    const std::vector<std::size_t>& erasures, std::size_t blockSize
+)
+{
+  std::string pattern = getErrorPattern(erasures);
+
+  /* in case of a single data block use replication: the first healthy block is the only source. */
+  if (nData == 1 || !erasures.size()) {
+    std::vector<unsigned int> sources;
+    for (unsigned int i = 0; i < pattern.size() && sources.size() < nData; i++) {
+      if (!pattern[i]) {
+        sources.push_back(i);
+      }
+    }
+    return std::unique_ptr<Decoder>(new Decoder(pattern, NULL, sources, blockSize));
+  }
+
+  auto& dd = getCodingTable(pattern);
+  return std::unique_ptr<Decoder>(new Decoder(pattern, &dd, dd.blockIndices, blockSize));
+}
+
+RedundancyProvider::Decoder::Decoder(const std::string& pattern, const CodingTable* table,
+                                     std::vector<unsigned int> sources, std::size_t blockSize) :
+    pattern(pattern), table(table), blockIndices(std::move(sources)), blockSize(blockSize),
+    added(blockIndices.size(), false), memory(table ? table->nErrors * blockSize : 0)
+{
+}
+
+const std::vector<unsigned int>& RedundancyProvider::Decoder::sources() const
+{
+  return blockIndices;
+}
+
+void RedundancyProvider::Decoder::add(std::size_t index, const std::shared_ptr<const std::string>& block)
+{
+  using utility::Convert;
+
+  auto source = std::find(blockIndices.cbegin(), blockIndices.cend(), index);
+  if (source == blockIndices.cend()) {
+    throw std::invalid_argument(Convert::toString("ErasureCoding: Block ", index, " is not a decoding source."));
+  }
+  if (!block || (block->size() && block->size() != blockSize)) {
+    throw std::invalid_argument(Convert::toString(
+        "ErasureCoding: Expected block size of ", blockSize, " bytes, observed ", block ? block->size() : 0, " bytes."
+    ));
+  }
+  auto vec_i = source - blockIndices.cbegin();
+  if (added[vec_i]) {
+    return;
+  }
+  added[vec_i] = true;
+
+  if (!table) {
+    replica = block;
+    return;
+  }
+
+  /* A 0ed block does not contribute to the result. */
+  if (block->empty()) {
+    return;
+  }
+
+  unsigned char* outbuf[table->nErrors];
+  for (int i = 0; i < table->nErrors; i++) {
+    outbuf[i] = &memory[i * blockSize];
+  }
+
+  ec_encode_data_update(
+      static_cast<int>(blockSize),             // Length of each block of data (vector) of source or destination data.
+      static_cast<int>(blockIndices.size()),   // The number of vector sources in the generator matrix for coding.
+      table->nErrors,                          // The number of output vectors to concurrently encode/decode.
+      static_cast<int>(vec_i),                 // The vector index corresponding to the single input source.
+      const_cast<unsigned char*>(table->table.data()), // Pointer to array of input tables
+      (unsigned char*) block->c_str(),         // Pointer to single input source used to update output parity.
+      outbuf                                   // Array of pointers to coded output buffers
+  );
+}
+
+void RedundancyProvider::Decoder::finish(std::vector<std::shared_ptr<const std::string> >& stripe)
+{
+  if (stripe.size() != pattern.size()) {
+    throw std::invalid_argument(utility::Convert::toString(
+        "ErasureCoding: Illegal stripe size. Expected ", pattern.size(), ", observed ", stripe.size()
+    ));
+  }
+  if (std::find(added.cbegin(), added.cend(), false) != added.cend()) {
+    throw std::logic_error("ErasureCoding: Not all decoding sources have been added.");
+  }
+
+  int e = 0;
+  for (size_t i = 0; i < pattern.size(); i++) {
+    if (pattern[i]) {
+      if (table) {
+        stripe[i] = make_shared<const string>(reinterpret_cast<char*>(&memory[e * blockSize]), blockSize);
+        e++;
+      }
+      else {
+        stripe[i] = replica && replica->size() ? replica : make_shared<const string>(blockSize, '\0');
+      }
+    }
+  }
 }
 
 const std::size_t& RedundancyProvider::numData() const
@@ -0,0 +1,335 @@
+/************************************************************************
+ * KineticIo - a file io interface library to kinetic devices.          *
+ *                                                                      *
+ * This Source Code Form is subject to the terms of the Mozilla         *
+ * Public License, v. 2.0. If a copy of the MPL was not                 *
+ * distributed with this file, You can obtain one at                    *
+ * https://mozilla.org/MP:/2.0/.                                        *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without       *
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or         *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public             *
+ * License for more details.                                            *
+ ************************************************************************/
+
+#include "SharedBlockCache.hh"
+#include "Logging.hh"
+#include "outside/MurmurHash3.h"
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <pthread.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <algorithm>
+#include <limits>
+
+using std::string;
+using std::chrono::system_clock;
+using std::chrono::milliseconds;
+using std::chrono::duration_cast;
+using namespace kio;
+
+namespace {
+  //! marks a fully initialized segment, changes with the locking protocol
+  const uint64_t segment_magic = 0x6b696f73686d3032ULL;
+  //! maximum supported key length, equals the kinetic protocol limit
+  const size_t max_key_length = 4096;
+  //! maximum supported version length
+  const size_t max_version_length = 128;
+  //! header size is padded to keep slots aligned
+  const size_t header_size = 64;
+
+  int64_t toMilliseconds(const system_clock::time_point& t)
+  {
+    return duration_cast<milliseconds>(t.time_since_epoch()).count();
+  }
+}
+
+struct SharedBlockCache::Segment {
+  //! set last during initialization, attaching processes wait for it
+  volatile uint64_t magic;
+  //! the maximum value size of a slot
+  uint64_t slot_size;
+  //! the number of slots in the segment
+  uint64_t num_slots;
+};
+
+struct SharedBlockCache::Slot {
+  //! process-shared (and where available robust) mutex, the mutex of the
+  //! first slot of a set protects all slots of the set
+  pthread_mutex_t mutex;
+  //! time the entry was last verified against the backend, in ms since epoch
+  int64_t verified;
+  //! hash of the key, to skip most key comparisons
+  uint32_t hash;
+  //! length of the key, 0 if the slot is empty
+  uint32_t key_length;
+  //! length of the version
+  uint32_t version_length;
+  //! length of the value stored in the slot data area
+  uint64_t value_length;
+  //! the data key
+  char key[max_key_length];
+  //! the version of the value
+  char version[max_version_length];
+};
+
+const size_t SharedBlockCache::npos = static_cast<size_t>(-1);
+const size_t SharedBlockCache::associativity = 4;
+
+SharedBlockCache::SharedBlockCache() : segment(NULL), mapping_size(0)
+{
+}
+
+SharedBlockCache::~SharedBlockCache()
+{
+  Segment* s = segment;
+  if (s) {
+    munmap(s, mapping_size);
+  }
+}
+
+bool SharedBlockCache::enabled() const
+{
+  return segment.load() != NULL;
+}
+
+SharedBlockCache::Slot* SharedBlockCache::slot(size_t index) const
+{
+  char* base = reinterpret_cast<char*>(segment.load());
+  return reinterpret_cast<Slot*>(base + header_size + index * sizeof(Slot));
+}
+
+char* SharedBlockCache::data(size_t index) const
+{
+  Segment* s = segment;
+  char* base = reinterpret_cast<char*>(s);
+  return base + header_size + s->num_slots * sizeof(Slot) + index * s->slot_size;
+}
+
+size_t SharedBlockCache::setSize() const
+{
+  return std::min<size_t>(associativity, segment.load()->num_slots);
+}
+
+bool SharedBlockCache::lock(size_t index)
+{
+  size_t first = index - index % setSize();
+  Slot* s = slot(first);
+  int rc = pthread_mutex_lock(&s->mutex);
+#ifdef __linux__
+  /* The previous owner died holding the lock, the content of the set can not be trusted. */
+  if (rc == EOWNERDEAD) {
+    kio_notice("Recovering shared cache set abandoned by a terminated process.");
+    for (size_t i = first; i < first + setSize(); i++) {
+      slot(i)->key_length = 0;
+    }
+    rc = pthread_mutex_consistent(&s->mutex);
+  }
+#endif
+  /* If the lock can not be recovered (ENOTRECOVERABLE), the set stays unusable and every access misses. */
+  if (rc) {
+    kio_debug("Failed locking shared cache set ", first, ", rc=", rc);
+    return false;
+  }
+  return true;
+}
+
+void SharedBlockCache::unlock(size_t index)
+{
+  pthread_mutex_unlock(&slot(index - index % setSize())->mutex);
+}
+
+size_t SharedBlockCache::lockSlot(const std::string& key, bool evict)
+{
+  uint32_t hash;
+  MurmurHash3_x86_32(key.c_str(), static_cast<int>(key.length()), 0, &hash);
+
+  size_t set_size = setSize();
+  size_t first = (hash % (segment.load()->num_slots / set_size)) * set_size;
+
+  /* A single lock protects the whole set, so that looking up the key and choosing a victim for it is atomic and
+   * concurrent puts of the same key can not end up in different slots. */
+  if (!lock(first)) {
+    return npos;
+  }
+
+  size_t victim = first;
+  int64_t victim_verified = std::numeric_limits<int64_t>::max();
+
+  for (size_t i = first; i < first + set_size; i++) {
+    Slot* s = slot(i);
+    if (s->key_length == key.length() && s->hash == hash && memcmp(s->key, key.c_str(), key.length()) == 0) {
+      return i;
+    }
+    int64_t verified = s->key_length ? s->verified : std::numeric_limits<int64_t>::min();
+    if (verified < victim_verified) {
+      victim_verified = verified;
+      victim = i;
+    }
+  }
+
+  if (!evict) {
+    unlock(first);
+    return npos;
+  }
+  return victim;
+}
+
+bool SharedBlockCache::get(const std::string& key,
+                           std::shared_ptr<const std::string>& version,
+                           std::shared_ptr<const std::string>& value,
+                           std::chrono::system_clock::time_point& timestamp)
+{
+  if (!enabled() || key.length() > max_key_length) {
+    return false;
+  }
+
+  size_t index = lockSlot(key, false);
+  if (index == npos) {
+    return false;
+  }
+  Slot* s = slot(index);
+  version = std::make_shared<const string>(s->version, s->version_length);
+  value = std::make_shared<const string>(data(index), s->value_length);
+  timestamp = system_clock::time_point(milliseconds(s->verified));
+  unlock(index);
+
+  kio_debug("Serving key ", key, " from shared cache.");
+  return true;
+}
+
+void SharedBlockCache::put(const std::string& key, const std::string& version, const std::string& value)
+{
+  if (!enabled() || key.length() > max_key_length || version.length() > max_version_length ||
+      value.length() > segment.load()->slot_size) {
+    return;
+  }
+
+  size_t index = lockSlot(key, true);
+  if (index == npos) {
+    return;
+  }
+  Slot* s = slot(index);
+  MurmurHash3_x86_32(key.c_str(), static_cast<int>(key.length()), 0, &s->hash);
+  s->key_length = static_cast<uint32_t>(key.length());
+  memcpy(s->key, key.c_str(), key.length());
+  s->version_length = static_cast<uint32_t>(version.length());
+  memcpy(s->version, version.c_str(), version.length());
+  s->value_length = value.length();
+  memcpy(data(index), value.c_str(), value.length());
+  s->verified = toMilliseconds(system_clock::now());
+  unlock(index);
+}
+
+void SharedBlockCache::touch(const std::string& key, const std::string& version)
+{
+  if (!enabled() || key.length() > max_key_length) {
+    return;
+  }
+
+  size_t index = lockSlot(key, false);
+  if (index == npos) {
+    return;
+  }
+  Slot* s = slot(index);
+  if (s->version_length == version.length() && memcmp(s->version, version.c_str(), version.length()) == 0) {
+    s->verified = toMilliseconds(system_clock::now());
+  }
+  unlock(index);
+}
+
+void SharedBlockCache::changeConfiguration(const std::string& name, size_t capacity, size_t slot_size)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  if (enabled()) {
+    Segment* s = segment;
+    if (s->num_slots != capacity / slot_size || s->slot_size != slot_size) {
+      kio_notice("Shared cache segment is already attached, configuration change requires a restart.");
+    }
+    return;
+  }
+  if (!capacity || !slot_size || capacity < slot_size) {
+    return;
+  }
+
+  size_t num_slots = capacity / slot_size;
+  size_t size = header_size + num_slots * (sizeof(Slot) + slot_size);
+
+  bool creator = true;
+  int fd = shm_open(name.c_str(), O_RDWR | O_CREAT | O_EXCL, 0600);
+  if (fd < 0 && errno == EEXIST) {
+    creator = false;
+    fd = shm_open(name.c_str(), O_RDWR, 0600);
+  }
+  if (fd < 0) {
+    kio_warning("Failed opening shared cache segment ", name, ", errno=", errno);
+    return;
+  }
+
+  /* The creating process sizes the segment, wait for it if it has not done so yet. */
+  struct stat st;
+  if (creator) {
+    if (ftruncate(fd, size)) {
+      kio_warning("Failed sizing shared cache segment ", name, " to ", size, " bytes, errno=", errno);
+      close(fd);
+      shm_unlink(name.c_str());
+      return;
+    }
+  }
+  for (int i = 0; !creator && !fstat(fd, &st) && st.st_size == 0 && i < 1000; i++) {
+    usleep(1000);
+  }
+  if (!creator && (fstat(fd, &st) || static_cast<size_t>(st.st_size) != size)) {
+    kio_warning("Shared cache segment ", name, " exists with a different geometry, shared cache disabled.");
+    close(fd);
+    return;
+  }
+
+  void* mapping = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+  close(fd);
+  if (mapping == MAP_FAILED) {
+    kio_warning("Failed mapping shared cache segment ", name, ", errno=", errno);
+    return;
+  }
+  Segment* s = static_cast<Segment*>(mapping);
+
+  if (creator) {
+    s->slot_size = slot_size;
+    s->num_slots = num_slots;
+    pthread_mutexattr_t attr;
+    pthread_mutexattr_init(&attr);
+    pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+#ifdef __linux__
+    pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+#endif
+    char* slots = static_cast<char*>(mapping) + header_size;
+    for (size_t i = 0; i < num_slots; i++) {
+      Slot* sl = reinterpret_cast<Slot*>(slots + i * sizeof(Slot));
+      pthread_mutex_init(&sl->mutex, &attr);
+      sl->key_length = 0;
+      sl->verified = 0;
+    }
+    pthread_mutexattr_destroy(&attr);
+    __sync_synchronize();
+    s->magic = segment_magic;
+  }
+  else {
+    for (int i = 0; s->magic != segment_magic && i < 1000; i++) {
+      usleep(1000);
+    }
+    __sync_synchronize();
+    if (s->magic != segment_magic || s->slot_size != slot_size || s->num_slots != num_slots) {
+      kio_warning("Shared cache segment ", name, " is not usable, shared cache disabled.");
+      munmap(mapping, size);
+      return;
+    }
+  }
+
+  mapping_size = size;
+  segment = s;
+  kio_notice("Attached shared cache segment ", name, " with ", num_slots, " slots of ", slot_size, " bytes.");
+}
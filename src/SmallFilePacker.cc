@@ -0,0 +1,482 @@
+/************************************************************************
+ * KineticIo - a file io interface library to kinetic devices.          *
+ *                                                                      *
+ * This Source Code Form is subject to the terms of the Mozilla         *
+ * Public License, v. 2.0. If a copy of the MPL was not                 *
+ * distributed with this file, You can obtain one at                    *
+ * https://mozilla.org/MP:/2.0/.                                        *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without       *
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or         *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public             *
+ * License for more details.                                            *
+ ************************************************************************/
+
+#include "SmallFilePacker.hh"
+#include "KineticIoSingleton.hh"
+#include "DataBlock.hh"
+#include "Utility.hh"
+#include "Logging.hh"
+#include <sstream>
+#include <thread>
+
+using std::shared_ptr;
+using std::make_shared;
+using std::string;
+using std::chrono::system_clock;
+using kinetic::KineticStatus;
+using kinetic::StatusCode;
+using namespace kio;
+
+namespace {
+  //! metadata values of packed files start with this tag
+  const string location_tag("kio-pack");
+  //! packs are stored as hidden files with this path prefix
+  const string pack_prefix(".kio-pack/");
+  //! name of the pack attribute storing the pack index
+  const string index_attribute("pack-index");
+  //! number of recently read packs to keep
+  const size_t recent_capacity = 8;
+
+  string locationToString(const SmallFilePacker::Location& location)
+  {
+    return utility::Convert::toString(location_tag, " ", location.offset, " ", location.length, " ", location.pack);
+  }
+}
+
+SmallFilePacker::SmallFilePacker() : max_file_size(0), delay(0), running(false), shutdown(false)
+{
+}
+
+SmallFilePacker::~SmallFilePacker()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  shutdown = true;
+  cv.notify_all();
+  while (running) {
+    done_cv.wait(lock);
+  }
+}
+
+size_t SmallFilePacker::threshold() const
+{
+  return max_file_size;
+}
+
+void SmallFilePacker::changeConfiguration(size_t threshold, std::chrono::milliseconds d)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  max_file_size = threshold;
+  delay = d;
+
+  /* Closed files are stored in their own data keys, nothing is lost by not packing them. */
+  if (!threshold) {
+    batches.clear();
+    ready.clear();
+  }
+  else if (!running) {
+    running = true;
+    std::thread(&SmallFilePacker::worker, this).detach();
+  }
+  cv.notify_all();
+}
+
+bool SmallFilePacker::parse(const std::string& metadata_value, Location& location)
+{
+  if (metadata_value.compare(0, location_tag.length(), location_tag) != 0) {
+    return false;
+  }
+  std::istringstream ss(metadata_value.substr(location_tag.length()));
+  Location l;
+  ss >> l.offset >> l.length >> l.pack;
+  if (ss.fail() || l.pack.empty()) {
+    kio_warning("Invalid pack location in metadata value: ", metadata_value);
+    return false;
+  }
+  location = l;
+  return true;
+}
+
+void SmallFilePacker::schedule(const std::shared_ptr<ClusterInterface>& cluster,
+                               const std::string& path,
+                               const std::string& base,
+                               const std::shared_ptr<const std::string>& value,
+                               const std::shared_ptr<const std::string>& metadata_version)
+{
+  auto capacity = cluster->limits().max_value_size;
+  std::lock_guard<std::mutex> lock(mutex);
+  if (!max_file_size || value->size() > max_file_size || value->size() > capacity) {
+    return;
+  }
+  auto& open = batches[cluster->instanceId()];
+
+  /* If the value doesn't fit the currently filled pack anymore, the pack will be written as is. */
+  if (open && open->value.size() + value->size() > capacity) {
+    ready.push_back(open);
+    open.reset();
+  }
+  if (!open) {
+    open = make_shared<Batch>();
+    open->cluster = cluster;
+    open->pack = pack_prefix + utility::uuidGenerateString();
+    open->started = system_clock::now();
+  }
+  open->entries.push_back(Entry(path, base, open->value.size(), value->size(), metadata_version));
+  open->value.append(*value);
+
+  /* Once another file of the maximum packed size might not fit anymore, the pack is written without waiting. */
+  if (open->value.size() + max_file_size > capacity) {
+    ready.push_back(open);
+    open.reset();
+  }
+  cv.notify_all();
+}
+
+void SmallFilePacker::worker()
+{
+  std::unique_lock<std::mutex> lock(mutex);
+  while (!shutdown) {
+    auto now = system_clock::now();
+    auto wakeup = now + std::chrono::seconds(1);
+
+    /* A pack is written once the delay since its first file has passed, even if it is not full. */
+    for (auto it = batches.begin(); it != batches.end(); it++) {
+      if (it->second && it->second->started + delay <= now) {
+        ready.push_back(it->second);
+        it->second.reset();
+      }
+      else if (it->second) {
+        wakeup = std::min(wakeup, it->second->started + delay);
+      }
+    }
+
+    if (!ready.empty()) {
+      auto batch = ready.front();
+      ready.pop_front();
+      lock.unlock();
+      auto written = writeClosed(*batch);
+      lock.lock();
+
+      /* Readers verify the metadata of small files within the expiration time of their cached data. Delaying the
+       * removal until then ensures they notice the file has been packed before its data key disappears. */
+      if (written) {
+        removals.push_back(std::make_pair(system_clock::now() + DataBlock::expiration_time, written));
+      }
+      continue;
+    }
+
+    if (!removals.empty() && removals.front().first <= now) {
+      auto batch = removals.front().second;
+      removals.pop_front();
+      lock.unlock();
+      removeClosed(*batch);
+      lock.lock();
+      continue;
+    }
+    if (!removals.empty()) {
+      wakeup = std::min(wakeup, removals.front().first);
+    }
+    cv.wait_until(lock, wakeup);
+  }
+
+  /* The packed files are referenced from their packs already, don't leave their former data keys behind. */
+  while (!removals.empty()) {
+    auto batch = removals.front().second;
+    removals.pop_front();
+    lock.unlock();
+    removeClosed(*batch);
+    lock.lock();
+  }
+  running = false;
+  done_cv.notify_all();
+}
+
+std::shared_ptr<SmallFilePacker::Batch> SmallFilePacker::writeClosed(const Batch& batch)
+{
+  auto& cluster = batch.cluster;
+  auto written = make_shared<Batch>();
+  written->cluster = cluster;
+  written->pack = batch.pack;
+  written->started = batch.started;
+
+  /* Only pack files still storing the content they have been closed with. The version of their data key is
+   * remembered, so that a write after this point prevents removing it. */
+  for (auto it = batch.entries.cbegin(); it != batch.entries.cend(); it++) {
+    shared_ptr<const string> data_version;
+    shared_ptr<const string> data_value;
+    auto status = cluster->get(utility::makeDataKey(cluster->id(), it->base, 0), data_version, data_value);
+    size_t data_size = data_value ? data_value->size() : 0;
+    if (!status.ok() || data_size != it->length ||
+        (data_size && data_value->compare(0, data_size, batch.value, it->offset, it->length) != 0)) {
+      kio_debug("File ", it->path, " changed after it has been closed, not packing it: ", status);
+      continue;
+    }
+    written->entries.push_back(
+        Entry(it->path, it->base, written->value.size(), it->length, it->metadata_version, data_version)
+    );
+    written->value.append(batch.value, it->offset, it->length);
+  }
+  if (written->entries.empty()) {
+    return shared_ptr<Batch>();
+  }
+
+  write(*written);
+  return written;
+}
+
+void SmallFilePacker::removeClosed(const Batch& batch)
+{
+  auto& cluster = batch.cluster;
+  for (auto it = batch.entries.cbegin(); it != batch.entries.cend(); it++) {
+    if (!it->status.ok()) {
+      continue;
+    }
+    auto status = cluster->remove(utility::makeDataKey(cluster->id(), it->base, 0), it->data_version);
+    if (status.ok() || status.statusCode() == StatusCode::REMOTE_NOT_FOUND) {
+      continue;
+    }
+    if (status.statusCode() != StatusCode::REMOTE_VERSION_MISMATCH) {
+      kio_warning("Failed removing data key of packed file ", it->path, ": ", status);
+      continue;
+    }
+
+    /* Written by a handle that did not notice the file has been packed, the data key is up to date. Unless the
+     * metadata has been changed in the meantime (e.g. by unpacking the file), stop referencing the pack. */
+    shared_ptr<const string> version;
+    status = cluster->put(
+        utility::makeMetadataKey(cluster->id(), it->path),
+        it->metadata_version,
+        make_shared<const string>(utility::makeBaseReference(it->path, it->base)),
+        version
+    );
+    if (status.ok()) {
+      Location location;
+      location.pack = batch.pack;
+      location.offset = it->offset;
+      location.length = it->length;
+      release(cluster, location);
+    }
+    kio_debug("Data key of packed file ", it->path, " has been written after packing: ", status);
+  }
+}
+
+void SmallFilePacker::write(Batch& batch)
+{
+  auto& cluster = batch.cluster;
+  auto pack_key = utility::makeDataKey(cluster->id(), batch.pack, 0);
+  auto index_key = utility::makeAttributeKey(cluster->id(), batch.pack, index_attribute);
+
+  std::ostringstream index;
+  for (auto it = batch.entries.cbegin(); it != batch.entries.cend(); it++) {
+    index << it->offset << " " << it->length << " " << it->path << "\n";
+  }
+
+  /* The pack and its index have to exist before any metadata key references them. */
+  shared_ptr<const string> version;
+  auto status = cluster->put(pack_key, make_shared<const string>(), make_shared<const string>(batch.value), version);
+  if (status.ok()) {
+    status = cluster->put(index_key, make_shared<const string>(index.str()), version);
+  }
+  if (!status.ok()) {
+    kio_error("Failed writing pack ", batch.pack, " with ", batch.entries.size(), " entries: ", status);
+    for (auto it = batch.entries.begin(); it != batch.entries.end(); it++) {
+      it->status = status;
+    }
+    return;
+  }
+
+  size_t stored = 0;
+  for (auto it = batch.entries.begin(); it != batch.entries.end(); it++) {
+    Location location;
+    location.pack = batch.pack;
+    location.offset = it->offset;
+    location.length = it->length;
+
+    /* The attributes of the file remain stored under its base, keep referencing it. */
+    auto metadata = locationToString(location);
+    auto reference = utility::makeBaseReference(it->path, it->base);
+    if (!reference.empty()) {
+      metadata += "\n" + reference;
+    }
+
+    it->status = cluster->put(
+        utility::makeMetadataKey(cluster->id(), it->path),
+        it->metadata_version,
+        make_shared<const string>(metadata),
+        it->metadata_version
+    );
+    if (it->status.ok()) {
+      stored++;
+    }
+    else {
+      kio_warning("Failed referencing pack ", batch.pack, " from metadata of ", it->path, ": ", it->status);
+    }
+  }
+  kio_debug("Wrote pack ", batch.pack, " storing ", stored, " of ", batch.entries.size(), " files in ",
+            batch.value.size(), " bytes.");
+
+  /* Nothing references the pack, no need to wait for compaction to remove it. */
+  if (!stored) {
+    cluster->remove(index_key);
+    cluster->remove(pack_key);
+  }
+}
+
+KineticStatus SmallFilePacker::read(const std::shared_ptr<ClusterInterface>& cluster,
+                                    const Location& location,
+                                    std::shared_ptr<const std::string>& value)
+{
+  auto pack_key = utility::makeDataKey(cluster->id(), location.pack, 0);
+  shared_ptr<const string> pack_value;
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = recent.begin(); it != recent.end(); it++) {
+      if (it->first == *pack_key) {
+        pack_value = it->second;
+        recent.splice(recent.begin(), recent, it);
+        break;
+      }
+    }
+  }
+
+  if (!pack_value) {
+    shared_ptr<const string> version;
+    auto status = cluster->get(pack_key, version, pack_value);
+    if (!status.ok()) {
+      return status;
+    }
+    std::lock_guard<std::mutex> lock(mutex);
+    recent.push_front(std::make_pair(*pack_key, pack_value));
+    if (recent.size() > recent_capacity) {
+      recent.pop_back();
+    }
+  }
+
+  if (!pack_value || location.offset + location.length > pack_value->size()) {
+    kio_error("Pack ", location.pack, " does not contain requested range offset=", location.offset,
+              " length=", location.length);
+    return KineticStatus(StatusCode::CLIENT_INTERNAL_ERROR, "invalid pack location");
+  }
+  value = make_shared<const string>(*pack_value, location.offset, location.length);
+  return KineticStatus(StatusCode::OK, "");
+}
+
+void SmallFilePacker::release(const std::shared_ptr<ClusterInterface>& cluster, const Location& location)
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  auto& size = released[cluster->id() + location.pack];
+  size += location.length;
+
+  /* If the compaction can't be scheduled, keep the count so that the next release of the pack tries again. */
+  if (size > cluster->limits().max_value_size / 2 &&
+      kio().threadpool().try_run(std::bind(&SmallFilePacker::doCompact, this, cluster, location.pack, size))) {
+    released.erase(cluster->id() + location.pack);
+  }
+}
+
+void SmallFilePacker::doCompact(std::shared_ptr<ClusterInterface> cluster, std::string pack, size_t size)
+{
+  auto status = compact(cluster, pack);
+  if (!status.ok()) {
+    kio_warning("Background compaction of pack ", pack, " failed: ", status);
+
+    /* Unless the pack has been removed in the meantime, account for the released space again. */
+    if (status.statusCode() != StatusCode::REMOTE_NOT_FOUND) {
+      std::lock_guard<std::mutex> lock(mutex);
+      released[cluster->id() + pack] += size;
+    }
+  }
+}
+
+KineticStatus SmallFilePacker::compact(const std::shared_ptr<ClusterInterface>& cluster, const std::string& pack)
+{
+  auto pack_key = utility::makeDataKey(cluster->id(), pack, 0);
+  auto index_key = utility::makeAttributeKey(cluster->id(), pack, index_attribute);
+
+  shared_ptr<const string> version;
+  shared_ptr<const string> index;
+  auto status = cluster->get(index_key, version, index);
+  if (!status.ok()) {
+    return status;
+  }
+
+  /* An entry is live if the metadata key of its file still references it. */
+  struct LiveEntry {
+    std::string path;
+    std::string base;
+    Location location;
+    shared_ptr<const string> metadata_version;
+  };
+  std::vector<LiveEntry> live;
+  size_t live_size = 0;
+  size_t total_size = 0;
+
+  std::istringstream ss(*index);
+  Location entry_location;
+  entry_location.pack = pack;
+  std::string path;
+  while (ss >> entry_location.offset >> entry_location.length && std::getline(ss >> std::ws, path)) {
+    total_size += entry_location.length;
+
+    shared_ptr<const string> metadata;
+    LiveEntry e;
+    status = cluster->get(utility::makeMetadataKey(cluster->id(), path), e.metadata_version, metadata);
+    if (status.statusCode() == StatusCode::REMOTE_NOT_FOUND) {
+      continue;
+    }
+    if (!status.ok()) {
+      return status;
+    }
+    if (parse(*metadata, e.location) && e.location.pack == pack && e.location.offset == entry_location.offset) {
+      e.path = path;
+      e.base = utility::metadataToBase(path, *metadata);
+      live.push_back(e);
+      live_size += e.location.length;
+    }
+  }
+
+  if (live_size * 2 > total_size) {
+    kio_debug("Pack ", pack, " still has ", live_size, " of ", total_size, " bytes referenced, not compacting.");
+    return KineticStatus(StatusCode::OK, "");
+  }
+
+  /* Re-pack the live entries. As they take up less than half a pack they always fit a single new pack. If a
+   * file changes concurrently, its metadata version will not match and it will not be re-packed, which is fine
+   * as it no longer references this pack either. */
+  Batch batch;
+  batch.cluster = cluster;
+  batch.pack = pack_prefix + utility::uuidGenerateString();
+  for (auto it = live.begin(); it != live.end(); it++) {
+    shared_ptr<const string> value;
+    status = read(cluster, it->location, value);
+    if (!status.ok()) {
+      return status;
+    }
+    batch.entries.push_back(Entry(it->path, it->base, batch.value.size(), value->size(), it->metadata_version));
+    batch.value.append(*value);
+  }
+  if (!batch.entries.empty()) {
+    write(batch);
+    for (auto it = batch.entries.cbegin(); it != batch.entries.cend(); it++) {
+      if (!it->status.ok() && it->status.statusCode() != StatusCode::REMOTE_VERSION_MISMATCH) {
+        kio_warning("Failed re-packing ", it->path, " from pack ", pack, ": ", it->status);
+        return it->status;
+      }
+    }
+  }
+
+  kio_debug("Compacted pack ", pack, ", re-packed ", live.size(), " files with ", live_size, " of ",
+            total_size, " bytes.");
+  {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto it = recent.begin(); it != recent.end(); it++) {
+      if (it->first == *pack_key) {
+        recent.erase(it);
+        break;
+      }
+    }
+  }
+  cluster->remove(index_key);
+  return cluster->remove(pack_key);
+}
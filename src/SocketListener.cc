@@ -17,6 +17,7 @@
 #include "KineticAutoConnection.hh"
 #include "Logging.hh"
 #include <unistd.h>
+#include <algorithm>
 
 #ifdef __APPLE__
 #include <sys/event.h>
@@ -75,26 +76,43 @@ void listener_thread(int main_fd, bool* shutdown)
   kio_debug("listener thread exiting.");
 }
 
-SocketListener::SocketListener() :
-    shutdown(false)
+SocketListener::SocketListener(size_t num_loops) :
+    active(0)
 {
-  /* Create the epoll / kqueue  descriptor. Only one is needed, and is used to monitor all sockets.*/
+  changeConfiguration(num_loops);
+}
+
+SocketListener::~SocketListener()
+{
+  for (auto it = loops.begin(); it != loops.end(); it++) {
+    stopLoop(**it);
+  }
+}
+
+std::unique_ptr<SocketListener::EventLoop> SocketListener::startLoop()
+{
+  std::unique_ptr<EventLoop> loop(new EventLoop());
+  loop->shutdown = false;
+  loop->subscriptions = 0;
+
+  /* Create the epoll / kqueue  descriptor. One is needed per loop, and is used to monitor all sockets of the loop.*/
 #ifdef __APPLE__
-  listener_fd = kqueue();
+  loop->listener_fd = kqueue();
 #else
-  listener_fd = epoll_create1(0);
+  loop->listener_fd = epoll_create1(0);
 #endif
 
-  if (listener_fd < 0) {
+  if (loop->listener_fd < 0) {
     kio_error("Failed setting up fd listener");
     throw std::system_error(errno, std::generic_category());
   }
-  kio_debug("set up listener_fd at ", listener_fd);
+  kio_debug("set up listener_fd at ", loop->listener_fd);
 
-  listener = std::thread(listener_thread, listener_fd, &shutdown);
+  loop->listener = std::thread(listener_thread, loop->listener_fd, &loop->shutdown);
+  return loop;
 }
 
-SocketListener::~SocketListener()
+void SocketListener::stopLoop(EventLoop& loop)
 {
   int pipefd[2];
   pipe(pipefd);
@@ -102,34 +120,66 @@ SocketListener::~SocketListener()
 #ifdef __APPLE__
   struct kevent e;
   EV_SET(&e, pipefd[0], EVFILT_READ, EV_ADD, 0, 0, NULL);
-  kevent(listener_fd, &e, 1, NULL, 0, NULL);
+  kevent(loop.listener_fd, &e, 1, NULL, 0, NULL);
 #else
   struct epoll_event e;
   e.events = EPOLLIN | EPOLLOUT;
   e.data.ptr = NULL;
-  epoll_ctl(listener_fd, EPOLL_CTL_ADD, pipefd[0], &e);
+  epoll_ctl(loop.listener_fd, EPOLL_CTL_ADD, pipefd[0], &e);
 #endif
 
-  shutdown = true;
+  loop.shutdown = true;
   write(pipefd[1], "0", 1);
 
-  listener.join();
+  loop.listener.join();
   close(pipefd[0]);
   close(pipefd[1]);
-  close(listener_fd);
-  listener_fd=0;
+  close(loop.listener_fd);
+  loop.listener_fd=0;
 }
 
+void SocketListener::changeConfiguration(size_t num_loops)
+{
+  if (!num_loops) {
+    num_loops = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  while (loops.size() < num_loops) {
+    loops.push_back(startLoop());
+  }
+  active = num_loops;
+  kio_debug("Listening with ", active, " event loops.");
+}
 
+std::vector<size_t> SocketListener::subscriptions()
+{
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<size_t> s;
+  for (size_t i = 0; i < active; i++) {
+    s.push_back(loops[i]->subscriptions);
+  }
+  return s;
+}
 
 void SocketListener::subscribe(int fd, kio::KineticAutoConnection* connection)
 {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  /* Balance connections over the event loops. */
+  EventLoop* loop = loops.front().get();
+  for (size_t i = 1; i < active; i++) {
+    if (loops[i]->subscriptions < loop->subscriptions) {
+      loop = loops[i].get();
+    }
+  }
+
   int rtn;
 #ifdef __APPLE__
   struct kevent e[2];
   EV_SET(&e[0], fd, EVFILT_WRITE, EV_ADD | EV_CLEAR, 0, 0, connection);
   EV_SET(&e[1], fd, EVFILT_READ, EV_ADD, 0, 0, connection);
-  rtn = kevent(listener_fd, &e[0], 2, 0, 0, 0);
+  rtn = kevent(loop->listener_fd, &e[0], 2, 0, 0, 0);
 #else
   /* EPOLLIN: Ready to read
    * EPOLLOUT: Ready to write
@@ -140,26 +190,44 @@ void SocketListener::subscribe(int fd, kio::KineticAutoConnection* connection)
 
   /* Add the descriptor into the monitoring list. We can do it even if another
     thread is waiting in epoll_wait - the descriptor will be properly added */
-  rtn = epoll_ctl(listener_fd, EPOLL_CTL_ADD, fd, &ev);
+  rtn = epoll_ctl(loop->listener_fd, EPOLL_CTL_ADD, fd, &ev);
 #endif
   if(rtn < 0){
     kio_error("failed adding fd ", fd, " to listener. ernno=", errno, " ", connection->getName());
     throw std::system_error(errno, std::generic_category());
   }
+
+  /* A closed fd is removed from epoll automatically, its number may be reused without an unsubscribe. */
+  auto it = subscribed.find(fd);
+  if (it != subscribed.end()) {
+    it->second->subscriptions--;
+  }
+  subscribed[fd] = loop;
+  loop->subscriptions++;
   kio_debug("Added fd ", fd, " for connection ", connection->getName(), " to listening queue.");
 }
 
 void SocketListener::unsubscribe(int fd)
 {
+  std::lock_guard<std::mutex> lock(mutex);
+  auto it = subscribed.find(fd);
+  if (it == subscribed.end()) {
+    kio_debug("fd ", fd, " is not subscribed to listener.");
+    return;
+  }
+  auto loop = it->second;
+  loop->subscriptions--;
+  subscribed.erase(it);
+
   int rtn;
 #ifdef __APPLE__
   struct kevent e[2];
   EV_SET(&e[0], fd, EVFILT_WRITE, EV_DELETE, 0, 0, NULL);
   EV_SET(&e[1], fd, EVFILT_READ, EV_DELETE, 0, 0, NULL);
-  rtn = kevent(listener_fd, &e[0], 2, 0, 0, 0);
+  rtn = kevent(loop->listener_fd, &e[0], 2, 0, 0, 0);
 #else
   struct epoll_event ev;
-  rtn = epoll_ctl(listener_fd, EPOLL_CTL_DEL, fd, &ev);
+  rtn = epoll_ctl(loop->listener_fd, EPOLL_CTL_DEL, fd, &ev);
 #endif
   if(rtn < 0) {
     kio_debug("failed to remove fd ", fd, " from listener. ernno=", errno);
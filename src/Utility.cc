@@ -103,6 +103,23 @@ std::shared_ptr<const std::string> utility::uuidGenerateEncodeSize(std::size_t s
   return std::make_shared<const std::string>(ss.str() + uuidGenerateString());
 }
 
+/* A checksum is stored in place of the first 8 characters of the uuid string, the uuid version character is replaced
+ * with a marker that never occurs in generated uuids. The version keeps its length and its size prefix, so readers that
+ * do not know about checksums decode it unchanged. */
+static const size_t checksum_offset = 10;
+static const size_t checksum_marker_offset = 10 + 14;
+static const char checksum_marker = 'c';
+
+std::shared_ptr<const std::string> utility::uuidGenerateEncodeSize(std::size_t size, uint32_t checksum)
+{
+  std::ostringstream ss;
+  ss << std::setw(8) << std::setfill('0') << std::hex << checksum;
+  std::string version(*uuidGenerateEncodeSize(size));
+  version.replace(checksum_offset, 8, ss.str());
+  version[checksum_marker_offset] = checksum_marker;
+  return std::make_shared<const std::string>(version);
+}
+
 std::size_t utility::uuidDecodeSize(const std::shared_ptr<const std::string>& uuid)
 {
   /* valid sizes are 10 bytes for encoded size plus either 16 byte uuid binary or 36 byte uuid string representation */
@@ -113,6 +130,20 @@ std::size_t utility::uuidDecodeSize(const std::shared_ptr<const std::string>& uu
   throw std::invalid_argument("invalid version supplied.");
 }
 
+bool utility::uuidDecodeChecksum(const std::shared_ptr<const std::string>& uuid, uint32_t& checksum)
+{
+  if (!uuid || uuid->size() != 46 || (*uuid)[checksum_marker_offset] != checksum_marker) {
+    return false;
+  }
+  std::istringstream ss(uuid->substr(checksum_offset, 8));
+  uint32_t c;
+  if (!(ss >> std::hex >> c)) {
+    return false;
+  }
+  checksum = c;
+  return true;
+}
+
 std::shared_ptr<const std::string> utility::makeDataKey(const std::string& clusterId, const std::string& base,
                                                         int block_number)
 {
@@ -139,6 +170,37 @@ std::string utility::extractAttributeName(const std::string& clusterId, const st
   return attrkey.substr(start);
 }
 
+namespace {
+  //! file ids are hidden paths with this prefix
+  const std::string file_id_prefix(".kio-fid/");
+  //! the base reference is a line of the metadata value starting with this tag
+  const std::string base_tag("kio-base ");
+}
+
+std::string utility::makeFileId()
+{
+  return file_id_prefix + uuidGenerateString();
+}
+
+std::string utility::metadataToBase(const std::string& path, const std::string& metadata_value)
+{
+  size_t start = 0;
+  while (metadata_value.compare(start, base_tag.size(), base_tag) != 0) {
+    start = metadata_value.find('\n', start);
+    if (start == std::string::npos) {
+      return path;
+    }
+    start++;
+  }
+  start += base_tag.size();
+  return metadata_value.substr(start, metadata_value.find('\n', start) - start);
+}
+
+std::string utility::makeBaseReference(const std::string& path, const std::string& base)
+{
+  return base == path ? std::string() : base_tag + base;
+}
+
 std::shared_ptr<const std::string> utility::makeIndicatorKey(const std::string& key)
 {
   return std::make_shared<const std::string>("indicator:" + key);
@@ -347,6 +347,49 @@ uint32_t crc32c(uint32_t crc, const void *buf, size_t len)
   return sse42 ? crc32c_hw(crc, buf, len) : crc32c_sw(crc, buf, len);
 }
 
+/* This is an addition to the original sources: combining crcs of adjacent buffers, following crc32_combine of zlib.
+   Returns the crc of the concatenation of two buffers given their crcs and the length of the second buffer. */
+uint32_t crc32c_combine(uint32_t crc1, uint32_t crc2, size_t len2)
+{
+  int n;
+  uint32_t row;
+  uint32_t even[32];      /* even-power-of-two zeros operator */
+  uint32_t odd[32];       /* odd-power-of-two zeros operator */
+
+  if (len2 == 0)
+    return crc1;
+
+  /* put operator for one zero bit in odd */
+  odd[0] = POLY;
+  row = 1;
+  for (n = 1; n < 32; n++) {
+    odd[n] = row;
+    row <<= 1;
+  }
+
+  /* put operator for two zero bits in even, four zero bits in odd */
+  gf2_matrix_square(even, odd);
+  gf2_matrix_square(odd, even);
+
+  /* apply len2 zeros to crc1 (first square will put the operator for one
+     zero byte, eight zero bits, in even) */
+  do {
+    gf2_matrix_square(even, odd);
+    if (len2 & 1)
+      crc1 = gf2_matrix_times(even, crc1);
+    len2 >>= 1;
+    if (len2 == 0)
+      break;
+
+    gf2_matrix_square(odd, even);
+    if (len2 & 1)
+      crc1 = gf2_matrix_times(odd, crc1);
+    len2 >>= 1;
+  } while (len2 != 0);
+
+  return crc1 ^ crc2;
+}
+
 #ifdef TEST
 
 #define SIZE (262144*3)
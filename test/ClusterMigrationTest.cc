@@ -0,0 +1,88 @@
+/************************************************************************
+ * KineticIo - a file io interface library to kinetic devices.          *
+ *                                                                      *
+ * This Source Code Form is subject to the terms of the Mozilla         *
+ * Public License, v. 2.0. If a copy of the MPL was not                 *
+ * distributed with this file, You can obtain one at                    *
+ * https://mozilla.org/MP:/2.0/.                                        *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without       *
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or         *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public             *
+ * License for more details.                                            *
+ ************************************************************************/
+
+#include "KineticIoFactory.hh"
+#include "KineticIoSingleton.hh"
+#include "SimulatorController.h"
+#include "catch.hpp"
+
+using namespace kio;
+
+SCENARIO("Cluster migration integration test.", "[Migrate]")
+{
+  auto& c = SimulatorController::getInstance();
+  REQUIRE(c.reset());
+  KineticIoFactory::reloadConfiguration();
+
+  GIVEN ("A file on a cluster with a different stripe geometry than the target cluster") {
+    std::string content(5000, 'x');
+    for (size_t i = 0; i < content.size(); i++) {
+      content[i] = static_cast<char>('a' + i % 26);
+    }
+
+    auto fileio = KineticIoFactory::makeFileIo("kinetic://Cluster1/migrate");
+    fileio->Open(SFS_O_CREAT);
+    REQUIRE((fileio->Write(0, content.c_str(), content.length()) == static_cast<int64_t>(content.length())));
+    fileio->attrSet("name", "value");
+    fileio->Close();
+
+    auto admin = kio::kio().cmap().getAdminCluster("Cluster1");
+
+    WHEN("The cluster is migrated.") {
+      auto counts = admin->migrate("Cluster2");
+      REQUIRE((counts.total == 1));
+      REQUIRE((counts.repaired == 1));
+      REQUIRE((counts.unrepairable == 0));
+
+      THEN("The file can be read from the target cluster.") {
+        auto target = KineticIoFactory::makeFileIo("kinetic://Cluster2/migrate");
+        target->Open(0);
+        std::vector<char> buf(content.size() + 10);
+        REQUIRE((target->Read(0, buf.data(), buf.size()) == static_cast<int64_t>(content.size())));
+        REQUIRE((std::string(buf.data(), content.size()) == content));
+        REQUIRE((target->attrGet("name") == "value"));
+
+        struct stat st;
+        target->Stat(&st);
+        REQUIRE((st.st_size == static_cast<off_t>(content.size())));
+      }
+
+      THEN("Migrating again does not copy unchanged files.") {
+        counts = admin->migrate("Cluster2");
+        REQUIRE((counts.total == 1));
+        REQUIRE((counts.need_action == 0));
+      }
+
+      THEN("Files modified since the migration are copied again.") {
+        fileio->Open(0);
+        REQUIRE((fileio->Write(5000, "end", 3) == 3));
+        fileio->Close();
+
+        counts = admin->migrate("Cluster2");
+        REQUIRE((counts.repaired == 1));
+
+        auto target = KineticIoFactory::makeFileIo("kinetic://Cluster2/migrate");
+        target->Open(0);
+        struct stat st;
+        target->Stat(&st);
+        REQUIRE((st.st_size == 5003));
+      }
+    }
+
+    THEN("Migrating a cluster to itself is rejected.") {
+      REQUIRE_THROWS(admin->migrate("Cluster1"));
+    }
+  }
+}
@@ -53,6 +53,7 @@ SCENARIO("Append Concurrency Testing...", "[Append]")
 
     auto ec = std::make_shared<RedundancyProvider>(1, 0);
     SocketListener listener;
+    ReconnectScheduler reconnects(1);
 
     auto& c = SimulatorController::getInstance();
     kinetic::ConnectionOptions conop = c.get(0);
@@ -71,7 +72,7 @@ SCENARIO("Append Concurrency Testing...", "[Append]")
           std::vector<std::unique_ptr<KineticAutoConnection>> connections;
           connections.push_back(
               std::unique_ptr<KineticAutoConnection>(
-                  new KineticAutoConnection(listener, std::make_pair(conop, conop), std::chrono::seconds(10)))
+                  new KineticAutoConnection(listener, reconnects, std::make_pair(conop, conop), std::chrono::seconds(10)))
           );
 
           clusters.push_back(
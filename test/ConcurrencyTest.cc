@@ -61,6 +61,7 @@ SCENARIO("Kinetic Concurrency Testing...", "[Concurrency]")
 {
   auto& c = SimulatorController::getInstance();
   SocketListener listener;
+  ReconnectScheduler reconnects(1);
 
   /* Maybe make that configurable? */
   std::size_t nData = 2;
@@ -86,7 +87,7 @@ SCENARIO("Kinetic Concurrency Testing...", "[Concurrency]")
           std::vector<std::unique_ptr<KineticAutoConnection>> connections;
           for (int con = 0; con < 3; con++) {
             std::unique_ptr<KineticAutoConnection> autocon(
-                new KineticAutoConnection(listener, std::make_pair(c.get(con), c.get(con)),
+                new KineticAutoConnection(listener, reconnects, std::make_pair(c.get(con), c.get(con)),
                                           std::chrono::seconds(10))
             );
             connections.push_back(std::move(autocon));
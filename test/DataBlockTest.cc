@@ -24,6 +24,100 @@
 
 using namespace kio;
 
+//! Forwards to a cluster, counting get requests with and without value.
+class CountingCluster : public ClusterInterface {
+public:
+  explicit CountingCluster(std::shared_ptr<ClusterInterface> cluster) : value_gets(0), version_gets(0), cluster(cluster)
+  { }
+
+  const std::string& id() const
+  {
+    return cluster->id();
+  }
+
+  const std::string& instanceId() const
+  {
+    return cluster->instanceId();
+  }
+
+  const ClusterLimits& limits() const
+  {
+    return cluster->limits();
+  }
+
+  ClusterStats stats()
+  {
+    return cluster->stats();
+  }
+
+  kinetic::KineticStatus get(
+      const std::shared_ptr<const std::string>& key,
+      std::shared_ptr<const std::string>& version,
+      std::shared_ptr<const std::string>& value)
+  {
+    value_gets++;
+    return cluster->get(key, version, value);
+  }
+
+  kinetic::KineticStatus get(
+      const std::shared_ptr<const std::string>& key,
+      std::shared_ptr<const std::string>& version)
+  {
+    version_gets++;
+    return cluster->get(key, version);
+  }
+
+  kinetic::KineticStatus put(
+      const std::shared_ptr<const std::string>& key,
+      const std::shared_ptr<const std::string>& version,
+      const std::shared_ptr<const std::string>& value,
+      std::shared_ptr<const std::string>& version_out)
+  {
+    return cluster->put(key, version, value, version_out);
+  }
+
+  kinetic::KineticStatus put(
+      const std::shared_ptr<const std::string>& key,
+      const std::shared_ptr<const std::string>& value,
+      std::shared_ptr<const std::string>& version_out)
+  {
+    return cluster->put(key, value, version_out);
+  }
+
+  kinetic::KineticStatus remove(
+      const std::shared_ptr<const std::string>& key,
+      const std::shared_ptr<const std::string>& version)
+  {
+    return cluster->remove(key, version);
+  }
+
+  kinetic::KineticStatus remove(
+      const std::shared_ptr<const std::string>& key)
+  {
+    return cluster->remove(key);
+  }
+
+  kinetic::KineticStatus flush()
+  {
+    return cluster->flush();
+  }
+
+  kinetic::KineticStatus range(
+      const std::shared_ptr<const std::string>& start_key,
+      const std::shared_ptr<const std::string>& end_key,
+      std::unique_ptr<std::vector<std::string>>& keys,
+      size_t elements)
+  {
+    return cluster->range(start_key, end_key, keys, elements);
+  }
+
+  int value_gets;
+  int version_gets;
+
+private:
+  std::shared_ptr<ClusterInterface> cluster;
+};
+
 SCENARIO("DataBlock integration test.", "[Data]")
 {
   std::list<std::string> clusternames = {"Cluster1", "Cluster2", "Cluster3"};
@@ -34,6 +128,31 @@ SCENARIO("DataBlock integration test.", "[Data]")
     REQUIRE(c.reset());
     auto cluster = kio::kio().cmap().getCluster(*it);
 
+    GIVEN (*it + " and a block that does not exist in the backend.") {
+      DataBlock data(cluster, std::make_shared<std::string>("hole"));
+
+      THEN("It is not known to be absent before it has been accessed.") {
+        REQUIRE_FALSE(data.absent());
+      }
+
+      WHEN("It is read from.") {
+        char out[10];
+        REQUIRE_NOTHROW(data.read(out, 0, 10));
+
+        THEN("It is absent.") {
+          REQUIRE(data.absent());
+        }
+
+        AND_WHEN("Something is written to it.") {
+          REQUIRE_NOTHROW(data.write("99", 0, 2));
+
+          THEN("It is no longer absent.") {
+            REQUIRE_FALSE(data.absent());
+          }
+        }
+      }
+    }
+
     GIVEN (*it + " and an empty block with create flag set.") {
       DataBlock data(cluster, std::make_shared<std::string>("key"), DataBlock::Mode::CREATE);
 
@@ -70,6 +189,28 @@ SCENARIO("DataBlock integration test.", "[Data]")
           REQUIRE((memcmp(in, out, sizeof(in)) == 0));
         }
 
+        THEN("It can be viewed without copying, the view is not affected by later writes.") {
+          size_t view_offset = 0;
+          std::shared_ptr<const std::string> view;
+          REQUIRE_NOTHROW(view = data.view(2, 4, view_offset));
+          REQUIRE((memcmp(in + 2, view->data() + view_offset, 4) == 0));
+
+          REQUIRE_NOTHROW(data.write("xxxx", 2, 4));
+          REQUIRE((memcmp(in + 2, view->data() + view_offset, 4) == 0));
+
+          char out[4];
+          REQUIRE_NOTHROW(data.read(out, 2, 4));
+          REQUIRE((memcmp("xxxx", out, 4) == 0));
+        }
+
+        THEN("Viewing past the value size returns 0s for the hole.") {
+          size_t view_offset = 0;
+          auto view = data.view(sizeof(in) - 1, 4, view_offset);
+          char compare[4];
+          memset(compare, 0, 4);
+          REQUIRE((memcmp(compare, view->data() + view_offset, 4) == 0));
+        }
+
         AND_WHEN("It is truncated to size 0.") {
           REQUIRE_NOTHROW(data.truncate(0));
           REQUIRE((data.size() == 0));
@@ -115,6 +256,27 @@ SCENARIO("DataBlock integration test.", "[Data]")
               }
             }
           }
+
+          AND_WHEN("The on-drive value is overwritten completely by someone else.") {
+            auto counting = std::make_shared<CountingCluster>(cluster);
+            DataBlock x(counting, std::make_shared<std::string>("key"));
+            std::string full(x.capacity(), 'z');
+            REQUIRE_NOTHROW(x.write(full.c_str(), 0, full.size()));
+            REQUIRE_NOTHROW(x.flush());
+
+            THEN("Only the version of the old value has been read.") {
+              REQUIRE((counting->value_gets == 0));
+              REQUIRE((counting->version_gets == 1));
+            }
+
+            THEN("The new value replaces the old one.") {
+              DataBlock y(cluster, std::make_shared<std::string>("key"));
+              std::vector<char> out(full.size());
+              REQUIRE_NOTHROW(y.read(out.data(), 0, out.size()));
+              REQUIRE((std::string(out.data(), out.size()) == full));
+              REQUIRE((y.size() == full.size()));
+            }
+          }
         }
       }
     }
@@ -17,6 +17,7 @@
 #include "Utility.hh"
 #include "SimulatorController.h"
 #include <unistd.h>
+#include <thread>
 #include <Logging.hh>
 #include "catch.hpp"
 
@@ -51,6 +52,9 @@ public:
       std::shared_ptr<const std::string>& version,
       std::shared_ptr<const std::string>& value)
   {
+    if (_absent) {
+      return KineticStatus(StatusCode::REMOTE_NOT_FOUND, "");
+    }
     version = _version;
     value = _value;
     return KineticStatus(StatusCode::OK, "");
@@ -60,6 +64,9 @@ public:
       const std::shared_ptr<const std::string>& key,
       std::shared_ptr<const std::string>& version)
   {
+    if (_absent) {
+      return KineticStatus(StatusCode::REMOTE_NOT_FOUND, "");
+    }
     version = _version;
     return KineticStatus(StatusCode::OK, "");
   }
@@ -70,6 +77,7 @@ public:
       const std::shared_ptr<const std::string>& value,
       std::shared_ptr<const std::string>& version_out)
   {
+    _absent = false;
     version_out = _version;
     return KineticStatus(StatusCode::OK, "");
   }
@@ -79,6 +87,7 @@ public:
       const std::shared_ptr<const std::string>& value,
       std::shared_ptr<const std::string>& version_out)
   {
+    _absent = false;
     version_out = _version;
     return KineticStatus(StatusCode::OK, "");
   }
@@ -111,9 +120,15 @@ public:
     return KineticStatus(StatusCode::OK, "");
   }
 
-  MockCluster()
+  //! keys do not exist until they are put
+  void setAbsent(bool absent)
   {
-    _id = "MockCluster";
+    _absent = absent;
+  }
+
+  explicit MockCluster(std::string id = "MockCluster") : _absent(false)
+  {
+    _id = id;
     _stats.bytes_free = 128;
     _stats.bytes_total = 128;
     _limits.max_key_size = 4096;
@@ -132,14 +147,16 @@ private:
   kio::ClusterLimits _limits;
   kio::ClusterStats _stats;
   std::string _id;
+  bool _absent;
 };
 
 class MockFileIo : public kio::FileIo {
 public:
 
-  MockFileIo(std::string path, std::shared_ptr<kio::ClusterInterface> c) : FileIo(path)
+  MockFileIo(std::string path, std::shared_ptr<kio::ClusterInterface> c, std::string tenant_tag = "") : FileIo(path)
   {
     cluster = c;
+    tenant = tenant_tag;
   }
 
   ~MockFileIo()
@@ -201,3 +218,159 @@ SCENARIO("Cache Performance Test.", "[Cache]")
   }
 }
 
+SCENARIO("Cache Partition Test.", "[Cache]")
+{
+  GIVEN("A Cache with a cluster partition and a tenant partition") {
+    DataCache ccc(100 * 128);
+    std::vector<DataCache::PartitionConfiguration> partitions;
+    partitions.push_back(DataCache::PartitionConfiguration{"MockCluster", 50 * 128, 0});
+    partitions.push_back(DataCache::PartitionConfiguration{"batch", 0, 20 * 128});
+    ccc.changeConfiguration(100 * 128, partitions);
+
+    std::shared_ptr<ClusterInterface> cluster(new MockCluster());
+    std::shared_ptr<ClusterInterface> other_cluster(new MockCluster("OtherCluster"));
+    MockFileIo interactive("kinetic://Cluster1/interactive", cluster);
+    MockFileIo batch("kinetic://Cluster1/batch", cluster, "batch");
+    MockFileIo other("kinetic://Cluster1/other", other_cluster, "unconfigured");
+
+    for (int i = 0; i < 40; i++) {
+      ccc.getDataKey((FileIo*) &interactive, i, DataBlock::Mode::STANDARD);
+    }
+
+    THEN("Minimum shares exceeding the capacity are rejected") {
+      partitions.push_back(DataCache::PartitionConfiguration{"other", 60 * 128, 0});
+      REQUIRE_THROWS(ccc.changeConfiguration(100 * 128, partitions));
+    }
+
+    WHEN("A tenant requests more blocks than its maximum share") {
+      for (int i = 0; i < 200; i++) {
+        ccc.getDataKey((FileIo*) &batch, i, DataBlock::Mode::STANDARD);
+      }
+
+      THEN("The tenant partition is limited to its maximum share") {
+        auto stats = ccc.partitionStatistics();
+        REQUIRE((stats["batch"].size <= 21 * 128));
+        REQUIRE((stats["batch"].misses == 200));
+        REQUIRE((stats["MockCluster"].size == 40 * 128));
+      }
+    }
+
+    WHEN("An unconfigured tenant of an unconfigured cluster fills the cache") {
+      for (int i = 0; i < 200; i++) {
+        ccc.getDataKey((FileIo*) &other, i, DataBlock::Mode::STANDARD);
+      }
+
+      THEN("It may borrow idle capacity without evicting the guaranteed share of other partitions") {
+        auto stats = ccc.partitionStatistics();
+        REQUIRE((stats[""].size >= 50 * 128));
+        REQUIRE((stats[""].size + stats["MockCluster"].size <= 101 * 128));
+        REQUIRE((stats["MockCluster"].size == 40 * 128));
+
+        for (int i = 0; i < 40; i++) {
+          ccc.getDataKey((FileIo*) &interactive, i, DataBlock::Mode::STANDARD);
+        }
+        stats = ccc.partitionStatistics();
+        REQUIRE((stats["MockCluster"].hits == 40));
+        REQUIRE((stats["MockCluster"].misses == 40));
+      }
+    }
+  }
+}
+
+namespace {
+  void requestBlocks(DataCache* cache, FileIo* fio, int count)
+  {
+    for (int i = 0; i < count; i++) {
+      cache->getDataKey(fio, i, DataBlock::Mode::STANDARD);
+    }
+  }
+}
+
+SCENARIO("Sharded Cache Test.", "[Cache]")
+{
+  GIVEN("A Cache with multiple shards and mocked FileIo objects") {
+    DataCache ccc(50 * 128, NULL, 4);
+    std::shared_ptr<ClusterInterface> cluster(new MockCluster());
+    MockFileIo fio1("kinetic://Cluster1/one", cluster);
+    MockFileIo fio2("kinetic://Cluster1/two", cluster);
+    MockFileIo fio3("kinetic://Cluster1/three", cluster);
+    MockFileIo fio4("kinetic://Cluster1/four", cluster);
+
+    WHEN("Multiple threads request blocks concurrently") {
+      std::thread t1(requestBlocks, &ccc, (FileIo*) &fio1, 200);
+      std::thread t2(requestBlocks, &ccc, (FileIo*) &fio2, 200);
+      std::thread t3(requestBlocks, &ccc, (FileIo*) &fio3, 200);
+      std::thread t4(requestBlocks, &ccc, (FileIo*) &fio4, 200);
+      t1.join();
+      t2.join();
+      t3.join();
+      t4.join();
+
+      THEN("Every request is accounted for and the capacity applies to the cache as a whole") {
+        auto stats = ccc.partitionStatistics();
+        REQUIRE((stats[""].misses == 800));
+        REQUIRE((stats[""].size <= 50 * 128));
+      }
+
+      THEN("Blocks remaining in the cache are served from it") {
+        auto block = ccc.getDataKey((FileIo*) &fio1, 200, DataBlock::Mode::STANDARD);
+        auto hits = ccc.partitionStatistics()[""].hits;
+        REQUIRE((ccc.getDataKey((FileIo*) &fio1, 200, DataBlock::Mode::STANDARD) == block));
+        REQUIRE((ccc.partitionStatistics()[""].hits == hits + 1));
+      }
+    }
+  }
+}
+
+SCENARIO("Negative Cache Test.", "[Cache]")
+{
+  GIVEN("A Cache Object and a mocked FileIo object without data in the backend") {
+    DataCache ccc(10 * 128);
+    auto mock = std::make_shared<MockCluster>();
+    mock->setAbsent(true);
+    std::shared_ptr<ClusterInterface> cluster(mock);
+    MockFileIo fio("kinetic://Cluster1/hole", cluster);
+
+    THEN("A block is not known to be absent before it has been read") {
+      REQUIRE_FALSE(ccc.isAbsent((FileIo*) &fio, 1));
+    }
+
+    WHEN("A block is read and found to be absent") {
+      auto data = ccc.getDataKey((FileIo*) &fio, 1, DataBlock::Mode::STANDARD);
+      char out[10];
+      REQUIRE_NOTHROW(data->read(out, 0, sizeof(out)));
+      REQUIRE(data->absent());
+      ccc.setAbsent(data);
+      data.reset();
+
+      THEN("It is known to be absent without occupying the cache") {
+        REQUIRE(ccc.isAbsent((FileIo*) &fio, 1));
+        REQUIRE_FALSE(ccc.isAbsent((FileIo*) &fio, 2));
+        REQUIRE((ccc.partitionStatistics()[""].size == 0));
+      }
+
+      AND_WHEN("The block is written and put to the backend") {
+        auto block = ccc.getDataKey((FileIo*) &fio, 1, DataBlock::Mode::STANDARD);
+        REQUIRE_NOTHROW(block->write("99", 0, 2));
+        REQUIRE_NOTHROW(block->flush());
+
+        THEN("It is no longer known to be absent") {
+          REQUIRE_FALSE(ccc.isAbsent((FileIo*) &fio, 1));
+
+          AND_THEN("Reporting the written block as absent is ignored") {
+            ccc.setAbsent(block);
+            REQUIRE_FALSE(ccc.isAbsent((FileIo*) &fio, 1));
+          }
+        }
+      }
+
+      AND_WHEN("The negative entry expires") {
+        usleep(DataBlock::expiration_time.count() * 1000);
+
+        THEN("The block is no longer known to be absent") {
+          REQUIRE_FALSE(ccc.isAbsent((FileIo*) &fio, 1));
+        }
+      }
+    }
+  }
+}
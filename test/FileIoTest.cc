@@ -16,13 +16,44 @@
 #include "KineticIoFactory.hh"
 #include "SimulatorController.h"
 #include <unistd.h>
+#include <iomanip>
+#include <condition_variable>
+#include <mutex>
 #include <fcntl.h>
+#include <dlfcn.h>
 #include <FileIo.hh>
+#include <KineticIoSingleton.hh>
+#include <Utility.hh>
 #include <Logging.hh>
 #include "catch.hpp"
 
 using namespace kio;
 
+namespace {
+  //----------------------------------------------------------------------------
+  //! Load the shared library in addition to the library code linked into the
+  //! test. The loaded instance has its own configuration, data cache and
+  //! connections. It binds to its own symbols, as the test executable does not
+  //! export the library symbols.
+  //!
+  //! @return the factory of the loaded instance, NULL on failure
+  //----------------------------------------------------------------------------
+  LoadableKineticIoFactoryInterface* loadIndependentInstance()
+  {
+#ifdef __APPLE__
+    void* handle = dlopen("./libkineticio.dylib", RTLD_NOW | RTLD_LOCAL);
+#else
+    void* handle = dlopen("./libkineticio.so", RTLD_NOW | RTLD_LOCAL);
+#endif
+    if (!handle) {
+      return NULL;
+    }
+    typedef LoadableKineticIoFactoryInterface* (* function_t)();
+    function_t get_factory = (function_t) dlsym(handle, "getKineticIoFactory");
+    return get_factory ? get_factory() : NULL;
+  }
+}
+
 SCENARIO("KineticIo Integration Test", "[Io]")
 {
 
@@ -69,6 +100,7 @@ SCENARIO("KineticIo Integration Test", "[Io]")
       REQUIRE_THROWS_AS(fileio->Write(0, write_buf, buf_size), std::system_error);
       REQUIRE_THROWS_AS(fileio->Truncate(0), std::system_error);
       REQUIRE_THROWS_AS(fileio->Remove(), std::system_error);
+      REQUIRE_THROWS_AS(fileio->Advise(0, 0, FileIoInterface::Advice::WILLNEED), std::system_error);
     }
 
     THEN("Attempting to open without create flag fails with ENOENT.") {
@@ -187,6 +219,87 @@ SCENARIO("KineticIo Integration Test", "[Io]")
       AND_THEN("Reading data before the offset is possible and returns 0s (file with holes)") {
         REQUIRE((fileio->Read(66666666, read_buf, buf_size) == buf_size));
         REQUIRE((memcmp(null_buf, read_buf, buf_size) == 0));
+
+        AND_THEN("The hole is known to be absent and reading it again returns 0s") {
+          int hole_block = 66666666 / (2 * 1024 * 1024);
+          REQUIRE(kio::kio().cache().isAbsent(dynamic_cast<FileIo*>(fileio.get()), hole_block));
+          memset(read_buf, 'x', buf_size);
+          REQUIRE((fileio->Read(66666666, read_buf, buf_size) == buf_size));
+          REQUIRE((memcmp(null_buf, read_buf, buf_size) == 0));
+
+          AND_WHEN("The hole is written to") {
+            REQUIRE((fileio->Write(66666666, write_buf, buf_size) == buf_size));
+
+            THEN("It is no longer absent and the written data is read") {
+              REQUIRE_FALSE(kio::kio().cache().isAbsent(dynamic_cast<FileIo*>(fileio.get()), hole_block));
+              REQUIRE((fileio->Read(66666666, read_buf, buf_size) == buf_size));
+              REQUIRE((memcmp(write_buf, read_buf, buf_size) == 0));
+            }
+          }
+        }
+      }
+    }
+
+    THEN("Advise throws with EINVAL on negative ranges") {
+      REQUIRE_THROWS_AS(fileio->Advise(-1, 0, FileIoInterface::Advice::DONTNEED), std::system_error);
+      try {
+        fileio->Advise(-1, 0, FileIoInterface::Advice::DONTNEED);
+      } catch (const std::system_error& e) {
+        REQUIRE((e.code().value() == EINVAL));
+      }
+    }
+
+    WHEN("Writing data across multiple blocks with access pattern advice.") {
+      int block_size = 2 * 1024 * 1024;
+      std::vector<char> wbuf(3 * block_size + buf_size, 'x');
+      std::vector<char> rbuf(wbuf.size());
+      REQUIRE((fileio->Write(0, wbuf.data(), wbuf.size()) == static_cast<int64_t>(wbuf.size())));
+      REQUIRE_NOTHROW(fileio->Sync());
+
+      THEN("Data can be read in sequential mode.") {
+        REQUIRE_NOTHROW(fileio->Advise(0, 0, FileIoInterface::Advice::SEQUENTIAL));
+        REQUIRE((fileio->Read(0, rbuf.data(), rbuf.size()) == static_cast<int64_t>(rbuf.size())));
+        REQUIRE((wbuf == rbuf));
+      }
+      THEN("Data can be read without copying.") {
+        std::vector<DataView> views;
+        REQUIRE((fileio->ReadViews(0, rbuf.size(), views) == static_cast<int64_t>(rbuf.size())));
+        REQUIRE((views.size() == 4));
+        size_t done = 0;
+        for (auto it = views.cbegin(); it != views.cend(); it++) {
+          REQUIRE((memcmp(wbuf.data() + done, it->data(), it->length) == 0));
+          done += it->length;
+        }
+        REQUIRE((done == rbuf.size()));
+
+        AND_THEN("Reading past the end of file views the last block without copying it.") {
+          std::vector<DataView> again;
+          REQUIRE((fileio->ReadViews(0, rbuf.size() + buf_size, again) == static_cast<int64_t>(rbuf.size())));
+          REQUIRE((again.size() == 4));
+          REQUIRE((again.back().length == static_cast<size_t>(buf_size)));
+          REQUIRE((again.back().buffer == views.back().buffer));
+        }
+      }
+      THEN("Data can be read in random mode.") {
+        REQUIRE_NOTHROW(fileio->Advise(0, 0, FileIoInterface::Advice::RANDOM));
+        REQUIRE((fileio->Read(0, rbuf.data(), rbuf.size()) == static_cast<int64_t>(rbuf.size())));
+        REQUIRE((wbuf == rbuf));
+      }
+      THEN("Data can be read after being prefetched.") {
+        REQUIRE_NOTHROW(fileio->Advise(block_size, 2 * block_size, FileIoInterface::Advice::WILLNEED));
+        REQUIRE((fileio->Read(0, rbuf.data(), rbuf.size()) == static_cast<int64_t>(rbuf.size())));
+        REQUIRE((wbuf == rbuf));
+      }
+      THEN("Data can be read after being released from the cache.") {
+        REQUIRE_NOTHROW(fileio->Advise(0, 0, FileIoInterface::Advice::DONTNEED));
+        REQUIRE((fileio->Read(0, rbuf.data(), rbuf.size()) == static_cast<int64_t>(rbuf.size())));
+        REQUIRE((wbuf == rbuf));
+      }
+      THEN("Data can be read repeatedly when advised not to be reused.") {
+        REQUIRE_NOTHROW(fileio->Advise(0, block_size, FileIoInterface::Advice::NOREUSE));
+        REQUIRE((fileio->Read(0, rbuf.data(), rbuf.size()) == static_cast<int64_t>(rbuf.size())));
+        REQUIRE((fileio->Read(0, rbuf.data(), rbuf.size()) == static_cast<int64_t>(rbuf.size())));
+        REQUIRE((wbuf == rbuf));
       }
     }
 
@@ -285,6 +398,94 @@ SCENARIO("KineticIo Integration Test", "[Io]")
       }
     }
   }
+
+  GIVEN("Multiple io objects writing disjoint regions of a file in parallel.") {
+    std::string url("kinetic://Cluster2/parallel");
+    const int capacity = 2 * 1024 * 1024;
+    const int region = capacity + capacity / 2;
+    const int writers = 3;
+
+    std::vector<char> wbuf(writers * region);
+    for (size_t i = 0; i < wbuf.size(); i++) {
+      wbuf[i] = static_cast<char>('a' + i % 26);
+    }
+
+    std::vector<std::unique_ptr<FileIoInterface>> handles;
+    for (int i = 0; i < writers; i++) {
+      handles.push_back(kio::KineticIoFactory::makeFileIo(url));
+      REQUIRE_NOTHROW(handles.back()->Open(i ? 0 : SFS_O_CREAT));
+      REQUIRE_NOTHROW(handles.back()->Advise(i * region, region, FileIoInterface::Advice::PARALLEL_WRITE));
+    }
+
+    WHEN("Every object writes its region in reverse order and is closed.") {
+      for (int i = writers - 1; i >= 0; i--) {
+        REQUIRE((handles[i]->Write(i * region, wbuf.data() + i * region, region) == region));
+      }
+      for (int i = 0; i < writers; i++) {
+        REQUIRE_NOTHROW(handles[i]->Close());
+      }
+
+      THEN("Blocks shared by regions contain the data of all writers.") {
+        auto fileio = kio::KineticIoFactory::makeFileIo(url);
+        fileio->Open(0);
+        std::vector<char> rbuf(wbuf.size() + buf_size);
+        REQUIRE((fileio->Read(0, rbuf.data(), rbuf.size()) == static_cast<int64_t>(wbuf.size())));
+        REQUIRE((memcmp(wbuf.data(), rbuf.data(), wbuf.size()) == 0));
+
+        struct stat stbuf;
+        REQUIRE_NOTHROW(fileio->Stat(&stbuf));
+        REQUIRE((stbuf.st_size == static_cast<off_t>(wbuf.size())));
+        REQUIRE_NOTHROW(fileio->Remove());
+      }
+    }
+  }
+
+  GIVEN("Two independent library instances writing disjoint regions of a file that share one stripe.") {
+    /* Objects of the same library instance share the data cache and thereby the shared stripe. A second instance
+     * of the library has its own cache and connections, like a different client. */
+    auto independent = loadIndependentInstance();
+    REQUIRE(independent);
+
+    std::string url("kinetic://Cluster2/parallel-independent");
+    const int capacity = 2 * 1024 * 1024;
+    const int region = capacity + capacity / 2;
+
+    std::vector<char> wbuf(2 * region);
+    for (size_t i = 0; i < wbuf.size(); i++) {
+      wbuf[i] = static_cast<char>('a' + i % 26);
+    }
+
+    auto first = kio::KineticIoFactory::makeFileIo(url);
+    REQUIRE_NOTHROW(first->Open(SFS_O_CREAT));
+    REQUIRE_NOTHROW(first->Advise(0, region, FileIoInterface::Advice::PARALLEL_WRITE));
+    auto second = independent->makeFileIo(url);
+    REQUIRE_NOTHROW(second->Open(0));
+    REQUIRE_NOTHROW(second->Advise(region, region, FileIoInterface::Advice::PARALLEL_WRITE));
+
+    WHEN("Both write their region and are closed.") {
+      REQUIRE((second->Write(region, wbuf.data() + region, region) == region));
+      REQUIRE((first->Write(0, wbuf.data(), region) == region));
+      REQUIRE_NOTHROW(first->Close());
+      REQUIRE_NOTHROW(second->Close());
+
+      THEN("Both instances read the data of both writers and the combined file size.") {
+        std::vector<std::unique_ptr<FileIoInterface>> readers;
+        readers.push_back(kio::KineticIoFactory::makeFileIo(url));
+        readers.push_back(independent->makeFileIo(url));
+        for (auto it = readers.begin(); it != readers.end(); it++) {
+          (*it)->Open(0);
+          std::vector<char> rbuf(wbuf.size() + buf_size);
+          REQUIRE(((*it)->Read(0, rbuf.data(), rbuf.size()) == static_cast<int64_t>(wbuf.size())));
+          REQUIRE((memcmp(wbuf.data(), rbuf.data(), wbuf.size()) == 0));
+
+          struct stat stbuf;
+          REQUIRE_NOTHROW((*it)->Stat(&stbuf));
+          REQUIRE((stbuf.st_size == static_cast<off_t>(wbuf.size())));
+        }
+        REQUIRE_NOTHROW(readers.front()->Remove());
+      }
+    }
+  }
 }
 
 SCENARIO("FileIo Attribute Integration Test", "[Attr]")
@@ -357,6 +558,65 @@ SCENARIO("FileIo Attribute Integration Test", "[Attr]")
       REQUIRE(stats.size());
     }
 
+    THEN("We can use the attr interface to request cache partition stats") {
+      auto stats = fileio->attrGet("sys.cachestats");
+      REQUIRE((stats.find("partition=,") != std::string::npos));
+    }
+
+    THEN("We can use the attr interface to request the file checksum") {
+      std::string content(3 * 1024 * 1024, 'c');
+      REQUIRE((fileio->Write(0, content.data(), content.size()) == static_cast<int64_t>(content.size())));
+      REQUIRE_NOTHROW(fileio->Close());
+
+      auto expected = utility::Convert::toString(std::hex, std::setfill('0'), std::setw(8),
+                                                 crc32c(0, content.data(), content.size()));
+      REQUIRE((fileio->attrGet("sys.checksum") == expected));
+
+      AND_WHEN("The file is modified at an offset") {
+        REQUIRE_NOTHROW(fileio->Open(0));
+        REQUIRE((fileio->Write(10, "modified", 8) == 8));
+        REQUIRE_NOTHROW(fileio->Close());
+        content.replace(10, 8, "modified");
+
+        THEN("The checksum is computed from the data stripes") {
+          expected = utility::Convert::toString(std::hex, std::setfill('0'), std::setw(8),
+                                                crc32c(0, content.data(), content.size()));
+          REQUIRE((fileio->attrGet("sys.checksum") == expected));
+        }
+      }
+
+      AND_WHEN("The file is extended past a hole") {
+        REQUIRE_NOTHROW(fileio->Open(0));
+        REQUIRE((fileio->Write(8 * 1024 * 1024, "end", 3) == 3));
+        REQUIRE_NOTHROW(fileio->Close());
+        content.resize(8 * 1024 * 1024, '\0');
+        content += "end";
+
+        THEN("Holes are accounted for as zeros") {
+          expected = utility::Convert::toString(std::hex, std::setfill('0'), std::setw(8),
+                                                crc32c(0, content.data(), content.size()));
+          REQUIRE((fileio->attrGet("sys.checksum") == expected));
+        }
+      }
+    }
+
+    THEN("A checksum is not stored if the file has been changed through another object") {
+      std::string content(1000, 'c');
+      REQUIRE((fileio->Write(0, content.data(), content.size()) == static_cast<int64_t>(content.size())));
+
+      auto other = KineticIoFactory::makeFileIo(full_url);
+      REQUIRE_NOTHROW(other->Open(0));
+      REQUIRE((other->Write(5000, "end", 3) == 3));
+      REQUIRE_NOTHROW(other->Close());
+      REQUIRE_NOTHROW(fileio->Close());
+      content.resize(5000, '\0');
+      content += "end";
+
+      auto expected = utility::Convert::toString(std::hex, std::setfill('0'), std::setw(8),
+                                                 crc32c(0, content.data(), content.size()));
+      REQUIRE((fileio->attrGet("sys.checksum") == expected));
+    }
+
     THEN("We can use the attr interface to request health stats") {
       auto health = fileio->attrGet("sys.health");
       REQUIRE((health.find("redundancy_factor=1") != std::string::npos));
@@ -364,3 +624,190 @@ SCENARIO("FileIo Attribute Integration Test", "[Attr]")
   }
 }
 
+SCENARIO("FileIo Rename Integration Test", "[Rename]")
+{
+  auto& c = SimulatorController::getInstance();
+  REQUIRE(c.reset());
+  kio::KineticIoFactory::reloadConfiguration();
+
+  char write_buf[] = "rcPOa12L3nhN5Cgvsa6Jlr3gn58VhazjA6oSpKacLFYqZBEu0khRwbWtEjge3BUA";
+  const int buf_size = sizeof(write_buf) - 1;
+  char read_buf[buf_size];
+
+  GIVEN("A file with data and attributes.") {
+    std::string from("kinetic://Cluster2/from");
+    std::string to("kinetic://Cluster2/to");
+    auto fileio = KineticIoFactory::makeFileIo(from);
+    REQUIRE_NOTHROW(fileio->Open(SFS_O_CREAT));
+    REQUIRE((fileio->Write(0, write_buf, buf_size) == buf_size));
+    REQUIRE_NOTHROW(fileio->attrSet("name", "value"));
+    REQUIRE_NOTHROW(fileio->Close());
+
+    WHEN("It is renamed.") {
+      fileio = KineticIoFactory::makeFileIo(from);
+      REQUIRE_NOTHROW(fileio->Rename(to));
+
+      THEN("Data and attributes are available at the new path.") {
+        auto renamed = KineticIoFactory::makeFileIo(to);
+        REQUIRE_NOTHROW(renamed->Open(0));
+        REQUIRE((renamed->Read(0, read_buf, buf_size) == buf_size));
+        REQUIRE((memcmp(write_buf, read_buf, buf_size) == 0));
+        REQUIRE((renamed->attrGet("name") == "value"));
+        REQUIRE((fileio->attrGet("name") == "value"));
+
+        auto list = renamed->ListFiles("kinetic://Cluster2/", 10);
+        REQUIRE((list.size() == 1));
+        REQUIRE((list.front() == to));
+
+        AND_THEN("Removing the file removes its data and attributes.") {
+          REQUIRE_NOTHROW(renamed->Remove());
+          REQUIRE((renamed->attrList().empty()));
+        }
+      }
+
+      THEN("The old path does not exist anymore.") {
+        auto old = KineticIoFactory::makeFileIo(from);
+        REQUIRE_THROWS_AS(old->Open(0), std::system_error);
+        try {
+          old->Open(0);
+        } catch (const std::system_error& e) {
+          REQUIRE((e.code().value() == ENOENT));
+        }
+      }
+    }
+
+    THEN("Renaming to an existing file fails with EEXIST.") {
+      auto existing = KineticIoFactory::makeFileIo(to);
+      REQUIRE_NOTHROW(existing->Open(SFS_O_CREAT));
+      REQUIRE_NOTHROW(existing->Close());
+      REQUIRE_THROWS_AS(fileio->Rename(to), std::system_error);
+      try {
+        fileio->Rename(to);
+      } catch (const std::system_error& e) {
+        REQUIRE((e.code().value() == EEXIST));
+      }
+      REQUIRE((fileio->attrGet("name") == "value"));
+    }
+
+    THEN("Renaming to a different cluster fails with EXDEV.") {
+      REQUIRE_THROWS_AS(fileio->Rename("kinetic://Cluster1/to"), std::system_error);
+      try {
+        fileio->Rename("kinetic://Cluster1/to");
+      } catch (const std::system_error& e) {
+        REQUIRE((e.code().value() == EXDEV));
+      }
+    }
+  }
+
+  GIVEN("A file stored under its path.") {
+    auto cluster = kio::kio().cmap().getCluster("Cluster2");
+    std::shared_ptr<const std::string> version;
+    REQUIRE((cluster->put(utility::makeMetadataKey("Cluster2", "legacy"), std::make_shared<const std::string>(),
+                          std::make_shared<const std::string>(), version).ok()));
+    REQUIRE((cluster->put(utility::makeAttributeKey("Cluster2", "legacy", "name"),
+                          std::make_shared<const std::string>("value"), version).ok()));
+
+    THEN("It keeps its attributes when renamed.") {
+      auto fileio = KineticIoFactory::makeFileIo("kinetic://Cluster2/legacy");
+      REQUIRE((fileio->attrGet("name") == "value"));
+      REQUIRE_NOTHROW(fileio->Rename("kinetic://Cluster2/renamed"));
+      auto renamed = KineticIoFactory::makeFileIo("kinetic://Cluster2/renamed");
+      REQUIRE((renamed->attrGet("name") == "value"));
+      REQUIRE_NOTHROW(renamed->Remove());
+    }
+  }
+}
+
+namespace {
+  class CloseCompletion {
+  public:
+    void done(std::error_code ec)
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      result = ec;
+      completed = true;
+      cv.notify_all();
+    }
+
+    std::error_code wait()
+    {
+      std::unique_lock<std::mutex> lock(mutex);
+      while (!completed) {
+        cv.wait(lock);
+      }
+      return result;
+    }
+
+    CloseCompletion() : completed(false)
+    { }
+
+  private:
+    std::mutex mutex;
+    std::condition_variable cv;
+    bool completed;
+    std::error_code result;
+  };
+}
+
+SCENARIO("FileIo Asynchronous Close Integration Test", "[CloseAsync]")
+{
+  auto& c = SimulatorController::getInstance();
+  REQUIRE(c.reset());
+  kio::KineticIoFactory::reloadConfiguration();
+
+  GIVEN("A file is created and written.") {
+    std::string url("kinetic://Cluster2/async");
+    std::string content(5 * 1024 * 1024, 'a');
+    for (size_t i = 0; i < content.size(); i += 4096) {
+      content[i] = static_cast<char>('a' + (i / 4096) % 26);
+    }
+
+    auto fileio = KineticIoFactory::makeFileIo(url);
+    REQUIRE_NOTHROW(fileio->Open(SFS_O_CREAT));
+    REQUIRE((fileio->Write(0, content.data(), content.size()) == static_cast<int64_t>(content.size())));
+
+    auto completion = std::make_shared<CloseCompletion>();
+
+    WHEN("It is closed asynchronously.") {
+      REQUIRE_NOTHROW(fileio->CloseAsync(std::bind(&CloseCompletion::done, completion, std::placeholders::_1)));
+
+      THEN("Reopening it before the close completes sees all data.") {
+        /* Results are checked after the close completed, so that a failed check doesn't leave the close running
+         * into the next test. */
+        struct stat stbuf;
+        memset(&stbuf, 0, sizeof(stbuf));
+        std::vector<char> rbuf(content.size());
+        int64_t bytes = -1;
+        bool failed = false;
+        try {
+          auto reopened = KineticIoFactory::makeFileIo(url);
+          reopened->Open(0);
+          reopened->Stat(&stbuf);
+          bytes = reopened->Read(0, rbuf.data(), rbuf.size());
+          reopened->Close();
+        }
+        catch (const std::system_error& e) {
+          failed = true;
+        }
+        REQUIRE((!completion->wait()));
+
+        REQUIRE_FALSE(failed);
+        REQUIRE((stbuf.st_size == static_cast<off_t>(content.size())));
+        REQUIRE((bytes == static_cast<int64_t>(content.size())));
+        REQUIRE((memcmp(content.data(), rbuf.data(), content.size()) == 0));
+      }
+
+      THEN("The callback reports success.") {
+        REQUIRE((!completion->wait()));
+
+        AND_THEN("The object can be reused.") {
+          REQUIRE_NOTHROW(fileio->Open(0));
+          struct stat stbuf;
+          REQUIRE_NOTHROW(fileio->Stat(&stbuf));
+          REQUIRE((stbuf.st_size == static_cast<off_t>(content.size())));
+          REQUIRE_NOTHROW(fileio->Close());
+        }
+      }
+    }
+  }
+}
@@ -14,6 +14,7 @@
  ************************************************************************/
 
 #include <unistd.h>
+#include <iomanip>
 #include "KineticAdminCluster.hh"
 #include "SimulatorController.h"
 #include "Utility.hh"
@@ -52,6 +53,7 @@ SCENARIO("Repair test.", "[Repair]")
 {
   auto& c = SimulatorController::getInstance();
   SocketListener listener;
+  ReconnectScheduler reconnects(1);
 
   GIVEN ("A valid admin cluster") {
     REQUIRE(c.reset());
@@ -62,7 +64,7 @@ SCENARIO("Repair test.", "[Repair]")
     std::vector<std::unique_ptr<KineticAutoConnection>> connections;
     for (int i = 0; i < 10; i++) {
       std::unique_ptr<KineticAutoConnection> autocon(
-          new KineticAutoConnection(listener, std::make_pair(c.get(i), c.get(i)), std::chrono::seconds(1))
+          new KineticAutoConnection(listener, reconnects, std::make_pair(c.get(i), c.get(i)), std::chrono::seconds(1))
       );
       connections.push_back(std::move(autocon));
     }
@@ -106,6 +108,35 @@ SCENARIO("Repair test.", "[Repair]")
       
         repair = cluster->repair(AdminClusterInterface::OperationTarget::METADATA);
         REQUIRE((repair.repaired == 1));  
+
+        auto scan = cluster->scan(AdminClusterInterface::OperationTarget::DATA);
+        REQUIRE((scan.need_action == 0));
+      }
+
+      THEN("Partial stripes should be repairable after resetting nParity drives") {
+        auto small_value = make_shared<const string>(blocksize + blocksize / 2, 's');
+        auto small_key = utility::makeDataKey(clusterId, "small", 1);
+        shared_ptr<const string> small_version;
+        REQUIRE(cluster->put(small_key, small_value, small_version).ok());
+
+        for(int i=0; i<4; i++) {
+          c.reset(i);
+        }
+        auto repair = cluster->repair(AdminClusterInterface::OperationTarget::DATA);
+        REQUIRE((repair.repaired == 2));
+        REQUIRE((repair.unrepairable == 0));
+
+        auto scan = cluster->scan(AdminClusterInterface::OperationTarget::DATA);
+        REQUIRE((scan.need_action == 0));
+
+        std::shared_ptr<const std::string> get_value;
+        std::shared_ptr<const std::string> get_version;
+        cluster->get(small_key, get_version, get_value);
+        REQUIRE((*small_value == *get_value));
+
+        /* Only the invalid chunks are written with the existing version, the full put fallback would have written
+         * the stripe with a new version. */
+        REQUIRE((*get_version == *small_version));
       }
       
       THEN("Keys should not be repairable after resetting nParity+1 drives") {
@@ -140,6 +171,7 @@ SCENARIO("Admin integration test.", "[Admin]")
 {
   auto& c = SimulatorController::getInstance();
   SocketListener listener;
+  ReconnectScheduler reconnects(1);
 
   GIVEN ("A valid admin cluster") {
     REQUIRE(c.reset());
@@ -152,7 +184,7 @@ SCENARIO("Admin integration test.", "[Admin]")
     std::vector<std::unique_ptr<KineticAutoConnection>> connections;
     for (int i = 0; i < 3; i++) {
       std::unique_ptr<KineticAutoConnection> autocon(
-          new KineticAutoConnection(listener, std::make_pair(c.get(i), c.get(i)), std::chrono::seconds(1))
+          new KineticAutoConnection(listener, reconnects, std::make_pair(c.get(i), c.get(i)), std::chrono::seconds(1))
       );
       connections.push_back(std::move(autocon));
     }
@@ -162,6 +194,17 @@ SCENARIO("Admin integration test.", "[Admin]")
                                                          std::make_shared<RedundancyProvider>(nData, nParity)
     );
 
+    THEN("All drives can be benchmarked concurrently") {
+      auto status = cluster->status(10, 4, 64 * 1024);
+      REQUIRE((status.benchmark.size() == 3));
+      for (size_t i = 0; i < status.benchmark.size(); i++) {
+        REQUIRE(status.connected[i]);
+        REQUIRE((status.benchmark[i].put_iops > 0));
+        REQUIRE((status.benchmark[i].get_mbps > 0));
+        REQUIRE((status.benchmark[i].get_latency_p99 >= status.benchmark[i].get_latency_p50));
+      }
+      REQUIRE((cluster->status().benchmark.empty()));
+    }
 
     WHEN("Putting a key-value pair with one drive down") {
       c.block(0);
@@ -264,3 +307,185 @@ SCENARIO("Admin integration test.", "[Admin]")
     }
   }
 }
+
+SCENARIO("Deduplication test.", "[Dedup]")
+{
+  auto& c = SimulatorController::getInstance();
+  SocketListener listener;
+  ReconnectScheduler reconnects(1);
+
+  GIVEN ("An admin cluster with deduplication enabled") {
+    REQUIRE(c.reset());
+
+    std::string clusterId = "testCluster";
+    std::size_t blocksize = 1024 * 1024;
+
+    std::vector<std::unique_ptr<KineticAutoConnection>> connections;
+    for (int i = 0; i < 3; i++) {
+      std::unique_ptr<KineticAutoConnection> autocon(
+          new KineticAutoConnection(listener, reconnects, std::make_pair(c.get(i), c.get(i)), std::chrono::seconds(1))
+      );
+      connections.push_back(std::move(autocon));
+    }
+
+    auto grace = std::chrono::seconds(2);
+    auto cluster = std::make_shared<KineticAdminCluster>(clusterId, blocksize, std::chrono::seconds(10),
+                                                         std::move(connections),
+                                                         std::make_shared<RedundancyProvider>(2, 1), 4096, false,
+                                                         grace
+    );
+
+    WHEN("The same value is put to two data keys") {
+      auto value = make_shared<const string>(64 * 1024, 'd');
+      auto first = utility::makeDataKey(clusterId, "first", 0);
+      auto second = utility::makeDataKey(clusterId, "second", 0);
+
+      shared_ptr<const string> version;
+      REQUIRE(cluster->put(first, value, version).ok());
+      REQUIRE(cluster->put(second, value, version).ok());
+
+      THEN("The content is stored only once") {
+        auto stats = cluster->stats();
+        REQUIRE((stats.dedup_bytes_logical == 2 * value->size()));
+        REQUIRE((stats.dedup_bytes_stored == value->size()));
+        REQUIRE((cluster->count(AdminClusterInterface::OperationTarget::DATA) == 3));
+      }
+
+      THEN("Both keys can be read and their versions encode the value size") {
+        shared_ptr<const string> readvalue;
+        REQUIRE(cluster->get(second, version, readvalue).ok());
+        REQUIRE((*readvalue == *value));
+        REQUIRE((utility::uuidDecodeSize(version) == value->size()));
+      }
+
+      THEN("Referenced content is not garbage collected") {
+        auto kc = cluster->collectGarbage();
+        REQUIRE((kc.total == 1));
+        REQUIRE((kc.removed == 0));
+      }
+
+      THEN("Small values are not deduplicated") {
+        auto small = utility::makeDataKey(clusterId, "small", 0);
+        REQUIRE(cluster->put(small, make_shared<const string>(1024, 'd'), version).ok());
+        REQUIRE((cluster->count(AdminClusterInterface::OperationTarget::DATA) == 4));
+      }
+
+      THEN("A different value of the same size is stored as separate content") {
+        auto other = utility::makeDataKey(clusterId, "other", 0);
+        auto othervalue = make_shared<string>(*value);
+        (*othervalue)[othervalue->size() / 2] = 'e';
+        REQUIRE(cluster->put(other, othervalue, version).ok());
+        REQUIRE((cluster->count(AdminClusterInterface::OperationTarget::DATA) == 5));
+
+        shared_ptr<const string> readvalue;
+        REQUIRE(cluster->get(other, version, readvalue).ok());
+        REQUIRE((*readvalue == *othervalue));
+      }
+
+      AND_WHEN("The data keys are removed") {
+        REQUIRE(cluster->remove(first).ok());
+        REQUIRE(cluster->remove(second).ok());
+
+        THEN("The content is kept while its references are within the grace period") {
+          auto kc = cluster->collectGarbage();
+          REQUIRE((kc.total == 1));
+          REQUIRE((kc.need_action == 0));
+          REQUIRE((kc.removed == 0));
+          REQUIRE((cluster->count(AdminClusterInterface::OperationTarget::DATA) == 1));
+        }
+
+        AND_WHEN("The grace period has passed") {
+          sleep(grace.count() + 1);
+
+          THEN("The content and its stale references are garbage collected") {
+            auto kc = cluster->collectGarbage();
+            REQUIRE((kc.total == 1));
+            REQUIRE((kc.need_action == 1));
+            REQUIRE((kc.removed == 1));
+            REQUIRE((cluster->count(AdminClusterInterface::OperationTarget::DATA) == 0));
+            REQUIRE((cluster->count(AdminClusterInterface::OperationTarget::ATTRIBUTE) == 0));
+          }
+        }
+      }
+    }
+  }
+}
+
+SCENARIO("Approximate count test.", "[Count]")
+{
+  auto& c = SimulatorController::getInstance();
+  SocketListener listener;
+  ReconnectScheduler reconnects(1);
+
+  GIVEN ("An admin cluster with key counters enabled") {
+    REQUIRE(c.reset());
+
+    std::string clusterId = "testCluster";
+    std::size_t blocksize = 1024 * 1024;
+
+    std::vector<std::unique_ptr<KineticAutoConnection>> connections;
+    for (int i = 0; i < 3; i++) {
+      std::unique_ptr<KineticAutoConnection> autocon(
+          new KineticAutoConnection(listener, reconnects, std::make_pair(c.get(i), c.get(i)), std::chrono::seconds(1))
+      );
+      connections.push_back(std::move(autocon));
+    }
+
+    auto cluster = std::make_shared<KineticAdminCluster>(clusterId, blocksize, std::chrono::seconds(10),
+                                                         std::move(connections),
+                                                         std::make_shared<RedundancyProvider>(2, 1), 0, true
+    );
+    auto value = make_shared<const string>("value");
+    shared_ptr<const string> version;
+
+    WHEN("A few keys are put") {
+      for (int i = 0; i < 10; i++) {
+        REQUIRE(cluster->put(utility::makeMetadataKey(clusterId, utility::Convert::toString("file", i)), value,
+                             version).ok());
+      }
+
+      THEN("They are counted exactly") {
+        auto estimate = cluster->estimateCount(AdminClusterInterface::OperationTarget::METADATA);
+        REQUIRE((estimate.count == 10));
+        REQUIRE((estimate.error == 0));
+      }
+    }
+
+    WHEN("More keys are put than can be listed with a single request") {
+      for (int i = 0; i < 250; i++) {
+        auto name = utility::Convert::toString("file", std::setw(3), std::setfill('0'), i);
+        REQUIRE(cluster->put(utility::makeMetadataKey(clusterId, name), value, version).ok());
+      }
+
+      THEN("Sampling estimates their number") {
+        auto estimate = cluster->estimateCount(AdminClusterInterface::OperationTarget::METADATA);
+        REQUIRE((estimate.error > 0));
+        REQUIRE((std::abs(estimate.count - 250) <= 2 * estimate.error));
+      }
+
+      AND_WHEN("The key counter is initialized by a count") {
+        REQUIRE((cluster->count(AdminClusterInterface::OperationTarget::METADATA) == 250));
+
+        THEN("Created and removed keys are accounted for") {
+          REQUIRE(cluster->put(utility::makeMetadataKey(clusterId, "new"), make_shared<const string>(), value,
+                               version).ok());
+          auto other = make_shared<const string>("other");
+          REQUIRE(cluster->put(utility::makeMetadataKey(clusterId, "file000"), other, version).ok());
+          REQUIRE(cluster->put(utility::makeMetadataKey(clusterId, "forced"), other, version).ok());
+          REQUIRE(cluster->remove(utility::makeMetadataKey(clusterId, "file001")).ok());
+          REQUIRE((cluster->remove(utility::makeMetadataKey(clusterId, "missing")).statusCode() ==
+                   StatusCode::REMOTE_NOT_FOUND));
+
+          shared_ptr<const string> readvalue;
+          REQUIRE(cluster->get(utility::makeMetadataKey(clusterId, "file000"), version, readvalue).ok());
+          REQUIRE((*readvalue == *other));
+
+          /* One key created, one removed and two forced puts which may or may not have created a key. */
+          auto estimate = cluster->estimateCount(AdminClusterInterface::OperationTarget::METADATA);
+          REQUIRE((estimate.count == 251));
+          REQUIRE((estimate.error == -1));
+        }
+      }
+    }
+  }
+}
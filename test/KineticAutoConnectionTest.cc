@@ -15,6 +15,7 @@
 
 #include <unistd.h>
 #include "KineticAutoConnection.hh"
+#include "KineticCallbacks.hh"
 #include "SimulatorController.h"
 #include "catch.hpp"
 
@@ -59,13 +60,14 @@ SCENARIO("Connection Test", "[Con]")
   c.enable(0);
 
   SocketListener listener;
+  ReconnectScheduler reconnects(1);
   fd_set x;
   int y;
 
   GIVEN ("An autoconnection") {
 
     auto info = std::make_pair(c.get(0), c.get(0));
-    auto autocon = std::make_shared<KineticAutoConnection>(listener, info, std::chrono::seconds(1));
+    auto autocon = std::make_shared<KineticAutoConnection>(listener, reconnects, info, std::chrono::seconds(1));
 
     THEN("It is accessible.") {
       auto con = autocon->get();
@@ -107,6 +109,13 @@ SCENARIO("Connection Test", "[Con]")
             REQUIRE(cb->done());
             REQUIRE(cb->ok());
           }
+
+          AND_THEN("the reconnect is accounted for.") {
+            REQUIRE((autocon->reconnectStats().attempts == 2));
+            REQUIRE((autocon->reconnectStats().failures == 0));
+            REQUIRE((reconnects.stats().attempts == 2));
+            REQUIRE((reconnects.stats().pending == 0));
+          }
         }
       }
 
@@ -124,4 +133,123 @@ SCENARIO("Connection Test", "[Con]")
     }
 
   }
+
+  GIVEN ("An autoconnection to a port nobody listens on") {
+    auto bad = c.get(0);
+    bad.port = 1;
+    KineticAutoConnection autocon(listener, reconnects, std::make_pair(bad, bad), std::chrono::seconds(1));
+
+    THEN("The initial connect fails and the connection backs off.") {
+      REQUIRE_THROWS(autocon.get());
+      REQUIRE((reconnects.stats().failures == 1));
+      REQUIRE((reconnects.stats().backing_off == 1));
+
+      AND_WHEN("A reconnect is requested repeatedly.") {
+        REQUIRE_THROWS(autocon.get());
+        REQUIRE_THROWS(autocon.get());
+        REQUIRE((reconnects.stats().pending == 1));
+
+        THEN("It is attempted once after the first backoff of at most the rate limit.") {
+          usleep(1000 * 1200);
+          REQUIRE((autocon.reconnectStats().attempts == 2));
+          REQUIRE((autocon.reconnectStats().failures == 2));
+          REQUIRE((reconnects.stats().pending == 0));
+
+          AND_THEN("The next attempt waits for at least the rate limit.") {
+            REQUIRE_THROWS(autocon.get());
+            usleep(1000 * 500);
+            REQUIRE((autocon.reconnectStats().attempts == 2));
+            REQUIRE((reconnects.stats().pending == 1));
+          }
+        }
+      }
+    }
+  }
+
+  GIVEN ("An autoconnection with a maximum queue depth of 4 and a target latency of 10 ms") {
+    auto info = std::make_pair(c.get(0), c.get(0));
+    KineticAutoConnection autocon(listener, reconnects, info, std::chrono::seconds(1), 4, std::chrono::milliseconds(10));
+
+    THEN("No more than 4 slots can be acquired.") {
+      for (int i = 0; i < 4; i++) {
+        REQUIRE(autocon.acquireSlot());
+      }
+      REQUIRE_FALSE(autocon.acquireSlot());
+      REQUIRE((autocon.queueStats().outstanding == 4));
+
+      AND_WHEN("A request times out.") {
+        autocon.releaseSlot(std::chrono::microseconds(100), true);
+
+        THEN("The limit is halved.") {
+          REQUIRE((autocon.queueStats().limit == 2));
+          REQUIRE_FALSE(autocon.acquireSlot());
+
+          AND_WHEN("Requests complete within the target latency.") {
+            for (int i = 0; i < 3; i++) {
+              autocon.releaseSlot(std::chrono::microseconds(100), false);
+            }
+            for (int i = 0; i < 8; i++) {
+              REQUIRE(autocon.acquireSlot());
+              autocon.releaseSlot(std::chrono::microseconds(100), false);
+            }
+
+            THEN("The limit grows back to the maximum.") {
+              REQUIRE((autocon.queueStats().limit == 4));
+              REQUIRE((autocon.queueStats().outstanding == 0));
+            }
+          }
+        }
+      }
+    }
+
+    THEN("Requests waiting for a slot are served in order and notified when a slot is available.") {
+      for (int i = 0; i < 4; i++) {
+        REQUIRE(autocon.acquireSlot());
+      }
+      auto first_sync = std::make_shared<CallbackSynchronization>();
+      auto second_sync = std::make_shared<CallbackSynchronization>();
+      BasicCallback first(first_sync);
+      BasicCallback second(second_sync);
+      REQUIRE_FALSE(autocon.acquireSlot(&first));
+      REQUIRE_FALSE(autocon.acquireSlot(&second));
+
+      autocon.releaseSlot(std::chrono::microseconds(100), false);
+      auto start = std::chrono::system_clock::now();
+      first_sync->wait_for_slot(start + std::chrono::seconds(5));
+      REQUIRE((std::chrono::system_clock::now() - start < std::chrono::seconds(5)));
+
+      REQUIRE_FALSE(autocon.acquireSlot());
+      REQUIRE_FALSE(autocon.acquireSlot(&second));
+      REQUIRE(autocon.acquireSlot(&first));
+      REQUIRE_FALSE(autocon.acquireSlot(&second));
+
+      AND_WHEN("The remaining queued request gives up waiting.") {
+        autocon.releaseSlot(std::chrono::microseconds(100), false);
+        autocon.cancelSlot(&second);
+
+        THEN("The slot is available to new requests.") {
+          REQUIRE(autocon.acquireSlot());
+        }
+      }
+    }
+
+    THEN("Waiting requests are accounted for.") {
+      autocon.recordQueueWait(std::chrono::microseconds(1500));
+      autocon.recordQueueWait(std::chrono::microseconds(500));
+      REQUIRE((autocon.queueStats().deferred == 2));
+      REQUIRE((autocon.queueStats().wait == std::chrono::microseconds(2000)));
+    }
+  }
+
+  GIVEN ("An autoconnection without queue depth limit") {
+    auto info = std::make_pair(c.get(0), c.get(0));
+    KineticAutoConnection autocon(listener, reconnects, info, std::chrono::seconds(1));
+
+    THEN("Slots are always available.") {
+      for (int i = 0; i < 1000; i++) {
+        REQUIRE(autocon.acquireSlot());
+      }
+      REQUIRE((autocon.queueStats().limit == 0));
+    }
+  }
 }
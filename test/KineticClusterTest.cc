@@ -30,6 +30,7 @@ SCENARIO("Cluster integration test.", "[Cluster]")
 
   auto& c = SimulatorController::getInstance();
   SocketListener listener;
+  ReconnectScheduler reconnects(1);
 
   GIVEN ("A valid drive cluster") {
     REQUIRE(c.reset(0));
@@ -43,7 +44,7 @@ SCENARIO("Cluster integration test.", "[Cluster]")
     std::vector<std::unique_ptr<KineticAutoConnection>> connections;
     for (int i = 0; i < 3; i++) {
       std::unique_ptr<KineticAutoConnection> autocon(
-          new KineticAutoConnection(listener, std::make_pair(c.get(i), c.get(i)), std::chrono::seconds(10))
+          new KineticAutoConnection(listener, reconnects, std::make_pair(c.get(i), c.get(i)), std::chrono::seconds(10))
       );
       connections.push_back(std::move(autocon));
     }
@@ -0,0 +1,69 @@
+/************************************************************************
+ * KineticIo - a file io interface library to kinetic devices.          *
+ *                                                                      *
+ * This Source Code Form is subject to the terms of the Mozilla         *
+ * Public License, v. 2.0. If a copy of the MPL was not                 *
+ * distributed with this file, You can obtain one at                    *
+ * https://mozilla.org/MP:/2.0/.                                        *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without       *
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or         *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public             *
+ * License for more details.                                            *
+ ************************************************************************/
+
+#include "LockProfiler.hh"
+#include <thread>
+#include <unistd.h>
+#include "catch.hpp"
+
+using namespace kio;
+
+namespace {
+  void hold(ProfiledMutex* m)
+  {
+    std::lock_guard<ProfiledMutex> lock(*m);
+    usleep(20000);
+  }
+}
+
+SCENARIO("Lock profiler test.", "[Lock]")
+{
+  bool was_enabled = LockProfiler::enabled();
+
+  GIVEN("A mutex constructed with profiling disabled") {
+    LockProfiler::setEnabled(false);
+    ProfiledMutex m("LockProfilerTest::disabled");
+    m.lock();
+    m.unlock();
+
+    THEN("It is not part of the report") {
+      REQUIRE((LockProfiler::report().find("LockProfilerTest::disabled") == std::string::npos));
+    }
+  }
+
+  GIVEN("A mutex constructed with profiling enabled") {
+    LockProfiler::setEnabled(true);
+    ProfiledMutex m("LockProfilerTest::enabled");
+    LockProfiler::reset();
+
+    WHEN("It is acquired while held by another thread") {
+      std::thread t(hold, &m);
+      usleep(5000);
+      m.lock();
+      m.unlock();
+      t.join();
+      REQUIRE(m.try_lock());
+      m.unlock();
+
+      THEN("Acquisitions, contention and wait times are reported") {
+        auto report = LockProfiler::report();
+        REQUIRE((report.find("LockProfilerTest::enabled: 3 acquisitions, 1 contended") != std::string::npos));
+        REQUIRE((report.find("contended wait histogram") != std::string::npos));
+      }
+    }
+  }
+
+  LockProfiler::setEnabled(was_enabled);
+}
@@ -15,6 +15,7 @@
 
 #include "RedundancyProvider.hh"
 #include "Utility.hh"
+#include <algorithm>
 #include <fcntl.h>
 #include <unistd.h>
 #include <Logging.hh>
@@ -129,6 +130,33 @@ SCENARIO("Redundancy Provider Test.", "[Redundancy]"){
             reconstructed.resize(value.size());
             REQUIRE((value == reconstructed));
           }
+
+          THEN("We can decode deleted subchunks incrementally, adding sources in any order."){
+            auto encoded = stripe;
+            std::vector<size_t> erasures;
+            for(int i=0; i<nParity; i++){
+              erasures.push_back(i*2 % (nData+nParity));
+            }
+            std::sort(erasures.begin(), erasures.end());
+            erasures.erase(std::unique(erasures.begin(), erasures.end()), erasures.end());
+            for(auto it=erasures.begin(); it!=erasures.end(); it++){
+              stripe[*it] = make_shared<const string>();
+            }
+
+            std::unique_ptr<RedundancyProvider::Decoder> decoder;
+            REQUIRE_NOTHROW(decoder = rp.makeDecoder(erasures, encoded[0]->size()));
+            auto sources = decoder->sources();
+            REQUIRE((sources.size() == static_cast<size_t>(nData)));
+            REQUIRE_THROWS(decoder->finish(stripe));
+
+            for(auto it=sources.rbegin(); it!=sources.rend(); it++){
+              REQUIRE_NOTHROW(decoder->add(*it, stripe[*it]));
+            }
+            REQUIRE_NOTHROW(decoder->finish(stripe));
+            for(int i=0; i<nData+nParity; i++){
+              REQUIRE((*stripe[i] == *encoded[i]));
+            }
+          }
         }
 
         THEN("Too few healthy chunks throws."){
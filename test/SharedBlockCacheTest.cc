@@ -0,0 +1,111 @@
+/************************************************************************
+ * KineticIo - a file io interface library to kinetic devices.          *
+ *                                                                      *
+ * This Source Code Form is subject to the terms of the Mozilla         *
+ * Public License, v. 2.0. If a copy of the MPL was not                 *
+ * distributed with this file, You can obtain one at                    *
+ * https://mozilla.org/MP:/2.0/.                                        *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without       *
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or         *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public             *
+ * License for more details.                                            *
+ ************************************************************************/
+
+#include "SharedBlockCache.hh"
+#include <sys/mman.h>
+#include <unistd.h>
+#include <thread>
+#include "catch.hpp"
+
+using std::shared_ptr;
+using std::string;
+using namespace kio;
+
+namespace {
+  void put_repeatedly(SharedBlockCache* cache, std::string version)
+  {
+    for (int i = 0; i < 1000; i++) {
+      cache->put("race", version, version);
+    }
+  }
+}
+
+SCENARIO("Shared block cache test.", "[SharedCache]")
+{
+  std::string name = "/kineticio-test";
+  shm_unlink(name.c_str());
+
+  GIVEN ("Two shared caches attached to the same segment.") {
+    SharedBlockCache first;
+    SharedBlockCache second;
+    REQUIRE_FALSE(first.enabled());
+
+    first.changeConfiguration(name, 1024 * 64, 1024);
+    second.changeConfiguration(name, 1024 * 64, 1024);
+    REQUIRE(first.enabled());
+    REQUIRE(second.enabled());
+
+    shared_ptr<const string> version;
+    shared_ptr<const string> value;
+    std::chrono::system_clock::time_point verified;
+
+    THEN("A key that has not been published is not found.") {
+      REQUIRE_FALSE(second.get("key", version, value, verified));
+    }
+
+    WHEN("A value is published by one cache.") {
+      first.put("key", "version", "value");
+
+      THEN("It can be read through the other.") {
+        REQUIRE(second.get("key", version, value, verified));
+        REQUIRE((*version == "version"));
+        REQUIRE((*value == "value"));
+
+        AND_THEN("Touching it with the correct version updates the verification time.") {
+          usleep(1000 * 10);
+          second.touch("key", "version");
+          std::chrono::system_clock::time_point touched;
+          REQUIRE(first.get("key", version, value, touched));
+          REQUIRE(touched > verified);
+        }
+
+        AND_THEN("Touching it with an old version does not.") {
+          usleep(1000 * 10);
+          second.touch("key", "old");
+          std::chrono::system_clock::time_point touched;
+          REQUIRE(first.get("key", version, value, touched));
+          REQUIRE(touched == verified);
+        }
+      }
+    }
+
+    WHEN("The same key is published concurrently by both caches.") {
+      std::thread a(put_repeatedly, &first, std::string("a"));
+      std::thread b(put_repeatedly, &second, std::string("b"));
+      a.join();
+      b.join();
+
+      THEN("It is stored in a single slot, the latest value is read by both.") {
+        first.put("race", "final", "final");
+        REQUIRE(second.get("race", version, value, verified));
+        REQUIRE((*version == "final"));
+        REQUIRE(first.get("race", version, value, verified));
+        REQUIRE((*value == "final"));
+      }
+    }
+
+    THEN("Values exceeding the slot size are not published.") {
+      first.put("large", "version", std::string(2048, 'x'));
+      REQUIRE_FALSE(second.get("large", version, value, verified));
+    }
+
+    THEN("Attaching with a different geometry leaves the cache disabled.") {
+      SharedBlockCache third;
+      third.changeConfiguration(name, 1024 * 128, 1024);
+      REQUIRE_FALSE(third.enabled());
+    }
+  }
+  shm_unlink(name.c_str());
+}
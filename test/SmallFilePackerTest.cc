@@ -0,0 +1,259 @@
+/************************************************************************
+ * KineticIo - a file io interface library to kinetic devices.          *
+ *                                                                      *
+ * This Source Code Form is subject to the terms of the Mozilla         *
+ * Public License, v. 2.0. If a copy of the MPL was not                 *
+ * distributed with this file, You can obtain one at                    *
+ * https://mozilla.org/MP:/2.0/.                                        *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without       *
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or         *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public             *
+ * License for more details.                                            *
+ ************************************************************************/
+
+#include "KineticIoFactory.hh"
+#include "KineticIoSingleton.hh"
+#include "SimulatorController.h"
+#include "SmallFilePacker.hh"
+#include "Utility.hh"
+#include <thread>
+#include <mutex>
+#include <set>
+#include <unistd.h>
+#include "catch.hpp"
+
+using std::shared_ptr;
+using std::string;
+using namespace kio;
+
+namespace {
+  void create_file(std::string url, std::string content)
+  {
+    auto fileio = KineticIoFactory::makeFileIo(url);
+    fileio->Open(SFS_O_CREAT);
+    fileio->Write(0, content.c_str(), content.length());
+    fileio->Close();
+  }
+
+  void close_file(kio::FileIoInterface* fileio, std::mutex* gate)
+  {
+    gate->lock();
+    gate->unlock();
+    fileio->Close();
+  }
+
+  SmallFilePacker::Location get_location(std::shared_ptr<ClusterInterface> cluster, std::string path)
+  {
+    shared_ptr<const string> version;
+    shared_ptr<const string> value;
+    SmallFilePacker::Location location;
+    if (cluster->get(utility::makeMetadataKey(cluster->id(), path), version, value).ok()) {
+      SmallFilePacker::parse(*value, location);
+    }
+    return location;
+  }
+
+  //! Files are packed in the background after they have been closed.
+  SmallFilePacker::Location wait_for_location(std::shared_ptr<ClusterInterface> cluster, std::string path)
+  {
+    auto location = get_location(cluster, path);
+    for (int i = 0; i < 500 && location.pack.empty(); i++) {
+      usleep(10 * 1000);
+      location = get_location(cluster, path);
+    }
+    return location;
+  }
+}
+
+SCENARIO("Small file packing integration test.", "[Pack]")
+{
+  auto& c = SimulatorController::getInstance();
+  REQUIRE(c.reset());
+  KineticIoFactory::reloadConfiguration();
+  auto cluster = kio::kio().cmap().getCluster("Cluster1");
+
+  GIVEN ("Metadata values") {
+    SmallFilePacker::Location location;
+
+    THEN("Empty values are not packed.") {
+      REQUIRE_FALSE(SmallFilePacker::parse("", location));
+    }
+    THEN("Pack locations can be parsed.") {
+      REQUIRE(SmallFilePacker::parse("kio-pack 10 20 .kio-pack/abc", location));
+      REQUIRE((location.offset == 10));
+      REQUIRE((location.length == 20));
+      REQUIRE((location.pack == ".kio-pack/abc"));
+    }
+    THEN("Invalid pack locations are not accepted.") {
+      REQUIRE_FALSE(SmallFilePacker::parse("kio-pack 10", location));
+    }
+  }
+
+  GIVEN ("Small file packing is enabled") {
+    kio::kio().packer().changeConfiguration(64 * 1024, std::chrono::milliseconds(200));
+
+    WHEN("A single small file is closed.") {
+      kio::kio().packer().changeConfiguration(64 * 1024, std::chrono::seconds(10));
+      auto start = std::chrono::system_clock::now();
+      create_file("kinetic://Cluster1/single", "single");
+
+      THEN("Close does not wait for other files, the file is readable before it is packed.") {
+        REQUIRE((std::chrono::system_clock::now() - start < std::chrono::seconds(10)));
+        REQUIRE(get_location(cluster, "single").pack.empty());
+
+        auto fileio = KineticIoFactory::makeFileIo("kinetic://Cluster1/single");
+        fileio->Open(0);
+        char buf[16];
+        REQUIRE((fileio->Read(0, buf, 16) == 6));
+        REQUIRE((memcmp(buf, "single", 6) == 0));
+      }
+    }
+
+    WHEN("Small files are closed one after the other.") {
+      kio::kio().packer().changeConfiguration(64 * 1024, std::chrono::seconds(1));
+      const size_t count = 4;
+      for (size_t i = 0; i < count; i++) {
+        create_file("kinetic://Cluster1/s" + std::to_string((long long) i), std::string(i + 1, 's'));
+      }
+
+      THEN("They share a pack and their own data keys are removed.") {
+        std::set<std::string> packs;
+        for (size_t i = 0; i < count; i++) {
+          auto location = wait_for_location(cluster, "s" + std::to_string((long long) i));
+          REQUIRE_FALSE(location.pack.empty());
+          REQUIRE((location.length == i + 1));
+          packs.insert(location.pack);
+        }
+        REQUIRE((packs.size() == 1));
+
+        /* The data keys are removed after readers had the chance to notice the file has been packed. */
+        sleep(2);
+        for (size_t i = 0; i < count; i++) {
+          auto path = "s" + std::to_string((long long) i);
+          shared_ptr<const string> version;
+          shared_ptr<const string> value;
+          REQUIRE(cluster->get(utility::makeMetadataKey(cluster->id(), path), version, value).ok());
+          auto data_key = utility::makeDataKey(cluster->id(), utility::metadataToBase(path, *value), 0);
+          REQUIRE((cluster->get(data_key, version).statusCode() == kinetic::StatusCode::REMOTE_NOT_FOUND));
+
+          auto fileio = KineticIoFactory::makeFileIo("kinetic://Cluster1/" + path);
+          fileio->Open(0);
+          char buf[16];
+          REQUIRE((fileio->Read(0, buf, 16) == (ssize_t) i + 1));
+        }
+      }
+    }
+
+    WHEN("Small files are closed concurrently.") {
+      const size_t count = 8;
+      std::vector<std::unique_ptr<kio::FileIoInterface>> files;
+      std::vector<std::thread> threads;
+      std::mutex gate;
+      gate.lock();
+      for (size_t i = 0; i < count; i++) {
+        auto content = std::string(i + 1, static_cast<char>('a' + i));
+        files.push_back(KineticIoFactory::makeFileIo("kinetic://Cluster1/f" + std::to_string((long long) i)));
+        files.back()->Open(SFS_O_CREAT);
+        files.back()->Write(0, content.c_str(), content.length());
+        threads.push_back(std::thread(std::bind(close_file, files.back().get(), &gate)));
+      }
+      gate.unlock();
+      for (auto it = threads.begin(); it != threads.end(); it++) {
+        it->join();
+      }
+
+      std::vector<SmallFilePacker::Location> locations;
+      for (size_t i = 0; i < count; i++) {
+        locations.push_back(wait_for_location(cluster, "f" + std::to_string((long long) i)));
+      }
+
+      THEN("Files closed within the delay share a pack.") {
+        std::set<std::string> packs;
+        for (size_t i = 0; i < count; i++) {
+          REQUIRE_FALSE(locations[i].pack.empty());
+          REQUIRE((locations[i].length == i + 1));
+          packs.insert(locations[i].pack);
+        }
+        REQUIRE((packs.size() < count));
+      }
+
+      THEN("They can be read and stat'd.") {
+        for (size_t i = 0; i < count; i++) {
+          auto fileio = KineticIoFactory::makeFileIo("kinetic://Cluster1/f" + std::to_string((long long) i));
+          fileio->Open(0);
+          char buf[16];
+          REQUIRE((fileio->Read(0, buf, 16) == (ssize_t) i + 1));
+          REQUIRE((buf[i] == static_cast<char>('a' + i)));
+
+          struct stat st;
+          fileio->Stat(&st);
+          REQUIRE((st.st_size == (off_t) i + 1));
+        }
+      }
+
+      THEN("Writing to a packed file moves it to its own data key.") {
+        auto fileio = KineticIoFactory::makeFileIo("kinetic://Cluster1/f0");
+        fileio->Open(0);
+        REQUIRE((fileio->Write(1, "cc", 2) == 2));
+        fileio->Close();
+        REQUIRE(get_location(cluster, "f0").pack.empty());
+
+        fileio->Open(0);
+        char buf[3];
+        REQUIRE((fileio->Read(0, buf, 3) == 3));
+        REQUIRE((memcmp(buf, "acc", 3) == 0));
+      }
+
+      THEN("A pack is compacted once most of its files are removed.") {
+        /* Keep the smallest file of a pack shared by multiple files, remove the others. */
+        size_t keep = count;
+        for (size_t i = 0; i < count && keep == count; i++) {
+          for (size_t j = i + 1; j < count; j++) {
+            if (locations[j].pack == locations[i].pack) {
+              keep = i;
+              break;
+            }
+          }
+        }
+        REQUIRE((keep < count));
+        auto pack = locations[keep].pack;
+        for (size_t i = keep + 1; i < count; i++) {
+          if (locations[i].pack == pack) {
+            KineticIoFactory::makeFileIo("kinetic://Cluster1/f" + std::to_string((long long) i))->Remove();
+          }
+        }
+        REQUIRE(kio::kio().packer().compact(cluster, pack).ok());
+
+        shared_ptr<const string> version;
+        REQUIRE((cluster->get(utility::makeDataKey(cluster->id(), pack, 0), version).statusCode() ==
+                 kinetic::StatusCode::REMOTE_NOT_FOUND));
+
+        AND_THEN("Remaining files are still readable from their new pack.") {
+          auto name = "f" + std::to_string((long long) keep);
+          auto location = get_location(cluster, name);
+          REQUIRE_FALSE(location.pack.empty());
+          REQUIRE((location.pack != pack));
+
+          auto fileio = KineticIoFactory::makeFileIo("kinetic://Cluster1/" + name);
+          fileio->Open(0);
+          char buf[16];
+          REQUIRE((fileio->Read(0, buf, 16) == (ssize_t) keep + 1));
+          REQUIRE((buf[keep] == static_cast<char>('a' + keep)));
+        }
+      }
+    }
+
+    WHEN("A file exceeding the threshold is closed.") {
+      std::string content(64 * 1024 + 1, 'x');
+      create_file("kinetic://Cluster1/large", content);
+
+      THEN("It is not packed.") {
+        REQUIRE(get_location(cluster, "large").pack.empty());
+      }
+    }
+
+    kio::kio().packer().changeConfiguration(0, std::chrono::milliseconds(0));
+  }
+}
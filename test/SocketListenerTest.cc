@@ -16,6 +16,8 @@
 #include "KineticAutoConnection.hh"
 #include "SimulatorController.h"
 #include "catch.hpp"
+#include <algorithm>
+#include <deque>
 
 using std::shared_ptr;
 using std::string;
@@ -55,10 +57,12 @@ SCENARIO("Listener Test.", "[Listen]"){
 
   GIVEN ("A Socket Listener"){
     kio::SocketListener listen;
+    kio::ReconnectScheduler reconnects(1);
 
     THEN("We can create a connection that will register with the listener"){
       kio::KineticAutoConnection con(
         listen,
+        reconnects,
         std::pair<ConnectionOptions,ConnectionOptions>(c.get(0),c.get(0)),
         std::chrono::seconds(10)
       );
@@ -83,4 +87,65 @@ SCENARIO("Listener Test.", "[Listen]"){
       }
     }
   }
+
+  GIVEN ("A Socket Listener with 4 event loops"){
+    kio::SocketListener listen(4);
+    kio::ReconnectScheduler reconnects(1);
+    REQUIRE((listen.subscriptions().size() == 4));
+
+    THEN("Connections are distributed evenly among the event loops"){
+      std::vector<std::unique_ptr<kio::KineticAutoConnection>> cons;
+      for (int i = 0; i < 8; i++) {
+        cons.push_back(std::unique_ptr<kio::KineticAutoConnection>(new kio::KineticAutoConnection(
+          listen,
+          reconnects,
+          std::pair<ConnectionOptions,ConnectionOptions>(c.get(0),c.get(0)),
+          std::chrono::seconds(10)
+        )));
+        REQUIRE_NOTHROW(cons.back()->get());
+      }
+      auto subscriptions = listen.subscriptions();
+      for (auto it = subscriptions.begin(); it != subscriptions.end(); it++) {
+        REQUIRE((*it == 2));
+      }
+
+      AND_THEN("Callbacks of all connections will be called."){
+        std::condition_variable cv;
+        std::mutex mtx;
+        std::deque<bool> ready(cons.size(), false);
+        for (size_t i = 0; i < cons.size(); i++) {
+          auto cb = make_shared<AnotherSimpleCallback>(cv, mtx, ready[i]);
+          cons[i]->get()->NoOp(cb);
+          fd_set a; int fd;
+          cons[i]->get()->Run(&a,&a,&fd);
+        }
+
+        std::chrono::system_clock::time_point timeout_time = std::chrono::system_clock::now() + std::chrono::seconds(10);
+        std::unique_lock<std::mutex> lck(mtx);
+        while (std::count(ready.begin(), ready.end(), true) < static_cast<long>(ready.size()) &&
+               std::chrono::system_clock::now() < timeout_time) {
+          cv.wait_until(lck, timeout_time);
+        }
+        REQUIRE((std::count(ready.begin(), ready.end(), true) == static_cast<long>(ready.size())));
+      }
+
+      AND_WHEN("The number of event loops is reduced and a connection is removed"){
+        listen.changeConfiguration(2);
+        cons.pop_back();
+
+        THEN("New connections are only assigned to the remaining loops"){
+          REQUIRE((listen.subscriptions().size() == 2));
+          cons.push_back(std::unique_ptr<kio::KineticAutoConnection>(new kio::KineticAutoConnection(
+            listen,
+            reconnects,
+            std::pair<ConnectionOptions,ConnectionOptions>(c.get(0),c.get(0)),
+            std::chrono::seconds(10)
+          )));
+          REQUIRE_NOTHROW(cons.back()->get());
+          auto subscriptions = listen.subscriptions();
+          REQUIRE((subscriptions[0] + subscriptions[1] == 5));
+        }
+      }
+    }
+  }
 };
\ No newline at end of file
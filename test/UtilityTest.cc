@@ -57,6 +57,24 @@ SCENARIO("Utility Test.", "[Utility]"){
         REQUIRE((target_size == extracted_size));
       }
 
+      AND_WHEN("We also encode a checksum."){
+        auto vc = utility::uuidGenerateEncodeSize(target_size, 0x0a1b2c3d);
+        THEN("Both size and checksum can be extracted again."){
+          uint32_t checksum = 0;
+          REQUIRE((utility::uuidDecodeSize(vc) == target_size));
+          REQUIRE(utility::uuidDecodeChecksum(vc, checksum));
+          REQUIRE((checksum == 0x0a1b2c3d));
+        }
+        THEN("The version keeps the format readers without checksum support accept."){
+          REQUIRE((vc->size() == v->size()));
+          REQUIRE((vc->substr(0, 10) == v->substr(0, 10)));
+        }
+        THEN("Versions without checksum do not contain one."){
+          uint32_t checksum = 0;
+          REQUIRE_FALSE(utility::uuidDecodeChecksum(v, checksum));
+        }
+      }
+
       WHEN("We manipulate the version size"){
         auto v2 = std::make_shared<const std::string>(*v + "123");
         THEN("Trying to extract the size attribute fails. "){
@@ -106,6 +124,25 @@ SCENARIO("Utility Test.", "[Utility]"){
 
   }
 
+  GIVEN("a file id"){
+    auto id = utility::makeFileId();
+    REQUIRE((id != utility::makeFileId()));
+
+    THEN("The metadata value of a file stored under its id references the id"){
+      auto reference = utility::makeBaseReference("/the/path", id);
+      REQUIRE((utility::metadataToBase("/the/path", reference) == id));
+
+      AND_THEN("The reference can follow other content of the metadata value"){
+        REQUIRE((utility::metadataToBase("/the/path", "kio-pack 0 10 .kio-pack/x\n" + reference) == id));
+      }
+    }
+    THEN("Files stored under their path do not need a reference"){
+      REQUIRE((utility::makeBaseReference("/the/path", "/the/path").empty()));
+      REQUIRE((utility::metadataToBase("/the/path", "") == "/the/path"));
+      REQUIRE((utility::metadataToBase("/the/path", "kio-pack 0 10 .kio-pack/x") == "/the/path"));
+    }
+  }
+
   GIVEN("a stripe vector"){
     std::vector< std::shared_ptr<const string> > stripe;
     int size = 1024*1024;
@@ -137,6 +174,16 @@ SCENARIO("Utility Test.", "[Utility]"){
       kio_notice("creating ", crcs.size(), " crc32c checksums took ",
                 std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::system_clock::now()-t).count(),
                 " milliseconds ");
+
+      AND_THEN("crc32c checksums of adjacent values can be combined"){
+        uint32_t combined = crcs[0];
+        string concatenated = *stripe[0];
+        for(size_t i=1; i<10; i++){
+          combined = crc32c_combine(combined, crcs[i], stripe[i]->length());
+          concatenated += *stripe[i];
+        }
+        REQUIRE((combined == crc32c(0, concatenated.c_str(), concatenated.length())));
+      }
     }
   }
 };
\ No newline at end of file
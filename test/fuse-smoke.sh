@@ -0,0 +1,80 @@
+#!/bin/bash
+#
+# Smoke test for the kineticio-fuse frontend. Mounts a cluster in the background (daemonized, as in production use),
+# runs basic file system operations in a scratch directory and compares the results against local copies.
+#
+# The cluster is taken from the KINETIC_DRIVE_LOCATION, KINETIC_DRIVE_SECURITY and KINETIC_CLUSTER_DEFINITION
+# environment variables, e.g. the simulator cluster of test/localhost.json while kio-test is running.
+#
+# usage: fuse-smoke.sh <path to kineticio-fuse> <cluster id>
+
+set -e
+
+if [ $# -ne 2 ]; then
+  echo "usage: $0 <path to kineticio-fuse> <cluster id>"
+  exit 1
+fi
+fuse=$1
+id=$2
+
+mnt=$(mktemp -d)
+tmp=$(mktemp -d)
+dir=$mnt/fuse-smoke-$$
+
+cleanup() {
+  rm -rf "$dir" 2>/dev/null || true
+  fusermount3 -u "$mnt" 2>/dev/null || fusermount -u "$mnt" 2>/dev/null || true
+  rmdir "$mnt"
+  rm -rf "$tmp"
+}
+trap cleanup EXIT
+
+fail() {
+  echo "FAILED: $*"
+  exit 1
+}
+
+"$fuse" --id "$id" "$mnt"
+for i in $(seq 50); do
+  mountpoint -q "$mnt" && break
+  sleep 0.1
+done
+mountpoint -q "$mnt" || fail "mount"
+
+# Threads of the library have to be running in the daemon, a request blocking here means they are not.
+timeout 30 df "$mnt" > /dev/null || fail "statfs"
+
+mkdir "$dir" || fail "mkdir"
+[ -d "$dir" ] || fail "mkdir: directory does not exist"
+
+# Multiple stripes and a partial last stripe.
+head -c 5000000 /dev/urandom > "$tmp/data"
+cp "$tmp/data" "$dir/file" || fail "write"
+cmp "$tmp/data" "$dir/file" || fail "read back"
+[ "$(stat -c %s "$dir/file")" -eq 5000000 ] || fail "size after write"
+
+head -c 12345 /dev/urandom > "$tmp/append"
+cat "$tmp/append" >> "$dir/file" || fail "append"
+cat "$tmp/append" >> "$tmp/data"
+cmp "$tmp/data" "$dir/file" || fail "read back after append"
+
+truncate -s 1000000 "$dir/file" || fail "truncate"
+truncate -s 1000000 "$tmp/data"
+[ "$(stat -c %s "$dir/file")" -eq 1000000 ] || fail "size after truncate"
+cmp "$tmp/data" "$dir/file" || fail "read back after truncate"
+
+mv "$dir/file" "$dir/renamed" || fail "rename"
+[ ! -e "$dir/file" ] || fail "rename: source still exists"
+cmp "$tmp/data" "$dir/renamed" || fail "read back after rename"
+
+mkdir "$dir/empty" || fail "mkdir below file"
+[ "$(ls "$dir" | tr '\n' ' ')" = "empty renamed " ] || fail "readdir"
+rmdir "$dir/empty" || fail "rmdir"
+[ ! -e "$dir/empty" ] || fail "rmdir: directory still exists"
+
+# Directories are derived from file paths, removing the last file removes the directory.
+rm "$dir/renamed" || fail "unlink"
+[ ! -e "$dir/renamed" ] || fail "unlink: file still exists"
+[ ! -e "$dir" ] || fail "unlink: directory still exists"
+
+echo "PASSED"
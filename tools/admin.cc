@@ -26,7 +26,7 @@ typedef kio::AdminClusterInterface::OperationTarget OperationTarget;
 
 enum class Operation
 {
-  STATUS, COUNT, SCAN, REPAIR, RESET, INVALID, CONFIG_SHOW, CONFIG_PUBLISH, CONFIG_UPLOAD
+  STATUS, COUNT, SCAN, REPAIR, RESET, GC, MIGRATE, INVALID, CONFIG_SHOW, CONFIG_PUBLISH, CONFIG_UPLOAD
 };
 
 struct Configuration
@@ -37,10 +37,15 @@ struct Configuration
   std::string space;
   std::string file;
   std::string tag;
+  std::string to;
   int numthreads;
+  int throttle;
   int verbosity;
   int numbench;
+  int benchdepth;
+  int benchsize;
   bool monitoring;
+  bool estimate;
 };
 
 std::string to_str(OperationTarget target)
@@ -89,6 +94,9 @@ int kinetic_help()
   fprintf(stdout, "           scan   : check keys and display their status information\n");
   fprintf(stdout, "           repair : check keys, repair as required, display key status information\n");
   fprintf(stdout, "           reset  : force remove keys (Warning: Data will be lost!)\n");
+  fprintf(stdout, "           gc     : remove deduplicated data that is no longer referenced\n");
+  fprintf(stdout, "           migrate: copy all files to the cluster specified with --to, skipping files\n");
+  fprintf(stdout, "                    that are unchanged since a previous migration\n");
   fprintf(stdout, "           status : show health status of cluster. \n");
   fprintf(stdout, "\n");
   fprintf(stdout, "    OPTIONS\n");
@@ -111,9 +119,26 @@ int kinetic_help()
   fprintf(stdout, "           Specify verbosity level. Messages are printed to stdout (warning set as default). \n");
   fprintf(stdout, "\n");
 #endif
+  fprintf(stdout, "       --to <name> \n");
+  fprintf(stdout, "           Only for migrate operation. The name of the cluster files are copied to. \n");
+  fprintf(stdout, "\n");
+  fprintf(stdout, "       --throttle <MB/s> \n");
+  fprintf(stdout, "           Only for migrate operation. Limit the read throughput from the source cluster. \n");
+  fprintf(stdout, "\n");
   fprintf(stdout, "       --bench <number>\n");
-  fprintf(stdout, "           Only for status operation. Benchmark put/get/delete performance for each  connection \n");
-  fprintf(stdout, "           using <number> 1MB keys to get rough per-connection throughput. \n");
+  fprintf(stdout, "           Only for status operation. Benchmark put/get/delete performance of all connections \n");
+  fprintf(stdout, "           concurrently using <number> keys. Reports IOPS, MB/s and latency percentiles per drive \n");
+  fprintf(stdout, "           and flags drives that are much slower than the cluster median as OUTLIER. \n");
+  fprintf(stdout, "\n");
+  fprintf(stdout, "       --qdepth <number>\n");
+  fprintf(stdout, "           Only for status operation. Requests outstanding per drive while benchmarking (default 1). \n");
+  fprintf(stdout, "\n");
+  fprintf(stdout, "       --valuesize <KB>\n");
+  fprintf(stdout, "           Only for status operation. Size of benchmark values (default 1024). \n");
+  fprintf(stdout, "\n");
+  fprintf(stdout, "       --estimate \n");
+  fprintf(stdout, "           Only for count operation. Return the key counters if enabled, otherwise estimate the \n");
+  fprintf(stdout, "           number of keys by sampling. Completes in seconds independent of the number of keys. \n");
   fprintf(stdout, "\n");
   fprintf(stdout, "       -m : monitoring key=value output format\n");
   fprintf(stdout, "------------------------------------------------------------------------------------------------\n");
@@ -125,8 +150,12 @@ bool parseArguments(const std::vector<std::string>& arguments, Configuration& co
   config.op = Operation::INVALID;
   config.numthreads = 1;
   config.numbench = 0;
+  config.benchdepth = 1;
+  config.benchsize = 1024;
+  config.throttle = 0;
   config.verbosity = LOG_WARNING;
   config.monitoring = false;
+  config.estimate = false;
   config.space = "default";
 
   for (unsigned i = 0; i < arguments.size(); i++) {
@@ -140,6 +169,10 @@ bool parseArguments(const std::vector<std::string>& arguments, Configuration& co
       config.op = Operation::STATUS;
     } else if (arguments[i] == "reset") {
       config.op = Operation::RESET;
+    } else if (arguments[i] == "gc") {
+      config.op = Operation::GC;
+    } else if (arguments[i] == "migrate") {
+      config.op = Operation::MIGRATE;
     } else if (arguments[i] == "config") {
       config.op = Operation::CONFIG_SHOW;
       if (i + 1 < arguments.size() && arguments[i + 1] == "--publish") {
@@ -158,6 +191,8 @@ bool parseArguments(const std::vector<std::string>& arguments, Configuration& co
       config.tag = "cluster";
     } else if (arguments[i] == "-m") {
       config.monitoring = true;
+    } else if (arguments[i] == "--estimate") {
+      config.estimate = true;
     } else if (arguments.size() == i + 1) {
       /* all arguments beyond this point are pairs */
       return false;
@@ -195,8 +230,16 @@ bool parseArguments(const std::vector<std::string>& arguments, Configuration& co
       config.file = std::string(arguments[++i]);
     } else if (arguments[i] == "--threads") {
       config.numthreads = atoi(arguments[++i].c_str());
+    } else if (arguments[i] == "--to") {
+      config.to = std::string(arguments[++i]);
+    } else if (arguments[i] == "--throttle") {
+      config.throttle = atoi(arguments[++i].c_str());
     } else if (arguments[i] == "--bench") {
       config.numbench = atoi(arguments[++i].c_str());;
+    } else if (arguments[i] == "--qdepth") {
+      config.benchdepth = atoi(arguments[++i].c_str());
+    } else if (arguments[i] == "--valuesize") {
+      config.benchsize = atoi(arguments[++i].c_str());
     }
   }
 
@@ -205,6 +248,19 @@ bool parseArguments(const std::vector<std::string>& arguments, Configuration& co
     config.targets = {OperationTarget::METADATA, OperationTarget::ATTRIBUTE, OperationTarget::DATA};
   }
 
+  /* Deduplicated content is stored in data keys */
+  if (config.op == Operation::GC) {
+    config.targets = {OperationTarget::DATA};
+  }
+
+  /* Migration works on files, which are enumerated by their metadata keys */
+  if (config.op == Operation::MIGRATE) {
+    if (config.to.empty()) {
+      return false;
+    }
+    config.targets = {OperationTarget::METADATA};
+  }
+
   /* A valid operation has to be set */
   if (config.op == Operation::INVALID) {
     return false;
@@ -430,6 +486,14 @@ void printResults(const Configuration& config, KeyCounts& kc)
   } else if (config.op == Operation::RESET) {
     fprintf(stdout, "# Keys removed:                              %d\n", kc.removed);
     fprintf(stdout, "# Failed to remove:                          %d\n", kc.unrepairable);
+  } else if (config.op == Operation::GC) {
+    fprintf(stdout, "# Unreferenced content:                      %d\n", kc.need_action);
+    fprintf(stdout, "# Content removed:                           %d\n", kc.removed);
+    fprintf(stdout, "# Failed to collect:                         %d\n", kc.unrepairable);
+  } else if (config.op == Operation::MIGRATE) {
+    fprintf(stdout, "# Files copied:                              %d\n", kc.repaired);
+    fprintf(stdout, "# Files unchanged since last migration:      %d\n", kc.total - kc.need_action);
+    fprintf(stdout, "# Failed to migrate:                         %d\n", kc.unrepairable);
   }
   fprintf(stdout, "# Keys with chunks on inaccessible drives:   %d\n", kc.incomplete);
   fprintf(stdout, "# ------------------------------------------------------------------------\n");
@@ -438,14 +502,23 @@ void printResults(const Configuration& config, KeyCounts& kc)
 void do_operation(Configuration& config, std::shared_ptr<kio::AdminClusterInterface> ac)
 {
   if (config.op == Operation::STATUS) {
-    auto v = ac->status(config.numbench);
+    auto v = ac->status(config.numbench, config.benchdepth, config.benchsize * 1024);
     if (config.monitoring) {
       fprintf(stdout, "kinetic.connections.total=%u kinetic.connections.failed=%u\n", v.drives_total,
               v.drives_failed);
       fprintf(stdout, "kinetic.redundancy_factor=%u\n", v.redundancy_factor);
       fprintf(stdout, "kinetic.indicator_exist=%s\n", v.indicator_exist ? "YES" : "NO");
       for (unsigned int i = 0; i < v.connected.size(); i++) {
-        fprintf(stdout, "kinetic.drive.index=%u kinetic.drive.status=%s\n", i, v.connected[i] ? "OK" : "FAILED");
+        fprintf(stdout, "kinetic.drive.index=%u kinetic.drive.status=%s", i, v.connected[i] ? "OK" : "FAILED");
+        if (i < v.benchmark.size()) {
+          const auto& b = v.benchmark[i];
+          fprintf(stdout, " kinetic.drive.put.iops=%.1f kinetic.drive.put.mbps=%.1f kinetic.drive.put.p50=%.1f "
+                      "kinetic.drive.put.p99=%.1f kinetic.drive.get.iops=%.1f kinetic.drive.get.mbps=%.1f "
+                      "kinetic.drive.get.p50=%.1f kinetic.drive.get.p99=%.1f kinetic.drive.outlier=%s",
+                  b.put_iops, b.put_mbps, b.put_latency_p50, b.put_latency_p99, b.get_iops, b.get_mbps,
+                  b.get_latency_p50, b.get_latency_p99, b.outlier ? "YES" : "NO");
+        }
+        fprintf(stdout, "\n");
       }
     } else {
       fprintf(stdout, "# ------------------------------------------------------------------------\n");
@@ -469,6 +542,7 @@ void do_operation(Configuration& config, std::shared_ptr<kio::AdminClusterInterf
     auto callback = std::bind(callbackfunction, !config.monitoring, std::placeholders::_1);
 
     int tcount = 0;
+    int terror = 0;
     KeyCounts tstats{0, 0, 0, 0, 0, 0};
 
     for (unsigned i = 0; i < config.targets.size(); i++) {
@@ -479,7 +553,14 @@ void do_operation(Configuration& config, std::shared_ptr<kio::AdminClusterInterf
       }
       switch (config.op) {
         case Operation::COUNT:
-          tcount += ac->count(target, callback);
+          if (config.estimate) {
+            auto estimate = ac->estimateCount(target);
+            tcount += estimate.count;
+            /* An unknown error of a single target makes the total error unknown. */
+            terror = terror < 0 || estimate.error < 0 ? -1 : terror + estimate.error;
+          } else {
+            tcount += ac->count(target, callback);
+          }
           break;
         case Operation::SCAN:
           tstats = tstats + ac->scan(target, callback, config.numthreads);
@@ -490,6 +571,12 @@ void do_operation(Configuration& config, std::shared_ptr<kio::AdminClusterInterf
         case Operation::RESET:
           tstats = tstats + ac->reset(target, callback, config.numthreads);
           break;
+        case Operation::GC:
+          tstats = tstats + ac->collectGarbage(callback, config.numthreads);
+          break;
+        case Operation::MIGRATE:
+          tstats = tstats + ac->migrate(config.to, callback, config.numthreads, config.throttle);
+          break;
         default:
           throw std::runtime_error("No valid operation specified.");
       }
@@ -500,11 +587,24 @@ void do_operation(Configuration& config, std::shared_ptr<kio::AdminClusterInterf
 
     if (config.op == Operation::COUNT) {
       if (config.monitoring) {
-        fprintf(stdout, "kinetic.stat.keys.n=%d\n", tcount);
+        fprintf(stdout, "kinetic.stat.keys.n=%d", tcount);
+        if (config.estimate) {
+          fprintf(stdout, " kinetic.stat.keys.error=%d", terror);
+        }
+        fprintf(stdout, "\n");
       } else {
         fprintf(stdout, "\n");
         fprintf(stdout, "# ------------------------------------------------------------------------\n");
-        fprintf(stdout, "# Completed Operation - Counted a total of %d keys\n", tcount);
+        if (config.estimate) {
+          if (terror < 0) {
+            fprintf(stdout, "# Completed Operation - Estimated a total of %d keys (error unknown)\n", tcount);
+          }
+          else {
+            fprintf(stdout, "# Completed Operation - Estimated a total of %d keys (+/- %d)\n", tcount, terror);
+          }
+        } else {
+          fprintf(stdout, "# Completed Operation - Counted a total of %d keys\n", tcount);
+        }
         fprintf(stdout, "# ------------------------------------------------------------------------\n");
       }
     } else {
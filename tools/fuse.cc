@@ -0,0 +1,569 @@
+/************************************************************************
+ * KineticIo - a file io interface library to kinetic devices.          *
+ *                                                                      *
+ * This Source Code Form is subject to the terms of the Mozilla         *
+ * Public License, v. 2.0. If a copy of the MPL was not                 *
+ * distributed with this file, You can obtain one at                    *
+ * https://mozilla.org/MP:/2.0/.                                        *
+ *                                                                      *
+ * This program is distributed in the hope that it will be useful,      *
+ * but is provided AS-IS, WITHOUT ANY WARRANTY; including without       *
+ * the implied warranty of MERCHANTABILITY, NON-INFRINGEMENT or         *
+ * FITNESS FOR A PARTICULAR PURPOSE. See the Mozilla Public             *
+ * License for more details.                                            *
+ ************************************************************************/
+
+#define FUSE_USE_VERSION 31
+
+#include <fuse.h>
+#include <kio/KineticIoFactory.hh>
+#include "KineticIoSingleton.hh"
+#include <sys/syslog.h>
+#include <sys/statvfs.h>
+#include <sys/vfs.h>
+#include <unistd.h>
+#include <string.h>
+#include <stdlib.h>
+#include <stdio.h>
+#include <errno.h>
+#include <system_error>
+#include <mutex>
+#include <set>
+
+#ifndef RENAME_NOREPLACE
+#define RENAME_NOREPLACE (1 << 0)
+#endif
+#ifndef RENAME_EXCHANGE
+#define RENAME_EXCHANGE (1 << 1)
+#endif
+
+/* Mount a kinetic cluster as a file system. Every open file is backed by a FileIo object, so applications get the
+ * stripe cache and readahead of the library. Directories do not exist in the cluster namespace, they are derived from
+ * the paths of existing files. Empty directories created by mkdir only exist for the lifetime of the mount. */
+
+namespace {
+
+struct Configuration
+{
+  std::string id;
+  size_t max_io;
+  int verbosity;
+};
+
+Configuration config;
+
+//! empty directories created during the lifetime of the mount
+std::set<std::string> directories;
+std::mutex directories_mutex;
+
+//! an open file
+struct Handle
+{
+  std::unique_ptr<kio::FileIoInterface> io;
+  //! FileIo objects are not thread safe, fuse might issue concurrent requests for the same file handle
+  std::mutex mutex;
+};
+
+std::string toUrl(const char* path)
+{
+  return "kinetic://" + config.id + path;
+}
+
+Handle* toHandle(struct fuse_file_info* fi)
+{
+  return reinterpret_cast<Handle*>(fi->fh);
+}
+
+int toErrno(const std::exception& e)
+{
+  auto se = dynamic_cast<const std::system_error*>(&e);
+  if (se && se->code().value()) {
+    return -se->code().value();
+  }
+  return -EIO;
+}
+
+bool mshouldLog(const char* func, int level, int target_level)
+{
+  return level <= target_level;
+}
+
+void mlog(const char* func, const char* file, int line, int level, const char* msg)
+{
+  fprintf(stderr, "kineticio-fuse: %s\n", msg);
+}
+
+//------------------------------------------------------------------------------
+//! List the entries directly below a directory. As files are listed in order,
+//! all files of a subdirectory are contiguous and the subdirectory is reported
+//! once.
+//!
+//! @param path the directory path, "/" for the root directory
+//! @param max stop after this many entries
+//! @param entries the entry names and whether they are directories
+//------------------------------------------------------------------------------
+void listDirectory(const char* path, size_t max, std::vector<std::pair<std::string, bool>>& entries)
+{
+  auto url = toUrl(path);
+  if (url[url.size() - 1] != '/') {
+    url += "/";
+  }
+  auto io = kio::KineticIoFactory::makeFileIo(url);
+  const size_t batch_size = 1000;
+
+  auto subtree = url;
+  while (entries.size() < max) {
+    auto names = io->ListFiles(subtree, batch_size);
+    for (auto it = names.cbegin(); it != names.cend(); it++) {
+      if (it->compare(0, url.size(), url) != 0) {
+        return;
+      }
+      auto name = it->substr(url.size());
+      auto slash = name.find('/');
+      bool directory = slash != std::string::npos;
+      if (directory) {
+        name = name.substr(0, slash);
+      }
+      if (name.empty() || (!entries.empty() && entries.back().first == name)) {
+        continue;
+      }
+      entries.push_back(std::make_pair(name, directory));
+      if (entries.size() == max) {
+        return;
+      }
+    }
+    if (names.size() < batch_size) {
+      return;
+    }
+    subtree = names.back() + " ";
+  }
+}
+
+bool isDirectory(const char* path)
+{
+  if (!strcmp(path, "/")) {
+    return true;
+  }
+  {
+    std::lock_guard<std::mutex> lock(directories_mutex);
+    if (directories.count(path)) {
+      return true;
+    }
+  }
+  std::vector<std::pair<std::string, bool>> entries;
+  listDirectory(path, 1, entries);
+  return !entries.empty();
+}
+
+void setFileAttributes(const struct stat& kst, struct stat* st)
+{
+  memset(st, 0, sizeof(struct stat));
+  st->st_mode = S_IFREG | 0644;
+  st->st_nlink = 1;
+  st->st_uid = getuid();
+  st->st_gid = getgid();
+  st->st_size = kst.st_size;
+  st->st_blksize = kst.st_blksize;
+  st->st_blocks = (kst.st_size + 511) / 512;
+}
+
+void setDirectoryAttributes(struct stat* st)
+{
+  memset(st, 0, sizeof(struct stat));
+  st->st_mode = S_IFDIR | 0755;
+  st->st_nlink = 2;
+  st->st_uid = getuid();
+  st->st_gid = getgid();
+}
+
+void* kio_init(struct fuse_conn_info* conn, struct fuse_config* cfg)
+{
+  /* The library starts its threads when it is first used. Fuse calls init after it daemonized, accessing the cluster
+   * from main() instead would start the threads in the parent process, they would not exist after the fork. */
+  try {
+    config.max_io = kio::kio().cmap().getCluster(config.id)->limits().max_value_size;
+  } catch (const std::exception& e) {
+    syslog(LOG_ERR, "kineticio-fuse: failed accessing cluster %s: %s", config.id.c_str(), e.what());
+    fprintf(stderr, "Failed accessing cluster %s: %s\n", config.id.c_str(), e.what());
+    fuse_exit(fuse_get_context()->fuse);
+    return NULL;
+  }
+
+  /* Let the kernel page cache absorb small writes and hand us large ones. Splice is not requested, read and write
+   * copy from and to memory buffers, so splicing requests and replies through a pipe would only add a copy. */
+  if (conn->capable & FUSE_CAP_WRITEBACK_CACHE) {
+    conn->want |= FUSE_CAP_WRITEBACK_CACHE;
+  }
+  if (conn->capable & FUSE_CAP_ASYNC_READ) {
+    conn->want |= FUSE_CAP_ASYNC_READ;
+  }
+  /* Size requests to match full stripes. */
+  conn->max_write = static_cast<unsigned>(config.max_io);
+  conn->max_readahead = static_cast<unsigned>(config.max_io);
+
+  /* Keep cached pages across opens unless size or mtime changed, the library validates its own cache. */
+  cfg->auto_cache = 1;
+  cfg->use_ino = 0;
+  return NULL;
+}
+
+int kio_getattr(const char* path, struct stat* st, struct fuse_file_info* fi)
+{
+  try {
+    struct stat kst;
+    if (fi && fi->fh) {
+      auto h = toHandle(fi);
+      std::lock_guard<std::mutex> lock(h->mutex);
+      h->io->Stat(&kst);
+      setFileAttributes(kst, st);
+      return 0;
+    }
+    if (strcmp(path, "/")) {
+      try {
+        kio::KineticIoFactory::makeFileIo(toUrl(path))->Stat(&kst);
+        setFileAttributes(kst, st);
+        return 0;
+      } catch (const std::system_error& e) {
+        if (e.code() != std::errc::no_such_file_or_directory) {
+          throw;
+        }
+      }
+    }
+    if (isDirectory(path)) {
+      setDirectoryAttributes(st);
+      return 0;
+    }
+    return -ENOENT;
+  } catch (const std::exception& e) {
+    return toErrno(e);
+  }
+}
+
+int kio_readdir(const char* path, void* buf, fuse_fill_dir_t filler, off_t offset, struct fuse_file_info* fi,
+                enum fuse_readdir_flags flags)
+{
+  try {
+    std::vector<std::pair<std::string, bool>> entries;
+    listDirectory(path, static_cast<size_t>(-1), entries);
+
+    std::string prefix(path);
+    if (prefix[prefix.size() - 1] != '/') {
+      prefix += "/";
+    }
+    {
+      std::lock_guard<std::mutex> lock(directories_mutex);
+      for (auto it = directories.lower_bound(prefix); it != directories.end(); it++) {
+        if (it->compare(0, prefix.size(), prefix) != 0) {
+          break;
+        }
+        auto name = it->substr(prefix.size());
+        if (name.find('/') == std::string::npos) {
+          entries.push_back(std::make_pair(name, true));
+        }
+      }
+    }
+
+    filler(buf, ".", NULL, 0, static_cast<fuse_fill_dir_flags>(0));
+    filler(buf, "..", NULL, 0, static_cast<fuse_fill_dir_flags>(0));
+    std::set<std::string> reported;
+    for (auto it = entries.cbegin(); it != entries.cend(); it++) {
+      if (!reported.insert(it->first).second) {
+        continue;
+      }
+      struct stat st;
+      memset(&st, 0, sizeof(struct stat));
+      st.st_mode = it->second ? S_IFDIR : S_IFREG;
+      if (filler(buf, it->first.c_str(), &st, 0, static_cast<fuse_fill_dir_flags>(0))) {
+        break;
+      }
+    }
+    return 0;
+  } catch (const std::exception& e) {
+    return toErrno(e);
+  }
+}
+
+int kio_mkdir(const char* path, mode_t mode)
+{
+  try {
+    if (isDirectory(path)) {
+      return -EEXIST;
+    }
+  } catch (const std::exception& e) {
+    return toErrno(e);
+  }
+  std::lock_guard<std::mutex> lock(directories_mutex);
+  directories.insert(path);
+  return 0;
+}
+
+int kio_rmdir(const char* path)
+{
+  try {
+    std::vector<std::pair<std::string, bool>> entries;
+    listDirectory(path, 1, entries);
+    if (!entries.empty()) {
+      return -ENOTEMPTY;
+    }
+  } catch (const std::exception& e) {
+    return toErrno(e);
+  }
+  std::lock_guard<std::mutex> lock(directories_mutex);
+  return directories.erase(path) ? 0 : -ENOENT;
+}
+
+int openHandle(const char* path, int flags, struct fuse_file_info* fi)
+{
+  try {
+    std::unique_ptr<Handle> h(new Handle());
+    h->io = kio::KineticIoFactory::makeFileIo(toUrl(path));
+    h->io->Open(flags);
+    if (fi->flags & O_TRUNC) {
+      h->io->Truncate(0);
+    }
+    fi->fh = reinterpret_cast<uint64_t>(h.release());
+    return 0;
+  } catch (const std::exception& e) {
+    return toErrno(e);
+  }
+}
+
+int kio_create(const char* path, mode_t mode, struct fuse_file_info* fi)
+{
+  int rc = openHandle(path, SFS_O_CREAT, fi);
+  if (!rc) {
+    std::lock_guard<std::mutex> lock(directories_mutex);
+    auto parent = std::string(path).substr(0, std::string(path).find_last_of('/'));
+    directories.erase(parent);
+  }
+  return rc;
+}
+
+int kio_open(const char* path, struct fuse_file_info* fi)
+{
+  return openHandle(path, 0, fi);
+}
+
+int kio_read(const char* path, char* buf, size_t size, off_t offset, struct fuse_file_info* fi)
+{
+  auto h = toHandle(fi);
+  std::lock_guard<std::mutex> lock(h->mutex);
+  try {
+    return static_cast<int>(h->io->Read(offset, buf, static_cast<int>(size)));
+  } catch (const std::exception& e) {
+    return toErrno(e);
+  }
+}
+
+int kio_write(const char* path, const char* buf, size_t size, off_t offset, struct fuse_file_info* fi)
+{
+  auto h = toHandle(fi);
+  std::lock_guard<std::mutex> lock(h->mutex);
+  try {
+    return static_cast<int>(h->io->Write(offset, buf, static_cast<int>(size)));
+  } catch (const std::exception& e) {
+    return toErrno(e);
+  }
+}
+
+int kio_truncate(const char* path, off_t size, struct fuse_file_info* fi)
+{
+  try {
+    if (fi && fi->fh) {
+      auto h = toHandle(fi);
+      std::lock_guard<std::mutex> lock(h->mutex);
+      h->io->Truncate(size);
+      return 0;
+    }
+    auto io = kio::KineticIoFactory::makeFileIo(toUrl(path));
+    io->Open(0);
+    io->Truncate(size);
+    io->Close();
+    return 0;
+  } catch (const std::exception& e) {
+    return toErrno(e);
+  }
+}
+
+int kio_fsync(const char* path, int datasync, struct fuse_file_info* fi)
+{
+  auto h = toHandle(fi);
+  std::lock_guard<std::mutex> lock(h->mutex);
+  try {
+    h->io->Sync();
+    return 0;
+  } catch (const std::exception& e) {
+    return toErrno(e);
+  }
+}
+
+int kio_flush(const char* path, struct fuse_file_info* fi)
+{
+  return kio_fsync(path, 0, fi);
+}
+
+int kio_release(const char* path, struct fuse_file_info* fi)
+{
+  std::unique_ptr<Handle> h(toHandle(fi));
+  fi->fh = 0;
+  try {
+    h->io->Close();
+    return 0;
+  } catch (const std::exception& e) {
+    return toErrno(e);
+  }
+}
+
+int kio_unlink(const char* path)
+{
+  try {
+    auto io = kio::KineticIoFactory::makeFileIo(toUrl(path));
+    io->Open(0);
+    io->Remove();
+    return 0;
+  } catch (const std::exception& e) {
+    return toErrno(e);
+  }
+}
+
+int kio_rename(const char* from, const char* to, unsigned int flags)
+{
+  if (flags & RENAME_EXCHANGE) {
+    return -EINVAL;
+  }
+  try {
+    /* Renaming a directory would require renaming every file below it. */
+    if (isDirectory(from)) {
+      return -EXDEV;
+    }
+    auto io = kio::KineticIoFactory::makeFileIo(toUrl(from));
+    io->Open(0);
+    try {
+      io->Rename(toUrl(to));
+    } catch (const std::system_error& e) {
+      if (e.code() != std::errc::file_exists || (flags & RENAME_NOREPLACE)) {
+        throw;
+      }
+      /* POSIX rename replaces an existing target. */
+      kio::KineticIoFactory::makeFileIo(toUrl(to))->Remove();
+      io->Rename(toUrl(to));
+    }
+    return 0;
+  } catch (const std::exception& e) {
+    return toErrno(e);
+  }
+}
+
+int kio_statfs(const char* path, struct statvfs* st)
+{
+  try {
+    struct statfs sfs;
+    memset(&sfs, 0, sizeof(sfs));
+    kio::KineticIoFactory::makeFileIo(toUrl("/"))->Statfs(&sfs);
+
+    memset(st, 0, sizeof(struct statvfs));
+    st->f_bsize = config.max_io;
+    st->f_frsize = sfs.f_bsize;
+    st->f_blocks = sfs.f_blocks;
+    st->f_bfree = sfs.f_bfree;
+    st->f_bavail = sfs.f_bavail;
+    st->f_files = sfs.f_files;
+    st->f_ffree = sfs.f_ffree;
+    st->f_favail = sfs.f_ffree;
+    st->f_namemax = 1024;
+    return 0;
+  } catch (const std::exception& e) {
+    return toErrno(e);
+  }
+}
+
+/* Ownership, permissions and timestamps are not stored, accept changes so that tools like cp -p do not fail. */
+int kio_chmod(const char* path, mode_t mode, struct fuse_file_info* fi)
+{
+  return 0;
+}
+
+int kio_chown(const char* path, uid_t uid, gid_t gid, struct fuse_file_info* fi)
+{
+  return 0;
+}
+
+int kio_utimens(const char* path, const struct timespec tv[2], struct fuse_file_info* fi)
+{
+  return 0;
+}
+
+int usage(const char* name)
+{
+  fprintf(stdout, "usage: %s --id <name> [--verbosity debug|notice|warning|error] <mountpoint> [FUSE OPTIONS]\n",
+          name);
+  fprintf(stdout, "\n");
+  fprintf(stdout, "       --id <name> \n");
+  fprintf(stdout, "           the name of the cluster to mount\n");
+  fprintf(stdout, "\n");
+  fprintf(stdout, "       Requests are handled multi-threaded unless -s is specified. Use -f to run in foreground.\n");
+  return EXIT_FAILURE;
+}
+
+}
+
+int main(int argc, char** argv)
+{
+  config.verbosity = LOG_WARNING;
+
+  /* Consume our own arguments, pass everything else on to fuse. */
+  std::vector<char*> fuse_argv;
+  fuse_argv.push_back(argv[0]);
+  for (int i = 1; i < argc; i++) {
+    std::string arg(argv[i]);
+    if (arg == "--id" && i + 1 < argc) {
+      config.id = argv[++i];
+    } else if (arg == "--verbosity" && i + 1 < argc) {
+      std::string level(argv[++i]);
+      if (level == "debug") {
+        config.verbosity = LOG_DEBUG;
+      } else if (level == "notice") {
+        config.verbosity = LOG_NOTICE;
+      } else if (level == "warning") {
+        config.verbosity = LOG_WARNING;
+      } else if (level == "error") {
+        config.verbosity = LOG_ERR;
+      } else {
+        return usage(argv[0]);
+      }
+    } else {
+      fuse_argv.push_back(argv[i]);
+    }
+  }
+  if (config.id.empty()) {
+    return usage(argv[0]);
+  }
+
+  kio::KineticIoFactory::registerLogFunction(
+      mlog, std::bind(mshouldLog, std::placeholders::_1, std::placeholders::_2, config.verbosity)
+  );
+
+  struct fuse_operations ops;
+  memset(&ops, 0, sizeof(ops));
+  ops.init = kio_init;
+  ops.getattr = kio_getattr;
+  ops.readdir = kio_readdir;
+  ops.mkdir = kio_mkdir;
+  ops.rmdir = kio_rmdir;
+  ops.create = kio_create;
+  ops.open = kio_open;
+  ops.read = kio_read;
+  ops.write = kio_write;
+  ops.truncate = kio_truncate;
+  ops.fsync = kio_fsync;
+  ops.flush = kio_flush;
+  ops.release = kio_release;
+  ops.unlink = kio_unlink;
+  ops.rename = kio_rename;
+  ops.statfs = kio_statfs;
+  ops.chmod = kio_chmod;
+  ops.chown = kio_chown;
+  ops.utimens = kio_utimens;
+
+  return fuse_main(static_cast<int>(fuse_argv.size()), fuse_argv.data(), &ops, NULL);
+}